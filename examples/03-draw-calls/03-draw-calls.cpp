@@ -130,6 +130,8 @@ class NormalMappingExample : public bdr::BaseGame
         view.setCamera(&camera);
         // Enable mesh pass
         RenderPassHandle passId = addMeshPass(renderSystem, &view);
+        meshPassId = passId;
+        meshView = &view;
         renderSystem.init(&renderer);
 
         std::string shaderFilePath = "../examples/03-draw-calls/normal_mapping.hlsl";
@@ -198,6 +200,7 @@ class NormalMappingExample : public bdr::BaseGame
                 transform.translation.z = padding * (j - (float(numEntities) / 2.0f));
                 transform.mask |= TransformType::Translation;
                 assignTransform(scene, entity, transform);
+                assignBounds(scene, entity, renderer.meshes[meshHandle].bounds);
 
                 RenderObjectDesc rod = {
                     entity,
@@ -225,6 +228,17 @@ class NormalMappingExample : public bdr::BaseGame
         updateMatrices(scene.registry);
         copyDrawData(scene.registry);
         //prepare(scene);
+
+        const CullingStats& cullingStats = getCullingStats(renderSystem.getPass(meshPassId), meshView);
+        if (cullingStats.numVisible != lastCullingStats.numVisible || cullingStats.numCulled != lastCullingStats.numCulled
+            || cullingStats.numOccluded != lastCullingStats.numOccluded || cullingStats.numTriangles != lastCullingStats.numTriangles) {
+            Utility::Printf(
+                "%s: %u visible, %u culled, %u occluded, %u triangles (%u at full detail), %u of %u meshlets culled\n",
+                meshView->name.c_str(), cullingStats.numVisible, cullingStats.numCulled, cullingStats.numOccluded,
+                cullingStats.numTriangles, cullingStats.numFullDetailTriangles, cullingStats.numMeshletsCulled, cullingStats.numMeshlets
+            );
+            lastCullingStats = cullingStats;
+        }
     }
 
 private:
@@ -232,6 +246,9 @@ private:
     typedef uint32_t BDRid;
 
     OrbitCameraController cameraController;
+    RenderPassHandle meshPassId;
+    const bdr::View* meshView = nullptr;
+    CullingStats lastCullingStats;
 };
 
 ENTRY_IMPLEMENT_MAIN(NormalMappingExample);
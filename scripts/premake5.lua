@@ -124,24 +124,29 @@ project("bdr_lib")
   configuration {}
 
 
-  -- project("tests")
-  -- uuid(os.uuid("tests"))
-  -- kind "StaticLib"
+project("tests")
+  uuid(os.uuid("tests"))
+  kind "ConsoleApp"
 
-  -- files {
-  --   path.join(TESTS_DIR, "**.cpp"),
-  -- }
+  files {
+    path.join(TESTS_DIR, "**.cpp"),
+  }
+
+  includedirs {
+    BDR_SRC_DIR,
+    EXTERNAL_DIR,
+  }
 
-  -- includedirs {
-  --   BDR_SRC_DIR,
-  --   EXTERNAL_DIR,
-  -- }
+  -- Benchmarks are tagged [.][benchmark] and only run when asked for
+  defines {
+    "CATCH_CONFIG_ENABLE_BENCHMARKING",
+  }
 
-  -- links {
-  --   "bdr_lib",
-  -- }
+  links {
+    "bdr_lib",
+  }
 
-  -- configuration {}
+  configuration {}
 
 
 
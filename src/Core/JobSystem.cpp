@@ -0,0 +1,105 @@
+#include "pch.h"
+#include "JobSystem.h"
+
+
+namespace bdr
+{
+    JobSystem::JobSystem(uint32_t numWorkers)
+    {
+        if (numWorkers == 0) {
+            const uint32_t numHardwareThreads = std::thread::hardware_concurrency();
+            numWorkers = numHardwareThreads > 1 ? numHardwareThreads - 1 : 0;
+        }
+        workers.reserve(numWorkers);
+        for (uint32_t i = 0; i < numWorkers; ++i) {
+            workers.emplace_back(&JobSystem::workerLoop, this);
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            isShuttingDown = true;
+        }
+        wakeCondition.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void JobSystem::parallelFor(const size_t count, const size_t grainSize, const RangeFunction& function)
+    {
+        if (count == 0) {
+            return;
+        }
+        const size_t grain = std::max(grainSize, size_t(1));
+        if (workers.empty() || count <= grain) {
+            function(0, count);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            currentFunction = &function;
+            currentCount = count;
+            currentGrainSize = grain;
+            nextIndex.store(0);
+            ++generation;
+        }
+        wakeCondition.notify_all();
+
+        runRanges(function, count, grain);
+
+        // Every range has been claimed at this point, wait for the workers still running theirs.
+        // Workers that wake up after this see an empty loop and go back to sleep.
+        std::unique_lock<std::mutex> lock{ mutex };
+        doneCondition.wait(lock, [this]() { return numBusyWorkers == 0; });
+        currentFunction = nullptr;
+        currentCount = 0;
+    }
+
+    void JobSystem::runRanges(const RangeFunction& function, const size_t count, const size_t grainSize)
+    {
+        while (true) {
+            const size_t begin = nextIndex.fetch_add(grainSize);
+            if (begin >= count) {
+                return;
+            }
+            function(begin, std::min(begin + grainSize, count));
+        }
+    }
+
+    void JobSystem::workerLoop()
+    {
+        uint64_t lastGeneration = 0;
+        while (true) {
+            const RangeFunction* function = nullptr;
+            size_t count = 0;
+            size_t grainSize = 1;
+            {
+                std::unique_lock<std::mutex> lock{ mutex };
+                wakeCondition.wait(lock, [&]() { return isShuttingDown || generation != lastGeneration; });
+                if (isShuttingDown) {
+                    return;
+                }
+                lastGeneration = generation;
+                if (currentCount == 0) {
+                    continue;
+                }
+                function = currentFunction;
+                count = currentCount;
+                grainSize = currentGrainSize;
+                ++numBusyWorkers;
+            }
+
+            runRanges(*function, count, grainSize);
+
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                --numBusyWorkers;
+            }
+            doneCondition.notify_one();
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "pch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bdr
+{
+    // A fixed pool of worker threads for data parallel loops.
+    // parallelFor splits [0, count) into ranges of grainSize that workers (and the calling thread) pull from
+    // a shared counter, and only returns once every range has run.
+    // Only one parallelFor can be in flight at a time, and it must not be called from inside a job.
+    class JobSystem
+    {
+    public:
+        typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+
+        // numWorkers == 0 uses one worker per hardware thread, minus the calling thread
+        explicit JobSystem(uint32_t numWorkers = 0);
+        ~JobSystem();
+
+        UNCOPIABLE(JobSystem);
+        UNMOVABLE(JobSystem);
+
+        // Worker threads plus the thread calling parallelFor
+        inline uint32_t getNumThreads() const
+        {
+            return uint32_t(workers.size()) + 1u;
+        };
+
+        void parallelFor(const size_t count, const size_t grainSize, const RangeFunction& function);
+
+    private:
+        void workerLoop();
+        void runRanges(const RangeFunction& function, const size_t count, const size_t grainSize);
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wakeCondition;
+        std::condition_variable doneCondition;
+        uint64_t generation = 0;
+        uint32_t numBusyWorkers = 0;
+        bool isShuttingDown = false;
+
+        // The loop currently being run. Only read or written with the mutex held, except for nextIndex.
+        const RangeFunction* currentFunction = nullptr;
+        size_t currentCount = 0;
+        size_t currentGrainSize = 1;
+        std::atomic<size_t> nextIndex{ 0 };
+    };
+}
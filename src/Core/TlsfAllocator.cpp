@@ -0,0 +1,286 @@
+#include "pch.h"
+#include "TlsfAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+namespace bdr
+{
+    // Index of the highest set bit, value can't be zero
+    inline uint32_t findLastSet(const uint32_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanReverse(&idx, value);
+        return uint32_t(idx);
+#else
+        return 31u - uint32_t(__builtin_clz(value));
+#endif
+    }
+
+    // Index of the lowest set bit, value can't be zero
+    inline uint32_t findFirstSet(const uint32_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward(&idx, value);
+        return uint32_t(idx);
+#else
+        return uint32_t(__builtin_ctz(value));
+#endif
+    }
+
+    // The free list holding blocks of size
+    inline void mapSize(const uint32_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+    {
+        if (size < kTlsfSecondLevels) {
+            firstLevel = 0;
+            secondLevel = size;
+        }
+        else {
+            const uint32_t lastSet = findLastSet(size);
+            firstLevel = lastSet - kTlsfSecondLevelBits + 1u;
+            secondLevel = (size >> (lastSet - kTlsfSecondLevelBits)) - kTlsfSecondLevels;
+        }
+    }
+
+    void TlsfAllocator::init(const uint32_t size)
+    {
+        blocks.clear();
+        unusedBlocks.clear();
+        allocations.clear();
+        firstLevelBitmap = 0;
+        for (uint32_t firstLevel = 0; firstLevel < kTlsfFirstLevels; ++firstLevel) {
+            secondLevelBitmaps[firstLevel] = 0;
+            for (uint32_t secondLevel = 0; secondLevel < kTlsfSecondLevels; ++secondLevel) {
+                freeLists[firstLevel][secondLevel] = kInvalidAllocation;
+            }
+        }
+        totalSize = size;
+        usedSize = 0;
+        firstBlock = kInvalidAllocation;
+        if (size > 0) {
+            firstBlock = createBlock(0, size);
+            insertFreeBlock(firstBlock);
+        }
+    }
+
+    uint32_t TlsfAllocator::createBlock(const uint32_t offset, const uint32_t size)
+    {
+        uint32_t blockIdx;
+        if (unusedBlocks.empty()) {
+            blockIdx = uint32_t(blocks.size());
+            blocks.emplace_back();
+        }
+        else {
+            blockIdx = unusedBlocks.back();
+            unusedBlocks.pop_back();
+            blocks[blockIdx] = Block{};
+        }
+        blocks[blockIdx].offset = offset;
+        blocks[blockIdx].size = size;
+        return blockIdx;
+    }
+
+    void TlsfAllocator::insertFreeBlock(const uint32_t blockIdx)
+    {
+        Block& block = blocks[blockIdx];
+        uint32_t firstLevel, secondLevel;
+        mapSize(block.size, firstLevel, secondLevel);
+        uint32_t& head = freeLists[firstLevel][secondLevel];
+        block.isFree = true;
+        block.prevFree = kInvalidAllocation;
+        block.nextFree = head;
+        if (head != kInvalidAllocation) {
+            blocks[head].prevFree = blockIdx;
+        }
+        head = blockIdx;
+        firstLevelBitmap |= 1u << firstLevel;
+        secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    }
+
+    void TlsfAllocator::removeFreeBlock(const uint32_t blockIdx)
+    {
+        Block& block = blocks[blockIdx];
+        uint32_t firstLevel, secondLevel;
+        mapSize(block.size, firstLevel, secondLevel);
+        if (block.prevFree != kInvalidAllocation) {
+            blocks[block.prevFree].nextFree = block.nextFree;
+        }
+        else {
+            freeLists[firstLevel][secondLevel] = block.nextFree;
+            if (block.nextFree == kInvalidAllocation) {
+                secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+                if (secondLevelBitmaps[firstLevel] == 0) {
+                    firstLevelBitmap &= ~(1u << firstLevel);
+                }
+            }
+        }
+        if (block.nextFree != kInvalidAllocation) {
+            blocks[block.nextFree].prevFree = block.prevFree;
+        }
+        block.isFree = false;
+        block.prevFree = kInvalidAllocation;
+        block.nextFree = kInvalidAllocation;
+    }
+
+    uint32_t TlsfAllocator::findFreeBlock(const uint32_t size) const
+    {
+        // Round up to the next list boundary, so any block in the lists searched is large enough
+        uint64_t roundedSize = size;
+        if (size >= kTlsfSecondLevels) {
+            roundedSize += (uint64_t(1) << (findLastSet(size) - kTlsfSecondLevelBits)) - 1u;
+        }
+        if (roundedSize <= UINT32_MAX) {
+            uint32_t firstLevel, secondLevel;
+            mapSize(uint32_t(roundedSize), firstLevel, secondLevel);
+            uint32_t secondLevelMap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+            if (secondLevelMap == 0) {
+                const uint32_t firstLevelMap = firstLevelBitmap & (~0u << (firstLevel + 1u));
+                if (firstLevelMap != 0) {
+                    firstLevel = findFirstSet(firstLevelMap);
+                    secondLevelMap = secondLevelBitmaps[firstLevel];
+                }
+            }
+            if (secondLevelMap != 0) {
+                return freeLists[firstLevel][findFirstSet(secondLevelMap)];
+            }
+        }
+
+        // Only the list size itself maps to can still have a block that fits, which is worth a linear search
+        // rather than failing while there's space
+        uint32_t firstLevel, secondLevel;
+        mapSize(size, firstLevel, secondLevel);
+        for (uint32_t blockIdx = freeLists[firstLevel][secondLevel]; blockIdx != kInvalidAllocation; blockIdx = blocks[blockIdx].nextFree) {
+            if (blocks[blockIdx].size >= size) {
+                return blockIdx;
+            }
+        }
+        return kInvalidAllocation;
+    }
+
+    uint32_t TlsfAllocator::allocate(const uint32_t size)
+    {
+        ASSERT(size > 0, "Can't allocate nothing");
+        const uint32_t blockIdx = findFreeBlock(size);
+        if (blockIdx == kInvalidAllocation) {
+            return kInvalidAllocation;
+        }
+        removeFreeBlock(blockIdx);
+
+        // The rest of the block goes back to the free lists
+        if (blocks[blockIdx].size > size) {
+            const uint32_t remainderIdx = createBlock(blocks[blockIdx].offset + size, blocks[blockIdx].size - size);
+            Block& block = blocks[blockIdx];
+            Block& remainder = blocks[remainderIdx];
+            remainder.prevPhysical = blockIdx;
+            remainder.nextPhysical = block.nextPhysical;
+            if (block.nextPhysical != kInvalidAllocation) {
+                blocks[block.nextPhysical].prevPhysical = remainderIdx;
+            }
+            block.nextPhysical = remainderIdx;
+            block.size = size;
+            insertFreeBlock(remainderIdx);
+        }
+
+        usedSize += size;
+        allocations[blocks[blockIdx].offset] = blockIdx;
+        return blocks[blockIdx].offset;
+    }
+
+    void TlsfAllocator::free(const uint32_t offset)
+    {
+        auto it = allocations.find(offset);
+        ASSERT(it != allocations.end(), "Freeing an offset that wasn't allocated");
+        uint32_t blockIdx = it->second;
+        allocations.erase(it);
+        usedSize -= blocks[blockIdx].size;
+
+        // Merge with free neighbours, always into the lower block
+        const uint32_t nextIdx = blocks[blockIdx].nextPhysical;
+        if (nextIdx != kInvalidAllocation && blocks[nextIdx].isFree) {
+            removeFreeBlock(nextIdx);
+            blocks[blockIdx].size += blocks[nextIdx].size;
+            blocks[blockIdx].nextPhysical = blocks[nextIdx].nextPhysical;
+            if (blocks[nextIdx].nextPhysical != kInvalidAllocation) {
+                blocks[blocks[nextIdx].nextPhysical].prevPhysical = blockIdx;
+            }
+            unusedBlocks.push_back(nextIdx);
+        }
+        const uint32_t prevIdx = blocks[blockIdx].prevPhysical;
+        if (prevIdx != kInvalidAllocation && blocks[prevIdx].isFree) {
+            removeFreeBlock(prevIdx);
+            blocks[prevIdx].size += blocks[blockIdx].size;
+            blocks[prevIdx].nextPhysical = blocks[blockIdx].nextPhysical;
+            if (blocks[blockIdx].nextPhysical != kInvalidAllocation) {
+                blocks[blocks[blockIdx].nextPhysical].prevPhysical = prevIdx;
+            }
+            unusedBlocks.push_back(blockIdx);
+            blockIdx = prevIdx;
+        }
+        insertFreeBlock(blockIdx);
+    }
+
+    AllocatorStats TlsfAllocator::getStats() const
+    {
+        AllocatorStats stats{};
+        stats.size = totalSize;
+        stats.usedSize = usedSize;
+        stats.freeSize = totalSize - usedSize;
+        stats.numAllocations = uint32_t(allocations.size());
+        for (uint32_t blockIdx = firstBlock; blockIdx != kInvalidAllocation; blockIdx = blocks[blockIdx].nextPhysical) {
+            if (blocks[blockIdx].isFree) {
+                stats.largestFreeBlock = std::max(stats.largestFreeBlock, blocks[blockIdx].size);
+                ++stats.numFreeBlocks;
+            }
+        }
+        if (stats.freeSize > 0) {
+            stats.fragmentation = 1.0f - float(stats.largestFreeBlock) / float(stats.freeSize);
+        }
+        return stats;
+    }
+
+    void TlsfAllocator::compact(std::vector<AllocationMove>& moves)
+    {
+        std::vector<AllocationMove> packed;
+        packed.reserve(allocations.size());
+        uint32_t cursor = 0;
+        for (uint32_t blockIdx = firstBlock; blockIdx != kInvalidAllocation; blockIdx = blocks[blockIdx].nextPhysical) {
+            if (!blocks[blockIdx].isFree) {
+                packed.push_back({ blocks[blockIdx].offset, cursor, blocks[blockIdx].size });
+                cursor += blocks[blockIdx].size;
+            }
+        }
+
+        // Rebuild from scratch as the packed allocations followed by one free block
+        init(totalSize);
+        if (packed.empty()) {
+            return;
+        }
+        removeFreeBlock(firstBlock);
+        blocks.clear();
+        uint32_t prevIdx = kInvalidAllocation;
+        for (const AllocationMove& allocation : packed) {
+            const uint32_t blockIdx = createBlock(allocation.to, allocation.size);
+            blocks[blockIdx].prevPhysical = prevIdx;
+            if (prevIdx != kInvalidAllocation) {
+                blocks[prevIdx].nextPhysical = blockIdx;
+            }
+            allocations[allocation.to] = blockIdx;
+            prevIdx = blockIdx;
+            if (allocation.from != allocation.to) {
+                moves.push_back(allocation);
+            }
+        }
+        firstBlock = 0;
+        usedSize = cursor;
+        if (cursor < totalSize) {
+            const uint32_t freeIdx = createBlock(cursor, totalSize - cursor);
+            blocks[freeIdx].prevPhysical = prevIdx;
+            blocks[prevIdx].nextPhysical = freeIdx;
+            insertFreeBlock(freeIdx);
+        }
+    }
+}
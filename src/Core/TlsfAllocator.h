@@ -0,0 +1,90 @@
+#pragma once
+#include "pch.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace bdr
+{
+    // Each power of two size class is split into this many linearly spaced free lists
+    constexpr uint32_t kTlsfSecondLevelBits = 4u;
+    constexpr uint32_t kTlsfSecondLevels = 1u << kTlsfSecondLevelBits;
+    // Sizes below kTlsfSecondLevels share the first class, every other bit of a 32 bit size gets its own
+    constexpr uint32_t kTlsfFirstLevels = 32u - kTlsfSecondLevelBits + 1u;
+    constexpr uint32_t kInvalidAllocation = UINT32_MAX;
+
+    struct AllocatorStats
+    {
+        uint32_t size = 0;
+        uint32_t usedSize = 0;
+        uint32_t freeSize = 0;
+        uint32_t largestFreeBlock = 0;
+        uint32_t numAllocations = 0;
+        uint32_t numFreeBlocks = 0;
+        // How much of the free space is unusable for an allocation as large as all of it, 0 when it's one block
+        float fragmentation = 0.0f;
+    };
+
+    // An allocation compact() moved, in the allocator's units
+    struct AllocationMove
+    {
+        uint32_t from = 0;
+        uint32_t to = 0;
+        uint32_t size = 0;
+    };
+
+    // Two level segregated fit allocator (Masmano et al.), with constant time allocation and freeing. Free blocks
+    // are kept in lists by size class, with bitmaps of the non empty lists, and merged with free neighbours when
+    // freed. It only hands out offsets into a range of abstract units, whatever memory they refer to lives elsewhere.
+    class TlsfAllocator
+    {
+    public:
+        TlsfAllocator() = default;
+
+        void init(const uint32_t size);
+
+        // Returns kInvalidAllocation when no free block is large enough
+        uint32_t allocate(const uint32_t size);
+        void free(const uint32_t offset);
+
+        inline uint32_t getSize() const
+        {
+            return totalSize;
+        };
+
+        AllocatorStats getStats() const;
+
+        // Packs every allocation to the start of the range, keeping their order, and appends the ones that moved to
+        // moves in increasing offset order. Whoever owns the memory has to copy them.
+        void compact(std::vector<AllocationMove>& moves);
+
+    private:
+        struct Block
+        {
+            uint32_t offset = 0;
+            uint32_t size = 0;
+            uint32_t prevPhysical = kInvalidAllocation;
+            uint32_t nextPhysical = kInvalidAllocation;
+            uint32_t prevFree = kInvalidAllocation;
+            uint32_t nextFree = kInvalidAllocation;
+            bool isFree = false;
+        };
+
+        uint32_t createBlock(const uint32_t offset, const uint32_t size);
+        void insertFreeBlock(const uint32_t blockIdx);
+        void removeFreeBlock(const uint32_t blockIdx);
+        uint32_t findFreeBlock(const uint32_t size) const;
+
+        std::vector<Block> blocks;
+        std::vector<uint32_t> unusedBlocks;
+        // Offsets of live allocations, to their blocks
+        std::unordered_map<uint32_t, uint32_t> allocations;
+        uint32_t firstLevelBitmap = 0;
+        uint32_t secondLevelBitmaps[kTlsfFirstLevels] = { 0 };
+        uint32_t freeLists[kTlsfFirstLevels][kTlsfSecondLevels] = {};
+        // The block at offset 0, which merges never remove
+        uint32_t firstBlock = kInvalidAllocation;
+        uint32_t totalSize = 0;
+        uint32_t usedSize = 0;
+    };
+}
@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "bdrMath.h"
 
+#include "bdrSimd.h"
+
 
 namespace bdr
 {
@@ -40,5 +42,140 @@ namespace bdr
         result[3][2] = -(zNear * zFar) / (zNear - zFar);
         return result;
     }
-}
 
+    math::Frustum math::extractFrustum(const glm::mat4& viewProjection)
+    {
+        const glm::vec4 row0 = glm::row(viewProjection, 0);
+        const glm::vec4 row1 = glm::row(viewProjection, 1);
+        const glm::vec4 row2 = glm::row(viewProjection, 2);
+        const glm::vec4 row3 = glm::row(viewProjection, 3);
+
+        Frustum frustum{ {
+            row3 + row0,
+            row3 - row0,
+            row3 + row1,
+            row3 - row1,
+            row2,
+            row3 - row2,
+        } };
+        for (glm::vec4& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    DualQuaternion math::toDualQuaternion(const glm::mat4& transform)
+    {
+        // v * transform is transposed(transform) * v, so the rotation is the transposed upper 3x3 and the
+        // translation is the last row. Normalizing the axes strips any scale.
+        const glm::mat3 rotation = glm::transpose(glm::mat3{ transform });
+        const glm::quat real = glm::quat_cast(glm::mat3{
+            glm::normalize(rotation[0]),
+            glm::normalize(rotation[1]),
+            glm::normalize(rotation[2]),
+        });
+        const glm::vec3 translation{ transform[0][3], transform[1][3], transform[2][3] };
+
+        // dual = 0.5 * translation * real, with the translation as a pure quaternion
+        const glm::vec3 realVector{ real.x, real.y, real.z };
+        const glm::vec3 dualVector = 0.5f * (real.w * translation + glm::cross(translation, realVector));
+        const float dualScalar = -0.5f * glm::dot(translation, realVector);
+        return DualQuaternion{
+            glm::vec4{ realVector, real.w },
+            glm::vec4{ dualVector, dualScalar },
+        };
+    }
+
+    AABB math::computeAABB(const glm::vec3* points, const size_t numPoints)
+    {
+        using simd::FloatV;
+        constexpr uint32_t kLanes = simd::laneWidth;
+
+        // Reading the packed xyz stream in blocks of three vectors, lane l of vector k always holds component
+        // (k * kLanes + l) % 3, so the min and max can be accumulated without deinterleaving
+        const float* values = &points[0].x;
+        FloatV minimum[3];
+        FloatV maximum[3];
+        for (uint32_t k = 0; k < 3; ++k) {
+            minimum[k] = simd::set1(FLT_MAX);
+            maximum[k] = simd::set1(-FLT_MAX);
+        }
+        size_t point = 0;
+        for (; point + kLanes <= numPoints; point += kLanes) {
+            const float* block = values + 3 * point;
+            for (uint32_t k = 0; k < 3; ++k) {
+                const FloatV v = simd::load(block + k * kLanes);
+                minimum[k] = simd::min(minimum[k], v);
+                maximum[k] = simd::max(maximum[k], v);
+            }
+        }
+
+        AABB aabb{};
+        alignas(32) float lanes[2][kLanes];
+        for (uint32_t k = 0; k < 3; ++k) {
+            simd::store(lanes[0], minimum[k]);
+            simd::store(lanes[1], maximum[k]);
+            for (uint32_t lane = 0; lane < kLanes; ++lane) {
+                const uint32_t c = (k * kLanes + lane) % 3;
+                aabb.min[c] = std::min(aabb.min[c], lanes[0][lane]);
+                aabb.max[c] = std::max(aabb.max[c], lanes[1][lane]);
+            }
+        }
+        for (; point < numPoints; ++point) {
+            expand(aabb, points[point]);
+        }
+        return aabb;
+    }
+
+    AABB math::transformAABB(const AABB& aabb, const glm::mat4& transform)
+    {
+        const glm::vec3 center = getCenter(aabb);
+        const glm::vec3 extents = getExtents(aabb);
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+        const __m128 column0 = _mm_loadu_ps(&transform[0][0]);
+        const __m128 column1 = _mm_loadu_ps(&transform[1][0]);
+        const __m128 column2 = _mm_loadu_ps(&transform[2][0]);
+        __m128 newCenter = _mm_loadu_ps(&transform[3][0]);
+        newCenter = _mm_add_ps(newCenter, _mm_mul_ps(column0, _mm_set1_ps(center.x)));
+        newCenter = _mm_add_ps(newCenter, _mm_mul_ps(column1, _mm_set1_ps(center.y)));
+        newCenter = _mm_add_ps(newCenter, _mm_mul_ps(column2, _mm_set1_ps(center.z)));
+        __m128 newExtents = _mm_mul_ps(_mm_and_ps(column0, absMask), _mm_set1_ps(extents.x));
+        newExtents = _mm_add_ps(newExtents, _mm_mul_ps(_mm_and_ps(column1, absMask), _mm_set1_ps(extents.y)));
+        newExtents = _mm_add_ps(newExtents, _mm_mul_ps(_mm_and_ps(column2, absMask), _mm_set1_ps(extents.z)));
+
+        alignas(16) float minimum[4];
+        alignas(16) float maximum[4];
+        _mm_store_ps(minimum, _mm_sub_ps(newCenter, newExtents));
+        _mm_store_ps(maximum, _mm_add_ps(newCenter, newExtents));
+        return AABB{
+            glm::vec3{ minimum[0], minimum[1], minimum[2] },
+            glm::vec3{ maximum[0], maximum[1], maximum[2] },
+        };
+    }
+
+    AABB math::transformAABBRowVector(const AABB& aabb, const glm::mat4& transform)
+    {
+        const glm::vec3 center = getCenter(aabb);
+        const glm::vec3 extents = getExtents(aabb);
+        glm::vec3 newCenter;
+        glm::vec3 newExtents;
+        for (glm::length_t c = 0; c < 3; ++c) {
+            const glm::vec3 column{ transform[c] };
+            newCenter[c] = glm::dot(center, column) + transform[c][3];
+            newExtents[c] = glm::dot(extents, glm::abs(column));
+        }
+        return AABB{ newCenter - newExtents, newCenter + newExtents };
+    }
+
+    BoundingSphere math::computeBoundingSphere(const glm::vec3* points, const size_t numPoints, const AABB& bounds)
+    {
+        const glm::vec3 center = getCenter(bounds);
+        float maxDistanceSq = 0.0f;
+        for (size_t point = 0; point < numPoints; ++point) {
+            const glm::vec3 offset = points[point] - center;
+            maxDistanceSq = std::max(maxDistanceSq, glm::dot(offset, offset));
+        }
+        return BoundingSphere{ center, sqrtf(maxDistanceSq) };
+    }
+}
@@ -22,6 +22,114 @@ namespace bdr
         }
 
         glm::mat4 perspective(const float fov, const float width, const float height, const float _near, const float _far);
+
+        // Planes are stored as (normal, distance) with normals pointing into the frustum
+        struct Frustum
+        {
+            glm::vec4 planes[6];
+        };
+
+        // Works for any D3D style projection (clip space z in [0, w]), including reversed Z
+        Frustum extractFrustum(const glm::mat4& viewProjection);
+
+        inline bool isSphereInFrustum(const Frustum& frustum, const glm::vec3& center, const float radius)
+        {
+            for (const glm::vec4& plane : frustum.planes) {
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    // Axis aligned bounding box. Default constructed boxes are empty, so expanding them by points just works.
+    struct AABB
+    {
+        glm::vec3 min{ FLT_MAX };
+        glm::vec3 max{ -FLT_MAX };
+    };
+
+    struct BoundingSphere
+    {
+        glm::vec3 center{ 0.0f };
+        float radius = 0.0f;
+    };
+
+    namespace math
+    {
+        inline bool isEmpty(const AABB& aabb)
+        {
+            return aabb.min.x > aabb.max.x || aabb.min.y > aabb.max.y || aabb.min.z > aabb.max.z;
+        }
+
+        inline void expand(AABB& aabb, const glm::vec3& point)
+        {
+            aabb.min = glm::min(aabb.min, point);
+            aabb.max = glm::max(aabb.max, point);
+        }
+
+        inline void expand(AABB& aabb, const AABB& other)
+        {
+            aabb.min = glm::min(aabb.min, other.min);
+            aabb.max = glm::max(aabb.max, other.max);
+        }
+
+        inline glm::vec3 getCenter(const AABB& aabb)
+        {
+            return 0.5f * (aabb.max + aabb.min);
+        }
+
+        inline glm::vec3 getExtents(const AABB& aabb)
+        {
+            return 0.5f * (aabb.max - aabb.min);
+        }
+
+        inline float getSurfaceArea(const AABB& aabb)
+        {
+            const glm::vec3 size = aabb.max - aabb.min;
+            return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+
+        inline AABB getUnion(const AABB& lhs, const AABB& rhs)
+        {
+            return AABB{ glm::min(lhs.min, rhs.min), glm::max(lhs.max, rhs.max) };
+        }
+
+        inline bool contains(const AABB& outer, const AABB& inner)
+        {
+            return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::lessThanEqual(inner.max, outer.max));
+        }
+
+        inline bool overlaps(const AABB& lhs, const AABB& rhs)
+        {
+            return glm::all(glm::lessThanEqual(lhs.min, rhs.max)) && glm::all(glm::lessThanEqual(rhs.min, lhs.max));
+        }
+
+        inline bool isAABBInFrustum(const Frustum& frustum, const AABB& aabb)
+        {
+            const glm::vec3 center = getCenter(aabb);
+            const glm::vec3 extents = getExtents(aabb);
+            for (const glm::vec4& plane : frustum.planes) {
+                const glm::vec3 normal{ plane };
+                if (glm::dot(normal, center) + plane.w < -glm::dot(glm::abs(normal), extents)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Bounds of a tightly packed array of points, scanned with SIMD
+        AABB computeAABB(const glm::vec3* points, const size_t numPoints);
+
+        // Entity matrices (ECSRegistry::globalMatrices) transform column vectors, transform * v with the translation in
+        // transform[3]. Skinning joint matrices transform row vectors, v * transform like skinning.hlsl, with the
+        // translation in transform[c][3]. Both versions use Arvo's method on the box's center and extents.
+        AABB transformAABB(const AABB& aabb, const glm::mat4& transform);
+        AABB transformAABBRowVector(const AABB& aabb, const glm::mat4& transform);
+
+        // Sphere centered on the bounds' center, just large enough to contain every point
+        BoundingSphere computeBoundingSphere(const glm::vec3* points, const size_t numPoints, const AABB& bounds);
     }
 
     enum TransformType : uint8_t
@@ -41,4 +149,33 @@ namespace bdr
     };
 
     glm::mat4 getMatrixFromTransform(const Transform& transform);
+
+    // A rigid transform as a unit quaternion rotation plus a dual part encoding the translation.
+    // Stored as vec4s (xyz vector part, w scalar part) so the layout matches a float4 pair in HLSL.
+    struct DualQuaternion
+    {
+        glm::vec4 real;
+        glm::vec4 dual;
+    };
+
+    namespace math
+    {
+        // Converts a rigid transform applied as a row vector (v * transform, like the skinning shaders) into a
+        // dual quaternion. Any scale or shear in the matrix is lost.
+        DualQuaternion toDualQuaternion(const glm::mat4& transform);
+
+        inline glm::vec3 transformPoint(const DualQuaternion& dq, const glm::vec3& point)
+        {
+            const glm::vec3 realVector{ dq.real };
+            const glm::vec3 dualVector{ dq.dual };
+            const glm::vec3 rotated = point + 2.0f * glm::cross(realVector, glm::cross(realVector, point) + dq.real.w * point);
+            return rotated + 2.0f * (dq.real.w * dualVector - dq.dual.w * realVector + glm::cross(realVector, dualVector));
+        }
+
+        inline glm::vec3 transformVector(const DualQuaternion& dq, const glm::vec3& vector)
+        {
+            const glm::vec3 realVector{ dq.real };
+            return vector + 2.0f * glm::cross(realVector, glm::cross(realVector, vector) + dq.real.w * vector);
+        }
+    }
 }
\ No newline at end of file
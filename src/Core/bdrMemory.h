@@ -1,5 +1,8 @@
 #ifndef BDR_MEMORY
 #define BDR_MEMORY
+#include <malloc.h>
+#include <new>
+
 namespace bdr
 {
     namespace Memory
@@ -28,6 +31,50 @@ namespace bdr
         {
             free(data);
         }
+
+        // For containers of over aligned types, which the default allocator only honours from C++17 on
+        template<typename T, size_t alignment>
+        struct AlignedAllocator
+        {
+            typedef T value_type;
+
+            template<typename U>
+            struct rebind
+            {
+                typedef AlignedAllocator<U, alignment> other;
+            };
+
+            AlignedAllocator() = default;
+
+            template<typename U>
+            AlignedAllocator(const AlignedAllocator<U, alignment>&) { };
+
+            T* allocate(const size_t count)
+            {
+                void* data = _aligned_malloc(count * sizeof(T), alignment);
+                if (data == nullptr) {
+                    throw std::bad_alloc{};
+                }
+                return static_cast<T*>(data);
+            }
+
+            void deallocate(T* data, const size_t)
+            {
+                _aligned_free(data);
+            }
+        };
+
+        template<typename T, typename U, size_t alignment>
+        bool operator==(const AlignedAllocator<T, alignment>&, const AlignedAllocator<U, alignment>&)
+        {
+            return true;
+        }
+
+        template<typename T, typename U, size_t alignment>
+        bool operator!=(const AlignedAllocator<T, alignment>&, const AlignedAllocator<U, alignment>&)
+        {
+            return false;
+        }
     }
 }
 #endif BDR_MEMORY
\ No newline at end of file
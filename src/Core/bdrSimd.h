@@ -0,0 +1,147 @@
+#pragma once
+#include "pch.h"
+
+#include <immintrin.h>
+
+// Thin wrappers around SSE/AVX so kernels can be written once against a native vector width.
+// AVX is used when the compiler targets it (/arch:AVX or /arch:AVX2), SSE otherwise.
+#if defined(__AVX__)
+#define BDR_SIMD_AVX 1
+#else
+#define BDR_SIMD_AVX 0
+#endif
+
+namespace bdr
+{
+    namespace simd
+    {
+#if BDR_SIMD_AVX
+        typedef __m256 FloatV;
+        typedef __m256i IntV;
+        constexpr uint32_t laneWidth = 8u;
+
+        inline FloatV load(const float* p) { return _mm256_loadu_ps(p); }
+        inline void store(float* p, const FloatV v) { _mm256_storeu_ps(p, v); }
+        inline FloatV set1(const float f) { return _mm256_set1_ps(f); }
+        inline FloatV zero() { return _mm256_setzero_ps(); }
+        inline FloatV add(const FloatV a, const FloatV b) { return _mm256_add_ps(a, b); }
+        inline FloatV sub(const FloatV a, const FloatV b) { return _mm256_sub_ps(a, b); }
+        inline FloatV mul(const FloatV a, const FloatV b) { return _mm256_mul_ps(a, b); }
+        inline FloatV div(const FloatV a, const FloatV b) { return _mm256_div_ps(a, b); }
+        inline FloatV min(const FloatV a, const FloatV b) { return _mm256_min_ps(a, b); }
+        inline FloatV max(const FloatV a, const FloatV b) { return _mm256_max_ps(a, b); }
+        inline FloatV sqrt(const FloatV a) { return _mm256_sqrt_ps(a); }
+        inline FloatV bitAnd(const FloatV a, const FloatV b) { return _mm256_and_ps(a, b); }
+        inline FloatV bitOr(const FloatV a, const FloatV b) { return _mm256_or_ps(a, b); }
+        inline FloatV bitXor(const FloatV a, const FloatV b) { return _mm256_xor_ps(a, b); }
+        inline FloatV cmpLt(const FloatV a, const FloatV b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        inline FloatV cmpLe(const FloatV a, const FloatV b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        inline FloatV cmpGt(const FloatV a, const FloatV b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        // Picks b where the mask is set, a otherwise
+        inline FloatV select(const FloatV a, const FloatV b, const FloatV mask) { return _mm256_blendv_ps(a, b, mask); }
+        inline uint32_t moveMask(const FloatV a) { return uint32_t(_mm256_movemask_ps(a)); }
+        inline FloatV cmpEq(const FloatV a, const FloatV b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+        inline FloatV cmpGe(const FloatV a, const FloatV b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        // ~a & b
+        inline FloatV andNot(const FloatV a, const FloatV b) { return _mm256_andnot_ps(a, b); }
+        // Loads laneWidth uint16s, widened to floats. Only uses 128 bit integer ops so it doesn't need AVX2.
+        inline FloatV loadU16(const uint16_t* p)
+        {
+            const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            const __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, _mm_setzero_si128()));
+            const __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(packed, _mm_setzero_si128()));
+            return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+        }
+#else
+        typedef __m128 FloatV;
+        typedef __m128i IntV;
+        constexpr uint32_t laneWidth = 4u;
+
+        inline FloatV load(const float* p) { return _mm_loadu_ps(p); }
+        inline void store(float* p, const FloatV v) { _mm_storeu_ps(p, v); }
+        inline FloatV set1(const float f) { return _mm_set1_ps(f); }
+        inline FloatV zero() { return _mm_setzero_ps(); }
+        inline FloatV add(const FloatV a, const FloatV b) { return _mm_add_ps(a, b); }
+        inline FloatV sub(const FloatV a, const FloatV b) { return _mm_sub_ps(a, b); }
+        inline FloatV mul(const FloatV a, const FloatV b) { return _mm_mul_ps(a, b); }
+        inline FloatV div(const FloatV a, const FloatV b) { return _mm_div_ps(a, b); }
+        inline FloatV min(const FloatV a, const FloatV b) { return _mm_min_ps(a, b); }
+        inline FloatV max(const FloatV a, const FloatV b) { return _mm_max_ps(a, b); }
+        inline FloatV sqrt(const FloatV a) { return _mm_sqrt_ps(a); }
+        inline FloatV bitAnd(const FloatV a, const FloatV b) { return _mm_and_ps(a, b); }
+        inline FloatV bitOr(const FloatV a, const FloatV b) { return _mm_or_ps(a, b); }
+        inline FloatV bitXor(const FloatV a, const FloatV b) { return _mm_xor_ps(a, b); }
+        inline FloatV cmpLt(const FloatV a, const FloatV b) { return _mm_cmplt_ps(a, b); }
+        inline FloatV cmpLe(const FloatV a, const FloatV b) { return _mm_cmple_ps(a, b); }
+        inline FloatV cmpGt(const FloatV a, const FloatV b) { return _mm_cmpgt_ps(a, b); }
+        // Picks b where the mask is set, a otherwise. SSE2 has no blendv, so we do it with bit ops.
+        inline FloatV select(const FloatV a, const FloatV b, const FloatV mask) { return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a)); }
+        inline uint32_t moveMask(const FloatV a) { return uint32_t(_mm_movemask_ps(a)); }
+        inline FloatV cmpEq(const FloatV a, const FloatV b) { return _mm_cmpeq_ps(a, b); }
+        inline FloatV cmpGe(const FloatV a, const FloatV b) { return _mm_cmpge_ps(a, b); }
+        // ~a & b
+        inline FloatV andNot(const FloatV a, const FloatV b) { return _mm_andnot_ps(a, b); }
+        // Loads laneWidth uint16s, widened to floats
+        inline FloatV loadU16(const uint16_t* p)
+        {
+            const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+            return _mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, _mm_setzero_si128()));
+        }
+#endif
+
+        // Loads base[indices[lane]] into each lane, with the hardware gather when targeting AVX2
+        inline FloatV gather(const float* base, const int32_t* indices)
+        {
+#if defined(__AVX2__) && BDR_SIMD_AVX
+            return _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)), 4);
+#elif defined(__AVX2__)
+            return _mm_i32gather_ps(base, _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices)), 4);
+#else
+            alignas(32) float values[laneWidth];
+            for (uint32_t lane = 0; lane < laneWidth; ++lane) {
+                values[lane] = base[indices[lane]];
+            }
+            return load(values);
+#endif
+        }
+
+        inline FloatV madd(const FloatV a, const FloatV b, const FloatV c) { return add(mul(a, b), c); }
+        inline FloatV lerp(const FloatV a, const FloatV b, const FloatV t) { return madd(sub(b, a), t, a); }
+        inline FloatV negate(const FloatV a) { return bitXor(a, set1(-0.0f)); }
+        inline FloatV abs(const FloatV a) { return bitAnd(a, set1(glm::uintBitsToFloat(0x7FFFFFFFu))); }
+
+        // 4-wide helpers, used where the data is naturally 4 wide (matrix rows, single quaternions)
+        inline __m128 dot4(const __m128 a, const __m128 b)
+        {
+            __m128 prod = _mm_mul_ps(a, b);
+            __m128 shuffled = _mm_shuffle_ps(prod, prod, _MM_SHUFFLE(2, 3, 0, 1));
+            __m128 sums = _mm_add_ps(prod, shuffled);
+            shuffled = _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(1, 0, 3, 2));
+            return _mm_add_ps(sums, shuffled);
+        }
+
+        // out = a * b, with all three matrices stored row-major
+        inline void mul4x4(const float* a, const float* b, float* out)
+        {
+            const __m128 b0 = _mm_loadu_ps(b);
+            const __m128 b1 = _mm_loadu_ps(b + 4);
+            const __m128 b2 = _mm_loadu_ps(b + 8);
+            const __m128 b3 = _mm_loadu_ps(b + 12);
+            for (size_t i = 0; i < 4; ++i) {
+                __m128 row = _mm_mul_ps(_mm_set1_ps(a[4 * i + 0]), b0);
+                row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[4 * i + 1]), b1));
+                row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[4 * i + 2]), b2));
+                row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[4 * i + 3]), b3));
+                _mm_storeu_ps(out + 4 * i, row);
+            }
+        }
+
+        inline glm::mat4 mul(const glm::mat4& a, const glm::mat4& b)
+        {
+            // glm is column-major, so read as row-major its memory holds the transposes: b^T * a^T = (a * b)^T
+            glm::mat4 result;
+            mul4x4(&b[0][0], &a[0][0], &result[0][0]);
+            return result;
+        }
+    }
+}
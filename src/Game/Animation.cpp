@@ -5,5 +5,25 @@
 
 namespace bdr
 {
+    // How many keyframes we step over linearly before giving up and binary searching instead.
+    // Playback usually advances by less than a keyframe per frame, so this almost never triggers.
+    constexpr uint32_t kMaxForwardScan = 4u;
 
-}
\ No newline at end of file
+    uint32_t advanceKeyframeCursor(const float* input, const uint32_t numKeys, const uint32_t cursor, const float time)
+    {
+        const uint32_t lastIdx = numKeys - 1;
+        uint32_t idx = std::min(cursor, lastIdx);
+
+        if (time >= input[idx]) {
+            for (uint32_t i = 0; i < kMaxForwardScan; ++i) {
+                if (idx == lastIdx || input[idx + 1] > time) {
+                    return idx;
+                }
+                ++idx;
+            }
+        }
+
+        const float* upper = std::upper_bound(input, input + numKeys, time);
+        return upper == input ? 0u : uint32_t(upper - input - 1);
+    }
+}
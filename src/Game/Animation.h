@@ -38,12 +38,25 @@ namespace bdr
         typedef Channel<glm::vec3> TranslationChannel;
         typedef Channel<glm::quat> RotationChannel;
         typedef Channel<glm::vec3> ScaleChannel;
+        // Output holds one weight per morph target for each keyframe (three for cubic splines), flattened.
+        // Drives the target entity's primitives, scene.morphedMeshes[firstMorphedMesh, + numMorphedMeshes).
+        struct WeightsChannel : Channel<float>
+        {
+            uint32_t firstMorphedMesh = 0;
+            uint32_t numMorphedMeshes = 0;
+        };
 
         std::vector<TranslationChannel> translationChannels;
         std::vector<RotationChannel> rotationChannels;
         std::vector<ScaleChannel> scaleChannels;
+        std::vector<WeightsChannel> weightsChannels;
     };
 
+    // Returns the index of the last keyframe with input <= time, clamped to [0, numKeys - 1].
+    // Starts from the cached cursor and scans forward, which is the common case for monotonic playback,
+    // falling back to a binary search for seeks, loops and large time steps.
+    uint32_t advanceKeyframeCursor(const float* input, const uint32_t numKeys, const uint32_t cursor, const float time);
+
     inline void addTranslationChannel(Animation& animation, Animation::TranslationChannel&& channel)
     {
         animation.translationChannels.push_back(std::forward<Animation::TranslationChannel>(channel));
@@ -59,9 +72,26 @@ namespace bdr
         animation.scaleChannels.push_back(std::forward<Animation::ScaleChannel>(channel));
     }
 
+    inline void addWeightsChannel(Animation& animation, Animation::WeightsChannel&& channel)
+    {
+        animation.weightsChannels.push_back(std::forward<Animation::WeightsChannel>(channel));
+    }
+
+    enum class SkinningMode : uint8_t
+    {
+        // Blends the joint matrices, like skinning.hlsl
+        Linear = 0,
+        // Blends the joints as dual quaternions, which keeps volume around twisting joints but drops any scale
+        DualQuaternion,
+    };
+
     struct Skin
     {
         std::vector<uint32_t> jointEntities;
         std::vector<glm::mat4> inverseBindMatrices;
+        SkinningMode mode = SkinningMode::Linear;
+        // Bind space bounds of the vertices each joint influences, across every mesh using the skin.
+        // Empty for joints that don't influence any vertex.
+        std::vector<AABB> jointBounds;
     };
 }
\ No newline at end of file
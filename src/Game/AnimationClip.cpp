@@ -0,0 +1,489 @@
+#include "pch.h"
+#include "AnimationClip.h"
+
+#include <unordered_map>
+
+#include "ECSRegistry.h"
+
+
+namespace bdr
+{
+    using simd::FloatV;
+    constexpr uint32_t kLanes = simd::laneWidth;
+
+    constexpr uint32_t getNumComponents(const AnimationClip::TrackType trackType)
+    {
+        return trackType == AnimationClip::ROTATION_TRACK ? 4u : 3u;
+    }
+
+    inline uint32_t getValuesPerKey(const Animation::InterpolationType interpolationType)
+    {
+        return interpolationType == Animation::InterpolationType::CubicSpline ? 3u : 1u;
+    }
+
+    struct ChannelRef
+    {
+        AnimationClip::TrackType trackType;
+        Animation::InterpolationType interpolationType;
+        uint32_t targetEntity;
+        const std::vector<float>* input;
+        // Points at the channel's output, viewed as floats (glm::quat and glm::vec3 are tightly packed)
+        const float* output;
+    };
+
+    template<typename T>
+    void collectChannels(std::vector<ChannelRef>& refs, const std::vector<Animation::Channel<T>>& channels, const AnimationClip::TrackType trackType)
+    {
+        static_assert(sizeof(T) % sizeof(float) == 0, "Channel outputs must be made of floats");
+        for (const Animation::Channel<T>& channel : channels) {
+            if (channel.input.empty()) {
+                continue;
+            }
+            ASSERT(channel.output.size() == channel.input.size() * getValuesPerKey(channel.interpolationType),
+                "Channel output count does not match its input count");
+            refs.push_back({
+                trackType,
+                channel.interpolationType,
+                channel.targetEntity,
+                &channel.input,
+                reinterpret_cast<const float*>(channel.output.data()),
+            });
+        }
+    }
+
+    inline bool hasSameKeys(const ChannelRef& lhs, const ChannelRef& rhs)
+    {
+        return lhs.interpolationType == rhs.interpolationType
+            && lhs.input->size() == rhs.input->size()
+            && memcmp(lhs.input->data(), rhs.input->data(), sizeof(float) * lhs.input->size()) == 0;
+    }
+
+    AnimationClip compileAnimationClip(const Animation& animation)
+    {
+        AnimationClip clip{};
+
+        std::vector<ChannelRef> refs;
+        collectChannels(refs, animation.rotationChannels, AnimationClip::ROTATION_TRACK);
+        collectChannels(refs, animation.translationChannels, AnimationClip::TRANSLATION_TRACK);
+        collectChannels(refs, animation.scaleChannels, AnimationClip::SCALE_TRACK);
+        clip.numChannels = uint32_t(refs.size());
+
+        // Assign a pose slot to each targeted entity
+        std::unordered_map<uint32_t, uint32_t> entityToSlot;
+        std::vector<uint32_t> refSlots(refs.size());
+        for (size_t i = 0; i < refs.size(); ++i) {
+            const ChannelRef& ref = refs[i];
+            auto it = entityToSlot.find(ref.targetEntity);
+            if (it == entityToSlot.end()) {
+                it = entityToSlot.emplace(ref.targetEntity, uint32_t(clip.slotEntities.size())).first;
+                clip.slotEntities.push_back(ref.targetEntity);
+                clip.slotMasks.push_back(0);
+            }
+            refSlots[i] = it->second;
+            clip.slotMasks[it->second] |= uint8_t(1u << ref.trackType);
+        }
+        static_assert(TransformType::Rotation == (1 << AnimationClip::ROTATION_TRACK), "Track types must map onto TransformType bits");
+        static_assert(TransformType::Translation == (1 << AnimationClip::TRANSLATION_TRACK), "Track types must map onto TransformType bits");
+        static_assert(TransformType::Scale == (1 << AnimationClip::SCALE_TRACK), "Track types must map onto TransformType bits");
+        const uint32_t scratchSlot = clip.getScratchSlot();
+
+        // Group channels sharing their key times, keeping the channel order within each group
+        std::vector<std::vector<uint32_t>> groupMembers;
+        std::vector<uint32_t> groupLeaders;
+        for (uint32_t i = 0; i < refs.size(); ++i) {
+            size_t groupIdx = 0;
+            for (; groupIdx < groupLeaders.size(); ++groupIdx) {
+                if (hasSameKeys(refs[groupLeaders[groupIdx]], refs[i])) {
+                    break;
+                }
+            }
+            if (groupIdx == groupLeaders.size()) {
+                groupLeaders.push_back(i);
+                groupMembers.emplace_back();
+            }
+            groupMembers[groupIdx].push_back(i);
+        }
+
+        clip.groups.resize(groupLeaders.size());
+        for (size_t groupIdx = 0; groupIdx < groupLeaders.size(); ++groupIdx) {
+            AnimationClip::KeyGroup& group = clip.groups[groupIdx];
+            const ChannelRef& leader = refs[groupLeaders[groupIdx]];
+            const std::vector<float>& input = *leader.input;
+
+            group.interpolationType = leader.interpolationType;
+            group.numKeys = uint32_t(input.size());
+            group.timesOffset = uint32_t(clip.keyTimes.size());
+            clip.keyTimes.insert(clip.keyTimes.end(), input.begin(), input.end());
+            clip.duration = std::max(clip.duration, input.back());
+
+            const uint32_t valuesPerKey = getValuesPerKey(group.interpolationType);
+
+            for (uint8_t trackType = 0; trackType < AnimationClip::NUM_TRACK_TYPES; ++trackType) {
+                std::vector<uint32_t> members;
+                for (const uint32_t refIdx : groupMembers[groupIdx]) {
+                    if (refs[refIdx].trackType == trackType) {
+                        members.push_back(refIdx);
+                    }
+                }
+
+                const uint32_t numComponents = getNumComponents(AnimationClip::TrackType(trackType));
+                const uint32_t numBlocks = uint32_t((members.size() + kLanes - 1) / kLanes);
+                const uint32_t blockSize = numComponents * kLanes;
+                group.numBlocks[trackType] = numBlocks;
+                group.valuesOffset[trackType] = uint32_t(clip.values.size());
+                group.targetsOffset[trackType] = uint32_t(clip.laneTargets.size());
+
+                const size_t numValues = size_t(group.numKeys) * valuesPerKey * numBlocks * blockSize;
+                clip.values.resize(clip.values.size() + numValues, 0.0f);
+                float* values = clip.values.data() + group.valuesOffset[trackType];
+
+                clip.laneTargets.resize(clip.laneTargets.size() + numBlocks * kLanes, scratchSlot);
+                uint32_t* laneTargets = clip.laneTargets.data() + group.targetsOffset[trackType];
+
+                for (uint32_t memberIdx = 0; memberIdx < numBlocks * kLanes; ++memberIdx) {
+                    const uint32_t block = memberIdx / kLanes;
+                    const uint32_t lane = memberIdx % kLanes;
+                    const bool isPadding = memberIdx >= members.size();
+                    if (!isPadding) {
+                        laneTargets[memberIdx] = refSlots[members[memberIdx]];
+                    }
+
+                    for (uint32_t key = 0; key < group.numKeys * valuesPerKey; ++key) {
+                        float* blockValues = &values[(size_t(key) * numBlocks + block) * blockSize];
+                        for (uint32_t component = 0; component < numComponents; ++component) {
+                            float value = 0.0f;
+                            if (!isPadding) {
+                                value = refs[members[memberIdx]].output[key * numComponents + component];
+                            }
+                            else if (trackType == AnimationClip::ROTATION_TRACK && component == 3) {
+                                // Identity quaternion, so padding lanes never normalize a zero vector
+                                value = 1.0f;
+                            }
+                            blockValues[component * kLanes + lane] = value;
+                        }
+                    }
+                }
+            }
+        }
+
+        return clip;
+    }
+
+    template<typename T>
+    size_t getChannelsMemoryUsage(const std::vector<Animation::Channel<T>>& channels)
+    {
+        size_t bytes = channels.capacity() * sizeof(Animation::Channel<T>);
+        for (const Animation::Channel<T>& channel : channels) {
+            bytes += channel.input.capacity() * sizeof(float) + channel.output.capacity() * sizeof(T);
+        }
+        return bytes;
+    }
+
+    size_t getMemoryUsage(const Animation& animation)
+    {
+        return getChannelsMemoryUsage(animation.rotationChannels)
+            + getChannelsMemoryUsage(animation.translationChannels)
+            + getChannelsMemoryUsage(animation.scaleChannels);
+    }
+
+    size_t getMemoryUsage(const AnimationClip& clip)
+    {
+        return clip.groups.capacity() * sizeof(AnimationClip::KeyGroup)
+            + clip.keyTimes.capacity() * sizeof(float)
+            + clip.values.capacity() * sizeof(float)
+            + clip.quantizedValues.capacity() * sizeof(uint16_t)
+            + clip.trackRanges.capacity() * sizeof(float)
+            + clip.laneTargets.capacity() * sizeof(uint32_t)
+            + clip.slotEntities.capacity() * sizeof(uint32_t)
+            + clip.slotMasks.capacity() * sizeof(uint8_t);
+    }
+
+    void initPose(const AnimationClip& clip, AnimationPose& pose)
+    {
+        // One extra slot that padding lanes can scribble over
+        const size_t numSlots = clip.getNumSlots() + 1;
+        pose.rotations.assign(numSlots, glm::identity<glm::quat>());
+        pose.translations.assign(numSlots, glm::vec3{ 0.0f });
+        pose.scales.assign(numSlots, glm::vec3{ 1.0f });
+        pose.groupCursors.assign(clip.groups.size(), 0u);
+    }
+
+    // Hermite basis functions, with the tangent terms already scaled by the time between keys
+    struct HermiteWeights
+    {
+        FloatV previousValue;
+        FloatV previousTangent;
+        FloatV nextValue;
+        FloatV nextTangent;
+    };
+
+    inline HermiteWeights getHermiteWeights(const float t, const float deltaT)
+    {
+        const float t2 = t * t;
+        const float t3 = t2 * t;
+        return {
+            simd::set1(2.0f * t3 - 3.0f * t2 + 1.0f),
+            simd::set1(deltaT * (t3 - 2.0f * t2 + t)),
+            simd::set1(-2.0f * t3 + 3.0f * t2),
+            simd::set1(deltaT * (t3 - t2)),
+        };
+    }
+
+    inline FloatV evalHermite(const HermiteWeights& w, const FloatV p0, const FloatV m0, const FloatV p1, const FloatV m1)
+    {
+        FloatV result = simd::mul(w.previousValue, p0);
+        result = simd::madd(w.previousTangent, m0, result);
+        result = simd::madd(w.nextValue, p1, result);
+        return simd::madd(w.nextTangent, m1, result);
+    }
+
+    inline void normalizeQuats(FloatV q[4])
+    {
+        FloatV lengthSq = simd::mul(q[0], q[0]);
+        lengthSq = simd::madd(q[1], q[1], lengthSq);
+        lengthSq = simd::madd(q[2], q[2], lengthSq);
+        lengthSq = simd::madd(q[3], q[3], lengthSq);
+        const FloatV invLength = simd::div(simd::set1(1.0f), simd::sqrt(lengthSq));
+        for (size_t c = 0; c < 4; ++c) {
+            q[c] = simd::mul(q[c], invLength);
+        }
+    }
+
+    // Interpolates kLanes quaternion pairs along the shortest path.
+    // Slerp uses the nlerp correction from "Approximating slerp" (Kapoulkine), which
+    // adjusts t per lane based on the angle between the two quaternions.
+    inline void interpolateQuats(const FloatV a[4], const FloatV b[4], const float t, const QuatInterpolation quatInterpolation, FloatV out[4])
+    {
+        FloatV dot = simd::mul(a[0], b[0]);
+        dot = simd::madd(a[1], b[1], dot);
+        dot = simd::madd(a[2], b[2], dot);
+        dot = simd::madd(a[3], b[3], dot);
+        // Flip b where the dot product is negative
+        const FloatV sign = simd::bitAnd(dot, simd::set1(-0.0f));
+
+        FloatV tv = simd::set1(t);
+        if (quatInterpolation == QuatInterpolation::Slerp) {
+            const FloatV d = simd::abs(dot);
+            FloatV A = simd::madd(d, simd::set1(-1.43519f), simd::set1(3.55645f));
+            A = simd::madd(d, A, simd::set1(-3.2452f));
+            A = simd::madd(d, A, simd::set1(1.0904f));
+            FloatV B = simd::madd(d, simd::set1(0.215638f), simd::set1(-1.06021f));
+            B = simd::madd(d, B, simd::set1(0.848013f));
+            const float tHalf = t - 0.5f;
+            const FloatV k = simd::madd(A, simd::set1(tHalf * tHalf), B);
+            tv = simd::madd(simd::set1(t * tHalf * (t - 1.0f)), k, tv);
+        }
+
+        for (size_t c = 0; c < 4; ++c) {
+            out[c] = simd::lerp(a[c], simd::bitXor(b[c], sign), tv);
+        }
+        normalizeQuats(out);
+    }
+
+    struct BlockCursor
+    {
+        const float* values;
+        uint32_t numBlocks;
+        uint32_t numComponents;
+        uint32_t valuesPerKey;
+
+        inline const float* get(const uint32_t key, const uint32_t subValue, const uint32_t block) const
+        {
+            const size_t blockIdx = (size_t(key) * valuesPerKey + subValue) * numBlocks + block;
+            return values + blockIdx * numComponents * kLanes;
+        };
+
+        inline void load(const uint32_t key, const uint32_t subValue, const uint32_t block, FloatV out[]) const
+        {
+            const float* blockValues = get(key, subValue, block);
+            for (uint32_t c = 0; c < numComponents; ++c) {
+                out[c] = simd::load(blockValues + c * kLanes);
+            }
+        };
+    };
+
+    // Reads blocks of a quantized group, decoding them back to floats
+    struct QuantizedBlockCursor
+    {
+        const uint16_t* values;
+        const float* ranges;
+        uint32_t numBlocks;
+        bool isRotation;
+
+        inline void load(const uint32_t key, const uint32_t block, FloatV out[]) const
+        {
+            const uint16_t* blockValues = values + (size_t(key) * numBlocks + block) * 3u * kLanes;
+            if (isRotation) {
+                decodeSmallestThree(blockValues, out);
+            }
+            else {
+                const float* blockRanges = ranges + size_t(block) * 6u * kLanes;
+                const FloatV scale = simd::set1(1.0f / 65535.0f);
+                for (uint32_t c = 0; c < 3; ++c) {
+                    const FloatV minimum = simd::load(blockRanges + c * kLanes);
+                    const FloatV extent = simd::load(blockRanges + (3u + c) * kLanes);
+                    const FloatV normalized = simd::mul(simd::loadU16(blockValues + c * kLanes), scale);
+                    out[c] = simd::madd(normalized, extent, minimum);
+                }
+            }
+        };
+
+        static inline void decodeSmallestThree(const uint16_t* blockValues, FloatV out[4])
+        {
+            const FloatV topBit = simd::set1(32768.0f);
+            const FloatV scale = simd::set1(1.41421356f / 32767.0f);
+            const FloatV offset = simd::set1(-0.70710678f);
+
+            FloatV a = simd::loadU16(blockValues);
+            FloatV b = simd::loadU16(blockValues + kLanes);
+            FloatV c = simd::loadU16(blockValues + 2u * kLanes);
+
+            // The index of the dropped (largest) component is stored in the top bits of a and b
+            const FloatV bit0 = simd::cmpGe(a, topBit);
+            const FloatV bit1 = simd::cmpGe(b, topBit);
+            a = simd::sub(a, simd::bitAnd(bit0, topBit));
+            b = simd::sub(b, simd::bitAnd(bit1, topBit));
+
+            a = simd::madd(a, scale, offset);
+            b = simd::madd(b, scale, offset);
+            c = simd::madd(c, scale, offset);
+
+            FloatV lengthSq = simd::mul(a, a);
+            lengthSq = simd::madd(b, b, lengthSq);
+            lengthSq = simd::madd(c, c, lengthSq);
+            const FloatV d = simd::sqrt(simd::max(simd::sub(simd::set1(1.0f), lengthSq), simd::zero()));
+
+            const FloatV isX = simd::andNot(bit1, simd::andNot(bit0, simd::cmpEq(a, a)));
+            const FloatV isY = simd::andNot(bit1, bit0);
+            const FloatV isZ = simd::andNot(bit0, bit1);
+            const FloatV isW = simd::bitAnd(bit0, bit1);
+
+            // The stored components are the remaining ones, in xyzw order
+            out[0] = simd::select(a, d, isX);
+            out[1] = simd::select(simd::select(b, d, isY), a, isX);
+            out[2] = simd::select(simd::select(c, d, isZ), b, simd::bitOr(isX, isY));
+            out[3] = simd::select(c, d, isW);
+        };
+    };
+
+    void sampleClip(const AnimationClip& clip, const float clipTime, AnimationPose& pose, const QuatInterpolation quatInterpolation)
+    {
+        ASSERT(pose.groupCursors.size() == clip.groups.size(), "Pose was not initialized for this clip");
+
+        alignas(32) float results[4][kLanes];
+        for (size_t groupIdx = 0; groupIdx < clip.groups.size(); ++groupIdx) {
+            const AnimationClip::KeyGroup& group = clip.groups[groupIdx];
+            const float* times = &clip.keyTimes[group.timesOffset];
+
+            // The keyframe search and interpolation factor are shared by every track in the group
+            uint32_t& cursor = pose.groupCursors[groupIdx];
+            cursor = advanceKeyframeCursor(times, group.numKeys, cursor, clipTime);
+            const uint32_t previousKey = cursor;
+            const uint32_t nextKey = std::min(previousKey + 1, group.numKeys - 1);
+            const float deltaT = times[nextKey] - times[previousKey];
+            float t = 0.0f;
+            if (deltaT > 0.0f && group.interpolationType != Animation::InterpolationType::Step) {
+                t = glm::clamp((clipTime - times[previousKey]) / deltaT, 0.0f, 1.0f);
+            }
+
+            const bool isCubic = group.interpolationType == Animation::InterpolationType::CubicSpline;
+            const uint32_t valuesPerKey = getValuesPerKey(group.interpolationType);
+            // For cubic splines the keyframe value sits between the in and out tangents
+            const uint32_t valueIdx = isCubic ? 1u : 0u;
+            const HermiteWeights hermite = getHermiteWeights(t, deltaT);
+
+            for (uint8_t trackType = 0; trackType < AnimationClip::NUM_TRACK_TYPES; ++trackType) {
+                const uint32_t numBlocks = group.numBlocks[trackType];
+                if (numBlocks == 0) {
+                    continue;
+                }
+                const BlockCursor blocks{
+                    group.isQuantized ? nullptr : &clip.values[group.valuesOffset[trackType]],
+                    numBlocks,
+                    getNumComponents(AnimationClip::TrackType(trackType)),
+                    valuesPerKey,
+                };
+                const QuantizedBlockCursor quantizedBlocks{
+                    group.isQuantized ? &clip.quantizedValues[group.valuesOffset[trackType]] : nullptr,
+                    group.isQuantized && trackType != AnimationClip::ROTATION_TRACK ? &clip.trackRanges[group.rangesOffset[trackType]] : nullptr,
+                    numBlocks,
+                    trackType == AnimationClip::ROTATION_TRACK,
+                };
+
+                for (uint32_t block = 0; block < numBlocks; ++block) {
+                    FloatV previous[4], next[4], out[4];
+                    if (group.isQuantized) {
+                        quantizedBlocks.load(previousKey, block, previous);
+                        quantizedBlocks.load(nextKey, block, next);
+                    }
+                    else {
+                        blocks.load(previousKey, valueIdx, block, previous);
+                        blocks.load(nextKey, valueIdx, block, next);
+                    }
+
+                    if (isCubic) {
+                        FloatV outTangent[4], inTangent[4];
+                        blocks.load(previousKey, 2u, block, outTangent);
+                        blocks.load(nextKey, 0u, block, inTangent);
+                        for (uint32_t c = 0; c < blocks.numComponents; ++c) {
+                            out[c] = evalHermite(hermite, previous[c], outTangent[c], next[c], inTangent[c]);
+                        }
+                        if (trackType == AnimationClip::ROTATION_TRACK) {
+                            normalizeQuats(out);
+                        }
+                    }
+                    else if (trackType == AnimationClip::ROTATION_TRACK) {
+                        interpolateQuats(previous, next, t, quatInterpolation, out);
+                    }
+                    else {
+                        const FloatV tv = simd::set1(t);
+                        for (uint32_t c = 0; c < 3; ++c) {
+                            out[c] = simd::lerp(previous[c], next[c], tv);
+                        }
+                    }
+
+                    for (uint32_t c = 0; c < blocks.numComponents; ++c) {
+                        simd::store(results[c], out[c]);
+                    }
+
+                    const uint32_t* laneTargets = &clip.laneTargets[group.targetsOffset[trackType] + block * kLanes];
+                    if (trackType == AnimationClip::ROTATION_TRACK) {
+                        for (uint32_t lane = 0; lane < kLanes; ++lane) {
+                            pose.rotations[laneTargets[lane]] = glm::quat{ results[3][lane], results[0][lane], results[1][lane], results[2][lane] };
+                        }
+                    }
+                    else {
+                        glm::vec3* outputs = trackType == AnimationClip::TRANSLATION_TRACK ? pose.translations.data() : pose.scales.data();
+                        for (uint32_t lane = 0; lane < kLanes; ++lane) {
+                            outputs[laneTargets[lane]] = glm::vec3{ results[0][lane], results[1][lane], results[2][lane] };
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void applyPose(ECSRegistry& registry, const AnimationClip& clip, const AnimationPose& pose)
+    {
+        applyPose(registry, clip, pose, clip.slotEntities);
+    }
+
+    void applyPose(ECSRegistry& registry, const AnimationClip& clip, const AnimationPose& pose, const std::vector<uint32_t>& slotEntities)
+    {
+        ASSERT(slotEntities.size() == clip.getNumSlots(), "Expected one entity per pose slot");
+        const uint32_t numSlots = clip.getNumSlots();
+        for (uint32_t slot = 0; slot < numSlots; ++slot) {
+            Transform& transform = registry.transforms[slotEntities[slot]];
+            const uint8_t mask = clip.slotMasks[slot];
+            if (mask & TransformType::Rotation) {
+                transform.rotation = pose.rotations[slot];
+            }
+            if (mask & TransformType::Translation) {
+                transform.translation = pose.translations[slot];
+            }
+            if (mask & TransformType::Scale) {
+                transform.scale = pose.scales[slot];
+            }
+        }
+    }
+}
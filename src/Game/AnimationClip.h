@@ -0,0 +1,112 @@
+#pragma once
+#include "pch.h"
+
+#include "Core/bdrSimd.h"
+#include "Animation.h"
+
+namespace bdr
+{
+    class ECSRegistry;
+
+    enum class QuatInterpolation : uint8_t
+    {
+        // Normalized lerp, cheapest and fine for densely sampled clips
+        Nlerp = 0,
+        // Nlerp with a polynomial correction of t, within ~1e-4 of a true slerp without any trig
+        Slerp,
+    };
+
+    // An Animation compiled for batched sampling.
+    // Channels that share identical key times (and interpolation) are grouped so the keyframe search and
+    // interpolation factor are computed once per group. Within a group the values of each track type are
+    // stored SoA, in blocks of simd::laneWidth tracks per key, so a single SIMD op interpolates laneWidth
+    // quaternions (or vectors) at once.
+    //
+    // Value layout for a track type within a group:
+    //   [key][subValue][block][component][lane]
+    // where subValue is 0 for Linear/Step and {inTangent, value, outTangent} for CubicSpline.
+    //
+    // Groups can also be quantized (see AnimationCompression.h), in which case their values live in quantizedValues
+    // with the same layout but three uint16 components per track:
+    //   - rotations use smallest-three encoding, 15 bits per component plus the 2 bit index of the dropped component
+    //     stored in the top bits of the first two components (48 bits per key).
+    //   - translations and scales are range quantized per track, with the ranges stored in trackRanges as
+    //     [block][min xyz, extent xyz][lane].
+    //
+    // The clip itself is immutable once compiled; all per-playback state (cursors, results) lives in AnimationPose.
+    struct AnimationClip
+    {
+        enum TrackType : uint8_t
+        {
+            ROTATION_TRACK = 0,
+            TRANSLATION_TRACK,
+            SCALE_TRACK,
+            NUM_TRACK_TYPES,
+        };
+
+        struct KeyGroup
+        {
+            uint32_t timesOffset = 0;
+            uint32_t numKeys = 0;
+            Animation::InterpolationType interpolationType = Animation::InterpolationType::Linear;
+            bool isQuantized = false;
+            // Offsets into values, or into quantizedValues if the group is quantized
+            uint32_t valuesOffset[NUM_TRACK_TYPES] = { 0 };
+            uint32_t numBlocks[NUM_TRACK_TYPES] = { 0 };
+            uint32_t targetsOffset[NUM_TRACK_TYPES] = { 0 };
+            // Offsets into trackRanges, only used by quantized translation and scale tracks
+            uint32_t rangesOffset[NUM_TRACK_TYPES] = { 0 };
+        };
+
+        float duration = 0.0f;
+        uint32_t numChannels = 0;
+        std::vector<KeyGroup> groups;
+        std::vector<float> keyTimes;
+        std::vector<float> values;
+        std::vector<uint16_t> quantizedValues;
+        std::vector<float> trackRanges;
+        // Pose slot written by each lane of each block. Padding lanes write to the pose's scratch slot.
+        std::vector<uint32_t> laneTargets;
+        // Each pose slot maps to a single entity, with a TransformType mask of the tracks targeting it
+        std::vector<uint32_t> slotEntities;
+        std::vector<uint8_t> slotMasks;
+
+        inline uint32_t getNumSlots() const
+        {
+            return uint32_t(slotEntities.size());
+        };
+
+        inline uint32_t getScratchSlot() const
+        {
+            return getNumSlots();
+        };
+    };
+
+    // Sampled output of a clip, plus the sampling state needed to play it back.
+    // Results are written per slot and scattered to the registry's transforms once, in applyPose.
+    struct AnimationPose
+    {
+        std::vector<glm::quat> rotations;
+        std::vector<glm::vec3> translations;
+        std::vector<glm::vec3> scales;
+        // Cached keyframe cursor for each of the clip's key groups
+        std::vector<uint32_t> groupCursors;
+    };
+
+    AnimationClip compileAnimationClip(const Animation& animation);
+
+    // Size in bytes of the keyframe data, for the source animation and the compiled clip respectively
+    size_t getMemoryUsage(const Animation& animation);
+    size_t getMemoryUsage(const AnimationClip& clip);
+
+    void initPose(const AnimationClip& clip, AnimationPose& pose);
+
+    // Samples every track of the clip at clipTime (in [0, clip.duration]) into the pose
+    void sampleClip(const AnimationClip& clip, const float clipTime, AnimationPose& pose, const QuatInterpolation quatInterpolation = QuatInterpolation::Nlerp);
+
+    // Writes the pose into the transforms of the entities targeted by the clip
+    void applyPose(ECSRegistry& registry, const AnimationClip& clip, const AnimationPose& pose);
+
+    // Same as above, but slot i writes to slotEntities[i] instead of the clip's own entities
+    void applyPose(ECSRegistry& registry, const AnimationClip& clip, const AnimationPose& pose, const std::vector<uint32_t>& slotEntities);
+}
@@ -0,0 +1,503 @@
+#include "pch.h"
+#include "AnimationCompression.h"
+
+
+namespace bdr
+{
+    constexpr uint32_t kLanes = simd::laneWidth;
+    constexpr float kInvSqrt2 = 0.70710678f;
+    // Most of a tolerance quantization may use up, the rest is left for dropping keys
+    constexpr float kMaxQuantizationShare = 0.5f;
+
+    // A single track (block and lane) within one track type of a Linear or Step group
+    struct TrackRef
+    {
+        uint32_t block;
+        uint32_t lane;
+    };
+
+    // Read only view over the float values of one track type within a (Linear or Step) group
+    struct TrackView
+    {
+        const float* times;
+        const float* values;
+        uint32_t numBlocks;
+        uint32_t numComponents;
+        bool isStep;
+
+        inline float get(const uint32_t key, const TrackRef track, const uint32_t component) const
+        {
+            return values[((size_t(key) * numBlocks + track.block) * numComponents + component) * kLanes + track.lane];
+        };
+    };
+
+    inline float getTolerance(const AnimationCompressionSettings& settings, const uint8_t trackType)
+    {
+        switch (trackType) {
+        case AnimationClip::ROTATION_TRACK:
+            return settings.rotationTolerance;
+        case AnimationClip::TRANSLATION_TRACK:
+            return settings.translationTolerance;
+        default:
+            return settings.scaleTolerance;
+        }
+    }
+
+    // Checks whether every key strictly between first and last can be reconstructed, within tolerance,
+    // from those two keys for all of the tracks
+    bool canSkipKeys(const TrackView& view, const std::vector<TrackRef>& tracks, const float tolerance, const uint32_t first, const uint32_t last)
+    {
+        const float span = view.times[last] - view.times[first];
+        if (span <= 0.0f) {
+            return false;
+        }
+        const bool isRotation = view.numComponents == 4;
+
+        for (const TrackRef track : tracks) {
+            float a[4], b[4];
+            float dot = 0.0f;
+            for (uint32_t c = 0; c < view.numComponents; ++c) {
+                a[c] = view.get(first, track, c);
+                b[c] = view.get(last, track, c);
+                dot += a[c] * b[c];
+            }
+            // Match the sampler, which interpolates rotations along the shortest path
+            if (isRotation && dot < 0.0f) {
+                for (uint32_t c = 0; c < 4; ++c) {
+                    b[c] = -b[c];
+                }
+            }
+
+            for (uint32_t key = first + 1; key < last; ++key) {
+                const float t = view.isStep ? 0.0f : (view.times[key] - view.times[first]) / span;
+                float predicted[4];
+                float lengthSq = 0.0f;
+                for (uint32_t c = 0; c < view.numComponents; ++c) {
+                    predicted[c] = glm::mix(a[c], b[c], t);
+                    lengthSq += predicted[c] * predicted[c];
+                }
+
+                float sign = 1.0f;
+                if (isRotation) {
+                    const float invLength = 1.0f / sqrtf(lengthSq);
+                    float keyDot = 0.0f;
+                    for (uint32_t c = 0; c < 4; ++c) {
+                        predicted[c] *= invLength;
+                        keyDot += predicted[c] * view.get(key, track, c);
+                    }
+                    sign = keyDot < 0.0f ? -1.0f : 1.0f;
+                }
+
+                for (uint32_t c = 0; c < view.numComponents; ++c) {
+                    if (fabsf(predicted[c] - sign * view.get(key, track, c)) > tolerance) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Translations, scales and Step tracks predict each component independently, so every key a segment skips bounds the
+    // slope from the segment's anchor to its end to an interval. Intersecting those intervals as the segment grows checks
+    // each candidate end against all the keys it skips in constant time, with the same result as canSkipKeys.
+    std::vector<uint32_t> selectComponentKeys(const TrackView& view, const std::vector<TrackRef>& tracks, const float tolerance, const uint32_t numKeys)
+    {
+        const size_t numValues = tracks.size() * view.numComponents;
+        std::vector<float> minSlopes(numValues);
+        std::vector<float> maxSlopes(numValues);
+        // Whether any end could still skip every key since the anchor
+        bool isFeasible = true;
+        auto resetSlopes = [&]() {
+            std::fill(minSlopes.begin(), minSlopes.end(), -FLT_MAX);
+            std::fill(maxSlopes.begin(), maxSlopes.end(), FLT_MAX);
+            isFeasible = true;
+        };
+        resetSlopes();
+
+        std::vector<uint32_t> keptKeys{ 0 };
+        uint32_t anchor = 0;
+        for (uint32_t key = 1; key < numKeys; ++key) {
+            const float span = view.times[key] - view.times[anchor];
+            if (key >= anchor + 2) {
+                bool canEnd = isFeasible && span > 0.0f;
+                for (size_t i = 0; canEnd && !view.isStep && i < numValues; ++i) {
+                    const TrackRef track = tracks[i / view.numComponents];
+                    const uint32_t c = uint32_t(i % view.numComponents);
+                    const float slope = (view.get(key, track, c) - view.get(anchor, track, c)) / span;
+                    canEnd = slope >= minSlopes[i] && slope <= maxSlopes[i];
+                }
+                if (!canEnd) {
+                    anchor = key - 1;
+                    keptKeys.push_back(anchor);
+                    resetSlopes();
+                }
+            }
+
+            // Any later end skips this key
+            const float offset = view.times[key] - view.times[anchor];
+            for (size_t i = 0; isFeasible && i < numValues; ++i) {
+                const TrackRef track = tracks[i / view.numComponents];
+                const uint32_t c = uint32_t(i % view.numComponents);
+                const float delta = view.get(key, track, c) - view.get(anchor, track, c);
+                // Step tracks hold the anchor's value, as does interpolation at the anchor's own time
+                if (view.isStep || offset <= 0.0f) {
+                    isFeasible = fabsf(delta) <= tolerance;
+                    continue;
+                }
+                minSlopes[i] = std::max(minSlopes[i], (delta - tolerance) / offset);
+                maxSlopes[i] = std::min(maxSlopes[i], (delta + tolerance) / offset);
+                isFeasible = minSlopes[i] <= maxSlopes[i];
+            }
+        }
+        if (numKeys > 1) {
+            keptKeys.push_back(numKeys - 1);
+        }
+        return keptKeys;
+    }
+
+    // Normalized rotations don't split into components, so each segment's end is found by doubling its length until
+    // canSkipKeys fails, then bisecting. That takes logarithmically many checks per segment instead of one per key.
+    std::vector<uint32_t> selectRotationKeys(const TrackView& view, const std::vector<TrackRef>& tracks, const float tolerance, const uint32_t numKeys)
+    {
+        std::vector<uint32_t> keptKeys{ 0 };
+        uint32_t anchor = 0;
+        while (anchor + 1 < numKeys) {
+            // Neighbouring keys skip nothing, so they always make a valid segment
+            uint32_t end = anchor + 1;
+            uint32_t step = 1;
+            while (end + step < numKeys && canSkipKeys(view, tracks, tolerance, anchor, end + step)) {
+                end += step;
+                step *= 2;
+            }
+            uint32_t failedEnd = std::min(end + step, numKeys);
+            while (failedEnd - end > 1) {
+                const uint32_t middle = end + (failedEnd - end) / 2;
+                if (canSkipKeys(view, tracks, tolerance, anchor, middle)) {
+                    end = middle;
+                }
+                else {
+                    failedEnd = middle;
+                }
+            }
+            keptKeys.push_back(end);
+            anchor = end;
+        }
+        return keptKeys;
+    }
+
+    // Keeps the keys needed to reconstruct every track within tolerance. The first and last keys are always kept.
+    std::vector<uint32_t> selectKeys(const TrackView& view, const std::vector<TrackRef>& tracks, const float tolerance, const uint32_t numKeys)
+    {
+        return view.numComponents == 4
+            ? selectRotationKeys(view, tracks, tolerance, numKeys)
+            : selectComponentKeys(view, tracks, tolerance, numKeys);
+    }
+
+    // Range quantization spends 16 bits over each track's extent, so is off by at most half a step. Kept keys only
+    // span part of the extent, so the whole track's bounds the error of any selection of keys.
+    float getRangeQuantizationError(const TrackView& view, const std::vector<TrackRef>& tracks, const uint32_t numKeys)
+    {
+        float maxExtent = 0.0f;
+        for (const TrackRef track : tracks) {
+            for (uint32_t c = 0; c < 3; ++c) {
+                float minimum = FLT_MAX;
+                float maximum = -FLT_MAX;
+                for (uint32_t key = 0; key < numKeys; ++key) {
+                    minimum = std::min(minimum, view.get(key, track, c));
+                    maximum = std::max(maximum, view.get(key, track, c));
+                }
+                maxExtent = std::max(maxExtent, maximum - minimum);
+            }
+        }
+        return maxExtent / (2.0f * 65535.0f);
+    }
+
+    // Drops the largest component (made positive so its sign is implied) and stores the other three in 15 bits each,
+    // with the index of the dropped component in the top bits of the first two.
+    inline void encodeSmallestThree(const float q[4], uint16_t out[3])
+    {
+        uint32_t largest = 0;
+        float lengthSq = 0.0f;
+        for (uint32_t c = 0; c < 4; ++c) {
+            lengthSq += q[c] * q[c];
+            if (fabsf(q[c]) > fabsf(q[largest])) {
+                largest = c;
+            }
+        }
+        const float scale = (q[largest] < 0.0f ? -1.0f : 1.0f) / sqrtf(lengthSq);
+
+        uint32_t outIdx = 0;
+        for (uint32_t c = 0; c < 4; ++c) {
+            if (c == largest) {
+                continue;
+            }
+            const float normalized = (q[c] * scale + kInvSqrt2) * (32767.0f / (2.0f * kInvSqrt2));
+            out[outIdx++] = uint16_t(glm::clamp(roundf(normalized), 0.0f, 32767.0f));
+        }
+        out[0] |= uint16_t((largest & 1u) << 15);
+        out[1] |= uint16_t((largest >> 1) << 15);
+    }
+
+    // Scalar version of the sampler's decode
+    inline void decodeSmallestThree(const uint16_t encoded[3], float q[4])
+    {
+        const uint32_t largest = (encoded[0] >> 15) | ((encoded[1] >> 15) << 1);
+        float lengthSq = 0.0f;
+        uint32_t inIdx = 0;
+        for (uint32_t c = 0; c < 4; ++c) {
+            if (c == largest) {
+                continue;
+            }
+            q[c] = float(encoded[inIdx++] & 0x7FFFu) * (2.0f * kInvSqrt2 / 32767.0f) - kInvSqrt2;
+            lengthSq += q[c] * q[c];
+        }
+        q[largest] = sqrtf(std::max(1.0f - lengthSq, 0.0f));
+    }
+
+    // Each key's smallest three error doesn't depend on which other keys are kept, so measure it for every key
+    float getRotationQuantizationError(const TrackView& view, const std::vector<TrackRef>& tracks, const uint32_t numKeys)
+    {
+        float maxError = 0.0f;
+        for (const TrackRef track : tracks) {
+            for (uint32_t key = 0; key < numKeys; ++key) {
+                float q[4];
+                float lengthSq = 0.0f;
+                for (uint32_t c = 0; c < 4; ++c) {
+                    q[c] = view.get(key, track, c);
+                    lengthSq += q[c] * q[c];
+                }
+                uint16_t encoded[3];
+                encodeSmallestThree(q, encoded);
+                float decoded[4];
+                decodeSmallestThree(encoded, decoded);
+
+                // The encoding flips the rotation so its largest component is positive
+                const uint32_t largest = (encoded[0] >> 15) | ((encoded[1] >> 15) << 1);
+                const float scale = (q[largest] < 0.0f ? -1.0f : 1.0f) / sqrtf(lengthSq);
+                for (uint32_t c = 0; c < 4; ++c) {
+                    maxError = std::max(maxError, fabsf(decoded[c] - q[c] * scale));
+                }
+            }
+        }
+        return maxError;
+    }
+
+    // Interpolating quantized keys is off by at most the keys' own error, which adds to the error of dropping keys.
+    // Quantizes when that leaves enough of the tolerance for dropping keys, and returns what's left.
+    float splitTolerance(
+        const TrackView& view,
+        const std::vector<TrackRef>& tracks,
+        const uint32_t numKeys,
+        const float tolerance,
+        const bool quantize,
+        bool& isQuantized
+    )
+    {
+        isQuantized = false;
+        if (!quantize) {
+            return tolerance;
+        }
+        const float quantizationError = view.numComponents == 4
+            ? getRotationQuantizationError(view, tracks, numKeys)
+            : getRangeQuantizationError(view, tracks, numKeys);
+        if (quantizationError > tolerance * kMaxQuantizationShare) {
+            return tolerance;
+        }
+        isQuantized = true;
+        return tolerance - quantizationError;
+    }
+
+    // Writes a single quantized block holding the tracks, padding lanes are left as identity/zero
+    void quantizeBlock(
+        const TrackView& view,
+        const std::vector<TrackRef>& tracks,
+        const std::vector<uint32_t>& keptKeys,
+        AnimationClip& compressed
+    )
+    {
+        const size_t blockSize = 3u * kLanes;
+        uint16_t* values = &*compressed.quantizedValues.insert(compressed.quantizedValues.end(), keptKeys.size() * blockSize, 0u);
+
+        if (view.numComponents == 4) {
+            const float identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+            for (size_t keyIdx = 0; keyIdx < keptKeys.size(); ++keyIdx) {
+                uint16_t* blockValues = &values[keyIdx * blockSize];
+                for (uint32_t lane = 0; lane < kLanes; ++lane) {
+                    float q[4];
+                    for (uint32_t c = 0; c < 4; ++c) {
+                        q[c] = lane < tracks.size() ? view.get(keptKeys[keyIdx], tracks[lane], c) : identity[c];
+                    }
+                    uint16_t encoded[3];
+                    encodeSmallestThree(q, encoded);
+                    for (uint32_t c = 0; c < 3; ++c) {
+                        blockValues[c * kLanes + lane] = encoded[c];
+                    }
+                }
+            }
+            return;
+        }
+
+        float* blockRanges = &*compressed.trackRanges.insert(compressed.trackRanges.end(), 6u * kLanes, 0.0f);
+        for (uint32_t lane = 0; lane < tracks.size(); ++lane) {
+            for (uint32_t c = 0; c < 3; ++c) {
+                float minimum = FLT_MAX;
+                float maximum = -FLT_MAX;
+                for (const uint32_t key : keptKeys) {
+                    minimum = std::min(minimum, view.get(key, tracks[lane], c));
+                    maximum = std::max(maximum, view.get(key, tracks[lane], c));
+                }
+                const float extent = maximum - minimum;
+                blockRanges[c * kLanes + lane] = minimum;
+                blockRanges[(3u + c) * kLanes + lane] = extent;
+
+                const float invExtent = extent > 0.0f ? 65535.0f / extent : 0.0f;
+                for (size_t keyIdx = 0; keyIdx < keptKeys.size(); ++keyIdx) {
+                    const float normalized = (view.get(keptKeys[keyIdx], tracks[lane], c) - minimum) * invExtent;
+                    values[keyIdx * blockSize + c * kLanes + lane] = uint16_t(glm::clamp(roundf(normalized), 0.0f, 65535.0f));
+                }
+            }
+        }
+    }
+
+    void copyBlock(
+        const TrackView& view,
+        const std::vector<TrackRef>& tracks,
+        const std::vector<uint32_t>& keptKeys,
+        AnimationClip& compressed
+    )
+    {
+        const size_t blockSize = size_t(view.numComponents) * kLanes;
+        float* values = &*compressed.values.insert(compressed.values.end(), keptKeys.size() * blockSize, 0.0f);
+        for (size_t keyIdx = 0; keyIdx < keptKeys.size(); ++keyIdx) {
+            for (uint32_t lane = 0; lane < kLanes; ++lane) {
+                for (uint32_t c = 0; c < view.numComponents; ++c) {
+                    float value = view.numComponents == 4 && c == 3 ? 1.0f : 0.0f;
+                    if (lane < tracks.size()) {
+                        value = view.get(keptKeys[keyIdx], tracks[lane], c);
+                    }
+                    values[keyIdx * blockSize + c * kLanes + lane] = value;
+                }
+            }
+        }
+    }
+
+    void copyCubicGroup(const AnimationClip& clip, const AnimationClip::KeyGroup& group, AnimationClip& compressed)
+    {
+        AnimationClip::KeyGroup compressedGroup = group;
+        compressedGroup.timesOffset = uint32_t(compressed.keyTimes.size());
+        const float* times = &clip.keyTimes[group.timesOffset];
+        compressed.keyTimes.insert(compressed.keyTimes.end(), times, times + group.numKeys);
+
+        for (uint8_t trackType = 0; trackType < AnimationClip::NUM_TRACK_TYPES; ++trackType) {
+            const uint32_t numComponents = trackType == AnimationClip::ROTATION_TRACK ? 4u : 3u;
+            const size_t numValues = size_t(group.numKeys) * 3u * group.numBlocks[trackType] * numComponents * kLanes;
+            const float* values = clip.values.data() + group.valuesOffset[trackType];
+            compressedGroup.valuesOffset[trackType] = uint32_t(compressed.values.size());
+            compressed.values.insert(compressed.values.end(), values, values + numValues);
+
+            const uint32_t* laneTargets = clip.laneTargets.data() + group.targetsOffset[trackType];
+            compressedGroup.targetsOffset[trackType] = uint32_t(compressed.laneTargets.size());
+            compressed.laneTargets.insert(compressed.laneTargets.end(), laneTargets, laneTargets + group.numBlocks[trackType] * kLanes);
+        }
+        compressed.groups.push_back(compressedGroup);
+    }
+
+    AnimationClip compressAnimationClip(const AnimationClip& clip, const AnimationCompressionSettings& settings)
+    {
+        AnimationClip compressed{};
+        compressed.duration = clip.duration;
+        compressed.numChannels = clip.numChannels;
+        compressed.slotEntities = clip.slotEntities;
+        compressed.slotMasks = clip.slotMasks;
+        const uint32_t scratchSlot = clip.getScratchSlot();
+
+        for (const AnimationClip::KeyGroup& group : clip.groups) {
+            if (group.interpolationType == Animation::InterpolationType::CubicSpline) {
+                copyCubicGroup(clip, group, compressed);
+                continue;
+            }
+
+            // Tracks sharing key times rarely all need the same keys, so each track type is split back into
+            // tracks, which are sorted by how many keys they need on their own and then re-blocked.
+            // Every block becomes its own group with its own key times, so near constant tracks end up
+            // together and keep only a couple of keys.
+            for (uint8_t trackType = 0; trackType < AnimationClip::NUM_TRACK_TYPES; ++trackType) {
+                // Empty track types' offsets are one past the end of the clip's arrays
+                if (group.numBlocks[trackType] == 0) {
+                    continue;
+                }
+                const TrackView view{
+                    &clip.keyTimes[group.timesOffset],
+                    clip.values.data() + group.valuesOffset[trackType],
+                    group.numBlocks[trackType],
+                    trackType == AnimationClip::ROTATION_TRACK ? 4u : 3u,
+                    group.interpolationType == Animation::InterpolationType::Step,
+                };
+                const float tolerance = getTolerance(settings, trackType);
+                const uint32_t* laneTargets = clip.laneTargets.data() + group.targetsOffset[trackType];
+
+                std::vector<std::pair<uint32_t, TrackRef>> sortedTracks;
+                for (uint32_t block = 0; block < view.numBlocks; ++block) {
+                    for (uint32_t lane = 0; lane < kLanes; ++lane) {
+                        if (laneTargets[block * kLanes + lane] == scratchSlot) {
+                            continue;
+                        }
+                        const TrackRef track{ block, lane };
+                        bool isQuantized;
+                        const float keyTolerance = splitTolerance(view, { track }, group.numKeys, tolerance, settings.quantize, isQuantized);
+                        const uint32_t numKeptKeys = uint32_t(selectKeys(view, { track }, keyTolerance, group.numKeys).size());
+                        sortedTracks.push_back({ numKeptKeys, track });
+                    }
+                }
+                std::stable_sort(sortedTracks.begin(), sortedTracks.end(), [](const std::pair<uint32_t, TrackRef>& lhs, const std::pair<uint32_t, TrackRef>& rhs) {
+                    return lhs.first < rhs.first;
+                });
+
+                for (size_t first = 0; first < sortedTracks.size(); first += kLanes) {
+                    std::vector<TrackRef> tracks;
+                    for (size_t i = first; i < std::min(first + kLanes, sortedTracks.size()); ++i) {
+                        tracks.push_back(sortedTracks[i].second);
+                    }
+                    bool isQuantized;
+                    const float keyTolerance = splitTolerance(view, tracks, group.numKeys, tolerance, settings.quantize, isQuantized);
+                    const std::vector<uint32_t> keptKeys = selectKeys(view, tracks, keyTolerance, group.numKeys);
+
+                    AnimationClip::KeyGroup blockGroup{};
+                    blockGroup.interpolationType = group.interpolationType;
+                    blockGroup.numKeys = uint32_t(keptKeys.size());
+                    blockGroup.timesOffset = uint32_t(compressed.keyTimes.size());
+                    for (const uint32_t key : keptKeys) {
+                        compressed.keyTimes.push_back(view.times[key]);
+                    }
+                    blockGroup.numBlocks[trackType] = 1;
+                    blockGroup.targetsOffset[trackType] = uint32_t(compressed.laneTargets.size());
+                    for (uint32_t lane = 0; lane < kLanes; ++lane) {
+                        const TrackRef track = lane < tracks.size() ? tracks[lane] : TrackRef{ 0, 0 };
+                        compressed.laneTargets.push_back(lane < tracks.size() ? laneTargets[track.block * kLanes + track.lane] : scratchSlot);
+                    }
+
+                    blockGroup.isQuantized = isQuantized;
+                    if (blockGroup.isQuantized) {
+                        blockGroup.valuesOffset[trackType] = uint32_t(compressed.quantizedValues.size());
+                        blockGroup.rangesOffset[trackType] = uint32_t(compressed.trackRanges.size());
+                        quantizeBlock(view, tracks, keptKeys, compressed);
+                    }
+                    else {
+                        blockGroup.valuesOffset[trackType] = uint32_t(compressed.values.size());
+                        copyBlock(view, tracks, keptKeys, compressed);
+                    }
+                    compressed.groups.push_back(blockGroup);
+                }
+            }
+        }
+
+        compressed.groups.shrink_to_fit();
+        compressed.keyTimes.shrink_to_fit();
+        compressed.values.shrink_to_fit();
+        compressed.quantizedValues.shrink_to_fit();
+        compressed.trackRanges.shrink_to_fit();
+        compressed.laneTargets.shrink_to_fit();
+        return compressed;
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "pch.h"
+
+#include "AnimationClip.h"
+
+namespace bdr
+{
+    struct AnimationCompressionSettings
+    {
+        // Maximum per component error of the compressed clip, in the track's own units. Quantization error is taken
+        // out of it first, what's left goes to dropping keys.
+        float rotationTolerance = 0.0005f;
+        float translationTolerance = 0.0001f;
+        float scaleTolerance = 0.0001f;
+        // Quantize Linear and Step groups: smallest-three rotations and range quantized translations/scales.
+        // Blocks whose quantization error would take more than half of the tolerances are left at full precision.
+        bool quantize = true;
+    };
+
+    // Returns a compressed copy of a compiled clip. Keys that can be reconstructed (within tolerance) by
+    // interpolating their neighbours are removed, then the remaining values are quantized to 16 bits.
+    // Tracks are re-blocked by how many keys they need, so the compressed clip has more, smaller groups.
+    // CubicSpline groups are left untouched, since their tangents depend on the exact key spacing.
+    AnimationClip compressAnimationClip(const AnimationClip& clip, const AnimationCompressionSettings& settings = AnimationCompressionSettings{});
+}
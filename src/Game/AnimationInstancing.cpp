@@ -0,0 +1,308 @@
+#include "pch.h"
+#include "AnimationInstancing.h"
+
+#include "Scene.h"
+#include "Core/JobSystem.h"
+
+
+namespace bdr
+{
+    uint32_t addAnimationInstance(Scene& scene, const uint32_t clipIdx, const float startTime, std::vector<uint32_t> slotEntities)
+    {
+        ASSERT(clipIdx < scene.animationClips.size(), "Invalid clip index");
+        const AnimationClip& clip = scene.animationClips[clipIdx];
+        if (slotEntities.empty()) {
+            slotEntities = clip.slotEntities;
+        }
+        ASSERT(slotEntities.size() == clip.getNumSlots(), "Expected one entity per pose slot");
+
+        AnimationInstance instance{};
+        instance.clipIdx = clipIdx;
+        instance.startTime = startTime;
+        instance.lodEntity = slotEntities.empty() ? UINT32_MAX : slotEntities[0];
+        instance.slotEntities = std::move(slotEntities);
+
+        const uint32_t idx = uint32_t(scene.animationInstances.size());
+        scene.animationInstances.push_back(std::move(instance));
+        return idx;
+    }
+
+    inline float getInstanceClipTime(const AnimationInstance& instance, const float duration, const float currentTime)
+    {
+        if (duration <= 0.0f) {
+            return 0.0f;
+        }
+        const float clipTime = fmod((currentTime - instance.startTime) * instance.speed, duration);
+        return clipTime < 0.0f ? clipTime + duration : clipTime;
+    }
+
+    // Picks the instance's update rate from how much of the screen its bounding sphere covers
+    void updateInstanceLod(const Scene& scene, const AnimationLodSettings& lodSettings, const math::Frustum& frustum, AnimationInstance& instance)
+    {
+        if (instance.lodEntity == UINT32_MAX) {
+            instance.updateRate = AnimationUpdateRate::Full;
+            instance.updateInterval = 1;
+            return;
+        }
+
+        const Camera& camera = scene.cameras[lodSettings.cameraIdx];
+        const glm::vec3 position = math::getTranslation(scene.registry.globalMatrices[instance.lodEntity]);
+        if (lodSettings.pauseHidden && !math::isSphereInFrustum(frustum, position, instance.boundingRadius)) {
+            instance.updateRate = AnimationUpdateRate::Paused;
+            instance.screenSize = 0.0f;
+            return;
+        }
+
+        // Fraction of the screen height covered by the sphere
+        const float depth = -(camera.view * glm::vec4{ position, 1.0f }).z;
+        instance.screenSize = depth > instance.boundingRadius ? instance.boundingRadius * camera.projection[1][1] / depth : 1.0f;
+
+        if (instance.screenSize >= lodSettings.fullRateScreenSize) {
+            instance.updateRate = AnimationUpdateRate::Full;
+            instance.updateInterval = 1;
+        }
+        else {
+            const float interval = ceilf(lodSettings.fullRateScreenSize / std::max(instance.screenSize, 1e-6f));
+            instance.updateInterval = std::max(1u, std::min(lodSettings.maxUpdateInterval, uint32_t(std::min(interval, 65536.0f))));
+            instance.updateRate = instance.updateInterval > 1 ? AnimationUpdateRate::Throttled : AnimationUpdateRate::Full;
+        }
+    }
+
+    // Returns the pose to use for the clip at clipTime, adding it to the cache if it's the first instance to need
+    // it this frame. Returns UINT32_MAX if sampling a new pose would go over the channel budget.
+    uint32_t acquirePose(
+        AnimationPoseCache& cache,
+        const Scene& scene,
+        const uint32_t clipIdx,
+        const float clipTime,
+        const uint32_t maxChannelsPerFrame
+    )
+    {
+        const AnimationClip& clip = scene.animationClips[clipIdx];
+        uint32_t bucket;
+        float sampleTime;
+        if (cache.phaseQuantum > 0.0f) {
+            bucket = uint32_t(clipTime / cache.phaseQuantum + 0.5f);
+            sampleTime = std::min(float(bucket) * cache.phaseQuantum, clip.duration);
+        }
+        else {
+            bucket = glm::floatBitsToUint(clipTime);
+            sampleTime = clipTime;
+        }
+
+        const uint64_t key = (uint64_t(clipIdx) << 32) | bucket;
+        auto it = cache.poseLookup.find(key);
+        if (it != cache.poseLookup.end()) {
+            ++cache.stats.numCacheHits;
+            return it->second;
+        }
+
+        // Always let the first pose through, so the budget can't stall every instance
+        const uint32_t numChannels = cache.stats.numChannelsSampled + clip.numChannels;
+        if (maxChannelsPerFrame > 0 && cache.stats.numChannelsSampled > 0 && numChannels > maxChannelsPerFrame) {
+            return UINT32_MAX;
+        }
+        cache.stats.numChannelsSampled = numChannels;
+
+        const uint32_t poseIdx = cache.numActivePoses++;
+        if (poseIdx == cache.poses.size()) {
+            cache.poses.emplace_back();
+            cache.poseClips.push_back(UINT32_MAX);
+            cache.poseTimes.push_back(0.0f);
+        }
+        // Pooled poses keep their key cursors, so only re-initialize when the pose switches clips
+        if (cache.poseClips[poseIdx] != clipIdx) {
+            initPose(clip, cache.poses[poseIdx]);
+            cache.poseClips[poseIdx] = clipIdx;
+        }
+        cache.poseTimes[poseIdx] = sampleTime;
+        cache.poseLookup.emplace(key, poseIdx);
+        return poseIdx;
+    }
+
+    void copyPoseValues(const AnimationPose& src, AnimationPose& dst)
+    {
+        dst.rotations.assign(src.rotations.begin(), src.rotations.end());
+        dst.translations.assign(src.translations.begin(), src.translations.end());
+        dst.scales.assign(src.scales.begin(), src.scales.end());
+    }
+
+    void applyBlendedPose(
+        ECSRegistry& registry,
+        const AnimationClip& clip,
+        const AnimationPose& from,
+        const AnimationPose& to,
+        const float alpha,
+        const std::vector<uint32_t>& slotEntities
+    )
+    {
+        const uint32_t numSlots = clip.getNumSlots();
+        for (uint32_t slot = 0; slot < numSlots; ++slot) {
+            Transform& transform = registry.transforms[slotEntities[slot]];
+            const uint8_t mask = clip.slotMasks[slot];
+            if (mask & TransformType::Rotation) {
+                const glm::quat& a = from.rotations[slot];
+                const glm::quat& b = to.rotations[slot];
+                const float sign = glm::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+                transform.rotation = glm::normalize(a * (1.0f - alpha) + b * (sign * alpha));
+            }
+            if (mask & TransformType::Translation) {
+                transform.translation = glm::mix(from.translations[slot], to.translations[slot], alpha);
+            }
+            if (mask & TransformType::Scale) {
+                transform.scale = glm::mix(from.scales[slot], to.scales[slot], alpha);
+            }
+        }
+    }
+
+    void updateInstances(
+        Scene& scene,
+        AnimationPoseCache& cache,
+        JobSystem& jobSystem,
+        const AnimationLodSettings* lodSettings,
+        const float currentTime,
+        const QuatInterpolation quatInterpolation
+    )
+    {
+        const size_t numInstances = scene.animationInstances.size();
+        cache.stats = AnimationPoseCache::Stats{};
+        cache.stats.numInstances = uint32_t(numInstances);
+        cache.poseLookup.clear();
+        cache.numActivePoses = 0;
+        cache.instancePoses.assign(numInstances, UINT32_MAX);
+        cache.dueInstances.clear();
+
+        math::Frustum frustum{};
+        if (lodSettings != nullptr) {
+            ASSERT(lodSettings->cameraIdx < scene.cameras.size(), "Invalid camera index");
+            const Camera& camera = scene.cameras[lodSettings->cameraIdx];
+            frustum = math::extractFrustum(camera.projection * camera.view);
+        }
+
+        for (uint32_t i = 0; i < numInstances; ++i) {
+            AnimationInstance& instance = scene.animationInstances[i];
+            if (!instance.isPlaying) {
+                continue;
+            }
+            ++cache.stats.numPlayingInstances;
+
+            if (lodSettings != nullptr) {
+                updateInstanceLod(scene, *lodSettings, frustum, instance);
+            }
+            else {
+                instance.updateRate = AnimationUpdateRate::Full;
+                instance.updateInterval = 1;
+            }
+            if (instance.updateRate == AnimationUpdateRate::Paused) {
+                // Resume from a fresh sample once visible again, rather than blending from a stale one
+                instance.framesSinceUpdate = UINT32_MAX;
+                instance.hasPreviousPose = false;
+                instance.latestPose.rotations.clear();
+                ++cache.stats.numPausedInstances;
+                continue;
+            }
+            if (instance.updateRate == AnimationUpdateRate::Throttled) {
+                ++cache.stats.numThrottledInstances;
+            }
+            else {
+                instance.hasPreviousPose = false;
+                instance.latestPose.rotations.clear();
+            }
+
+            if (instance.framesSinceUpdate != UINT32_MAX) {
+                ++instance.framesSinceUpdate;
+            }
+            if (instance.framesSinceUpdate >= instance.updateInterval) {
+                cache.dueInstances.push_back(i);
+            }
+        }
+
+        uint32_t maxChannelsPerFrame = 0;
+        if (lodSettings != nullptr && lodSettings->maxChannelsPerFrame > 0) {
+            maxChannelsPerFrame = lodSettings->maxChannelsPerFrame;
+            // Spend the budget on the instances covering the most of the screen first
+            std::stable_sort(cache.dueInstances.begin(), cache.dueInstances.end(), [&scene](const uint32_t lhs, const uint32_t rhs) {
+                return scene.animationInstances[lhs].screenSize > scene.animationInstances[rhs].screenSize;
+            });
+        }
+
+        for (const uint32_t i : cache.dueInstances) {
+            AnimationInstance& instance = scene.animationInstances[i];
+            const float clipTime = getInstanceClipTime(instance, scene.animationClips[instance.clipIdx].duration, currentTime);
+            const uint32_t poseIdx = acquirePose(cache, scene, instance.clipIdx, clipTime, maxChannelsPerFrame);
+            if (poseIdx == UINT32_MAX) {
+                // Stays due, so it's considered again next frame
+                ++cache.stats.numDeferredInstances;
+                continue;
+            }
+            cache.instancePoses[i] = poseIdx;
+            instance.framesSinceUpdate = 0;
+        }
+        cache.stats.numSampledPoses = cache.numActivePoses;
+
+        // Sampling cost scales with the number of unique poses...
+        jobSystem.parallelFor(cache.numActivePoses, 1, [&](const size_t begin, const size_t end) {
+            for (size_t poseIdx = begin; poseIdx < end; ++poseIdx) {
+                const AnimationClip& clip = scene.animationClips[cache.poseClips[poseIdx]];
+                sampleClip(clip, cache.poseTimes[poseIdx], cache.poses[poseIdx], quatInterpolation);
+            }
+        });
+
+        // ...while each instance only pays for copying (or blending) a pose into its transforms
+        jobSystem.parallelFor(numInstances, 16, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                AnimationInstance& instance = scene.animationInstances[i];
+                if (!instance.isPlaying || instance.updateRate == AnimationUpdateRate::Paused) {
+                    continue;
+                }
+                const AnimationClip& clip = scene.animationClips[instance.clipIdx];
+                const uint32_t poseIdx = cache.instancePoses[i];
+
+                if (instance.updateRate == AnimationUpdateRate::Full) {
+                    if (poseIdx != UINT32_MAX) {
+                        applyPose(scene.registry, clip, cache.poses[poseIdx], instance.slotEntities);
+                    }
+                    continue;
+                }
+
+                if (poseIdx != UINT32_MAX) {
+                    instance.hasPreviousPose = !instance.latestPose.rotations.empty();
+                    std::swap(instance.previousPose, instance.latestPose);
+                    copyPoseValues(cache.poses[poseIdx], instance.latestPose);
+                }
+
+                if (!instance.hasPreviousPose) {
+                    if (poseIdx != UINT32_MAX) {
+                        applyPose(scene.registry, clip, instance.latestPose, instance.slotEntities);
+                    }
+                    continue;
+                }
+                const float alpha = std::min(float(instance.framesSinceUpdate) / float(instance.updateInterval), 1.0f);
+                applyBlendedPose(scene.registry, clip, instance.previousPose, instance.latestPose, alpha, instance.slotEntities);
+            }
+        });
+    }
+
+    void updateAnimationInstances(
+        Scene& scene,
+        AnimationPoseCache& cache,
+        JobSystem& jobSystem,
+        const float currentTime,
+        const QuatInterpolation quatInterpolation
+    )
+    {
+        updateInstances(scene, cache, jobSystem, nullptr, currentTime, quatInterpolation);
+    }
+
+    void updateAnimationInstances(
+        Scene& scene,
+        AnimationPoseCache& cache,
+        JobSystem& jobSystem,
+        const AnimationLodSettings& lodSettings,
+        const float currentTime,
+        const QuatInterpolation quatInterpolation
+    )
+    {
+        updateInstances(scene, cache, jobSystem, &lodSettings, currentTime, quatInterpolation);
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include "pch.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include "AnimationClip.h"
+
+namespace bdr
+{
+    class Scene;
+    class JobSystem;
+
+    enum class AnimationUpdateRate : uint8_t
+    {
+        // Sampled every frame
+        Full = 0,
+        // Sampled every updateInterval frames, blending the two latest samples in between
+        Throttled,
+        // Outside of the camera's frustum, not sampled nor applied at all
+        Paused,
+    };
+
+    // A playback of one of the scene's compiled clips on its own set of entities, e.g. one member of a crowd.
+    // Many instances can share a clip; the clip itself is never copied.
+    struct AnimationInstance
+    {
+        // Index into scene.animationClips
+        uint32_t clipIdx = 0;
+        float startTime = 0.0f;
+        float speed = 1.0f;
+        bool isPlaying = true;
+        // The entity driven by each of the clip's pose slots, for this instance
+        std::vector<uint32_t> slotEntities;
+
+        // Level of detail inputs: the entity whose world position places the instance (its first slot entity
+        // by default) and the radius of a sphere around it bounding the animated character
+        uint32_t lodEntity = UINT32_MAX;
+        float boundingRadius = 1.0f;
+
+        // Level of detail state, updated by updateAnimationInstances
+        AnimationUpdateRate updateRate = AnimationUpdateRate::Full;
+        uint32_t updateInterval = 1;
+        uint32_t framesSinceUpdate = UINT32_MAX;
+        float screenSize = 0.0f;
+        // The two most recent samples of a throttled instance. Frames between samples blend from one to the
+        // other, so throttled instances lag by up to updateInterval frames but stay smooth.
+        AnimationPose previousPose;
+        AnimationPose latestPose;
+        bool hasPreviousPose = false;
+    };
+
+    // Per instance update rate policy for updateAnimationInstances
+    struct AnimationLodSettings
+    {
+        // Index into scene.cameras
+        uint32_t cameraIdx = 0;
+        // Instances whose bounding sphere covers at least this fraction of the screen height update every frame.
+        // Smaller ones update every ceil(fullRateScreenSize / screenSize) frames, up to maxUpdateInterval.
+        float fullRateScreenSize = 0.1f;
+        uint32_t maxUpdateInterval = 8;
+        bool pauseHidden = true;
+        // Caps the channels sampled per frame, 0 for no cap. Due instances are sampled from the largest on
+        // screen down, and the ones that don't fit are deferred to the next frame.
+        uint32_t maxChannelsPerFrame = 0;
+    };
+
+    // Poses sampled this frame, shared by every instance that plays the same clip in the same phase bucket
+    struct AnimationPoseCache
+    {
+        struct Stats
+        {
+            uint32_t numInstances = 0;
+            uint32_t numPlayingInstances = 0;
+            // Unique poses sampled this frame
+            uint32_t numSampledPoses = 0;
+            // Playing instances that reused a pose sampled for another instance
+            uint32_t numCacheHits = 0;
+            uint32_t numChannelsSampled = 0;
+            uint32_t numThrottledInstances = 0;
+            uint32_t numPausedInstances = 0;
+            // Instances that were due for an update but didn't fit in the channel budget
+            uint32_t numDeferredInstances = 0;
+        };
+
+        // Clip times are snapped to multiples of this before sampling, so instances whose phases are close
+        // share a pose. 0 only shares poses between instances at the exact same clip time.
+        float phaseQuantum = 1.0f / 60.0f;
+
+        // Pooled across frames so the poses (and their key cursors) don't get reallocated every frame
+        std::vector<AnimationPose> poses;
+        std::vector<uint32_t> poseClips;
+        std::vector<float> poseTimes;
+        uint32_t numActivePoses = 0;
+
+        // (clip, phase bucket) -> index into poses, for the current frame
+        std::unordered_map<uint64_t, uint32_t> poseLookup;
+        // Pose sampled for each instance this frame, UINT32_MAX if the instance isn't sampled this frame
+        std::vector<uint32_t> instancePoses;
+        // Scratch list of instances due for a sample, in priority order
+        std::vector<uint32_t> dueInstances;
+
+        Stats stats;
+    };
+
+    // Passing no slot entities plays the clip on the entities it was imported for
+    uint32_t addAnimationInstance(
+        Scene& scene,
+        const uint32_t clipIdx,
+        const float startTime,
+        std::vector<uint32_t> slotEntities = std::vector<uint32_t>{}
+    );
+
+    // Samples one pose per unique (clip, phase bucket) and broadcasts it to every instance playing it.
+    // Instances are expected to drive disjoint sets of entities.
+    void updateAnimationInstances(
+        Scene& scene,
+        AnimationPoseCache& cache,
+        JobSystem& jobSystem,
+        const float currentTime,
+        const QuatInterpolation quatInterpolation = QuatInterpolation::Nlerp
+    );
+
+    // Same as above, but each instance's update rate is picked from its size on screen, see AnimationLodSettings
+    void updateAnimationInstances(
+        Scene& scene,
+        AnimationPoseCache& cache,
+        JobSystem& jobSystem,
+        const AnimationLodSettings& lodSettings,
+        const float currentTime,
+        const QuatInterpolation quatInterpolation = QuatInterpolation::Nlerp
+    );
+}
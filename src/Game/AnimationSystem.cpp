@@ -9,76 +9,340 @@ namespace bdr
         uint32_t nextIdx = 1;
         // Interpolation Coefficient
         float t = 0.0f;
+        // Time between the two keyframes, needed to scale cubic spline tangents
+        float deltaT = 0.0f;
     };
 
-    // Increments the channel's currentInputIdx, if necessary
+    // Moves the channel's cached cursor (currentInputIdx) to the keyframe preceding animationTime
     template<typename ChannelT>
     void updateChannel(ChannelT& channel, const float animationTime)
     {
-        float deltaT = (channel.maxInput - channel.input[0]) / float(channel.input.size() - 1);
-        channel.currentInputIdx = static_cast<uint32_t>(floorf(animationTime / deltaT));
+        channel.currentInputIdx = advanceKeyframeCursor(
+            channel.input.data(),
+            uint32_t(channel.input.size()),
+            channel.currentInputIdx,
+            animationTime
+        );
     };
 
     template<typename ChannelT>
-    InterpolationInfo calcInterpolationInfo(ChannelT& channel, const float animationTime)
+    InterpolationInfo calcInterpolationInfo(const ChannelT& channel, const float animationTime)
     {
-        uint32_t nextIdx = channel.currentInputIdx + 1;
-        float previousTime = channel.input[channel.currentInputIdx];
-        float nextTime = channel.input[nextIdx];
-        // Interpolation Value
-        float t = (animationTime - previousTime) / (nextTime - previousTime);
+        const uint32_t lastIdx = uint32_t(channel.input.size() - 1);
+        const uint32_t previousIdx = channel.currentInputIdx;
+        const uint32_t nextIdx = std::min(previousIdx + 1, lastIdx);
+        const float previousTime = channel.input[previousIdx];
+        const float nextTime = channel.input[nextIdx];
+        const float deltaT = nextTime - previousTime;
+
+        // Before the first or after the last keyframe we just hold the closest value
+        float t = 0.0f;
+        if (deltaT > 0.0f) {
+            t = glm::clamp((animationTime - previousTime) / deltaT, 0.0f, 1.0f);
+        }
         return {
-            channel.currentInputIdx,
+            previousIdx,
             nextIdx,
-            t
+            t,
+            deltaT,
         };
     }
 
-    void updateAnimation(ECSRegistry& registry, Animation& animation, const float currentTime)
+    inline glm::vec3 interpolateLinear(const glm::vec3& previous, const glm::vec3& next, const float t)
+    {
+        return glm::mix(previous, next, t);
+    }
+
+    inline glm::quat interpolateLinear(const glm::quat& previous, const glm::quat& next, const float t)
+    {
+        return glm::slerp(previous, next, t);
+    }
+
+    inline glm::vec3 finalizeCubic(const glm::vec3& value)
+    {
+        return value;
+    }
+
+    inline glm::quat finalizeCubic(const glm::quat& value)
+    {
+        return glm::normalize(value);
+    }
+
+    // Samples the channel at animationTime, respecting its interpolation type.
+    // Cubic spline channels store three outputs per keyframe: in-tangent, value and out-tangent.
+    template<typename T>
+    T sampleChannel(Animation::Channel<T>& channel, const float animationTime)
+    {
+        updateChannel(channel, animationTime);
+        const InterpolationInfo info = calcInterpolationInfo(channel, animationTime);
+        const std::vector<T>& output = channel.output;
+
+        switch (channel.interpolationType) {
+        case Animation::InterpolationType::Step:
+            return output[info.previousIdx];
+
+        case Animation::InterpolationType::CubicSpline: {
+            const float t = info.t;
+            const float t2 = t * t;
+            const float t3 = t2 * t;
+            const T& previousValue = output[3u * info.previousIdx + 1u];
+            const T& previousOutTangent = output[3u * info.previousIdx + 2u];
+            const T& nextInTangent = output[3u * info.nextIdx];
+            const T& nextValue = output[3u * info.nextIdx + 1u];
+
+            const T result = (2.0f * t3 - 3.0f * t2 + 1.0f) * previousValue
+                + (info.deltaT * (t3 - 2.0f * t2 + t)) * previousOutTangent
+                + (-2.0f * t3 + 3.0f * t2) * nextValue
+                + (info.deltaT * (t3 - t2)) * nextInTangent;
+            return finalizeCubic(result);
+        }
+
+        case Animation::InterpolationType::Linear:
+        default:
+            return interpolateLinear(output[info.previousIdx], output[info.nextIdx], info.t);
+        }
+    }
+
+    // Weights channels animate every morph target of a mesh at once, so each keyframe holds numWeights outputs
+    void sampleWeightsChannel(Animation::WeightsChannel& channel, const float animationTime, float* weights, const uint32_t numWeights)
+    {
+        updateChannel(channel, animationTime);
+        const InterpolationInfo info = calcInterpolationInfo(channel, animationTime);
+        const float* output = channel.output.data();
+
+        switch (channel.interpolationType) {
+        case Animation::InterpolationType::Step:
+            memcpy(weights, &output[info.previousIdx * numWeights], sizeof(float) * numWeights);
+            break;
+
+        case Animation::InterpolationType::CubicSpline: {
+            const float t = info.t;
+            const float t2 = t * t;
+            const float t3 = t2 * t;
+            const float previousValueCoeff = 2.0f * t3 - 3.0f * t2 + 1.0f;
+            const float previousOutTangentCoeff = info.deltaT * (t3 - 2.0f * t2 + t);
+            const float nextValueCoeff = -2.0f * t3 + 3.0f * t2;
+            const float nextInTangentCoeff = info.deltaT * (t3 - t2);
+            const float* previous = &output[3u * info.previousIdx * numWeights];
+            const float* next = &output[3u * info.nextIdx * numWeights];
+            for (uint32_t i = 0; i < numWeights; ++i) {
+                weights[i] = previousValueCoeff * previous[numWeights + i]
+                    + previousOutTangentCoeff * previous[2u * numWeights + i]
+                    + nextValueCoeff * next[numWeights + i]
+                    + nextInTangentCoeff * next[i];
+            }
+            break;
+        }
+
+        case Animation::InterpolationType::Linear:
+        default: {
+            const float* previous = &output[info.previousIdx * numWeights];
+            const float* next = &output[info.nextIdx * numWeights];
+            for (uint32_t i = 0; i < numWeights; ++i) {
+                weights[i] = glm::mix(previous[i], next[i], info.t);
+            }
+            break;
+        }
+        }
+    }
+
+    inline float getAnimationTime(const float timeSinceStart, const float maxInput)
+    {
+        return maxInput > 0.0f ? fmod(timeSinceStart, maxInput) : 0.0f;
+    }
+
+    // Returns false if the animation isn't playing
+    inline bool updatePlayingState(Animation& animation, const float currentTime)
     {
         if (animation.playingState == Animation::State::Off) {
-            return;
+            return false;
         }
         else if (animation.playingState == Animation::State::Resetting) {
             animation.playingState = Animation::State::Off;
             animation.startTime = currentTime;
         }
+        return true;
+    }
+
+    void updateAnimation(ECSRegistry& registry, Animation& animation, const float currentTime)
+    {
+        if (!updatePlayingState(animation, currentTime)) {
+            return;
+        }
 
         const float timeSinceStart = currentTime - animation.startTime;
         for (auto& channel : animation.rotationChannels) {
-            const float animationTime = fmod(timeSinceStart, channel.maxInput);
+            const float animationTime = getAnimationTime(timeSinceStart, channel.maxInput);
+            registry.transforms[channel.targetEntity].rotation = sampleChannel(channel, animationTime);
+        }
 
-            updateChannel(channel, animationTime);
-            InterpolationInfo info = calcInterpolationInfo(channel, animationTime);
+        for (auto& channel : animation.translationChannels) {
+            const float animationTime = getAnimationTime(timeSinceStart, channel.maxInput);
+            registry.transforms[channel.targetEntity].translation = sampleChannel(channel, animationTime);
+        }
 
-            Transform& transform = registry.transforms[channel.targetEntity];
-            const glm::quat& previous = channel.output[info.previousIdx];
-            const glm::quat& next = channel.output[info.nextIdx];
-            transform.rotation = glm::slerp(previous, next, info.t);
+        for (auto& channel : animation.scaleChannels) {
+            const float animationTime = getAnimationTime(timeSinceStart, channel.maxInput);
+            registry.transforms[channel.targetEntity].scale = sampleChannel(channel, animationTime);
         }
+    }
 
-        for (auto& channel : animation.translationChannels) {
-            const float animationTime = fmod(timeSinceStart, channel.maxInput);
+    void updateAnimation(
+        ECSRegistry& registry,
+        Animation& animation,
+        const AnimationClip& clip,
+        AnimationPose& pose,
+        const float currentTime,
+        const QuatInterpolation quatInterpolation
+    )
+    {
+        if (!updatePlayingState(animation, currentTime)) {
+            return;
+        }
 
-            updateChannel(channel, animationTime);
-            InterpolationInfo info = calcInterpolationInfo(channel, animationTime);
+        // A single time for the whole clip, tracks shorter than the clip hold their last value
+        const float clipTime = getAnimationTime(currentTime - animation.startTime, clip.duration);
+        sampleClip(clip, clipTime, pose, quatInterpolation);
+        applyPose(registry, clip, pose);
+    }
 
-            Transform& transform = registry.transforms[channel.targetEntity];
-            const glm::vec3& previous = channel.output[info.previousIdx];
-            const glm::vec3& next = channel.output[info.nextIdx];
-            transform.translation = glm::mix(previous, next, info.t);
+    uint32_t findBucketRoot(std::vector<uint32_t>& parents, uint32_t clipIdx)
+    {
+        while (parents[clipIdx] != clipIdx) {
+            parents[clipIdx] = parents[parents[clipIdx]];
+            clipIdx = parents[clipIdx];
         }
+        return clipIdx;
+    }
 
-        for (auto& channel : animation.scaleChannels) {
-            const float animationTime = fmod(timeSinceStart, channel.maxInput);
+    void buildAnimationBatch(const Scene& scene, AnimationBatch& batch)
+    {
+        const uint32_t numClips = uint32_t(scene.animationClips.size());
+        ASSERT(scene.animations.size() == numClips && scene.animationPoses.size() == numClips, "Every animation needs a compiled clip and a pose");
+
+        batch.sampleOrder.resize(numClips);
+        for (uint32_t clipIdx = 0; clipIdx < numClips; ++clipIdx) {
+            batch.sampleOrder[clipIdx] = clipIdx;
+        }
+        std::stable_sort(batch.sampleOrder.begin(), batch.sampleOrder.end(), [&scene](const uint32_t lhs, const uint32_t rhs) {
+            return scene.animationClips[lhs].numChannels > scene.animationClips[rhs].numChannels;
+        });
+
+        // Union clips that target a common entity
+        std::vector<uint32_t> parents(numClips);
+        for (uint32_t clipIdx = 0; clipIdx < numClips; ++clipIdx) {
+            parents[clipIdx] = clipIdx;
+        }
+        std::vector<uint32_t> entityOwners(scene.registry.numEntities, UINT32_MAX);
+        for (uint32_t clipIdx = 0; clipIdx < numClips; ++clipIdx) {
+            for (const uint32_t entity : scene.animationClips[clipIdx].slotEntities) {
+                uint32_t& owner = entityOwners[entity];
+                if (owner == UINT32_MAX) {
+                    owner = clipIdx;
+                }
+                else {
+                    parents[findBucketRoot(parents, clipIdx)] = findBucketRoot(parents, owner);
+                }
+            }
+        }
+
+        // Counting sort of the clips by bucket, which keeps scene order within each bucket
+        std::vector<uint32_t> bucketIndices(numClips, UINT32_MAX);
+        std::vector<uint32_t> bucketSizes;
+        std::vector<uint32_t> clipBuckets(numClips);
+        for (uint32_t clipIdx = 0; clipIdx < numClips; ++clipIdx) {
+            const uint32_t root = findBucketRoot(parents, clipIdx);
+            if (bucketIndices[root] == UINT32_MAX) {
+                bucketIndices[root] = uint32_t(bucketSizes.size());
+                bucketSizes.push_back(0);
+            }
+            clipBuckets[clipIdx] = bucketIndices[root];
+            ++bucketSizes[clipBuckets[clipIdx]];
+        }
+
+        batch.applyBucketOffsets.assign(bucketSizes.size() + 1, 0);
+        for (size_t bucket = 0; bucket < bucketSizes.size(); ++bucket) {
+            batch.applyBucketOffsets[bucket + 1] = batch.applyBucketOffsets[bucket] + bucketSizes[bucket];
+        }
+        batch.applyBucketClips.resize(numClips);
+        std::vector<uint32_t> bucketCursors(batch.applyBucketOffsets.begin(), batch.applyBucketOffsets.end() - 1);
+        for (uint32_t clipIdx = 0; clipIdx < numClips; ++clipIdx) {
+            batch.applyBucketClips[bucketCursors[clipBuckets[clipIdx]]++] = clipIdx;
+        }
+
+        batch.clipTimes.assign(numClips, 0.0f);
+        batch.isPlaying.assign(numClips, 0);
+    }
 
-            updateChannel(channel, animationTime);
-            InterpolationInfo info = calcInterpolationInfo(channel, animationTime);
+    void updateAnimations(
+        Scene& scene,
+        AnimationBatch& batch,
+        JobSystem& jobSystem,
+        const float currentTime,
+        const QuatInterpolation quatInterpolation
+    )
+    {
+        const size_t numClips = scene.animationClips.size();
+        ASSERT(batch.clipTimes.size() == numClips, "Animation batch is out of date, rebuild it with buildAnimationBatch");
+        if (numClips == 0) {
+            return;
+        }
 
-            Transform& transform = registry.transforms[channel.targetEntity];
-            const glm::vec3& previous = channel.output[info.previousIdx];
-            const glm::vec3& next = channel.output[info.nextIdx];
-            transform.scale = glm::mix(previous, next, info.t);
+        // Playing state and clip time are resolved once per clip, up front, and shared by all of its tracks
+        for (size_t clipIdx = 0; clipIdx < numClips; ++clipIdx) {
+            Animation& animation = scene.animations[clipIdx];
+            batch.isPlaying[clipIdx] = updatePlayingState(animation, currentTime);
+            batch.clipTimes[clipIdx] = getAnimationTime(currentTime - animation.startTime, scene.animationClips[clipIdx].duration);
+        }
+
+        // Each clip samples into its own pose, so clips never contend while sampling
+        jobSystem.parallelFor(numClips, 1, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const uint32_t clipIdx = batch.sampleOrder[i];
+                if (batch.isPlaying[clipIdx]) {
+                    sampleClip(scene.animationClips[clipIdx], batch.clipTimes[clipIdx], scene.animationPoses[clipIdx], quatInterpolation);
+                }
+            }
+        });
+
+        const size_t numBuckets = batch.applyBucketOffsets.size() - 1;
+        jobSystem.parallelFor(numBuckets, 16, [&](const size_t begin, const size_t end) {
+            for (size_t bucket = begin; bucket < end; ++bucket) {
+                for (uint32_t i = batch.applyBucketOffsets[bucket]; i < batch.applyBucketOffsets[bucket + 1]; ++i) {
+                    const uint32_t clipIdx = batch.applyBucketClips[i];
+                    if (batch.isPlaying[clipIdx]) {
+                        applyPose(scene.registry, scene.animationClips[clipIdx], scene.animationPoses[clipIdx]);
+                    }
+                }
+            }
+        });
+    }
+
+    void updateMorphWeights(Scene& scene, const float currentTime)
+    {
+        for (Animation& animation : scene.animations) {
+            if (animation.playingState == Animation::State::Off || animation.weightsChannels.empty()) {
+                continue;
+            }
+
+            const bool isResetting = animation.playingState == Animation::State::Resetting;
+            const float timeSinceStart = currentTime - animation.startTime;
+            for (Animation::WeightsChannel& channel : animation.weightsChannels) {
+                MorphedMesh* meshes = &scene.morphedMeshes[channel.firstMorphedMesh];
+                if (isResetting) {
+                    for (uint32_t i = 0; i < channel.numMorphedMeshes; ++i) {
+                        meshes[i].weights = meshes[i].defaultWeights;
+                    }
+                    continue;
+                }
+
+                // Every primitive of the mesh gets the same weights, sample once into the first and copy
+                const float animationTime = getAnimationTime(timeSinceStart, channel.maxInput);
+                sampleWeightsChannel(channel, animationTime, meshes[0].weights.data(), uint32_t(meshes[0].weights.size()));
+                for (uint32_t i = 1; i < channel.numMorphedMeshes; ++i) {
+                    meshes[i].weights = meshes[0].weights;
+                }
+            }
         }
     }
 
@@ -100,6 +364,10 @@ namespace bdr
             else {
                 registry.globalMatrices[entity] = local;
             }
+
+            if (cmpMask & CmpMasks::BOUNDS) {
+                registry.worldBounds[entity] = math::transformAABB(registry.localBounds[entity], registry.globalMatrices[entity]);
+            }
         }
     }
 
@@ -1,11 +1,56 @@
 #pragma once
 #include "Animation.h"
+#include "AnimationClip.h"
 #include "ECSRegistry.h"
+#include "Scene.h"
+#include "Core/JobSystem.h"
 
 namespace bdr
 {
     void updateAnimation(ECSRegistry& registry, Animation& animation, const float currentTime);
 
+    // Samples the compiled version of the animation into the pose, then scatters the pose to the transforms
+    void updateAnimation(
+        ECSRegistry& registry,
+        Animation& animation,
+        const AnimationClip& clip,
+        AnimationPose& pose,
+        const float currentTime,
+        const QuatInterpolation quatInterpolation = QuatInterpolation::Nlerp
+    );
+
+    // How updateAnimations splits the scene's clips across threads. It only depends on which entities each clip
+    // targets, so it's built once after loading (and again whenever clips are added) rather than every frame.
+    struct AnimationBatch
+    {
+        // Clip indices, most expensive first so the long tasks get picked up early
+        std::vector<uint32_t> sampleOrder;
+        // Clips that target a common entity share an apply bucket, and a bucket's clips are applied in scene
+        // order by a single task, so no two tasks ever write the same transform.
+        std::vector<uint32_t> applyBucketOffsets;
+        std::vector<uint32_t> applyBucketClips;
+        // Per frame state, indexed by clip
+        std::vector<float> clipTimes;
+        std::vector<uint8_t> isPlaying;
+    };
+
+    void buildAnimationBatch(const Scene& scene, AnimationBatch& batch);
+
+    // Updates every playing animation of the scene from its compiled clip, sampling and applying clips in parallel
+    void updateAnimations(
+        Scene& scene,
+        AnimationBatch& batch,
+        JobSystem& jobSystem,
+        const float currentTime,
+        const QuatInterpolation quatInterpolation = QuatInterpolation::Nlerp
+    );
+
+    // Samples the weights channels of every playing animation into the scene's morphed meshes.
+    // Blending the meshes with the new weights is left to updateMorphTargets. Resetting animations put their meshes
+    // back to their default weights, so this has to run before updateAnimation turns them Off.
+    void updateMorphWeights(Scene& scene, const float currentTime);
+
+    // Also transforms the local bounds of entities with a BOUNDS component into world space
     void updateMatrices(ECSRegistry& registry);
 
     void copyDrawData(ECSRegistry& registry);
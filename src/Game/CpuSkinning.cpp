@@ -0,0 +1,170 @@
+#include "pch.h"
+#include "CpuSkinning.h"
+
+#include "Core/bdrSimd.h"
+#include "Core/JobSystem.h"
+
+
+namespace bdr
+{
+    using simd::FloatV;
+    constexpr uint32_t kLanes = simd::laneWidth;
+    constexpr uint32_t kJointsPerVertex = 4;
+
+    void skinVerticesScalar(
+        const SkinningInput& input,
+        const uint32_t begin,
+        const uint32_t end,
+        glm::vec3* outPositions,
+        glm::vec3* outNormals
+    )
+    {
+        for (uint32_t vertex = begin; vertex < end; ++vertex) {
+            const glm::u16vec4& joints = input.joints[vertex];
+            const glm::vec4& weights = input.weights[vertex];
+            const glm::mat4 skinMatrix = weights.x * input.jointMatrices[joints.x]
+                + weights.y * input.jointMatrices[joints.y]
+                + weights.z * input.jointMatrices[joints.z]
+                + weights.w * input.jointMatrices[joints.w];
+
+            // HLSL's mul(v, M) with M read column-major from glm's memory is glm's v * M
+            const glm::vec4 position = glm::vec4{ input.positions[vertex], 1.0f } * skinMatrix;
+            outPositions[vertex] = glm::vec3{ position } / position.w;
+            outNormals[vertex] = glm::normalize(input.normals[vertex] * glm::mat3{ skinMatrix });
+        }
+    }
+
+    void skinVertices(
+        const SkinningInput& input,
+        const uint32_t begin,
+        const uint32_t end,
+        glm::vec3* outPositions,
+        glm::vec3* outNormals
+    )
+    {
+        // Lane offsets for gathering the components of AoS vec3s and vec4s
+        alignas(32) int32_t vec3Offsets[kLanes];
+        alignas(32) int32_t vec4Offsets[kLanes];
+        for (uint32_t lane = 0; lane < kLanes; ++lane) {
+            vec3Offsets[lane] = int32_t(3 * lane);
+            vec4Offsets[lane] = int32_t(4 * lane);
+        }
+
+        const float* palette = &input.jointMatrices[0][0][0];
+        uint32_t vertex = begin;
+        for (; vertex + kLanes <= end; vertex += kLanes) {
+            // Offset of each lane's joint matrices into the palette, in floats
+            alignas(32) int32_t jointOffsets[kJointsPerVertex][kLanes];
+            for (uint32_t lane = 0; lane < kLanes; ++lane) {
+                const glm::u16vec4& joints = input.joints[vertex + lane];
+                for (uint32_t i = 0; i < kJointsPerVertex; ++i) {
+                    jointOffsets[i][lane] = int32_t(joints[i]) * 16;
+                }
+            }
+
+            FloatV weights[kJointsPerVertex];
+            for (uint32_t i = 0; i < kJointsPerVertex; ++i) {
+                weights[i] = simd::gather(&input.weights[vertex][i], vec4Offsets);
+            }
+
+            // Blended skin matrix, one lane per vertex, element e is memory offset e of a glm::mat4
+            FloatV skinMatrix[16];
+            for (uint32_t e = 0; e < 16; ++e) {
+                FloatV element = simd::mul(weights[0], simd::gather(palette + e, jointOffsets[0]));
+                for (uint32_t i = 1; i < kJointsPerVertex; ++i) {
+                    element = simd::madd(weights[i], simd::gather(palette + e, jointOffsets[i]), element);
+                }
+                skinMatrix[e] = element;
+            }
+
+            FloatV position[3];
+            FloatV normal[3];
+            for (uint32_t c = 0; c < 3; ++c) {
+                position[c] = simd::gather(&input.positions[vertex][c], vec3Offsets);
+                normal[c] = simd::gather(&input.normals[vertex][c], vec3Offsets);
+            }
+
+            // Output component c is the dot product of the input with column c
+            FloatV skinnedPosition[4];
+            for (uint32_t c = 0; c < 4; ++c) {
+                FloatV result = simd::madd(position[0], skinMatrix[4 * c], skinMatrix[4 * c + 3]);
+                result = simd::madd(position[1], skinMatrix[4 * c + 1], result);
+                skinnedPosition[c] = simd::madd(position[2], skinMatrix[4 * c + 2], result);
+            }
+            FloatV skinnedNormal[3];
+            for (uint32_t c = 0; c < 3; ++c) {
+                FloatV result = simd::mul(normal[0], skinMatrix[4 * c]);
+                result = simd::madd(normal[1], skinMatrix[4 * c + 1], result);
+                skinnedNormal[c] = simd::madd(normal[2], skinMatrix[4 * c + 2], result);
+            }
+
+            const FloatV invW = simd::div(simd::set1(1.0f), skinnedPosition[3]);
+            FloatV lengthSq = simd::mul(skinnedNormal[0], skinnedNormal[0]);
+            lengthSq = simd::madd(skinnedNormal[1], skinnedNormal[1], lengthSq);
+            lengthSq = simd::madd(skinnedNormal[2], skinnedNormal[2], lengthSq);
+            const FloatV invLength = simd::div(simd::set1(1.0f), simd::sqrt(lengthSq));
+
+            // Back to AoS
+            alignas(32) float outputs[6][kLanes];
+            for (uint32_t c = 0; c < 3; ++c) {
+                simd::store(outputs[c], simd::mul(skinnedPosition[c], invW));
+                simd::store(outputs[3 + c], simd::mul(skinnedNormal[c], invLength));
+            }
+            for (uint32_t lane = 0; lane < kLanes; ++lane) {
+                outPositions[vertex + lane] = glm::vec3{ outputs[0][lane], outputs[1][lane], outputs[2][lane] };
+                outNormals[vertex + lane] = glm::vec3{ outputs[3][lane], outputs[4][lane], outputs[5][lane] };
+            }
+        }
+
+        skinVerticesScalar(input, vertex, end, outPositions, outNormals);
+    }
+
+    void skinVerticesDualQuaternion(
+        const SkinningInput& input,
+        const uint32_t begin,
+        const uint32_t end,
+        glm::vec3* outPositions,
+        glm::vec3* outNormals
+    )
+    {
+        for (uint32_t vertex = begin; vertex < end; ++vertex) {
+            const glm::u16vec4& joints = input.joints[vertex];
+            const glm::vec4& weights = input.weights[vertex];
+
+            const DualQuaternion& first = input.jointDualQuaternions[joints[0]];
+            glm::vec4 real = weights[0] * first.real;
+            glm::vec4 dual = weights[0] * first.dual;
+            for (uint32_t i = 1; i < kJointsPerVertex; ++i) {
+                const DualQuaternion& dq = input.jointDualQuaternions[joints[i]];
+                const float weight = glm::dot(dq.real, first.real) < 0.0f ? -weights[i] : weights[i];
+                real += weight * dq.real;
+                dual += weight * dq.dual;
+            }
+            const float invLength = 1.0f / glm::length(real);
+            const DualQuaternion blended{ real * invLength, dual * invLength };
+
+            outPositions[vertex] = math::transformPoint(blended, input.positions[vertex]);
+            outNormals[vertex] = glm::normalize(math::transformVector(blended, input.normals[vertex]));
+        }
+    }
+
+    void skinVertices(
+        JobSystem& jobSystem,
+        const SkinningInput& input,
+        glm::vec3* outPositions,
+        glm::vec3* outNormals,
+        const uint32_t grainSize
+    )
+    {
+        // Keep ranges a multiple of the SIMD width so only the last one has a scalar tail
+        const uint32_t grain = std::max((grainSize + kLanes - 1) / kLanes * kLanes, kLanes);
+        jobSystem.parallelFor(input.numVertices, grain, [&](const size_t begin, const size_t end) {
+            if (input.mode == SkinningMode::DualQuaternion) {
+                skinVerticesDualQuaternion(input, uint32_t(begin), uint32_t(end), outPositions, outNormals);
+            }
+            else {
+                skinVertices(input, uint32_t(begin), uint32_t(end), outPositions, outNormals);
+            }
+        });
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "pch.h"
+
+#include "Core/bdrMath.h"
+#include "Animation.h"
+
+namespace bdr
+{
+    class JobSystem;
+
+    // The same inputs as skinning.hlsl, for one mesh
+    struct SkinningInput
+    {
+        uint32_t numVertices = 0;
+        const glm::vec3* positions = nullptr;
+        const glm::vec3* normals = nullptr;
+        const glm::u16vec4* joints = nullptr;
+        const glm::vec4* weights = nullptr;
+        // The mesh's joint matrices, see getJointMatrices
+        const glm::mat4* jointMatrices = nullptr;
+        // Only needed in dual quaternion mode, see getJointDualQuaternions
+        const DualQuaternion* jointDualQuaternions = nullptr;
+        SkinningMode mode = SkinningMode::Linear;
+    };
+
+    // Vertices per job when skinning across threads, a multiple of the SIMD width
+    constexpr uint32_t kSkinningGrainSize = 2048;
+
+    // Skins vertices [begin, end) one at a time, exactly like skinning.hlsl: the four joint matrices are blended,
+    // positions are transformed as row vectors and divided by w, normals by the upper 3x3 and renormalized.
+    void skinVerticesScalar(
+        const SkinningInput& input,
+        const uint32_t begin,
+        const uint32_t end,
+        glm::vec3* outPositions,
+        glm::vec3* outNormals
+    );
+
+    // Same results as skinVerticesScalar, laneWidth vertices at a time in SoA form
+    void skinVertices(
+        const SkinningInput& input,
+        const uint32_t begin,
+        const uint32_t end,
+        glm::vec3* outPositions,
+        glm::vec3* outNormals
+    );
+
+    // Dual quaternion version of skinVerticesScalar, matching skinning.hlsl built with DUAL_QUATERNION_SKINNING.
+    // Joints are flipped onto the first joint's hemisphere before blending so the blend takes the short path.
+    void skinVerticesDualQuaternion(
+        const SkinningInput& input,
+        const uint32_t begin,
+        const uint32_t end,
+        glm::vec3* outPositions,
+        glm::vec3* outNormals
+    );
+
+    // Skins the whole mesh with the input's mode, split into vertex ranges across the job system
+    void skinVertices(
+        JobSystem& jobSystem,
+        const SkinningInput& input,
+        glm::vec3* outPositions,
+        glm::vec3* outNormals,
+        const uint32_t grainSize = kSkinningGrainSize
+    );
+}
@@ -80,6 +80,13 @@ namespace bdr
         registry.cmpMasks[entity] |= CmpMasks::TRANSFORM;
     }
 
+    void assignBounds(ECSRegistry& registry, const uint32_t entity, const AABB& localBounds)
+    {
+        registry.localBounds[entity] = localBounds;
+        registry.worldBounds[entity] = localBounds;
+        registry.cmpMasks[entity] |= CmpMasks::BOUNDS;
+    }
+
 
     void ECSRegistry::clearComponentData()
     {
@@ -14,6 +14,9 @@ namespace bdr
         SKIN = (1 << 2),
         RENDER_OBJECT = (1 << 3),
         TRANSFORM = (1 << 4),
+        BOUNDS = (1 << 5),
+        // Tag for entities whose world bounds never change, see SpatialIndex
+        STATIC = (1 << 6),
     };
 
     template<typename T>
@@ -104,6 +107,9 @@ namespace bdr
         ComponentArray<FreeEntityNode> freeEntitiesNodes;
         ComponentArray<GenericMaterialData> materialData;
         ComponentArray<DrawConstants> drawConstants;
+        // Object space bounds, usually the mesh's, and the same bounds transformed by globalMatrices
+        ComponentArray<AABB> localBounds;
+        ComponentArray<AABB> worldBounds;
         /*ComponentArray<RenderObjectList> materialInstances;*/
 
         // This is used to calculate the number of components and store them.
@@ -134,4 +140,6 @@ namespace bdr
     uint32_t createEntity(ECSRegistry& registry);
 
     void assignTransform(ECSRegistry& registry, const uint32_t entity, const Transform& transform);
+
+    void assignBounds(ECSRegistry& registry, const uint32_t entity, const AABB& localBounds);
 }
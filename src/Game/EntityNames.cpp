@@ -0,0 +1,183 @@
+#include "pch.h"
+#include "EntityNames.h"
+
+#include "murmur/MurmurHash3.h"
+
+
+namespace bdr
+{
+    constexpr uint32_t EntityNameTable::emptySlot;
+
+    inline bool namesMatch(const EntityNameTable& table, const EntityNameTable::Entry& entry, const char* name, const size_t length)
+    {
+        return entry.length == length && memcmp(table.getString(entry), name, length) == 0;
+    }
+
+    // Returns the slot holding the name, or the empty slot where it should be inserted
+    uint32_t findSlot(const EntityNameTable& table, const uint32_t hash, const char* name, const size_t length)
+    {
+        const uint32_t mask = uint32_t(table.hashSlots.size() - 1);
+        uint32_t slot = hash & mask;
+        while (true) {
+            const uint32_t entryIdx = table.hashSlots[slot];
+            if (entryIdx == EntityNameTable::emptySlot) {
+                return slot;
+            }
+            const EntityNameTable::Entry& entry = table.entries[entryIdx];
+            if (entry.hash == hash && namesMatch(table, entry, name, length)) {
+                return slot;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    void growHashSlots(EntityNameTable& table)
+    {
+        const size_t newSize = table.hashSlots.empty() ? 64 : table.hashSlots.size() * 2;
+        std::vector<uint32_t> oldSlots = std::move(table.hashSlots);
+        table.hashSlots.assign(newSize, EntityNameTable::emptySlot);
+
+        const uint32_t mask = uint32_t(newSize - 1);
+        for (const uint32_t entryIdx : oldSlots) {
+            if (entryIdx == EntityNameTable::emptySlot) {
+                continue;
+            }
+            uint32_t slot = table.entries[entryIdx].hash & mask;
+            while (table.hashSlots[slot] != EntityNameTable::emptySlot) {
+                slot = (slot + 1) & mask;
+            }
+            table.hashSlots[slot] = entryIdx;
+        }
+    }
+
+    void sortEntries(EntityNameTable& table)
+    {
+        const size_t numEntries = table.entries.size();
+        table.sortedEntries.resize(numEntries);
+        for (size_t i = 0; i < numEntries; ++i) {
+            table.sortedEntries[i] = uint32_t(i);
+        }
+        std::sort(table.sortedEntries.begin(), table.sortedEntries.end(), [&table](const uint32_t lhs, const uint32_t rhs) {
+            return strcmp(table.getString(table.entries[lhs]), table.getString(table.entries[rhs])) < 0;
+        });
+        table.isSorted = true;
+    }
+
+    uint32_t hashName(const char* name, const size_t length)
+    {
+        uint32_t hash;
+        MurmurHash3_x86_32(name, int(length), EntityNameTable::seed, &hash);
+        return hash;
+    }
+
+    void assignName(EntityNameTable& table, const uint32_t entity, const char* name, const size_t length)
+    {
+        ASSERT(entity != kInvalidEntity);
+        ASSERT(entity >= table.entityToEntry.size() || table.entityToEntry[entity] == EntityNameTable::emptySlot,
+            "Entity has already been assigned a name");
+
+        // Keep the load factor under 0.5 so probe sequences stay short
+        if ((table.numUniqueNames + 1) * 2 > table.hashSlots.size()) {
+            growHashSlots(table);
+        }
+
+        EntityNameTable::Entry entry{};
+        entry.length = uint32_t(length);
+        entry.hash = hashName(name, length);
+        entry.entity = entity;
+
+        const uint32_t entryIdx = uint32_t(table.entries.size());
+        const uint32_t slot = findSlot(table, entry.hash, name, length);
+        if (table.hashSlots[slot] != EntityNameTable::emptySlot) {
+            // Interned already, share the string and leave the index pointing at the first entity
+            entry.offset = table.entries[table.hashSlots[slot]].offset;
+        }
+        else {
+            entry.offset = uint32_t(table.arena.size());
+            table.arena.insert(table.arena.end(), name, name + length);
+            table.arena.push_back('\0');
+            table.hashSlots[slot] = entryIdx;
+            ++table.numUniqueNames;
+        }
+        table.entries.push_back(entry);
+
+        if (entity >= table.entityToEntry.size()) {
+            table.entityToEntry.resize(entity + 1, EntityNameTable::emptySlot);
+        }
+        table.entityToEntry[entity] = entryIdx;
+        table.isSorted = false;
+    }
+
+    const char* getName(const EntityNameTable& table, const uint32_t entity)
+    {
+        if (entity >= table.entityToEntry.size() || table.entityToEntry[entity] == EntityNameTable::emptySlot) {
+            return nullptr;
+        }
+        return table.getString(table.entries[table.entityToEntry[entity]]);
+    }
+
+    uint32_t findEntityByName(const EntityNameTable& table, const char* name, const size_t length)
+    {
+        if (table.hashSlots.empty()) {
+            return kInvalidEntity;
+        }
+        const uint32_t slot = findSlot(table, hashName(name, length), name, length);
+        const uint32_t entryIdx = table.hashSlots[slot];
+        return entryIdx == EntityNameTable::emptySlot ? kInvalidEntity : table.entries[entryIdx].entity;
+    }
+
+    uint32_t findEntityByHash(const EntityNameTable& table, const uint32_t hash)
+    {
+        if (table.hashSlots.empty()) {
+            return kInvalidEntity;
+        }
+        // Without the string we can't disambiguate collisions, so this returns the first entry with a matching hash
+        const uint32_t mask = uint32_t(table.hashSlots.size() - 1);
+        uint32_t slot = hash & mask;
+        while (table.hashSlots[slot] != EntityNameTable::emptySlot) {
+            const EntityNameTable::Entry& entry = table.entries[table.hashSlots[slot]];
+            if (entry.hash == hash) {
+                return entry.entity;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return kInvalidEntity;
+    }
+
+    size_t findEntitiesByPrefix(EntityNameTable& table, const std::string& prefix, std::vector<uint32_t>& outEntities)
+    {
+        if (!table.isSorted) {
+            sortEntries(table);
+        }
+
+        const char* prefixStr = prefix.c_str();
+        const size_t prefixLength = prefix.length();
+        auto comparePrefix = [&table, prefixStr, prefixLength](const uint32_t entryIdx) {
+            return strncmp(table.getString(table.entries[entryIdx]), prefixStr, prefixLength);
+        };
+
+        // All names sharing the prefix are contiguous in the sorted view
+        auto first = std::lower_bound(table.sortedEntries.begin(), table.sortedEntries.end(), 0, [&](const uint32_t entryIdx, int) {
+            return comparePrefix(entryIdx) < 0;
+        });
+
+        size_t numFound = 0;
+        for (auto it = first; it != table.sortedEntries.end() && comparePrefix(*it) == 0; ++it) {
+            outEntities.push_back(table.entries[*it].entity);
+            ++numFound;
+        }
+        return numFound;
+    }
+
+    EntityNameTable::MemoryStats getMemoryStats(const EntityNameTable& table)
+    {
+        EntityNameTable::MemoryStats stats{};
+        stats.numEntries = table.entries.size();
+        stats.numUniqueNames = table.numUniqueNames;
+        stats.arenaBytes = table.arena.capacity() * sizeof(char);
+        stats.entryBytes = table.entries.capacity() * sizeof(EntityNameTable::Entry);
+        stats.indexBytes = (table.hashSlots.capacity() + table.entityToEntry.capacity() + table.sortedEntries.capacity()) * sizeof(uint32_t);
+        stats.totalBytes = stats.arenaBytes + stats.entryBytes + stats.indexBytes;
+        return stats;
+    }
+}
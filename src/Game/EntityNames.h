@@ -0,0 +1,95 @@
+#pragma once
+#include "pch.h"
+
+#include <vector>
+#include <string>
+
+
+namespace bdr
+{
+    constexpr uint32_t kInvalidEntity = UINT32_MAX;
+
+    // Interned entity names. Every unique name is stored exactly once in a single char arena, and an open
+    // addressing hash index maps name hashes to entries so lookups by name are O(1).
+    // Entries are kept in insertion order; a sorted view used for prefix queries is rebuilt lazily.
+    struct EntityNameTable
+    {
+        struct Entry
+        {
+            uint32_t offset = 0;
+            uint32_t length = 0;
+            uint32_t hash = 0;
+            uint32_t entity = kInvalidEntity;
+        };
+
+        struct MemoryStats
+        {
+            size_t numEntries = 0;
+            size_t numUniqueNames = 0;
+            size_t arenaBytes = 0;
+            size_t entryBytes = 0;
+            size_t indexBytes = 0;
+            size_t totalBytes = 0;
+        };
+
+        static constexpr uint32_t seed = 1337u;
+        static constexpr uint32_t emptySlot = UINT32_MAX;
+
+        // Null terminated names, back to back
+        std::vector<char> arena;
+        std::vector<Entry> entries;
+        // Power of two sized, stores indices into entries. Load factor is kept under 0.5
+        std::vector<uint32_t> hashSlots;
+        // Maps entity -> index into entries, emptySlot if the entity has no name
+        std::vector<uint32_t> entityToEntry;
+        // Indices into entries, sorted lexicographically by name. Only valid when isSorted is true.
+        std::vector<uint32_t> sortedEntries;
+        size_t numUniqueNames = 0;
+        bool isSorted = true;
+
+        inline const char* getString(const Entry& entry) const
+        {
+            return &arena[entry.offset];
+        };
+
+        inline void reset()
+        {
+            arena = std::vector<char>();
+            entries = std::vector<Entry>();
+            hashSlots = std::vector<uint32_t>();
+            entityToEntry = std::vector<uint32_t>();
+            sortedEntries = std::vector<uint32_t>();
+            numUniqueNames = 0;
+            isSorted = true;
+        };
+    };
+
+    uint32_t hashName(const char* name, const size_t length);
+
+    // Assigns a name to the entity. Names do not have to be unique, in which case findEntityByName
+    // will return the first entity that was assigned the name.
+    void assignName(EntityNameTable& table, const uint32_t entity, const char* name, const size_t length);
+
+    inline void assignName(EntityNameTable& table, const uint32_t entity, const std::string& name)
+    {
+        assignName(table, entity, name.data(), name.length());
+    }
+
+    // Returns nullptr if the entity has no name
+    const char* getName(const EntityNameTable& table, const uint32_t entity);
+
+    // Returns kInvalidEntity if no entity with that name exists
+    uint32_t findEntityByName(const EntityNameTable& table, const char* name, const size_t length);
+    uint32_t findEntityByHash(const EntityNameTable& table, const uint32_t hash);
+
+    inline uint32_t findEntityByName(const EntityNameTable& table, const std::string& name)
+    {
+        return findEntityByName(table, name.data(), name.length());
+    }
+
+    // Appends every entity whose name starts with the prefix to outEntities, returning the number appended.
+    // Matches are appended in lexicographic order of their names.
+    size_t findEntitiesByPrefix(EntityNameTable& table, const std::string& prefix, std::vector<uint32_t>& outEntities);
+
+    EntityNameTable::MemoryStats getMemoryStats(const EntityNameTable& table);
+}
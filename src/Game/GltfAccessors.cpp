@@ -0,0 +1,463 @@
+#include "pch.h"
+#include "GltfAccessors.h"
+
+#include <immintrin.h>
+#include <vector>
+
+
+namespace bdr
+{
+    namespace gltf
+    {
+        uint32_t getComponentSize(const ComponentType componentType)
+        {
+            switch (componentType) {
+            case COMPONENT_BYTE:
+            case COMPONENT_UNSIGNED_BYTE:
+                return 1;
+            case COMPONENT_SHORT:
+            case COMPONENT_UNSIGNED_SHORT:
+                return 2;
+            case COMPONENT_UNSIGNED_INT:
+            case COMPONENT_FLOAT:
+                return 4;
+            default:
+                throw std::runtime_error("Unknown accessor component type");
+            }
+        }
+
+        uint32_t getNumComponents(const AccessorType type)
+        {
+            switch (type) {
+            case AccessorType::SCALAR:
+                return 1;
+            case AccessorType::VEC2:
+                return 2;
+            case AccessorType::VEC3:
+                return 3;
+            case AccessorType::VEC4:
+            case AccessorType::MAT2:
+                return 4;
+            case AccessorType::MAT3:
+                return 9;
+            case AccessorType::MAT4:
+                return 16;
+            default:
+                throw std::runtime_error("Unknown accessor type");
+            }
+        }
+
+        uint32_t getNumColumns(const AccessorType type)
+        {
+            switch (type) {
+            case AccessorType::MAT2:
+                return 2;
+            case AccessorType::MAT3:
+                return 3;
+            case AccessorType::MAT4:
+                return 4;
+            default:
+                return 1;
+            }
+        }
+
+        uint32_t getColumnStride(const ComponentType componentType, const AccessorType type)
+        {
+            const uint32_t columnSize = getNumComponents(type) / getNumColumns(type) * getComponentSize(componentType);
+            return getNumColumns(type) > 1 ? (columnSize + 3u) & ~3u : columnSize;
+        }
+
+        uint32_t getElementSize(const ComponentType componentType, const AccessorType type)
+        {
+            return getNumColumns(type) * getColumnStride(componentType, type);
+        }
+
+        size_t getDecodedSize(const AccessorView& accessor, const ComponentType outputType)
+        {
+            return size_t(accessor.count) * getNumComponents(accessor.type) * getComponentSize(outputType);
+        }
+
+        template<typename T>
+        struct ComponentTraits;
+
+        template<>
+        struct ComponentTraits<int8_t>
+        {
+            static constexpr ComponentType type = COMPONENT_BYTE;
+            static constexpr float maxValue = 127.0f;
+            static constexpr bool isSigned = true;
+        };
+
+        template<>
+        struct ComponentTraits<uint8_t>
+        {
+            static constexpr ComponentType type = COMPONENT_UNSIGNED_BYTE;
+            static constexpr float maxValue = 255.0f;
+            static constexpr bool isSigned = false;
+        };
+
+        template<>
+        struct ComponentTraits<int16_t>
+        {
+            static constexpr ComponentType type = COMPONENT_SHORT;
+            static constexpr float maxValue = 32767.0f;
+            static constexpr bool isSigned = true;
+        };
+
+        template<>
+        struct ComponentTraits<uint16_t>
+        {
+            static constexpr ComponentType type = COMPONENT_UNSIGNED_SHORT;
+            static constexpr float maxValue = 65535.0f;
+            static constexpr bool isSigned = false;
+        };
+
+        template<>
+        struct ComponentTraits<uint32_t>
+        {
+            static constexpr ComponentType type = COMPONENT_UNSIGNED_INT;
+            static constexpr float maxValue = 4294967295.0f;
+            static constexpr bool isSigned = false;
+        };
+
+        template<>
+        struct ComponentTraits<float>
+        {
+            static constexpr ComponentType type = COMPONENT_FLOAT;
+            static constexpr float maxValue = 1.0f;
+            static constexpr bool isSigned = true;
+        };
+
+        // Buffer data has no alignment guarantees past the component size, and strides can break even that
+        template<typename T>
+        inline T readComponent(const uint8_t* data)
+        {
+            T value;
+            memcpy(&value, data, sizeof(T));
+            return value;
+        }
+
+        template<typename T, bool kNormalized>
+        inline float toFloat(const T value)
+        {
+            if (!kNormalized) {
+                return float(value);
+            }
+            // Signed types have one more negative value than positive ones, which clamps to -1
+            const float normalized = float(value) / ComponentTraits<T>::maxValue;
+            return ComponentTraits<T>::isSigned ? std::max(normalized, -1.0f) : normalized;
+        }
+
+        // Four consecutive components, converted to floats without normalizing
+        template<typename T>
+        inline __m128 widen4(const uint8_t* data);
+
+        template<>
+        inline __m128 widen4<int8_t>(const uint8_t* data)
+        {
+            // Each byte ends up in the top of its lane, so the arithmetic shift sign extends it
+            const __m128i bytes = _mm_cvtsi32_si128(readComponent<int32_t>(data));
+            const __m128i lanes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, bytes), _mm_unpacklo_epi8(bytes, bytes));
+            return _mm_cvtepi32_ps(_mm_srai_epi32(lanes, 24));
+        }
+
+        template<>
+        inline __m128 widen4<uint8_t>(const uint8_t* data)
+        {
+            const __m128i bytes = _mm_cvtsi32_si128(readComponent<int32_t>(data));
+            const __m128i zero = _mm_setzero_si128();
+            return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+        }
+
+        template<>
+        inline __m128 widen4<int16_t>(const uint8_t* data)
+        {
+            const __m128i shorts = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+            return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(shorts, shorts), 16));
+        }
+
+        template<>
+        inline __m128 widen4<uint16_t>(const uint8_t* data)
+        {
+            const __m128i shorts = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+            return _mm_cvtepi32_ps(_mm_unpacklo_epi16(shorts, _mm_setzero_si128()));
+        }
+
+        template<>
+        inline __m128 widen4<uint32_t>(const uint8_t* data)
+        {
+            // SSE only converts signed integers, and unnormalized UNSIGNED_INT floats are too rare to bother
+            return _mm_setr_ps(
+                float(readComponent<uint32_t>(data)), float(readComponent<uint32_t>(data + 4)),
+                float(readComponent<uint32_t>(data + 8)), float(readComponent<uint32_t>(data + 12))
+            );
+        }
+
+        template<>
+        inline __m128 widen4<float>(const uint8_t* data)
+        {
+            return _mm_loadu_ps(reinterpret_cast<const float*>(data));
+        }
+
+        template<typename T, bool kNormalized>
+        inline __m128 normalize4(const __m128 values)
+        {
+            if (!kNormalized) {
+                return values;
+            }
+            // Divides rather than multiplying by the reciprocal, to match toFloat exactly
+            const __m128 normalized = _mm_div_ps(values, _mm_set1_ps(ComponentTraits<T>::maxValue));
+            return ComponentTraits<T>::isSigned ? _mm_max_ps(normalized, _mm_set1_ps(-1.0f)) : normalized;
+        }
+
+        template<typename T, bool kNormalized>
+        void convertPackedToFloat(const uint8_t* src, const size_t numComponents, float* dst)
+        {
+            size_t i = 0;
+            for (; i + 4 <= numComponents; i += 4) {
+                _mm_storeu_ps(dst + i, normalize4<T, kNormalized>(widen4<T>(src + i * sizeof(T))));
+            }
+            for (; i < numComponents; ++i) {
+                dst[i] = toFloat<T, kNormalized>(readComponent<T>(src + i * sizeof(T)));
+            }
+        }
+
+        template<typename SrcT, typename DstT>
+        void convertPackedIntegers(const uint8_t* src, const size_t numComponents, DstT* dst)
+        {
+            for (size_t i = 0; i < numComponents; ++i) {
+                dst[i] = DstT(readComponent<SrcT>(src + i * sizeof(SrcT)));
+            }
+        }
+
+        // Byte indices, the one widening glTF files commonly need
+        template<>
+        void convertPackedIntegers<uint8_t, uint16_t>(const uint8_t* src, const size_t numComponents, uint16_t* dst)
+        {
+            size_t i = 0;
+            for (; i + 16 <= numComponents; i += 16) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(bytes, _mm_setzero_si128()));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(bytes, _mm_setzero_si128()));
+            }
+            for (; i < numComponents; ++i) {
+                dst[i] = src[i];
+            }
+        }
+
+        template<>
+        void convertPackedIntegers<uint16_t, uint32_t>(const uint8_t* src, const size_t numComponents, uint32_t* dst)
+        {
+            size_t i = 0;
+            for (; i + 8 <= numComponents; i += 8) {
+                const __m128i shorts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(shorts, _mm_setzero_si128()));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(shorts, _mm_setzero_si128()));
+            }
+            for (; i < numComponents; ++i) {
+                dst[i] = readComponent<uint16_t>(src + i * 2);
+            }
+        }
+
+        // Decodes count elements, srcStride bytes apart in the source and dstStride components apart in the output
+        typedef void (*DecodeKernel)(const uint8_t* src, const size_t srcStride, const size_t count, void* dst, const size_t dstStride);
+
+        template<typename T>
+        struct CopyComponents
+        {
+            template<uint32_t kNumComponents>
+            static void decode(const uint8_t* src, const size_t srcStride, const size_t count, void* dst, const size_t dstStride)
+            {
+                constexpr size_t elementSize = kNumComponents * sizeof(T);
+                uint8_t* output = static_cast<uint8_t*>(dst);
+                if (srcStride == elementSize && dstStride == kNumComponents) {
+                    memcpy(output, src, count * elementSize);
+                    return;
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    memcpy(output + i * dstStride * sizeof(T), src + i * srcStride, elementSize);
+                }
+            }
+        };
+
+        template<typename T, bool kNormalized>
+        struct ConvertToFloat
+        {
+            template<uint32_t kNumComponents>
+            static void decode(const uint8_t* src, const size_t srcStride, const size_t count, void* dst, const size_t dstStride)
+            {
+                float* output = static_cast<float*>(dst);
+                if (srcStride == kNumComponents * sizeof(T) && dstStride == kNumComponents) {
+                    convertPackedToFloat<T, kNormalized>(src, count * kNumComponents, output);
+                    return;
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    const uint8_t* element = src + i * srcStride;
+                    float* outputElement = output + i * dstStride;
+                    uint32_t c = 0;
+                    for (; c + 4 <= kNumComponents; c += 4) {
+                        _mm_storeu_ps(outputElement + c, normalize4<T, kNormalized>(widen4<T>(element + c * sizeof(T))));
+                    }
+                    for (; c < kNumComponents; ++c) {
+                        outputElement[c] = toFloat<T, kNormalized>(readComponent<T>(element + c * sizeof(T)));
+                    }
+                }
+            }
+        };
+
+        template<typename SrcT, typename DstT>
+        struct ConvertIntegers
+        {
+            template<uint32_t kNumComponents>
+            static void decode(const uint8_t* src, const size_t srcStride, const size_t count, void* dst, const size_t dstStride)
+            {
+                DstT* output = static_cast<DstT*>(dst);
+                if (srcStride == kNumComponents * sizeof(SrcT) && dstStride == kNumComponents) {
+                    convertPackedIntegers<SrcT, DstT>(src, count * kNumComponents, output);
+                    return;
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    for (uint32_t c = 0; c < kNumComponents; ++c) {
+                        output[i * dstStride + c] = DstT(readComponent<SrcT>(src + i * srcStride + c * sizeof(SrcT)));
+                    }
+                }
+            }
+        };
+
+        // Columns of padded matrices are decoded as vectors of the column's size
+        template<typename Kernel>
+        DecodeKernel selectKernel(const uint32_t numComponents)
+        {
+            switch (numComponents) {
+            case 1:
+                return &Kernel::template decode<1>;
+            case 2:
+                return &Kernel::template decode<2>;
+            case 3:
+                return &Kernel::template decode<3>;
+            case 4:
+                return &Kernel::template decode<4>;
+            case 9:
+                return &Kernel::template decode<9>;
+            case 16:
+                return &Kernel::template decode<16>;
+            default:
+                throw std::runtime_error("Unsupported accessor component count");
+            }
+        }
+
+        template<typename T>
+        DecodeKernel selectKernel(const bool normalized, const ComponentType outputType, const uint32_t numComponents)
+        {
+            if (outputType == ComponentTraits<T>::type) {
+                return selectKernel<CopyComponents<T>>(numComponents);
+            }
+            if (outputType == COMPONENT_FLOAT) {
+                return normalized
+                    ? selectKernel<ConvertToFloat<T, true>>(numComponents)
+                    : selectKernel<ConvertToFloat<T, false>>(numComponents);
+            }
+            const bool isUnsignedInteger = !ComponentTraits<T>::isSigned;
+            if (isUnsignedInteger && !normalized) {
+                if (outputType == COMPONENT_UNSIGNED_SHORT) {
+                    return selectKernel<ConvertIntegers<T, uint16_t>>(numComponents);
+                }
+                if (outputType == COMPONENT_UNSIGNED_INT) {
+                    return selectKernel<ConvertIntegers<T, uint32_t>>(numComponents);
+                }
+            }
+            throw std::runtime_error("Unsupported accessor conversion");
+        }
+
+        DecodeKernel selectKernel(const AccessorView& accessor, const ComponentType outputType, const uint32_t numComponents)
+        {
+            if (accessor.normalized && (accessor.componentType == COMPONENT_UNSIGNED_INT || accessor.componentType == COMPONENT_FLOAT)) {
+                throw std::runtime_error("Only byte and short accessors can be normalized");
+            }
+            switch (accessor.componentType) {
+            case COMPONENT_BYTE:
+                return selectKernel<int8_t>(accessor.normalized, outputType, numComponents);
+            case COMPONENT_UNSIGNED_BYTE:
+                return selectKernel<uint8_t>(accessor.normalized, outputType, numComponents);
+            case COMPONENT_SHORT:
+                return selectKernel<int16_t>(accessor.normalized, outputType, numComponents);
+            case COMPONENT_UNSIGNED_SHORT:
+                return selectKernel<uint16_t>(accessor.normalized, outputType, numComponents);
+            case COMPONENT_UNSIGNED_INT:
+                return selectKernel<uint32_t>(accessor.normalized, outputType, numComponents);
+            case COMPONENT_FLOAT:
+                return selectKernel<float>(accessor.normalized, outputType, numComponents);
+            default:
+                throw std::runtime_error("Unknown accessor component type");
+            }
+        }
+
+        void decodeElements(
+            const AccessorView& accessor,
+            const ComponentType outputType,
+            const uint8_t* src,
+            const size_t srcStride,
+            const size_t count,
+            uint8_t* output
+        )
+        {
+            const uint32_t numComponents = getNumComponents(accessor.type);
+            const uint32_t numColumns = getNumColumns(accessor.type);
+            const uint32_t numRows = numComponents / numColumns;
+            const uint32_t columnStride = getColumnStride(accessor.componentType, accessor.type);
+            if (columnStride == numRows * getComponentSize(accessor.componentType)) {
+                selectKernel(accessor, outputType, numComponents)(src, srcStride, count, output, numComponents);
+                return;
+            }
+            const DecodeKernel kernel = selectKernel(accessor, outputType, numRows);
+            const size_t outputColumnSize = size_t(numRows) * getComponentSize(outputType);
+            for (uint32_t column = 0; column < numColumns; ++column) {
+                kernel(src + column * columnStride, srcStride, count, output + column * outputColumnSize, numComponents);
+            }
+        }
+
+        uint32_t readSparseIndex(const SparseAccessorView& sparse, const uint32_t i)
+        {
+            switch (sparse.indexComponentType) {
+            case COMPONENT_UNSIGNED_BYTE:
+                return sparse.indices[i];
+            case COMPONENT_UNSIGNED_SHORT:
+                return readComponent<uint16_t>(sparse.indices + i * 2);
+            case COMPONENT_UNSIGNED_INT:
+                return readComponent<uint32_t>(sparse.indices + i * 4);
+            default:
+                throw std::runtime_error("Sparse indices have to be unsigned integers");
+            }
+        }
+
+        void decodeAccessor(const AccessorView& accessor, const ComponentType outputType, void* output)
+        {
+            // Throws for unsupported conversions even when there's no data to decode
+            selectKernel(accessor, outputType, getNumComponents(accessor.type));
+            uint8_t* outputBytes = static_cast<uint8_t*>(output);
+            const uint32_t elementSize = getElementSize(accessor.componentType, accessor.type);
+            if (accessor.data != nullptr) {
+                const size_t byteStride = accessor.byteStride != 0 ? accessor.byteStride : elementSize;
+                decodeElements(accessor, outputType, accessor.data, byteStride, accessor.count, outputBytes);
+            }
+            else {
+                memset(output, 0, getDecodedSize(accessor, outputType));
+            }
+
+            const SparseAccessorView& sparse = accessor.sparse;
+            if (sparse.count == 0) {
+                return;
+            }
+            const size_t outputElementSize = size_t(getNumComponents(accessor.type)) * getComponentSize(outputType);
+            std::vector<uint8_t> values(sparse.count * outputElementSize);
+            decodeElements(accessor, outputType, sparse.values, elementSize, sparse.count, values.data());
+            for (uint32_t i = 0; i < sparse.count; ++i) {
+                const uint32_t index = readSparseIndex(sparse, i);
+                if (index >= accessor.count) {
+                    throw std::runtime_error("Sparse accessor index out of range");
+                }
+                memcpy(outputBytes + index * outputElementSize, values.data() + i * outputElementSize, outputElementSize);
+            }
+        }
+    }
+}
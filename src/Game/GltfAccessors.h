@@ -0,0 +1,72 @@
+#pragma once
+#include "pch.h"
+
+namespace bdr
+{
+    namespace gltf
+    {
+        // glTF's componentType values
+        enum ComponentType : int32_t
+        {
+            COMPONENT_BYTE = 5120,
+            COMPONENT_UNSIGNED_BYTE = 5121,
+            COMPONENT_SHORT = 5122,
+            COMPONENT_UNSIGNED_SHORT = 5123,
+            COMPONENT_UNSIGNED_INT = 5125,
+            COMPONENT_FLOAT = 5126,
+        };
+
+        enum class AccessorType : uint8_t
+        {
+            SCALAR,
+            VEC2,
+            VEC3,
+            VEC4,
+            MAT2,
+            MAT3,
+            MAT4,
+        };
+
+        uint32_t getComponentSize(const ComponentType componentType);
+        uint32_t getNumComponents(const AccessorType type);
+        // Matrix columns start on 4 byte boundaries, so byte MAT2s and MAT3s and short MAT3s are padded
+        uint32_t getElementSize(const ComponentType componentType, const AccessorType type);
+
+        // Replaces count elements of the accessor's dense data, with values tightly packed like a buffer view without
+        // a byte stride
+        struct SparseAccessorView
+        {
+            uint32_t count = 0;
+            // UNSIGNED_BYTE, UNSIGNED_SHORT or UNSIGNED_INT, strictly increasing
+            const uint8_t* indices = nullptr;
+            ComponentType indexComponentType = COMPONENT_UNSIGNED_INT;
+            const uint8_t* values = nullptr;
+        };
+
+        // An accessor resolved against its buffer view, independent of the glTF parser
+        struct AccessorView
+        {
+            // Null when the accessor has no buffer view, in which case it reads as zeros
+            const uint8_t* data = nullptr;
+            uint32_t count = 0;
+            // 0 when elements are tightly packed
+            uint32_t byteStride = 0;
+            ComponentType componentType = COMPONENT_FLOAT;
+            AccessorType type = AccessorType::SCALAR;
+            bool normalized = false;
+            SparseAccessorView sparse;
+        };
+
+        // Decodes every element of the accessor into output, count tightly packed elements of outputType with no
+        // matrix column padding. Supported conversions:
+        //   - to the accessor's own component type, which only removes strides, padding and sparseness
+        //   - to FLOAT from any type, dividing normalized integers by their maximum as glTF specifies
+        //   - to UNSIGNED_SHORT or UNSIGNED_INT from unnormalized unsigned integers, whose values have to fit
+        // Throws for anything else. Every combination of component type, normalization and component count has its
+        // own kernel, instantiated at compile time, with SSE conversions for packed and four component data.
+        void decodeAccessor(const AccessorView& accessor, const ComponentType outputType, void* output);
+
+        // Bytes decodeAccessor writes
+        size_t getDecodedSize(const AccessorView& accessor, const ComponentType outputType);
+    }
+}
@@ -2,6 +2,9 @@
 #include "pch.h"
 
 #include "GltfSceneLoader.h"
+#include "AnimationCompression.h"
+#include "GltfAccessors.h"
+#include "Core/JobSystem.h"
 
 #define TINYGLTF_IMPLEMENTATION
 #define TINYGLTF_NO_STB_IMAGE
@@ -165,15 +168,61 @@ namespace bdr
             return (uint64_t(meshIdx) << 32) | uint64_t(primitiveIdx);
         }
 
+        AccessorType getAccessorType(const tinygltf::Accessor& accessor)
+        {
+            switch (accessor.type) {
+            case TINYGLTF_TYPE_SCALAR:
+                return AccessorType::SCALAR;
+            case TINYGLTF_TYPE_VEC2:
+                return AccessorType::VEC2;
+            case TINYGLTF_TYPE_VEC3:
+                return AccessorType::VEC3;
+            case TINYGLTF_TYPE_VEC4:
+                return AccessorType::VEC4;
+            case TINYGLTF_TYPE_MAT2:
+                return AccessorType::MAT2;
+            case TINYGLTF_TYPE_MAT3:
+                return AccessorType::MAT3;
+            case TINYGLTF_TYPE_MAT4:
+                return AccessorType::MAT4;
+            default:
+                throw std::runtime_error("Unknown accessor type");
+            }
+        }
+
+        // tinygltf doesn't parse sparse accessors, so the view never has any
+        AccessorView getAccessorView(const tinygltf::Model& inputModel, const tinygltf::Accessor& accessor)
+        {
+            AccessorView view{};
+            view.count = uint32_t(accessor.count);
+            view.componentType = ComponentType(accessor.componentType);
+            view.type = getAccessorType(accessor);
+            view.normalized = accessor.normalized;
+            if (accessor.bufferView < 0) {
+                return view;
+            }
+
+            const tinygltf::BufferView& bufferView = inputModel.bufferViews[accessor.bufferView];
+            const tinygltf::Buffer& buffer = inputModel.buffers[bufferView.buffer];
+            const size_t offset = accessor.byteOffset + bufferView.byteOffset;
+            const size_t elementSize = getElementSize(view.componentType, view.type);
+            const size_t byteStride = bufferView.byteStride != 0 ? bufferView.byteStride : elementSize;
+            if (accessor.count > 0 && offset + (accessor.count - 1) * byteStride + elementSize > buffer.data.size()) {
+                throw std::runtime_error("Accessor reads past the end of its buffer");
+            }
+            view.data = buffer.data.data() + offset;
+            view.byteStride = uint32_t(bufferView.byteStride);
+            return view;
+        }
+
+        // Decodes any accessor to floats, so T has to be made of as many floats as the accessor has components
         template<class T>
         void copyAccessorDataToVector(const tinygltf::Model* inputModel, const tinygltf::Accessor& accessor, std::vector<T>& dst)
         {
-            // Num elements is useful for flattening Vec3 and Vec4 arrays
-            const tinygltf::BufferView& bufferView = inputModel->bufferViews[accessor.bufferView];
-            const tinygltf::Buffer& buffer = inputModel->buffers[bufferView.buffer];
-            ASSERT(bufferView.byteStride == 0);
+            const AccessorView view = getAccessorView(*inputModel, accessor);
+            ASSERT(sizeof(T) == getNumComponents(view.type) * sizeof(float), "Accessor doesn't match the vector's element type");
             dst.resize(accessor.count);
-            memcpy(dst.data(), &buffer.data.at(accessor.byteOffset + bufferView.byteOffset), accessor.count * getByteSize(accessor));
+            decodeAccessor(view, COMPONENT_FLOAT, dst.data());
         }
 
         Transform processTransform(const tinygltf::Node& inputNode)
@@ -279,38 +328,45 @@ namespace bdr
                 ++numPresentAttr;
             }
             mesh.numPresentAttr = numPresentAttr;
+            mesh.numVertexBuffers = numPresentAttr;
         }
 
-        MeshHandle processPrimitive(SceneData& sceneData, const tinygltf::Primitive& inputPrimitive)
+        // Everything needed to create a primitive's meshes, gathered up front so they can be prepared in parallel
+        struct PrimitiveData
         {
-            const tinygltf::Model& inputModel = *sceneData.inputModel;
             MeshCreationInfo meshData;
+            // Widened indices, for primitives with byte indices
+            std::vector<uint16_t> indices;
+            // Tightly packed copies of attributes whose buffer views are strided
+            std::vector<uint8_t> vertexData[Mesh::maxAttrCount];
+            uint8_t preskinUsage[Mesh::maxAttrCount] = { BufferUsage::UNUSED };
+            bool isSkinned = false;
+            PreparedMesh prepared;
+        };
+
+        void processPrimitive(SceneData& sceneData, const tinygltf::Primitive& inputPrimitive, PrimitiveData& primitiveData)
+        {
+            const tinygltf::Model& inputModel = *sceneData.inputModel;
+            MeshCreationInfo& meshData = primitiveData.meshData;
 
             // Index buffer
             const tinygltf::Accessor& indexAccessor = inputModel.accessors[inputPrimitive.indices];
             meshData.numIndices = uint32_t(indexAccessor.count);
 
             // Process indices
-            std::vector<uint16_t> indices;
+            std::vector<uint16_t>& indices = primitiveData.indices;
             {
-                const tinygltf::BufferView& bufferView = inputModel.bufferViews[indexAccessor.bufferView];
-                const tinygltf::Buffer& buffer = inputModel.buffers[bufferView.buffer];
-                size_t offset = indexAccessor.byteOffset + bufferView.byteOffset;
-                meshData.indexData = &buffer.data.at(offset);
+                const AccessorView indexView = getAccessorView(inputModel, indexAccessor);
                 if (indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
                     meshData.indexFormat = BufferFormat::UINT16;
 
                     // Need to recast our indices
                     indices.resize(meshData.numIndices);
-                    // Copy the data from the buffer, casting each element
-                    for (size_t i = 0; i < indexAccessor.count; ++i) {
-                        size_t elementOffset = indexAccessor.byteOffset + bufferView.byteOffset + i;
-                        indices[i] = uint16_t(buffer.data.at(elementOffset));
-                    }
+                    decodeAccessor(indexView, COMPONENT_UNSIGNED_SHORT, indices.data());
                     meshData.indexData = (uint8_t*)(indices.data());
                 }
                 else {
-                    meshData.indexData = &buffer.data.at(offset);
+                    meshData.indexData = indexView.data;
                     if (indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
                         meshData.indexFormat = BufferFormat::UINT16;
                     }
@@ -323,9 +379,10 @@ namespace bdr
                 }
             }
 
-            bool isSkinned = inputPrimitive.attributes.count("JOINTS_0") > 0 && inputPrimitive.attributes.count("WEIGHTS_0") > 0;
+            const bool isSkinned = inputPrimitive.attributes.count("JOINTS_0") > 0 && inputPrimitive.attributes.count("WEIGHTS_0") > 0;
+            primitiveData.isSkinned = isSkinned;
 
-            uint8_t preskinUsage[Mesh::maxAttrCount] = { BufferUsage::UNUSED };
+            uint8_t* preskinUsage = primitiveData.preskinUsage;
             size_t attrIdx = 0;
             for (size_t i = 0; i < _countof(ATTR_INFO); ++i) {
                 const AttributeInfo& attrInfo = ATTR_INFO[i];
@@ -342,16 +399,28 @@ namespace bdr
 
                 int accessorIndex = inputPrimitive.attributes.at(attrName);
                 const tinygltf::Accessor& accessor = sceneData.inputModel->accessors[accessorIndex];
-                const tinygltf::BufferView& bufferView = sceneData.inputModel->bufferViews[accessor.bufferView];
-                const tinygltf::Buffer& buffer = sceneData.inputModel->buffers[bufferView.buffer];
-                const size_t offset = accessor.byteOffset + bufferView.byteOffset;
-                ASSERT(bufferView.byteStride == 0, "Cannot handle byte strides for our vertex attributes");
+                const AccessorView view = getAccessorView(inputModel, accessor);
 
                 if (attrInfo.attrBit & MeshAttribute::POSITION) {
                     meshData.numVertices = accessor.count;
+                    // glTF requires min and max on positions, but fall back to scanning if they're missing
+                    if (accessor.minValues.size() == 3 && accessor.maxValues.size() == 3) {
+                        meshData.bounds.min = glm::vec3{ accessor.minValues[0], accessor.minValues[1], accessor.minValues[2] };
+                        meshData.bounds.max = glm::vec3{ accessor.maxValues[0], accessor.maxValues[1], accessor.maxValues[2] };
+                    }
                 }
 
-                meshData.data[attrIdx] = (uint8_t*)(&buffer.data.at(accessor.byteOffset + bufferView.byteOffset));
+                const uint32_t elementSize = getElementSize(view.componentType, view.type);
+                if (view.data != nullptr && (view.byteStride == 0 || view.byteStride == elementSize)) {
+                    meshData.data[attrIdx] = (uint8_t*)(view.data);
+                }
+                else {
+                    // Strided and zero filled accessors are decoded to their own type, tightly packed
+                    std::vector<uint8_t>& vertexData = primitiveData.vertexData[attrIdx];
+                    vertexData.resize(getDecodedSize(view, view.componentType));
+                    decodeAccessor(view, view.componentType, vertexData.data());
+                    meshData.data[attrIdx] = vertexData.data();
+                }
                 meshData.bufferFormats[attrIdx] = getFormat(attrInfo, accessor.componentType);
                 meshData.attributes[attrIdx] = attrInfo.attrBit;
                 meshData.strides[attrIdx] = getByteSize(accessor);
@@ -371,11 +440,47 @@ namespace bdr
                 meshData.presentAttributesMask |= attrInfo.attrBit;
                 ++attrIdx;
             }
+            meshData.numAttributes = uint8_t(attrIdx);
+
+            // Skinning and morphing move the vertices every frame, so bounds built from the bind pose don't hold
+            const bool isDeformed = isSkinned || !inputPrimitive.targets.empty();
+            meshData.numLODs = isDeformed ? 1 : Mesh::maxLODs;
+            meshData.buildMeshlets = !isDeformed;
+            meshData.optimizeTriangleOrder = true;
+            // Morph targets are read straight from the glTF buffers, in the original vertex order
+            meshData.optimizeVertexOrder = inputPrimitive.targets.empty();
+            // Skinning and morphing write float vertices
+            meshData.quantizeVertices = sceneData.quantizeVertices && !isDeformed;
+            // Skinning and morphing need a view of each attribute
+            bool isVertexOnly = !isDeformed;
+            for (size_t i = 0; i < meshData.numAttributes; ++i) {
+                isVertexOnly &= meshData.bufferUsages[i] == BufferUsage::VERTEX;
+            }
+            if (isVertexOnly && sceneData.interleaveVertices) {
+                meshData.vertexLayout = VertexLayout::INTERLEAVED;
+            }
+            meshData.useGeometryPool = isVertexOnly && sceneData.useGeometryPool;
+        }
 
-            const MeshHandle meshId = createMesh(*sceneData.pRenderer, meshData);
-
-            if (isSkinned) {
-                memcpy(meshData.bufferUsages, preskinUsage, sizeof(preskinUsage[0]) * _countof(preskinUsage));
+        MeshHandle createPrimitiveMeshes(SceneData& sceneData, PrimitiveData& primitiveData)
+        {
+            MeshCreationInfo& meshData = primitiveData.meshData;
+            const MeshHandle meshId = createMesh(*sceneData.pRenderer, meshData, primitiveData.prepared);
+
+            if (primitiveData.isSkinned) {
+                // Skinning only reads the vertices
+                meshData.numLODs = 1;
+                meshData.buildMeshlets = false;
+                meshData.optimizeTriangleOrder = false;
+                meshData.optimizeVertexOrder = false;
+                meshData.quantizeVertices = false;
+                // Skinning writes vertex i of the preskin mesh to vertex i of the mesh, so they share the reordering
+                for (size_t i = 0; i < meshData.numAttributes; ++i) {
+                    if (!primitiveData.prepared.vertexData[i].empty()) {
+                        meshData.data[i] = primitiveData.prepared.vertexData[i].data();
+                    }
+                }
+                memcpy(meshData.bufferUsages, primitiveData.preskinUsage, sizeof(primitiveData.preskinUsage));
                 const MeshHandle preskinId = createMesh(*sceneData.pRenderer, meshData);
                 sceneData.pRenderer->meshes[meshId.idx].preskinMeshId = preskinId;
             }
@@ -383,21 +488,137 @@ namespace bdr
             return meshId;
         }
 
+        // Leaves deltas empty for attributes the target doesn't move
+        void getMorphTargetDeltas(
+            const tinygltf::Model& inputModel,
+            const std::map<std::string, int>& target,
+            const char* attrName,
+            const size_t numVertices,
+            std::vector<glm::vec3>& deltas
+        )
+        {
+            auto it = target.find(attrName);
+            if (it == target.end()) {
+                return;
+            }
+            const tinygltf::Accessor& accessor = inputModel.accessors[it->second];
+            // Without a buffer view the accessor is all zeros
+            if (accessor.bufferView < 0) {
+                return;
+            }
+            if (accessor.type != TINYGLTF_TYPE_VEC3 || accessor.count != numVertices) {
+                throw std::runtime_error("Cannot handle morph targets that aren't three components per vertex");
+            }
+            copyAccessorDataToVector(&inputModel, accessor, deltas);
+        }
+
+        // Imports the primitive's position and normal morph targets, keeping only their non-zero deltas.
+        // Returns the index of the new morph target set, or UINT32_MAX if the primitive has no targets.
+        uint32_t processMorphTargets(SceneData& sceneData, const tinygltf::Mesh& inputMesh, const tinygltf::Primitive& inputPrimitive)
+        {
+            if (inputPrimitive.targets.empty()) {
+                return UINT32_MAX;
+            }
+            const tinygltf::Model& inputModel = *sceneData.inputModel;
+
+            std::vector<glm::vec3> basePositions;
+            std::vector<glm::vec3> baseNormals;
+            copyAccessorDataToVector(sceneData.inputModel, inputModel.accessors[inputPrimitive.attributes.at("POSITION")], basePositions);
+            copyAccessorDataToVector(sceneData.inputModel, inputModel.accessors[inputPrimitive.attributes.at("NORMAL")], baseNormals);
+
+            const size_t numTargets = inputPrimitive.targets.size();
+            std::vector<std::vector<glm::vec3>> positionDeltas(numTargets);
+            std::vector<std::vector<glm::vec3>> normalDeltas(numTargets);
+            std::vector<const glm::vec3*> targetPositions(numTargets);
+            std::vector<const glm::vec3*> targetNormals(numTargets);
+            for (size_t i = 0; i < numTargets; ++i) {
+                getMorphTargetDeltas(inputModel, inputPrimitive.targets[i], "POSITION", basePositions.size(), positionDeltas[i]);
+                getMorphTargetDeltas(inputModel, inputPrimitive.targets[i], "NORMAL", basePositions.size(), normalDeltas[i]);
+                targetPositions[i] = positionDeltas[i].empty() ? nullptr : positionDeltas[i].data();
+                targetNormals[i] = normalDeltas[i].empty() ? nullptr : normalDeltas[i].data();
+            }
+
+            MorphTargetSet targetSet = createMorphTargetSet(std::move(basePositions), std::move(baseNormals), targetPositions, targetNormals);
+            for (size_t i = 0; i < inputMesh.weights.size() && i < targetSet.numTargets; ++i) {
+                targetSet.defaultWeights[i] = float(inputMesh.weights[i]);
+            }
+            DEBUGPRINT("Morph targets: %u targets, %zu bytes sparse, %zu bytes dense",
+                targetSet.numTargets, getMemoryUsage(targetSet), getDenseMemoryUsage(targetSet));
+
+            std::vector<MorphTargetSet>& morphTargetSets = sceneData.pScene->morphTargetSets;
+            morphTargetSets.push_back(std::move(targetSet));
+            return uint32_t(morphTargetSets.size() - 1);
+        }
+
         void processMeshes(SceneData& sceneData)
         {
             const auto& inputModel = *sceneData.inputModel;
 
+            size_t numPrimitives = 0;
+            for (const tinygltf::Mesh& inputMesh : inputModel.meshes) {
+                numPrimitives += inputMesh.primitives.size();
+            }
+            // Sized up front, meshData may point into each element's indices
+            std::vector<PrimitiveData> primitives(numPrimitives);
+            size_t primitiveDataIdx = 0;
+            for (const tinygltf::Mesh& inputMesh : inputModel.meshes) {
+                for (const tinygltf::Primitive& primitive : inputMesh.primitives) {
+                    processPrimitive(sceneData, primitive, primitives[primitiveDataIdx++]);
+                }
+            }
+
+            // Simplification and meshlet building dominate import times, and only read the glTF buffers
+            auto prepareRange = [&primitives](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    prepareMesh(primitives[i].meshData, primitives[i].prepared);
+                }
+            };
+            if (sceneData.pJobSystem != nullptr) {
+                sceneData.pJobSystem->parallelFor(primitives.size(), 1, prepareRange);
+            }
+            else {
+                prepareRange(0, primitives.size());
+            }
+
+            primitiveDataIdx = 0;
             for (uint32_t inputMeshIdx = 0; inputMeshIdx < inputModel.meshes.size(); ++inputMeshIdx) {
                 const tinygltf::Mesh& inputMesh = inputModel.meshes[inputMeshIdx];
 
                 for (uint32_t primitiveIdx = 0; primitiveIdx < inputMesh.primitives.size(); ++primitiveIdx) {
                     const auto& primitive = inputMesh.primitives[primitiveIdx];
-                    MeshHandle meshId = processPrimitive(sceneData, primitive);
+                    const PreparedMesh& prepared = primitives[primitiveDataIdx].prepared;
+                    DEBUGPRINT("%s primitive %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+                        inputMesh.name.c_str(), primitiveIdx,
+                        prepared.originalCacheStats.acmr, prepared.optimizedCacheStats.acmr,
+                        prepared.originalCacheStats.atvr, prepared.optimizedCacheStats.atvr);
+                    const MeshCreationInfo& meshData = primitives[primitiveDataIdx].meshData;
+                    uint32_t originalStride = 0;
+                    uint32_t preparedStride = 0;
+                    for (size_t i = 0; i < meshData.numAttributes; ++i) {
+                        originalStride += meshData.strides[i];
+                        preparedStride += prepared.strides[i];
+                    }
+                    DEBUGPRINT("%s primitive %u: %u -> %u bytes per vertex, %u -> %u bytes per index",
+                        inputMesh.name.c_str(), primitiveIdx, originalStride, preparedStride,
+                        getByteSize(meshData.indexFormat), getByteSize(prepared.indexFormat));
+                    MeshHandle meshId = createPrimitiveMeshes(sceneData, primitives[primitiveDataIdx++]);
 
                     uint64_t key = getMeshMapKey(inputMeshIdx, primitiveIdx);
                     sceneData.meshMap[key] = meshId;
+
+                    const uint32_t targetSetIdx = processMorphTargets(sceneData, inputMesh, primitive);
+                    if (targetSetIdx != UINT32_MAX) {
+                        sceneData.morphTargetMap[key] = targetSetIdx;
+                    }
                 }
             }
+
+            const Renderer& renderer = *sceneData.pRenderer;
+            for (size_t i = 0; i < renderer.geometryPools.size(); ++i) {
+                const GeometryPoolStats stats = getStats(renderer.geometryPools[i]);
+                DEBUGPRINT("Geometry pool %zu: %u / %u vertices, %u / %u index units, %u allocations",
+                    i, stats.vertices.usedSize, stats.vertices.size, stats.indices.usedSize, stats.indices.size, stats.vertices.numAllocations);
+            }
         }
 
         void processTextures(SceneData& sceneData)
@@ -475,29 +696,85 @@ namespace bdr
             }
 
             const tinygltf::Accessor& accessor = sceneData.inputModel->accessors[inputSkin.inverseBindMatrices];
-            const tinygltf::BufferView& bufferView = sceneData.inputModel->bufferViews[accessor.bufferView];
-            const tinygltf::Buffer& buffer = sceneData.inputModel->buffers[bufferView.buffer];
-            memcpy(skin.inverseBindMatrices.data(), &buffer.data.at(accessor.byteOffset + bufferView.byteOffset), getByteSize(accessor) * accessor.count);
+            copyAccessorDataToVector(sceneData.inputModel, accessor, skin.inverseBindMatrices);
 
             return skin;
         }
 
-        template<typename ChannelT, typename OutputT>
-        ChannelT processChannel(SceneData& sceneData, const tinygltf::AnimationChannel& inputChannel, const tinygltf::AnimationSampler& inputSampler)
+        // Grows each joint's bounds by the bind space positions of the vertices it influences, for every
+        // primitive of every mesh node using the skin
+        void processJointBounds(SceneData& sceneData, const int32_t skinIdx, Skin& skin)
         {
-            Animation::InterpolationType interpolationType = Animation::InterpolationType::CubicSpline;
-            if (inputSampler.interpolation.compare("LINEAR")) {
-                interpolationType = Animation::InterpolationType::Linear;
+            const tinygltf::Model& inputModel = *sceneData.inputModel;
+            skin.jointBounds.assign(skin.jointEntities.size(), AABB{});
+
+            for (const SceneNode& node : sceneData.nodes) {
+                if (node.skinId != skinIdx || node.meshId == -1) {
+                    continue;
+                }
+                for (const tinygltf::Primitive& primitive : inputModel.meshes[node.meshId].primitives) {
+                    if (primitive.attributes.count("JOINTS_0") == 0 || primitive.attributes.count("WEIGHTS_0") == 0) {
+                        continue;
+                    }
+                    const tinygltf::Accessor& positionAccessor = inputModel.accessors[primitive.attributes.at("POSITION")];
+                    const tinygltf::Accessor& jointAccessor = inputModel.accessors[primitive.attributes.at("JOINTS_0")];
+                    const tinygltf::Accessor& weightAccessor = inputModel.accessors[primitive.attributes.at("WEIGHTS_0")];
+
+                    if (jointAccessor.count != positionAccessor.count || weightAccessor.count != positionAccessor.count) {
+                        throw std::runtime_error("Skinned primitive's attributes have different vertex counts");
+                    }
+                    if (getAccessorType(jointAccessor) != AccessorType::VEC4 || getAccessorType(weightAccessor) != AccessorType::VEC4) {
+                        throw std::runtime_error("JOINTS_0 and WEIGHTS_0 have to be VEC4s");
+                    }
+
+                    // Decoding handles strides, bufferless accessors and every joint and weight component type
+                    std::vector<glm::vec3> positions;
+                    copyAccessorDataToVector(sceneData.inputModel, positionAccessor, positions);
+                    const AccessorView jointView = getAccessorView(inputModel, jointAccessor);
+                    std::vector<uint16_t> joints(getDecodedSize(jointView, COMPONENT_UNSIGNED_SHORT) / sizeof(uint16_t));
+                    decodeAccessor(jointView, COMPONENT_UNSIGNED_SHORT, joints.data());
+                    std::vector<glm::vec4> weights;
+                    copyAccessorDataToVector(sceneData.inputModel, weightAccessor, weights);
+
+                    for (size_t vertex = 0; vertex < positions.size(); ++vertex) {
+                        const glm::vec3& position = positions[vertex];
+                        for (uint32_t i = 0; i < 4; ++i) {
+                            if (weights[vertex][i] <= 0.0f) {
+                                continue;
+                            }
+                            const uint32_t joint = joints[vertex * 4 + i];
+                            ASSERT(joint < skin.jointBounds.size(), "Vertex references a joint the skin doesn't have");
+                            math::expand(skin.jointBounds[joint], position);
+                        }
+                    }
+                }
             }
-            else if (inputSampler.interpolation.compare("STEP")) {
+        }
+
+        // Each keyframe has valuesPerKey outputs, the number of morph targets for weights channels
+        template<typename ChannelT, typename OutputT>
+        ChannelT processChannel(
+            SceneData& sceneData,
+            const tinygltf::AnimationChannel& inputChannel,
+            const tinygltf::AnimationSampler& inputSampler,
+            const uint32_t valuesPerKey = 1
+        )
+        {
+            // LINEAR is the default when the sampler doesn't specify an interpolation
+            Animation::InterpolationType interpolationType = Animation::InterpolationType::Linear;
+            if (inputSampler.interpolation.compare("STEP") == 0) {
                 interpolationType = Animation::InterpolationType::Step;
             }
+            else if (inputSampler.interpolation.compare("CUBICSPLINE") == 0) {
+                interpolationType = Animation::InterpolationType::CubicSpline;
+            }
 
             const tinygltf::Accessor& inputAccessor = sceneData.inputModel->accessors[inputSampler.input];
             const tinygltf::Accessor& outputAccessor = sceneData.inputModel->accessors[inputSampler.output];
 
-            if (inputAccessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || outputAccessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
-                throw std::runtime_error("Don't support non float samplers just yet");
+            // Rotations and weights can be normalized integers, which are decoded to floats with the rest
+            if (outputAccessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT && !outputAccessor.normalized) {
+                throw std::runtime_error("Animation sampler outputs have to be floats or normalized integers");
             }
 
             ChannelT channel{};
@@ -508,6 +785,12 @@ namespace bdr
             copyAccessorDataToVector<float>(sceneData.inputModel, inputAccessor, channel.input);
             copyAccessorDataToVector<OutputT>(sceneData.inputModel, outputAccessor, channel.output);
 
+            // Cubic splines have an in tangent, a value and an out tangent per keyframe
+            const size_t outputsPerKey = interpolationType == Animation::InterpolationType::CubicSpline ? 3 : 1;
+            if (channel.input.empty() || channel.output.size() != channel.input.size() * outputsPerKey * valuesPerKey) {
+                throw std::runtime_error("Animation sampler outputs don't match its keyframes");
+            }
+
             return channel;
         }
 
@@ -531,8 +814,31 @@ namespace bdr
                     auto channel{ processChannel<Animation::TranslationChannel, glm::vec3>(sceneData, inputChannel, inputSampler) };
                     addTranslationChannel(output, std::move(channel));
                 }
+                else if (inputChannel.target_path.compare("weights") == 0) {
+                    // Morphed meshes are sorted by entity, so the target's primitives are a single range
+                    const std::vector<MorphedMesh>& morphedMeshes = sceneData.pScene->morphedMeshes;
+                    const uint32_t targetEntity = sceneData.nodeToEntityMap[inputChannel.target_node];
+                    const auto firstMesh = std::lower_bound(morphedMeshes.begin(), morphedMeshes.end(), targetEntity,
+                        [](const MorphedMesh& mesh, const uint32_t entity) { return mesh.entity < entity; });
+                    if (firstMesh == morphedMeshes.end() || firstMesh->entity != targetEntity) {
+                        Utility::Printf("Weights channel targets a node without morph targets");
+                        continue;
+                    }
+                    const uint32_t numTargets = uint32_t(firstMesh->weights.size());
+                    auto lastMesh = firstMesh;
+                    for (; lastMesh != morphedMeshes.end() && lastMesh->entity == targetEntity; ++lastMesh) {
+                        if (lastMesh->weights.size() != numTargets) {
+                            throw std::runtime_error("Every primitive of a mesh has to have the same number of morph targets");
+                        }
+                    }
+
+                    auto channel{ processChannel<Animation::WeightsChannel, float>(sceneData, inputChannel, inputSampler, numTargets) };
+                    channel.firstMorphedMesh = uint32_t(firstMesh - morphedMeshes.begin());
+                    channel.numMorphedMeshes = uint32_t(lastMesh - firstMesh);
+                    addWeightsChannel(output, std::move(channel));
+                }
                 else {
-                    Utility::Print("Don't support weights yet!");
+                    Utility::Printf("Don't support %s channels!", inputChannel.target_path.c_str());
                     continue;
                 }
             }
@@ -606,6 +912,9 @@ namespace bdr
                 // Don't map submeshes
                 if (node.primitiveId < 1) {
                     sceneData.nodeToEntityMap[node.index] = entity;
+                    if (!node.name.empty()) {
+                        assignName(sceneData.pScene->names, entity, node.name);
+                    }
                 }
 
                 if (node.parentId != -1) {
@@ -613,6 +922,28 @@ namespace bdr
                     registry.cmpMasks[entity] |= PARENT;
                 }
 
+                if (node.meshId != -1) {
+                    auto morphTargetIt = sceneData.morphTargetMap.find(getMeshMapKey(node.meshId, node.primitiveId));
+                    if (morphTargetIt != sceneData.morphTargetMap.end()) {
+                        // Weights channels target the node, so every primitive of the node is driven by its entity
+                        const MorphTargetSet& targetSet = sceneData.pScene->morphTargetSets[morphTargetIt->second];
+                        const tinygltf::Node& inputNode = gltfModel.nodes[node.index];
+
+                        MorphedMesh morphedMesh{};
+                        morphedMesh.entity = sceneData.nodeToEntityMap[node.index];
+                        morphedMesh.targetSetIdx = morphTargetIt->second;
+                        morphedMesh.weights = targetSet.defaultWeights;
+                        // Node weights override the mesh's
+                        for (size_t i = 0; i < inputNode.weights.size() && i < targetSet.numTargets; ++i) {
+                            morphedMesh.weights[i] = float(inputNode.weights[i]);
+                        }
+                        morphedMesh.defaultWeights = morphedMesh.weights;
+                        morphedMesh.positions.resize(targetSet.numVertices);
+                        morphedMesh.normals.resize(targetSet.baseNormals.size());
+                        sceneData.pScene->morphedMeshes.push_back(std::move(morphedMesh));
+                    }
+                }
+
                 //if (node.meshId != -1) {
                 //    registry.meshes[entity] = sceneData.meshMap[getMeshMapKey(node.meshId, node.primitiveId)];
                 //    registry.cmpMasks[entity] |= MESH;
@@ -709,10 +1040,17 @@ namespace bdr
                 registry.cmpMasks[entity] |= TRANSFORM;
             }
 
+            // Weights channels drive every primitive of their node, which this keeps next to each other
+            std::vector<MorphedMesh>& morphedMeshes = sceneData.pScene->morphedMeshes;
+            std::stable_sort(morphedMeshes.begin(), morphedMeshes.end(), [](const MorphedMesh& lhs, const MorphedMesh& rhs) {
+                return lhs.entity < rhs.entity;
+            });
+
             // Create Skins
             for (size_t i = 0; i < sceneData.inputModel->skins.size(); i++) {
                 const tinygltf::Skin& inputSkin = sceneData.inputModel->skins[i];
                 Skin skin = processSkin(sceneData, inputSkin);
+                processJointBounds(sceneData, int32_t(i), skin);
                 GPUBuffer jointBuffer{ createStructuredBuffer(
                     sceneData.pRenderer->getDevice(),
                     sizeof(skin.inverseBindMatrices[0]),
@@ -726,7 +1064,19 @@ namespace bdr
             for (size_t i = 0; i < sceneData.inputModel->animations.size(); i++) {
                 const tinygltf::Animation& animation = sceneData.inputModel->animations[i];
                 sceneData.pScene->animations.push_back(processAnimation(sceneData, animation));
+
+                const AnimationClip compiledClip = compileAnimationClip(sceneData.pScene->animations.back());
+                AnimationClip clip = compressAnimationClip(compiledClip);
+                DEBUGPRINT("Animation %zu: %zu bytes raw, %zu bytes compiled, %zu bytes compressed",
+                    i, getMemoryUsage(sceneData.pScene->animations.back()), getMemoryUsage(compiledClip), getMemoryUsage(clip));
+                AnimationPose pose{};
+                initPose(clip, pose);
+                sceneData.pScene->animationClips.push_back(std::move(clip));
+                sceneData.pScene->animationPoses.push_back(std::move(pose));
             }
+
+            const EntityNameTable::MemoryStats nameStats = getMemoryStats(sceneData.pScene->names);
+            DEBUGPRINT("Entity names: %zu entries, %zu unique, %zu bytes", nameStats.numEntries, nameStats.numUniqueNames, nameStats.totalBytes);
             sceneData.inputModel = nullptr;
         }
     }
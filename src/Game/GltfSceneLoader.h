@@ -11,6 +11,11 @@ namespace tinygltf
     class Model;
 }
 
+namespace bdr
+{
+    class JobSystem;
+}
+
 
 namespace bdr
 {
@@ -46,12 +51,21 @@ namespace bdr
         {
             Scene* pScene = nullptr;
             Renderer* pRenderer = nullptr;
+            // Optional, prepares meshes (LODs and meshlets) in parallel when set
+            JobSystem* pJobSystem = nullptr;
+            // Opt-in vertex compression for static primitives (not skinned or morphed). Quantizing and interleaving
+            // change the mesh's input layout, so the pipelines drawing it have to declare the matching one.
+            bool quantizeVertices = false;
+            bool interleaveVertices = false;
+            bool useGeometryPool = false;
             const std::string fileFolder;
             const std::string fileName;
             std::vector<SceneNode> nodes;
             std::vector<SceneNode> traversedNodes;
             std::vector<uint32_t> nodeToEntityMap;
             std::unordered_map<uint64_t, MeshHandle> meshMap;
+            // Same keys as meshMap, for primitives with morph targets. Indexes into pScene->morphTargetSets.
+            std::unordered_map<uint64_t, uint32_t> morphTargetMap;
             std::vector<TextureHandle> textureMap;
             tinygltf::Model* inputModel;
 
@@ -69,6 +83,7 @@ namespace bdr
                 traversedNodes{},
                 nodeToEntityMap{},
                 meshMap{},
+                morphTargetMap{},
                 textureMap{},
                 inputModel{}
             { };
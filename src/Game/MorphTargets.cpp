@@ -0,0 +1,172 @@
+#include "pch.h"
+#include "MorphTargets.h"
+
+#include "Core/bdrSimd.h"
+#include "Core/JobSystem.h"
+#include "Scene.h"
+
+
+namespace bdr
+{
+    // Gaps of up to this many unchanged vertices are stored as zeros rather than starting a new run
+    constexpr uint32_t kMaxRunGap = 2;
+
+    inline bool isNonZeroDelta(const glm::vec3& delta, const float threshold)
+    {
+        return fabsf(delta.x) > threshold || fabsf(delta.y) > threshold || fabsf(delta.z) > threshold;
+    }
+
+    MorphTargetSet createMorphTargetSet(
+        std::vector<glm::vec3>&& basePositions,
+        std::vector<glm::vec3>&& baseNormals,
+        const std::vector<const glm::vec3*>& targetPositions,
+        const std::vector<const glm::vec3*>& targetNormals,
+        const float threshold
+    )
+    {
+        MorphTargetSet targetSet{};
+        targetSet.numVertices = uint32_t(basePositions.size());
+        targetSet.numTargets = uint32_t(targetPositions.size());
+        targetSet.basePositions = std::move(basePositions);
+
+        bool hasNormals = false;
+        for (const glm::vec3* normals : targetNormals) {
+            hasNormals |= normals != nullptr;
+        }
+        if (hasNormals && !baseNormals.empty()) {
+            ASSERT(baseNormals.size() == targetSet.numVertices, "Normal count doesn't match position count");
+            targetSet.baseNormals = std::move(baseNormals);
+        }
+        hasNormals = !targetSet.baseNormals.empty();
+
+        targetSet.runOffsets.reserve(targetSet.numTargets + 1);
+        for (uint32_t target = 0; target < targetSet.numTargets; ++target) {
+            targetSet.runOffsets.push_back(uint32_t(targetSet.runs.size()));
+            const glm::vec3* positions = targetPositions[target];
+            const glm::vec3* normals = hasNormals && target < targetNormals.size() ? targetNormals[target] : nullptr;
+
+            MorphTargetSet::Run* run = nullptr;
+            for (uint32_t vertex = 0; vertex < targetSet.numVertices; ++vertex) {
+                const bool isNonZero = (positions != nullptr && isNonZeroDelta(positions[vertex], threshold))
+                    || (normals != nullptr && isNonZeroDelta(normals[vertex], threshold));
+                if (!isNonZero) {
+                    continue;
+                }
+
+                uint32_t firstVertex = vertex;
+                if (run != nullptr && vertex - (run->firstVertex + run->numVertices) <= kMaxRunGap) {
+                    firstVertex = run->firstVertex + run->numVertices;
+                }
+                else {
+                    targetSet.runs.push_back({ vertex, 0u, uint32_t(targetSet.positionDeltas.size()) });
+                    run = &targetSet.runs.back();
+                }
+
+                for (uint32_t v = firstVertex; v <= vertex; ++v) {
+                    targetSet.positionDeltas.push_back(positions != nullptr ? positions[v] : glm::vec3{ 0.0f });
+                    if (hasNormals) {
+                        targetSet.normalDeltas.push_back(normals != nullptr ? normals[v] : glm::vec3{ 0.0f });
+                    }
+                }
+                run->numVertices = vertex + 1 - run->firstVertex;
+            }
+        }
+        targetSet.runOffsets.push_back(uint32_t(targetSet.runs.size()));
+        targetSet.defaultWeights.assign(targetSet.numTargets, 0.0f);
+        return targetSet;
+    }
+
+    // out[i] += weight * deltas[i], over numFloats floats
+    inline void addScaledDeltas(float* out, const float* deltas, const size_t numFloats, const float weight)
+    {
+        const simd::FloatV weightV = simd::set1(weight);
+        size_t i = 0;
+        for (; i + simd::laneWidth <= numFloats; i += simd::laneWidth) {
+            simd::store(out + i, simd::madd(simd::load(deltas + i), weightV, simd::load(out + i)));
+        }
+        for (; i < numFloats; ++i) {
+            out[i] += weight * deltas[i];
+        }
+    }
+
+    void blendMorphTargets(
+        const MorphTargetSet& targetSet,
+        const float* weights,
+        const uint32_t maxActiveTargets,
+        glm::vec3* outPositions,
+        glm::vec3* outNormals
+    )
+    {
+        const bool hasNormals = !targetSet.baseNormals.empty() && outNormals != nullptr;
+        memcpy(outPositions, targetSet.basePositions.data(), sizeof(glm::vec3) * targetSet.numVertices);
+        if (hasNormals) {
+            memcpy(outNormals, targetSet.baseNormals.data(), sizeof(glm::vec3) * targetSet.numVertices);
+        }
+
+        // Zero weight targets never touch their deltas
+        uint32_t activeTargets[kMaxActiveMorphTargets];
+        uint32_t numActiveTargets = 0;
+        const uint32_t maxActive = std::min(maxActiveTargets, kMaxActiveMorphTargets);
+        for (uint32_t target = 0; target < targetSet.numTargets; ++target) {
+            const float weight = fabsf(weights[target]);
+            if (weight < kMinMorphWeight) {
+                continue;
+            }
+            if (numActiveTargets < maxActive) {
+                activeTargets[numActiveTargets++] = target;
+                continue;
+            }
+            // Over the limit, replace the lightest active target if this one is heavier
+            uint32_t lightest = 0;
+            for (uint32_t i = 1; i < numActiveTargets; ++i) {
+                if (fabsf(weights[activeTargets[i]]) < fabsf(weights[activeTargets[lightest]])) {
+                    lightest = i;
+                }
+            }
+            if (numActiveTargets > 0 && weight > fabsf(weights[activeTargets[lightest]])) {
+                activeTargets[lightest] = target;
+            }
+        }
+
+        for (uint32_t i = 0; i < numActiveTargets; ++i) {
+            const uint32_t target = activeTargets[i];
+            const float weight = weights[target];
+            for (uint32_t runIdx = targetSet.runOffsets[target]; runIdx < targetSet.runOffsets[target + 1]; ++runIdx) {
+                const MorphTargetSet::Run& run = targetSet.runs[runIdx];
+                const size_t numFloats = size_t(run.numVertices) * 3u;
+                addScaledDeltas(&outPositions[run.firstVertex].x, &targetSet.positionDeltas[run.deltasOffset].x, numFloats, weight);
+                if (hasNormals) {
+                    addScaledDeltas(&outNormals[run.firstVertex].x, &targetSet.normalDeltas[run.deltasOffset].x, numFloats, weight);
+                }
+            }
+        }
+    }
+
+    void updateMorphTargets(Scene& scene, JobSystem& jobSystem, const uint32_t maxActiveTargets)
+    {
+        jobSystem.parallelFor(scene.morphedMeshes.size(), 1, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                MorphedMesh& mesh = scene.morphedMeshes[i];
+                const MorphTargetSet& targetSet = scene.morphTargetSets[mesh.targetSetIdx];
+                ASSERT(mesh.weights.size() == targetSet.numTargets, "Expected one weight per morph target");
+                mesh.positions.resize(targetSet.numVertices);
+                mesh.normals.resize(targetSet.baseNormals.size());
+                blendMorphTargets(targetSet, mesh.weights.data(), maxActiveTargets, mesh.positions.data(), mesh.normals.empty() ? nullptr : mesh.normals.data());
+            }
+        });
+    }
+
+    size_t getMemoryUsage(const MorphTargetSet& targetSet)
+    {
+        return targetSet.runOffsets.capacity() * sizeof(uint32_t)
+            + targetSet.runs.capacity() * sizeof(MorphTargetSet::Run)
+            + targetSet.positionDeltas.capacity() * sizeof(glm::vec3)
+            + targetSet.normalDeltas.capacity() * sizeof(glm::vec3);
+    }
+
+    size_t getDenseMemoryUsage(const MorphTargetSet& targetSet)
+    {
+        const size_t numStreams = targetSet.baseNormals.empty() ? 1u : 2u;
+        return size_t(targetSet.numTargets) * targetSet.numVertices * numStreams * sizeof(glm::vec3);
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "pch.h"
+
+#include <vector>
+
+namespace bdr
+{
+    class JobSystem;
+    class Scene;
+
+    // The morph targets of a single primitive, with only their non-zero deltas stored.
+    // Each target's deltas are split into runs of consecutive vertices, so a blend is a handful of
+    // contiguous SIMD multiply-adds per target rather than a scatter per vertex. Short gaps between
+    // runs are stored as zeros when that's cheaper than starting a new run.
+    struct MorphTargetSet
+    {
+        struct Run
+        {
+            uint32_t firstVertex = 0;
+            uint32_t numVertices = 0;
+            // Index of the run's first delta, in float3s
+            uint32_t deltasOffset = 0;
+        };
+
+        uint32_t numVertices = 0;
+        uint32_t numTargets = 0;
+        std::vector<glm::vec3> basePositions;
+        // Empty if none of the targets move normals
+        std::vector<glm::vec3> baseNormals;
+
+        // Runs of target t are [runOffsets[t], runOffsets[t + 1])
+        std::vector<uint32_t> runOffsets;
+        std::vector<Run> runs;
+        std::vector<glm::vec3> positionDeltas;
+        // Same layout as positionDeltas, empty if baseNormals is
+        std::vector<glm::vec3> normalDeltas;
+
+        std::vector<float> defaultWeights;
+    };
+
+    // A mesh node's primitive using morph targets, along with its weights and blended vertices
+    struct MorphedMesh
+    {
+        // The node's entity, which weights channels target
+        uint32_t entity = UINT32_MAX;
+        // Index into scene.morphTargetSets
+        uint32_t targetSetIdx = UINT32_MAX;
+        std::vector<float> weights;
+        // The target set's default weights overridden by the node's, restored when an animation resets
+        std::vector<float> defaultWeights;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+    };
+
+    // Targets with a smaller absolute weight than this are skipped when blending
+    constexpr float kMinMorphWeight = 1e-5f;
+    constexpr uint32_t kMaxActiveMorphTargets = 64;
+
+    // targetPositions and targetNormals hold one array of numVertices deltas per target.
+    // targetNormals can be empty, or contain null arrays for targets that don't move normals.
+    // Deltas with no component larger than threshold are dropped. Default weights start at zero.
+    MorphTargetSet createMorphTargetSet(
+        std::vector<glm::vec3>&& basePositions,
+        std::vector<glm::vec3>&& baseNormals,
+        const std::vector<const glm::vec3*>& targetPositions,
+        const std::vector<const glm::vec3*>& targetNormals,
+        const float threshold = 0.0f
+    );
+
+    // Blends the maxActiveTargets heaviest non-zero weights into outPositions (and outNormals, if the set has normals).
+    // Normals are not renormalized.
+    void blendMorphTargets(
+        const MorphTargetSet& targetSet,
+        const float* weights,
+        const uint32_t maxActiveTargets,
+        glm::vec3* outPositions,
+        glm::vec3* outNormals
+    );
+
+    // Blends every morphed mesh of the scene with its current weights, one mesh per job
+    void updateMorphTargets(Scene& scene, JobSystem& jobSystem, const uint32_t maxActiveTargets = kMaxActiveMorphTargets);
+
+    // Size in bytes of the sparse deltas, and of the same targets stored densely
+    size_t getMemoryUsage(const MorphTargetSet& targetSet);
+    size_t getDenseMemoryUsage(const MorphTargetSet& targetSet);
+}
@@ -6,7 +6,12 @@
 
 #include "ECSRegistry.h"
 #include "Animation.h"
+#include "AnimationClip.h"
+#include "AnimationInstancing.h"
 #include "Camera.h"
+#include "EntityNames.h"
+#include "MorphTargets.h"
+#include "SpatialIndex.h"
 
 namespace bdr
 {
@@ -27,7 +32,14 @@ namespace bdr
             registry.clearComponentData();
             skins = std::vector<Skin>();
             animations = std::vector<Animation>();
+            animationClips = std::vector<AnimationClip>();
+            animationPoses = std::vector<AnimationPose>();
+            animationInstances = std::vector<AnimationInstance>();
+            morphTargetSets = std::vector<MorphTargetSet>();
+            morphedMeshes = std::vector<MorphedMesh>();
+            spatialIndex = SpatialIndex{};
             cameras = std::vector<Camera>();
+            names.reset();
         }
 
         inline operator ECSRegistry& ()
@@ -38,7 +50,16 @@ namespace bdr
         ECSRegistry registry;
         std::vector<Skin> skins;
         std::vector<Animation> animations;
+        // Compiled versions of the animations, with one pose each, indexed the same way
+        std::vector<AnimationClip> animationClips;
+        std::vector<AnimationPose> animationPoses;
+        // Crowd playbacks of animationClips, see AnimationInstancing.h
+        std::vector<AnimationInstance> animationInstances;
+        std::vector<MorphTargetSet> morphTargetSets;
+        std::vector<MorphedMesh> morphedMeshes;
+        SpatialIndex spatialIndex;
         std::vector<Camera> cameras;
+        EntityNameTable names;
     };
 
     Camera& getCamera(Scene& scene, const uint32_t cameraId);
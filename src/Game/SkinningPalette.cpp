@@ -0,0 +1,216 @@
+#include "pch.h"
+#include "SkinningPalette.h"
+
+#include <unordered_map>
+
+#include "Core/bdrSimd.h"
+#include "Scene.h"
+
+
+namespace bdr
+{
+    inline bool isSameSkin(const Skin& lhs, const Skin& rhs)
+    {
+        return lhs.mode == rhs.mode
+            && lhs.jointEntities == rhs.jointEntities
+            && lhs.inverseBindMatrices.size() == rhs.inverseBindMatrices.size()
+            && memcmp(lhs.inverseBindMatrices.data(), rhs.inverseBindMatrices.data(), sizeof(glm::mat4) * lhs.inverseBindMatrices.size()) == 0;
+    }
+
+    inline bool isSameMatrix(const glm::mat4& lhs, const glm::mat4& rhs)
+    {
+        return memcmp(&lhs, &rhs, sizeof(glm::mat4)) == 0;
+    }
+
+    void buildSkinningPalette(const Scene& scene, SkinningPalette& palette)
+    {
+        const ECSRegistry& registry = scene.registry;
+        const uint32_t numSkins = uint32_t(scene.skins.size());
+
+        // Duplicate skins get folded into the first one with the same joints and bind pose
+        std::vector<uint32_t> canonicalSkins(numSkins);
+        for (uint32_t skinIdx = 0; skinIdx < numSkins; ++skinIdx) {
+            canonicalSkins[skinIdx] = skinIdx;
+            for (uint32_t otherIdx = 0; otherIdx < skinIdx; ++otherIdx) {
+                if (canonicalSkins[otherIdx] == otherIdx && isSameSkin(scene.skins[skinIdx], scene.skins[otherIdx])) {
+                    canonicalSkins[skinIdx] = otherIdx;
+                    break;
+                }
+            }
+        }
+
+        palette.jointEntities.clear();
+        palette.ranges.clear();
+        palette.rangeJoints.clear();
+        palette.entityRanges.assign(registry.numEntities, UINT32_MAX);
+
+        std::unordered_map<uint32_t, uint32_t> jointLookup;
+        for (uint32_t entity = 0; entity < registry.numEntities; ++entity) {
+            if ((registry.cmpMasks[entity] & CmpMasks::SKIN) == 0) {
+                continue;
+            }
+            const uint32_t skinIdx = canonicalSkins[registry.skinIds[entity]];
+            const Skin& skin = scene.skins[skinIdx];
+            SkinningPalette::Range range{};
+            range.skinIdx = skinIdx;
+            range.modelEntity = entity;
+            range.offset = uint32_t(palette.rangeJoints.size());
+            range.numJoints = uint32_t(skin.jointEntities.size());
+            range.mode = skin.mode;
+            for (const uint32_t jointEntity : skin.jointEntities) {
+                auto jointIt = jointLookup.find(jointEntity);
+                if (jointIt == jointLookup.end()) {
+                    jointIt = jointLookup.emplace(jointEntity, uint32_t(palette.jointEntities.size())).first;
+                    palette.jointEntities.push_back(jointEntity);
+                }
+                palette.rangeJoints.push_back(jointIt->second);
+            }
+
+            const uint32_t rangeIdx = uint32_t(palette.ranges.size());
+            palette.ranges.push_back(range);
+            palette.entityRanges[entity] = rangeIdx;
+        }
+
+        palette.jointGlobals.resize(palette.jointEntities.size());
+        palette.isJointDirty.assign(palette.jointEntities.size(), 1);
+        palette.modelGlobals.resize(palette.ranges.size());
+        palette.isRangeDirty.assign(palette.ranges.size(), 1);
+        palette.numDirtyRanges = uint32_t(palette.ranges.size());
+        palette.matrices.resize(palette.rangeJoints.size());
+        palette.dualQuaternions.resize(palette.rangeJoints.size());
+        palette.bounds.resize(palette.ranges.size());
+        palette.needsFullUpdate = true;
+    }
+
+    uint32_t updateSkinningPalette(const Scene& scene, SkinningPalette& palette)
+    {
+        const ECSRegistry& registry = scene.registry;
+
+        // Shared joints only get checked once, however many skins use them
+        for (size_t i = 0; i < palette.jointEntities.size(); ++i) {
+            const glm::mat4& global = registry.globalMatrices[palette.jointEntities[i]];
+            const bool isDirty = palette.needsFullUpdate || !isSameMatrix(global, palette.jointGlobals[i]);
+            palette.isJointDirty[i] = isDirty;
+            if (isDirty) {
+                palette.jointGlobals[i] = global;
+            }
+        }
+
+        uint32_t numDirtyRanges = 0;
+        for (size_t rangeIdx = 0; rangeIdx < palette.ranges.size(); ++rangeIdx) {
+            const SkinningPalette::Range& range = palette.ranges[rangeIdx];
+            const glm::mat4& modelGlobal = registry.globalMatrices[range.modelEntity];
+            bool isDirty = palette.needsFullUpdate || !isSameMatrix(modelGlobal, palette.modelGlobals[rangeIdx]);
+            for (uint32_t i = 0; i < range.numJoints && !isDirty; ++i) {
+                isDirty = palette.isJointDirty[palette.rangeJoints[range.offset + i]] != 0;
+            }
+            palette.isRangeDirty[rangeIdx] = isDirty;
+            if (!isDirty) {
+                continue;
+            }
+
+            palette.modelGlobals[rangeIdx] = modelGlobal;
+            const glm::mat4 invModel = glm::affineInverse(modelGlobal);
+            const Skin& skin = scene.skins[range.skinIdx];
+            const uint32_t* rangeJoints = &palette.rangeJoints[range.offset];
+            glm::mat4* matrices = &palette.matrices[range.offset];
+            for (uint32_t i = 0; i < range.numJoints; ++i) {
+                const glm::mat4 jointToModel = simd::mul(palette.jointGlobals[rangeJoints[i]], invModel);
+                matrices[i] = simd::mul(skin.inverseBindMatrices[i], jointToModel);
+            }
+            if (range.mode == SkinningMode::DualQuaternion) {
+                DualQuaternion* dualQuaternions = &palette.dualQuaternions[range.offset];
+                for (uint32_t i = 0; i < range.numJoints; ++i) {
+                    dualQuaternions[i] = math::toDualQuaternion(matrices[i]);
+                }
+            }
+            ++numDirtyRanges;
+        }
+
+        palette.needsFullUpdate = false;
+        palette.numDirtyRanges = numDirtyRanges;
+        return numDirtyRanges;
+    }
+
+    void updateSkinnedBounds(const Scene& scene, SkinningPalette& palette)
+    {
+        static_assert(sizeof(AABB) == 6 * sizeof(float), "Joint bounds are gathered as 6 packed floats");
+        using simd::FloatV;
+        constexpr uint32_t kLanes = simd::laneWidth;
+
+        alignas(32) int32_t matrixOffsets[kLanes];
+        alignas(32) int32_t boundsOffsets[kLanes];
+        for (uint32_t lane = 0; lane < kLanes; ++lane) {
+            matrixOffsets[lane] = int32_t(16 * lane);
+            boundsOffsets[lane] = int32_t(6 * lane);
+        }
+        const FloatV half = simd::set1(0.5f);
+
+        for (size_t rangeIdx = 0; rangeIdx < palette.ranges.size(); ++rangeIdx) {
+            if (!palette.isRangeDirty[rangeIdx]) {
+                continue;
+            }
+            const SkinningPalette::Range& range = palette.ranges[rangeIdx];
+            const Skin& skin = scene.skins[range.skinIdx];
+            if (skin.jointBounds.size() != range.numJoints) {
+                palette.bounds[rangeIdx] = AABB{ glm::vec3{ -FLT_MAX }, glm::vec3{ FLT_MAX } };
+                continue;
+            }
+
+            // Model space bounds, laneWidth joints at a time, with math::transformAABBRowVector
+            FloatV minimum[3] = { simd::set1(FLT_MAX), simd::set1(FLT_MAX), simd::set1(FLT_MAX) };
+            FloatV maximum[3] = { simd::set1(-FLT_MAX), simd::set1(-FLT_MAX), simd::set1(-FLT_MAX) };
+            const float* matrices = &palette.matrices[range.offset][0][0];
+            const float* jointBounds = &skin.jointBounds[0].min.x;
+            uint32_t joint = 0;
+            for (; joint + kLanes <= range.numJoints; joint += kLanes) {
+                const float* jointMatrices = matrices + 16 * joint;
+                FloatV center[3];
+                FloatV extents[3];
+                FloatV isValid = simd::cmpEq(simd::zero(), simd::zero());
+                for (uint32_t c = 0; c < 3; ++c) {
+                    const FloatV jointMin = simd::gather(jointBounds + 6 * joint + c, boundsOffsets);
+                    const FloatV jointMax = simd::gather(jointBounds + 6 * joint + 3 + c, boundsOffsets);
+                    center[c] = simd::mul(simd::add(jointMax, jointMin), half);
+                    extents[c] = simd::mul(simd::sub(jointMax, jointMin), half);
+                    isValid = simd::bitAnd(isValid, simd::cmpLe(jointMin, jointMax));
+                }
+
+                for (uint32_t c = 0; c < 3; ++c) {
+                    FloatV newCenter = simd::gather(jointMatrices + 4 * c + 3, matrixOffsets);
+                    FloatV newExtents = simd::zero();
+                    for (uint32_t r = 0; r < 3; ++r) {
+                        const FloatV element = simd::gather(jointMatrices + 4 * c + r, matrixOffsets);
+                        newCenter = simd::madd(center[r], element, newCenter);
+                        newExtents = simd::madd(extents[r], simd::abs(element), newExtents);
+                    }
+                    // Joints without any vertices leave the bounds untouched
+                    const FloatV newMin = simd::select(simd::set1(FLT_MAX), simd::sub(newCenter, newExtents), isValid);
+                    const FloatV newMax = simd::select(simd::set1(-FLT_MAX), simd::add(newCenter, newExtents), isValid);
+                    minimum[c] = simd::min(minimum[c], newMin);
+                    maximum[c] = simd::max(maximum[c], newMax);
+                }
+            }
+
+            AABB modelBounds{};
+            alignas(32) float lanes[2][kLanes];
+            for (uint32_t c = 0; c < 3; ++c) {
+                simd::store(lanes[0], minimum[c]);
+                simd::store(lanes[1], maximum[c]);
+                for (uint32_t lane = 0; lane < kLanes; ++lane) {
+                    modelBounds.min[c] = std::min(modelBounds.min[c], lanes[0][lane]);
+                    modelBounds.max[c] = std::max(modelBounds.max[c], lanes[1][lane]);
+                }
+            }
+            for (; joint < range.numJoints; ++joint) {
+                if (!math::isEmpty(skin.jointBounds[joint])) {
+                    math::expand(modelBounds, math::transformAABBRowVector(skin.jointBounds[joint], palette.matrices[range.offset + joint]));
+                }
+            }
+
+            palette.bounds[rangeIdx] = math::isEmpty(modelBounds)
+                ? modelBounds
+                : math::transformAABB(modelBounds, scene.registry.globalMatrices[range.modelEntity]);
+        }
+    }
+}
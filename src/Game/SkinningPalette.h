@@ -0,0 +1,91 @@
+#pragma once
+#include "pch.h"
+
+#include <vector>
+
+#include "Core/bdrMath.h"
+#include "Animation.h"
+
+namespace bdr
+{
+    class Scene;
+
+    // The joint matrices of every skinned entity of a scene, packed into one contiguous buffer so they can be
+    // computed in a single batch and uploaded with a single copy.
+    struct SkinningPalette
+    {
+        // A skinned entity's slice of the palette
+        struct Range
+        {
+            // Index into scene.skins. Skins with the same joints and inverse bind matrices all use the first one.
+            uint32_t skinIdx = UINT32_MAX;
+            // The skinned entity, whose global matrix is inverted into the joint matrices
+            uint32_t modelEntity = UINT32_MAX;
+            // Index of the range's first matrix
+            uint32_t offset = 0;
+            uint32_t numJoints = 0;
+            SkinningMode mode = SkinningMode::Linear;
+        };
+
+        // Every joint entity used by any skin, once. Skins sharing a skeleton share these entries.
+        std::vector<uint32_t> jointEntities;
+        // Global matrices of jointEntities as of the last update, to find the joints that moved
+        std::vector<glm::mat4> jointGlobals;
+        std::vector<uint8_t> isJointDirty;
+
+        std::vector<Range> ranges;
+        // Index into jointEntities of each palette matrix's joint, laid out like matrices
+        std::vector<uint32_t> rangeJoints;
+        // Global matrix of each range's model entity as of the last update
+        std::vector<glm::mat4> modelGlobals;
+        // Ranges recomputed by the last update, the only ones that need uploading
+        std::vector<uint8_t> isRangeDirty;
+        uint32_t numDirtyRanges = 0;
+        // Range of each entity, UINT32_MAX for entities that aren't skinned
+        std::vector<uint32_t> entityRanges;
+
+        // inverseBindMatrix * jointGlobal * invModel, for every joint of every range
+        std::vector<glm::mat4> matrices;
+        // The same joints as dual quaternions, laid out like matrices but only filled for dual quaternion ranges.
+        // Those ranges upload these instead of the matrices, at half the size.
+        std::vector<DualQuaternion> dualQuaternions;
+        // World space bounds of each range's skinned mesh, see updateSkinnedBounds
+        std::vector<AABB> bounds;
+
+        bool needsFullUpdate = true;
+    };
+
+    // Assigns a palette range to every entity with a SKIN component. Needs rebuilding whenever skins or
+    // skinned entities are added, not when they move.
+    void buildSkinningPalette(const Scene& scene, SkinningPalette& palette);
+
+    // Recomputes the ranges whose joints or model entity moved since the last update, expects global matrices
+    // to be up to date. Returns the number of ranges recomputed.
+    uint32_t updateSkinningPalette(const Scene& scene, SkinningPalette& palette);
+
+    // Conservative world bounds of the ranges recomputed by the last updateSkinningPalette: the union of each joint's
+    // bind space bounds, transformed by its joint matrix, then by the model entity's global matrix.
+    // Skins without joint bounds get infinite bounds.
+    void updateSkinnedBounds(const Scene& scene, SkinningPalette& palette);
+
+    inline const glm::mat4* getJointMatrices(const SkinningPalette& palette, const uint32_t entity)
+    {
+        const uint32_t rangeIdx = palette.entityRanges[entity];
+        return rangeIdx != UINT32_MAX ? &palette.matrices[palette.ranges[rangeIdx].offset] : nullptr;
+    }
+
+    inline const AABB* getSkinnedBounds(const SkinningPalette& palette, const uint32_t entity)
+    {
+        const uint32_t rangeIdx = palette.entityRanges[entity];
+        return rangeIdx != UINT32_MAX ? &palette.bounds[rangeIdx] : nullptr;
+    }
+
+    inline const DualQuaternion* getJointDualQuaternions(const SkinningPalette& palette, const uint32_t entity)
+    {
+        const uint32_t rangeIdx = palette.entityRanges[entity];
+        if (rangeIdx == UINT32_MAX || palette.ranges[rangeIdx].mode != SkinningMode::DualQuaternion) {
+            return nullptr;
+        }
+        return &palette.dualQuaternions[palette.ranges[rangeIdx].offset];
+    }
+}
@@ -0,0 +1,777 @@
+#include "pch.h"
+#include "SpatialIndex.h"
+
+#include "ECSRegistry.h"
+
+
+namespace bdr
+{
+    constexpr uint32_t kNumSAHBins = 16;
+    constexpr uint32_t kMaxStaticLeafSize = 4;
+    // Cost of traversing a node relative to testing an entity
+    constexpr float kTraversalCost = 1.0f;
+
+    inline bool isLeaf(const DynamicAABBTree::Node& node)
+    {
+        return node.children[0] == kInvalidNode;
+    }
+
+    inline AABB fatten(const AABB& bounds, const float margin)
+    {
+        return AABB{ bounds.min - glm::vec3{ margin }, bounds.max + glm::vec3{ margin } };
+    }
+
+    uint32_t allocateNode(DynamicAABBTree& tree)
+    {
+        uint32_t nodeIdx = tree.freeNodes;
+        if (nodeIdx != kInvalidNode) {
+            tree.freeNodes = tree.nodes[nodeIdx].parent;
+        }
+        else {
+            nodeIdx = uint32_t(tree.nodes.size());
+            tree.nodes.emplace_back();
+        }
+        tree.nodes[nodeIdx] = DynamicAABBTree::Node{};
+        tree.nodes[nodeIdx].height = 0;
+        return nodeIdx;
+    }
+
+    void freeNode(DynamicAABBTree& tree, const uint32_t nodeIdx)
+    {
+        DynamicAABBTree::Node& node = tree.nodes[nodeIdx];
+        node.parent = tree.freeNodes;
+        node.children[0] = kInvalidNode;
+        node.children[1] = kInvalidNode;
+        node.height = -1;
+        tree.freeNodes = nodeIdx;
+    }
+
+    inline void updateFromChildren(DynamicAABBTree& tree, const uint32_t nodeIdx)
+    {
+        DynamicAABBTree::Node& node = tree.nodes[nodeIdx];
+        const DynamicAABBTree::Node& child0 = tree.nodes[node.children[0]];
+        const DynamicAABBTree::Node& child1 = tree.nodes[node.children[1]];
+        node.bounds = math::getUnion(child0.bounds, child1.bounds);
+        node.height = 1 + std::max(child0.height, child1.height);
+    }
+
+    // Points the parent of oldChild (or the root) at newChild
+    inline void replaceChild(DynamicAABBTree& tree, const uint32_t parentIdx, const uint32_t oldChild, const uint32_t newChild)
+    {
+        if (parentIdx == kInvalidNode) {
+            tree.root = newChild;
+            return;
+        }
+        DynamicAABBTree::Node& parent = tree.nodes[parentIdx];
+        parent.children[parent.children[0] == oldChild ? 0 : 1] = newChild;
+    }
+
+    // If one child of node A is two levels taller than the other, rotates the taller child up into A's place:
+    // A(B, C(F, G)) -> C(A(B, F), G),
+    // keeping the taller of C's children (G here) at C, and returns the new subtree root.
+    uint32_t rotate(DynamicAABBTree& tree, const uint32_t aIdx)
+    {
+        DynamicAABBTree::Node& a = tree.nodes[aIdx];
+        if (isLeaf(a) || a.height < 2) {
+            return aIdx;
+        }
+
+        const int32_t balance = tree.nodes[a.children[1]].height - tree.nodes[a.children[0]].height;
+        if (balance >= -1 && balance <= 1) {
+            return aIdx;
+        }
+
+        // Side of A holding the taller child C, which gets rotated up
+        const uint32_t tallSide = balance > 1 ? 1 : 0;
+        const uint32_t cIdx = a.children[tallSide];
+        DynamicAABBTree::Node& c = tree.nodes[cIdx];
+        const uint32_t fIdx = c.children[0];
+        const uint32_t gIdx = c.children[1];
+        // C keeps its taller child and hands the other to A
+        const bool keepF = tree.nodes[fIdx].height > tree.nodes[gIdx].height;
+        const uint32_t keptIdx = keepF ? fIdx : gIdx;
+        const uint32_t movedIdx = keepF ? gIdx : fIdx;
+
+        c.parent = a.parent;
+        replaceChild(tree, c.parent, aIdx, cIdx);
+        c.children[0] = aIdx;
+        c.children[1] = keptIdx;
+        a.parent = cIdx;
+        a.children[tallSide] = movedIdx;
+        tree.nodes[movedIdx].parent = aIdx;
+
+        updateFromChildren(tree, aIdx);
+        updateFromChildren(tree, cIdx);
+        return cIdx;
+    }
+
+    // Refits and rebalances every node from nodeIdx up to the root
+    void refitAncestors(DynamicAABBTree& tree, uint32_t nodeIdx)
+    {
+        while (nodeIdx != kInvalidNode) {
+            nodeIdx = rotate(tree, nodeIdx);
+            updateFromChildren(tree, nodeIdx);
+            nodeIdx = tree.nodes[nodeIdx].parent;
+        }
+    }
+
+    void insertLeaf(DynamicAABBTree& tree, const uint32_t leafIdx)
+    {
+        if (tree.root == kInvalidNode) {
+            tree.root = leafIdx;
+            tree.nodes[leafIdx].parent = kInvalidNode;
+            return;
+        }
+
+        // Find the best sibling by descending towards the child that grows the tree's surface area the least,
+        // stopping once making a new parent here is cheaper than going down either side
+        const AABB leafBounds = tree.nodes[leafIdx].bounds;
+        uint32_t siblingIdx = tree.root;
+        while (!isLeaf(tree.nodes[siblingIdx])) {
+            const DynamicAABBTree::Node& node = tree.nodes[siblingIdx];
+            const float area = math::getSurfaceArea(node.bounds);
+            const float combinedArea = math::getSurfaceArea(math::getUnion(node.bounds, leafBounds));
+            const float cost = 2.0f * combinedArea;
+            // Cost pushed onto every ancestor below this one if the leaf goes further down
+            const float inheritedCost = 2.0f * (combinedArea - area);
+
+            float childCosts[2];
+            for (uint32_t i = 0; i < 2; ++i) {
+                const DynamicAABBTree::Node& child = tree.nodes[node.children[i]];
+                const float unionArea = math::getSurfaceArea(math::getUnion(child.bounds, leafBounds));
+                childCosts[i] = inheritedCost + (isLeaf(child) ? unionArea : unionArea - math::getSurfaceArea(child.bounds));
+            }
+            if (cost < childCosts[0] && cost < childCosts[1]) {
+                break;
+            }
+            siblingIdx = node.children[childCosts[0] < childCosts[1] ? 0 : 1];
+        }
+
+        const uint32_t oldParentIdx = tree.nodes[siblingIdx].parent;
+        const uint32_t newParentIdx = allocateNode(tree);
+        DynamicAABBTree::Node& newParent = tree.nodes[newParentIdx];
+        newParent.parent = oldParentIdx;
+        newParent.children[0] = siblingIdx;
+        newParent.children[1] = leafIdx;
+        replaceChild(tree, oldParentIdx, siblingIdx, newParentIdx);
+        tree.nodes[siblingIdx].parent = newParentIdx;
+        tree.nodes[leafIdx].parent = newParentIdx;
+
+        refitAncestors(tree, newParentIdx);
+    }
+
+    void removeLeaf(DynamicAABBTree& tree, const uint32_t leafIdx)
+    {
+        if (leafIdx == tree.root) {
+            tree.root = kInvalidNode;
+            return;
+        }
+
+        const uint32_t parentIdx = tree.nodes[leafIdx].parent;
+        const DynamicAABBTree::Node& parent = tree.nodes[parentIdx];
+        const uint32_t grandParentIdx = parent.parent;
+        const uint32_t siblingIdx = parent.children[parent.children[0] == leafIdx ? 1 : 0];
+
+        replaceChild(tree, grandParentIdx, parentIdx, siblingIdx);
+        tree.nodes[siblingIdx].parent = grandParentIdx;
+        freeNode(tree, parentIdx);
+        refitAncestors(tree, grandParentIdx);
+    }
+
+    void insert(DynamicAABBTree& tree, const uint32_t entity, const AABB& bounds)
+    {
+        if (entity >= tree.entityLeaves.size()) {
+            tree.entityLeaves.resize(entity + 1, kInvalidNode);
+            tree.entityBounds.resize(entity + 1);
+        }
+        ASSERT(tree.entityLeaves[entity] == kInvalidNode, "Entity is already in the tree");
+
+        const uint32_t leafIdx = allocateNode(tree);
+        tree.nodes[leafIdx].bounds = fatten(bounds, tree.margin);
+        tree.nodes[leafIdx].entity = entity;
+        tree.entityLeaves[entity] = leafIdx;
+        tree.entityBounds[entity] = bounds;
+        ++tree.numLeaves;
+        insertLeaf(tree, leafIdx);
+    }
+
+    void remove(DynamicAABBTree& tree, const uint32_t entity)
+    {
+        const uint32_t leafIdx = tree.entityLeaves[entity];
+        ASSERT(leafIdx != kInvalidNode, "Entity isn't in the tree");
+        removeLeaf(tree, leafIdx);
+        freeNode(tree, leafIdx);
+        tree.entityLeaves[entity] = kInvalidNode;
+        --tree.numLeaves;
+    }
+
+    bool move(DynamicAABBTree& tree, const uint32_t entity, const AABB& bounds)
+    {
+        const uint32_t leafIdx = tree.entityLeaves[entity];
+        ASSERT(leafIdx != kInvalidNode, "Entity isn't in the tree");
+        tree.entityBounds[entity] = bounds;
+        DynamicAABBTree::Node& leaf = tree.nodes[leafIdx];
+        if (math::contains(leaf.bounds, bounds)) {
+            return false;
+        }
+
+        const bool isNearby = math::overlaps(leaf.bounds, bounds);
+        leaf.bounds = fatten(bounds, tree.margin);
+        if (isNearby) {
+            refitAncestors(tree, leaf.parent);
+        }
+        else {
+            removeLeaf(tree, leafIdx);
+            insertLeaf(tree, leafIdx);
+        }
+        return true;
+    }
+
+    float getCost(const DynamicAABBTree& tree)
+    {
+        if (tree.root == kInvalidNode) {
+            return 0.0f;
+        }
+        float cost = 0.0f;
+        for (const DynamicAABBTree::Node& node : tree.nodes) {
+            if (node.height > 0) {
+                cost += math::getSurfaceArea(node.bounds);
+            }
+        }
+        const float rootArea = math::getSurfaceArea(tree.nodes[tree.root].bounds);
+        return rootArea > 0.0f ? cost / rootArea : 0.0f;
+    }
+
+    void beginStaticBVHBuild(StaticBVHBuild& build, std::vector<uint32_t>&& entities, std::vector<AABB>&& bounds)
+    {
+        ASSERT(entities.size() == bounds.size(), "Expected one bounds per entity");
+        StaticBVH& bvh = build.bvh;
+        bvh.nodes.clear();
+        bvh.entities = std::move(entities);
+        bvh.bounds = std::move(bounds);
+        build.centroids.resize(bvh.bounds.size());
+        build.pendingNodes.clear();
+        build.isBuilding = true;
+        if (bvh.entities.empty()) {
+            return;
+        }
+
+        bvh.nodes.reserve(2 * bvh.entities.size() / kMaxStaticLeafSize + 1);
+        StaticBVH::Node root{};
+        root.first = 0;
+        root.count = uint32_t(bvh.entities.size());
+        for (size_t i = 0; i < bvh.bounds.size(); ++i) {
+            math::expand(root.bounds, bvh.bounds[i]);
+            build.centroids[i] = math::getCenter(bvh.bounds[i]);
+        }
+        bvh.nodes.push_back(root);
+        build.pendingNodes.push_back(0);
+    }
+
+    // Splits the leaf at the best binned SAH plane across all three axes, or leaves it alone if that's cheaper
+    void splitNode(StaticBVHBuild& build, const uint32_t nodeIdx)
+    {
+        StaticBVH& bvh = build.bvh;
+        const uint32_t first = bvh.nodes[nodeIdx].first;
+        const uint32_t count = bvh.nodes[nodeIdx].count;
+        if (count <= 1) {
+            return;
+        }
+
+        AABB centroidBounds{};
+        for (uint32_t i = first; i < first + count; ++i) {
+            math::expand(centroidBounds, build.centroids[i]);
+        }
+
+        struct Bin
+        {
+            AABB bounds;
+            uint32_t count = 0;
+        };
+        float bestCost = FLT_MAX;
+        uint32_t bestAxis = 0;
+        uint32_t bestSplit = 0;
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            const float axisMin = centroidBounds.min[axis];
+            const float axisExtent = centroidBounds.max[axis] - axisMin;
+            if (axisExtent <= 0.0f) {
+                continue;
+            }
+            const float binScale = float(kNumSAHBins) / axisExtent;
+
+            Bin bins[kNumSAHBins];
+            for (uint32_t i = first; i < first + count; ++i) {
+                const uint32_t binIdx = std::min(uint32_t((build.centroids[i][axis] - axisMin) * binScale), kNumSAHBins - 1);
+                math::expand(bins[binIdx].bounds, bvh.bounds[i]);
+                ++bins[binIdx].count;
+            }
+
+            // Sweep from the right to get the cost of every right side, then from the left to combine them
+            float rightAreas[kNumSAHBins];
+            uint32_t rightCounts[kNumSAHBins];
+            AABB rightBounds{};
+            uint32_t rightCount = 0;
+            for (uint32_t split = kNumSAHBins - 1; split > 0; --split) {
+                math::expand(rightBounds, bins[split].bounds);
+                rightCount += bins[split].count;
+                rightAreas[split] = rightCount > 0 ? math::getSurfaceArea(rightBounds) : 0.0f;
+                rightCounts[split] = rightCount;
+            }
+            AABB leftBounds{};
+            uint32_t leftCount = 0;
+            for (uint32_t split = 1; split < kNumSAHBins; ++split) {
+                math::expand(leftBounds, bins[split - 1].bounds);
+                leftCount += bins[split - 1].count;
+                if (leftCount == 0 || rightCounts[split] == 0) {
+                    continue;
+                }
+                const float cost = leftCount * math::getSurfaceArea(leftBounds) + rightCounts[split] * rightAreas[split];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        const float nodeArea = math::getSurfaceArea(bvh.nodes[nodeIdx].bounds);
+        const float leafCost = float(count);
+        const float splitCost = kTraversalCost + (nodeArea > 0.0f ? bestCost / nodeArea : 0.0f);
+        uint32_t middle = first;
+        if (bestCost < FLT_MAX && (splitCost < leafCost || count > kMaxStaticLeafSize)) {
+            const float axisMin = centroidBounds.min[bestAxis];
+            const float binScale = float(kNumSAHBins) / (centroidBounds.max[bestAxis] - axisMin);
+            uint32_t end = first + count;
+            middle = first;
+            while (middle < end) {
+                const uint32_t binIdx = std::min(uint32_t((build.centroids[middle][bestAxis] - axisMin) * binScale), kNumSAHBins - 1);
+                if (binIdx < bestSplit) {
+                    ++middle;
+                    continue;
+                }
+                --end;
+                std::swap(bvh.entities[middle], bvh.entities[end]);
+                std::swap(bvh.bounds[middle], bvh.bounds[end]);
+                std::swap(build.centroids[middle], build.centroids[end]);
+            }
+        }
+        else if (count > kMaxStaticLeafSize) {
+            // Every centroid is in the same spot, split down the middle so leaves stay small
+            middle = first + count / 2;
+        }
+        else {
+            return;
+        }
+
+        const uint32_t childIdx = uint32_t(bvh.nodes.size());
+        StaticBVH::Node children[2];
+        children[0].first = first;
+        children[0].count = middle - first;
+        children[1].first = middle;
+        children[1].count = first + count - middle;
+        for (StaticBVH::Node& child : children) {
+            for (uint32_t i = child.first; i < child.first + child.count; ++i) {
+                math::expand(child.bounds, bvh.bounds[i]);
+            }
+            bvh.nodes.push_back(child);
+        }
+        bvh.nodes[nodeIdx].first = childIdx;
+        bvh.nodes[nodeIdx].count = 0;
+        build.pendingNodes.push_back(childIdx);
+        build.pendingNodes.push_back(childIdx + 1);
+    }
+
+    bool stepStaticBVHBuild(StaticBVHBuild& build, const uint32_t maxSplits)
+    {
+        for (uint32_t i = 0; i < maxSplits && !build.pendingNodes.empty(); ++i) {
+            const uint32_t nodeIdx = build.pendingNodes.back();
+            build.pendingNodes.pop_back();
+            splitNode(build, nodeIdx);
+        }
+        build.isBuilding = !build.pendingNodes.empty();
+        return !build.isBuilding;
+    }
+
+    void buildStaticBVH(StaticBVH& bvh, std::vector<uint32_t>&& entities, std::vector<AABB>&& bounds)
+    {
+        StaticBVHBuild build{};
+        beginStaticBVHBuild(build, std::move(entities), std::move(bounds));
+        stepStaticBVHBuild(build, UINT32_MAX);
+        bvh = std::move(build.bvh);
+    }
+
+    void updateStaticEntities(const ECSRegistry& registry, SpatialIndex& index)
+    {
+        bool isMembershipChanged = false;
+        size_t numStatic = 0;
+        for (uint32_t entity = 0; entity < registry.numEntities; ++entity) {
+            const uint32_t cmpMask = registry.cmpMasks[entity];
+            if ((cmpMask & CmpMasks::BOUNDS) == 0 || (cmpMask & CmpMasks::STATIC) == 0) {
+                continue;
+            }
+            const AABB& bounds = registry.worldBounds[entity];
+            if (numStatic == index.staticEntities.size()) {
+                index.staticEntities.push_back(entity);
+                index.staticBounds.push_back(bounds);
+                isMembershipChanged = true;
+            }
+            else if (index.staticEntities[numStatic] != entity) {
+                index.staticEntities[numStatic] = entity;
+                index.staticBounds[numStatic] = bounds;
+                isMembershipChanged = true;
+            }
+            else if (memcmp(&index.staticBounds[numStatic], &bounds, sizeof(AABB)) != 0) {
+                index.staticBounds[numStatic] = bounds;
+                index.isStaticDirty = true;
+            }
+            ++numStatic;
+        }
+        if (numStatic != index.staticEntities.size()) {
+            index.staticEntities.resize(numStatic);
+            index.staticBounds.resize(numStatic);
+            isMembershipChanged = true;
+        }
+
+        // Entities becoming static or dynamic would go missing from queries until a time sliced build finishes,
+        // so those rebuild straight away. Static entities that were moved anyway can wait.
+        if (isMembershipChanged) {
+            index.staticBuild = StaticBVHBuild{};
+            buildStaticBVH(index.staticBVH, std::vector<uint32_t>(index.staticEntities), std::vector<AABB>(index.staticBounds));
+            index.isStaticDirty = false;
+            return;
+        }
+
+        if (index.isStaticDirty && !index.staticBuild.isBuilding) {
+            beginStaticBVHBuild(index.staticBuild, std::vector<uint32_t>(index.staticEntities), std::vector<AABB>(index.staticBounds));
+            index.isStaticDirty = false;
+        }
+        if (index.staticBuild.isBuilding && stepStaticBVHBuild(index.staticBuild, kStaticBVHSplitsPerUpdate)) {
+            index.staticBVH = std::move(index.staticBuild.bvh);
+            index.staticBuild = StaticBVHBuild{};
+        }
+    }
+
+    void updateDynamicEntities(const ECSRegistry& registry, SpatialIndex& index)
+    {
+        DynamicAABBTree& tree = index.dynamicTree;
+        for (uint32_t entity = 0; entity < registry.numEntities; ++entity) {
+            const uint32_t cmpMask = registry.cmpMasks[entity];
+            const bool isDynamic = (cmpMask & CmpMasks::BOUNDS) && (cmpMask & CmpMasks::STATIC) == 0;
+            const bool isInTree = entity < tree.entityLeaves.size() && tree.entityLeaves[entity] != kInvalidNode;
+            if (isDynamic && isInTree) {
+                move(tree, entity, registry.worldBounds[entity]);
+            }
+            else if (isDynamic) {
+                insert(tree, entity, registry.worldBounds[entity]);
+            }
+            else if (isInTree) {
+                remove(tree, entity);
+            }
+        }
+        for (uint32_t entity = registry.numEntities; entity < tree.entityLeaves.size(); ++entity) {
+            if (tree.entityLeaves[entity] != kInvalidNode) {
+                remove(tree, entity);
+            }
+        }
+
+        // Reinserting every leaf, a slice per update, once the rotations alone stop keeping the cost down
+        if (index.reinsertCursor == UINT32_MAX) {
+            const float cost = getCost(tree);
+            if (index.dynamicBaseCost == 0.0f) {
+                index.dynamicBaseCost = cost;
+            }
+            else if (cost > kDynamicRebuildCostRatio * index.dynamicBaseCost) {
+                index.reinsertCursor = 0;
+            }
+        }
+        if (index.reinsertCursor != UINT32_MAX) {
+            uint32_t numReinserted = 0;
+            uint32_t& cursor = index.reinsertCursor;
+            for (; cursor < tree.entityLeaves.size() && numReinserted < kDynamicReinsertsPerUpdate; ++cursor) {
+                const uint32_t leafIdx = tree.entityLeaves[cursor];
+                if (leafIdx != kInvalidNode) {
+                    removeLeaf(tree, leafIdx);
+                    insertLeaf(tree, leafIdx);
+                    ++numReinserted;
+                }
+            }
+            if (cursor == tree.entityLeaves.size()) {
+                cursor = UINT32_MAX;
+                index.dynamicBaseCost = getCost(tree);
+            }
+        }
+    }
+
+    void updateSpatialIndex(const ECSRegistry& registry, SpatialIndex& index)
+    {
+        updateStaticEntities(registry, index);
+        updateDynamicEntities(registry, index);
+    }
+
+    constexpr uint32_t kAllPlanes = (1u << 6) - 1u;
+
+    // Tests the box against the planes in planeMask, clearing the planes it's entirely inside of so children can
+    // skip them. Returns false if the box is outside any of them.
+    inline bool testPlanes(const math::Frustum& frustum, const AABB& bounds, uint32_t& planeMask)
+    {
+        const glm::vec3 center = math::getCenter(bounds);
+        const glm::vec3 extents = math::getExtents(bounds);
+        for (uint32_t p = 0; p < 6; ++p) {
+            if ((planeMask & (1u << p)) == 0) {
+                continue;
+            }
+            const glm::vec4& plane = frustum.planes[p];
+            const glm::vec3 normal{ plane };
+            const float distance = glm::dot(normal, center) + plane.w;
+            const float radius = glm::dot(glm::abs(normal), extents);
+            if (distance < -radius) {
+                return false;
+            }
+            if (distance >= radius) {
+                planeMask &= ~(1u << p);
+            }
+        }
+        return true;
+    }
+
+    // Traversal stack that only touches the heap for unusually deep trees
+    template<typename T>
+    struct TraversalStack
+    {
+        T entries[64];
+        uint32_t size = 0;
+        std::vector<T> overflow;
+
+        inline void push(const T& entry)
+        {
+            if (size < _countof(entries)) {
+                entries[size++] = entry;
+            }
+            else {
+                overflow.push_back(entry);
+            }
+        }
+
+        inline bool isEmpty() const
+        {
+            return size == 0 && overflow.empty();
+        }
+
+        inline T pop()
+        {
+            if (!overflow.empty()) {
+                const T entry = overflow.back();
+                overflow.pop_back();
+                return entry;
+            }
+            return entries[--size];
+        }
+    };
+
+    struct FrustumEntry
+    {
+        uint32_t nodeIdx;
+        // Planes the node isn't known to be inside of yet
+        uint32_t planeMask;
+    };
+
+    // Visits the tree depth first, descending into nodes where visitNode returns true and calling visitLeaf on the
+    // leaves it reaches
+    template<typename NodeVisitor, typename LeafVisitor>
+    void traverse(const DynamicAABBTree& tree, NodeVisitor&& visitNode, LeafVisitor&& visitLeaf)
+    {
+        if (tree.root == kInvalidNode) {
+            return;
+        }
+        TraversalStack<uint32_t> stack;
+        stack.push(tree.root);
+        while (!stack.isEmpty()) {
+            const uint32_t nodeIdx = stack.pop();
+            const DynamicAABBTree::Node& node = tree.nodes[nodeIdx];
+            if (!visitNode(nodeIdx, node.bounds)) {
+                continue;
+            }
+            if (isLeaf(node)) {
+                visitLeaf(node.entity);
+                continue;
+            }
+            stack.push(node.children[1]);
+            stack.push(node.children[0]);
+        }
+    }
+
+    // Same as above, but visitLeaf gets indices into the BVH's entities and bounds
+    template<typename NodeVisitor, typename LeafVisitor>
+    void traverse(const StaticBVH& bvh, NodeVisitor&& visitNode, LeafVisitor&& visitLeaf)
+    {
+        if (bvh.nodes.empty()) {
+            return;
+        }
+        TraversalStack<uint32_t> stack;
+        stack.push(0);
+        while (!stack.isEmpty()) {
+            const uint32_t nodeIdx = stack.pop();
+            const StaticBVH::Node& node = bvh.nodes[nodeIdx];
+            if (!visitNode(nodeIdx, node.bounds)) {
+                continue;
+            }
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    visitLeaf(i);
+                }
+                continue;
+            }
+            stack.push(node.first + 1);
+            stack.push(node.first);
+        }
+    }
+
+    // Children partition their parent's entities, so every subtree covers a contiguous range of them
+    inline void getEntityRange(const StaticBVH& bvh, const uint32_t nodeIdx, uint32_t& begin, uint32_t& end)
+    {
+        const StaticBVH::Node* node = &bvh.nodes[nodeIdx];
+        while (node->count == 0) {
+            node = &bvh.nodes[node->first];
+        }
+        begin = node->first;
+        node = &bvh.nodes[nodeIdx];
+        while (node->count == 0) {
+            node = &bvh.nodes[node->first + 1];
+        }
+        end = node->first + node->count;
+    }
+
+    void queryFrustum(const SpatialIndex& index, const math::Frustum& frustum, std::vector<uint32_t>& results)
+    {
+        // Nodes entirely inside the frustum take all of their entities without testing them
+        TraversalStack<FrustumEntry> stack;
+        const DynamicAABBTree& tree = index.dynamicTree;
+        if (tree.root != kInvalidNode) {
+            stack.push({ tree.root, kAllPlanes });
+        }
+        while (!stack.isEmpty()) {
+            FrustumEntry entry = stack.pop();
+            const DynamicAABBTree::Node& node = tree.nodes[entry.nodeIdx];
+            if (!testPlanes(frustum, node.bounds, entry.planeMask)) {
+                continue;
+            }
+            if (isLeaf(node)) {
+                // Leaves are fattened, so the entity's own bounds get the final say
+                if (entry.planeMask == 0 || testPlanes(frustum, tree.entityBounds[node.entity], entry.planeMask)) {
+                    results.push_back(node.entity);
+                }
+            }
+            else if (entry.planeMask == 0) {
+                const uint32_t subtreeRoot = entry.nodeIdx;
+                TraversalStack<uint32_t> subtree;
+                subtree.push(subtreeRoot);
+                while (!subtree.isEmpty()) {
+                    const DynamicAABBTree::Node& child = tree.nodes[subtree.pop()];
+                    if (isLeaf(child)) {
+                        results.push_back(child.entity);
+                    }
+                    else {
+                        subtree.push(child.children[1]);
+                        subtree.push(child.children[0]);
+                    }
+                }
+            }
+            else {
+                stack.push({ node.children[1], entry.planeMask });
+                stack.push({ node.children[0], entry.planeMask });
+            }
+        }
+
+        const StaticBVH& bvh = index.staticBVH;
+        if (!bvh.nodes.empty()) {
+            stack.push({ 0, kAllPlanes });
+        }
+        while (!stack.isEmpty()) {
+            FrustumEntry entry = stack.pop();
+            const StaticBVH::Node& node = bvh.nodes[entry.nodeIdx];
+            if (!testPlanes(frustum, node.bounds, entry.planeMask)) {
+                continue;
+            }
+            if (entry.planeMask == 0) {
+                uint32_t begin, end;
+                getEntityRange(bvh, entry.nodeIdx, begin, end);
+                results.insert(results.end(), bvh.entities.begin() + begin, bvh.entities.begin() + end);
+            }
+            else if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    uint32_t planeMask = entry.planeMask;
+                    if (testPlanes(frustum, bvh.bounds[i], planeMask)) {
+                        results.push_back(bvh.entities[i]);
+                    }
+                }
+            }
+            else {
+                stack.push({ node.first + 1, entry.planeMask });
+                stack.push({ node.first, entry.planeMask });
+            }
+        }
+    }
+
+    void queryOverlap(const SpatialIndex& index, const AABB& bounds, std::vector<uint32_t>& results)
+    {
+        const DynamicAABBTree& tree = index.dynamicTree;
+        traverse(
+            tree,
+            [&](uint32_t, const AABB& nodeBounds) { return math::overlaps(nodeBounds, bounds); },
+            [&](const uint32_t entity) {
+                if (math::overlaps(tree.entityBounds[entity], bounds)) {
+                    results.push_back(entity);
+                }
+            }
+        );
+
+        const StaticBVH& bvh = index.staticBVH;
+        traverse(
+            bvh,
+            [&](uint32_t, const AABB& nodeBounds) { return math::overlaps(nodeBounds, bounds); },
+            [&](const uint32_t i) {
+                if (math::overlaps(bvh.bounds[i], bounds)) {
+                    results.push_back(bvh.entities[i]);
+                }
+            }
+        );
+    }
+
+    // Distance along the ray to where it enters the box, FLT_MAX if it misses or only hits past maxDistance
+    inline float intersect(const glm::vec3& origin, const glm::vec3& invDirection, const float maxDistance, const AABB& bounds)
+    {
+        const glm::vec3 t0 = (bounds.min - origin) * invDirection;
+        const glm::vec3 t1 = (bounds.max - origin) * invDirection;
+        const glm::vec3 tNear = glm::min(t0, t1);
+        const glm::vec3 tFar = glm::max(t0, t1);
+        const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        return enter <= exit ? enter : FLT_MAX;
+    }
+
+    void raycast(const SpatialIndex& index, const Ray* rays, const uint32_t numRays, RayHit* hits)
+    {
+        const DynamicAABBTree& tree = index.dynamicTree;
+        const StaticBVH& bvh = index.staticBVH;
+        for (uint32_t rayIdx = 0; rayIdx < numRays; ++rayIdx) {
+            const Ray& ray = rays[rayIdx];
+            const glm::vec3 invDirection = 1.0f / ray.direction;
+            RayHit& hit = hits[rayIdx];
+            hit = RayHit{};
+
+            // Anything entered past the closest hit so far can't be closer
+            const auto visitNode = [&](uint32_t, const AABB& bounds) {
+                return intersect(ray.origin, invDirection, std::min(ray.maxDistance, hit.distance), bounds) < FLT_MAX;
+            };
+            const auto testEntity = [&](const uint32_t entity, const AABB& bounds) {
+                const float distance = intersect(ray.origin, invDirection, std::min(ray.maxDistance, hit.distance), bounds);
+                if (distance < hit.distance) {
+                    hit.entity = entity;
+                    hit.distance = distance;
+                }
+            };
+            traverse(tree, visitNode, [&](const uint32_t entity) { testEntity(entity, tree.entityBounds[entity]); });
+            traverse(bvh, visitNode, [&](const uint32_t i) { testEntity(bvh.entities[i], bvh.bounds[i]); });
+        }
+    }
+}
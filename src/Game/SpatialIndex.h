@@ -0,0 +1,144 @@
+#pragma once
+#include "pch.h"
+
+#include <vector>
+
+#include "Core/bdrMath.h"
+
+namespace bdr
+{
+    class ECSRegistry;
+
+    constexpr uint32_t kInvalidNode = UINT32_MAX;
+
+    // Incrementally updated AABB tree for entities that move. Leaves store fattened bounds, so small movements
+    // don't touch the tree, and AVL style rotations on every modified path keep it from degenerating.
+    struct DynamicAABBTree
+    {
+        struct Node
+        {
+            // Fattened by the tree's margin for leaves
+            AABB bounds;
+            uint32_t parent = kInvalidNode;
+            uint32_t children[2] = { kInvalidNode, kInvalidNode };
+            // Only set for leaves
+            uint32_t entity = UINT32_MAX;
+            // Zero for leaves, -1 for nodes on the free list
+            int32_t height = -1;
+        };
+
+        std::vector<Node> nodes;
+        uint32_t root = kInvalidNode;
+        // Free nodes are chained through their parent index
+        uint32_t freeNodes = kInvalidNode;
+        uint32_t numLeaves = 0;
+        // Leaf of each entity, kInvalidNode for entities that aren't in the tree
+        std::vector<uint32_t> entityLeaves;
+        // Unfattened bounds of each entity, what queries test leaves against
+        std::vector<AABB> entityBounds;
+        // How much leaf bounds are grown by, in world units
+        float margin = 0.1f;
+    };
+
+    void insert(DynamicAABBTree& tree, const uint32_t entity, const AABB& bounds);
+
+    void remove(DynamicAABBTree& tree, const uint32_t entity);
+
+    // Bounds still inside the leaf's fattened bounds are ignored. Otherwise, bounds that still overlap the old leaf
+    // get refit in place, and anything further away gets reinserted. Returns true if the tree changed.
+    bool move(DynamicAABBTree& tree, const uint32_t entity, const AABB& bounds);
+
+    // Sum of the surface areas of the internal nodes, relative to the root's. Lower is better.
+    float getCost(const DynamicAABBTree& tree);
+
+    // Static BVH built top down with binned SAH, for entities whose bounds never change. Child pairs are stored
+    // next to each other and leaves reference ranges of entities.
+    struct StaticBVH
+    {
+        struct Node
+        {
+            AABB bounds;
+            // Index of the first child for internal nodes, or of the first entity for leaves
+            uint32_t first = 0;
+            // Zero for internal nodes
+            uint32_t count = 0;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> entities;
+        // Bounds of each entity, in the same order
+        std::vector<AABB> bounds;
+    };
+
+    // A StaticBVH build that can be spread over several frames
+    struct StaticBVHBuild
+    {
+        StaticBVH bvh;
+        // Centroids of bvh.bounds, reordered along with them
+        std::vector<glm::vec3> centroids;
+        // Leaves that still need splitting
+        std::vector<uint32_t> pendingNodes;
+        bool isBuilding = false;
+    };
+
+    void beginStaticBVHBuild(StaticBVHBuild& build, std::vector<uint32_t>&& entities, std::vector<AABB>&& bounds);
+
+    // Splits up to maxSplits nodes, returns true once the build is done
+    bool stepStaticBVHBuild(StaticBVHBuild& build, const uint32_t maxSplits);
+
+    // Builds the whole BVH at once
+    void buildStaticBVH(StaticBVH& bvh, std::vector<uint32_t>&& entities, std::vector<AABB>&& bounds);
+
+    // Splits per update for the time sliced static rebuild, and leaves reinserted per update when the dynamic tree
+    // has degraded
+    constexpr uint32_t kStaticBVHSplitsPerUpdate = 256;
+    constexpr uint32_t kDynamicReinsertsPerUpdate = 256;
+    // The dynamic tree gets an incremental rebuild once its cost grows this much past the cost after the last one
+    constexpr float kDynamicRebuildCostRatio = 1.5f;
+
+    // Every entity with a BOUNDS component, indexed by their world bounds. Entities tagged STATIC go in the static
+    // BVH, everything else in the dynamic tree.
+    struct SpatialIndex
+    {
+        DynamicAABBTree dynamicTree;
+        StaticBVH staticBVH;
+
+        // Static entities and their bounds as of the last update, any change triggers a rebuild
+        std::vector<uint32_t> staticEntities;
+        std::vector<AABB> staticBounds;
+        // Rebuild in progress, swapped into staticBVH once done. Queries use the old BVH until then.
+        StaticBVHBuild staticBuild;
+        bool isStaticDirty = false;
+
+        // Cost of the dynamic tree after its last rebuild, and the next leaf to reinsert during a rebuild
+        float dynamicBaseCost = 0.0f;
+        uint32_t reinsertCursor = UINT32_MAX;
+    };
+
+    // Syncs the index with the registry's world bounds, expects updateMatrices to have run. Also advances any
+    // rebuilds in progress by one slice.
+    void updateSpatialIndex(const ECSRegistry& registry, SpatialIndex& index);
+
+    struct Ray
+    {
+        glm::vec3 origin{ 0.0f };
+        glm::vec3 direction{ 0.0f, 0.0f, 1.0f };
+        float maxDistance = FLT_MAX;
+    };
+
+    struct RayHit
+    {
+        // UINT32_MAX when nothing was hit
+        uint32_t entity = UINT32_MAX;
+        float distance = FLT_MAX;
+    };
+
+    // Queries append the entities they find to results
+    void queryFrustum(const SpatialIndex& index, const math::Frustum& frustum, std::vector<uint32_t>& results);
+
+    void queryOverlap(const SpatialIndex& index, const AABB& bounds, std::vector<uint32_t>& results);
+
+    // Finds the nearest entity bounds hit by each ray, for picking. Callers wanting exact hits can refine them
+    // against the entity's mesh.
+    void raycast(const SpatialIndex& index, const Ray* rays, const uint32_t numRays, RayHit* hits);
+}
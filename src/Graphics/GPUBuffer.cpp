@@ -44,6 +44,10 @@ namespace bdr
             return DXGI_FORMAT_R16G16B16A16_UNORM;
         case BufferFormat::FLOAT_4:
             return DXGI_FORMAT_R32G32B32A32_FLOAT;
+        case BufferFormat::SNORM16_2:
+            return DXGI_FORMAT_R16G16_SNORM;
+        case BufferFormat::FLOAT16_2:
+            return DXGI_FORMAT_R16G16_FLOAT;
         case BufferFormat::STRUCTURED:
             return DXGI_FORMAT_UNKNOWN;
 
@@ -60,6 +64,8 @@ namespace bdr
             return 2u;
         case BufferFormat::UINT32:
         case BufferFormat::UNORM16_2:
+        case BufferFormat::SNORM16_2:
+        case BufferFormat::FLOAT16_2:
         case BufferFormat::UINT8_4:
         case BufferFormat::UNORM8_4:
             return 4u;
@@ -86,6 +92,8 @@ namespace bdr
             return 2u;
         case BufferFormat::UINT32:
         case BufferFormat::UNORM16_2:
+        case BufferFormat::SNORM16_2:
+        case BufferFormat::FLOAT16_2:
         case BufferFormat::UINT8_4:
         case BufferFormat::UNORM8_4:
             return 4u;
@@ -0,0 +1,198 @@
+#include "pch.h"
+#include "GeometryPool.h"
+#include "Renderer.h"
+
+
+namespace bdr
+{
+    void reset(GeometryPool& pool)
+    {
+        for (GPUBuffer& vertexBuffer : pool.vertexBuffers) {
+            reset(vertexBuffer);
+        }
+        reset(pool.indexBuffer);
+        pool = GeometryPool{};
+    }
+
+    // Pool buffers are untyped, the mesh's input layout and index format say how to read them
+    GPUBuffer createPoolBuffer(ID3D11Device* device, const uint32_t numElements, const uint32_t elementSize, const uint8_t usage)
+    {
+        BufferCreationInfo createInfo{};
+        createInfo.numElements = numElements;
+        createInfo.usage = usage;
+        createInfo.format = BufferFormat::STRUCTURED;
+        createInfo.elementSize = elementSize;
+        return createBuffer(device, nullptr, createInfo);
+    }
+
+    GeometryPoolHandle createGeometryPool(Renderer& renderer, const Mesh& mesh, const uint32_t numVertices, const uint32_t numIndexUnits)
+    {
+        GeometryPoolHandle poolHandle = renderer.geometryPools.create();
+        GeometryPool& pool = renderer.geometryPools[poolHandle];
+        ID3D11Device* device = renderer.getDevice();
+        pool.numVertexBuffers = mesh.numVertexBuffers;
+        for (uint8_t i = 0; i < pool.numVertexBuffers; ++i) {
+            pool.strides[i] = mesh.strides[i];
+            pool.vertexBuffers[i] = createPoolBuffer(device, numVertices, pool.strides[i], BufferUsage::VERTEX);
+        }
+        pool.indexBuffer = createPoolBuffer(device, numIndexUnits, kGeometryPoolIndexUnitSize, BufferUsage::INDEX);
+        pool.vertexAllocator.init(numVertices);
+        pool.indexAllocator.init(numIndexUnits);
+        return poolHandle;
+    }
+
+    bool hasMatchingStreams(const GeometryPool& pool, const Mesh& mesh)
+    {
+        if (pool.numVertexBuffers != mesh.numVertexBuffers) {
+            return false;
+        }
+        for (uint8_t i = 0; i < pool.numVertexBuffers; ++i) {
+            if (pool.strides[i] != mesh.strides[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void uploadRange(ID3D11DeviceContext* context, const GPUBuffer& buffer, const void* data, const uint32_t byteOffset, const uint32_t byteSize)
+    {
+        const D3D11_BOX box{ byteOffset, 0, 0, byteOffset + byteSize, 1, 1 };
+        context->UpdateSubresource(buffer.buffer, 0, &box, data, 0, 0);
+    }
+
+    void allocatePooledGeometry(
+        Renderer& renderer,
+        Mesh& mesh,
+        const uint8_t* const* vertexData,
+        const uint8_t* indexData,
+        const uint32_t numIndices
+    )
+    {
+        const uint32_t indexSize = getByteSize(mesh.indexBuffer.format);
+        const uint32_t numIndexUnits = (numIndices * indexSize + kGeometryPoolIndexUnitSize - 1u) / kGeometryPoolIndexUnitSize;
+
+        GeometryPoolHandle poolHandle = INVALID_HANDLE;
+        uint32_t vertexOffset = kInvalidAllocation;
+        uint32_t indexOffset = kInvalidAllocation;
+        for (size_t i = 0; i < renderer.geometryPools.size(); ++i) {
+            GeometryPool& pool = renderer.geometryPools[i];
+            if (!hasMatchingStreams(pool, mesh)) {
+                continue;
+            }
+            vertexOffset = pool.vertexAllocator.allocate(mesh.numVertices);
+            if (vertexOffset == kInvalidAllocation) {
+                continue;
+            }
+            indexOffset = pool.indexAllocator.allocate(numIndexUnits);
+            if (indexOffset == kInvalidAllocation) {
+                pool.vertexAllocator.free(vertexOffset);
+                continue;
+            }
+            poolHandle = { uint32_t(i) };
+            break;
+        }
+        if (!isValid(poolHandle)) {
+            poolHandle = createGeometryPool(
+                renderer, mesh, std::max(kGeometryPoolVertices, mesh.numVertices), std::max(kGeometryPoolIndexUnits, numIndexUnits)
+            );
+            GeometryPool& pool = renderer.geometryPools[poolHandle];
+            vertexOffset = pool.vertexAllocator.allocate(mesh.numVertices);
+            indexOffset = pool.indexAllocator.allocate(numIndexUnits);
+            ASSERT(vertexOffset != kInvalidAllocation && indexOffset != kInvalidAllocation, "New pool too small for its mesh");
+        }
+
+        const GeometryPool& pool = renderer.geometryPools[poolHandle];
+        ID3D11DeviceContext* context = renderer.getContext();
+        for (uint8_t i = 0; i < pool.numVertexBuffers; ++i) {
+            uploadRange(context, pool.vertexBuffers[i], vertexData[i], vertexOffset * pool.strides[i], mesh.numVertices * pool.strides[i]);
+        }
+        uploadRange(context, pool.indexBuffer, indexData, indexOffset * kGeometryPoolIndexUnitSize, numIndices * indexSize);
+
+        mesh.geometryPool = poolHandle;
+        mesh.baseVertex = vertexOffset;
+        mesh.firstIndex = indexOffset * kGeometryPoolIndexUnitSize / indexSize;
+    }
+
+    void freePooledGeometry(Renderer& renderer, Mesh& mesh)
+    {
+        ASSERT(isValid(mesh.geometryPool), "Mesh isn't pooled");
+        GeometryPool& pool = renderer.geometryPools[mesh.geometryPool];
+        pool.vertexAllocator.free(mesh.baseVertex);
+        pool.indexAllocator.free(mesh.firstIndex * getByteSize(mesh.indexBuffer.format) / kGeometryPoolIndexUnitSize);
+        mesh.geometryPool = INVALID_HANDLE;
+        mesh.baseVertex = 0;
+        mesh.firstIndex = 0;
+    }
+
+    GeometryPoolStats getStats(const GeometryPool& pool)
+    {
+        GeometryPoolStats stats{};
+        stats.vertices = pool.vertexAllocator.getStats();
+        stats.indices = pool.indexAllocator.getStats();
+        return stats;
+    }
+
+    // Replaces buffer with a copy that has the moved ranges at their new offsets. Copying within a buffer can't
+    // overlap, which packing ranges down would.
+    void moveRanges(Renderer& renderer, GPUBuffer& buffer, const uint32_t unitSize, const std::vector<AllocationMove>& moves)
+    {
+        ID3D11DeviceContext* context = renderer.getContext();
+        GPUBuffer moved = createPoolBuffer(renderer.getDevice(), buffer.numElements, unitSize, buffer.usage);
+        context->CopyResource(moved.buffer, buffer.buffer);
+        for (const AllocationMove& move : moves) {
+            const D3D11_BOX box{ move.from * unitSize, 0, 0, (move.from + move.size) * unitSize, 1, 1 };
+            context->CopySubresourceRegion(moved.buffer, 0, move.to * unitSize, 0, 0, buffer.buffer, 0, &box);
+        }
+        reset(buffer);
+        buffer = moved;
+    }
+
+    uint32_t remapOffset(const std::vector<AllocationMove>& moves, const uint32_t offset)
+    {
+        auto it = std::lower_bound(moves.begin(), moves.end(), offset, [](const AllocationMove& move, const uint32_t from) {
+            return move.from < from;
+        });
+        return it != moves.end() && it->from == offset ? it->to : offset;
+    }
+
+    void defragmentGeometryPool(Renderer& renderer, const GeometryPoolHandle poolHandle)
+    {
+        GeometryPool& pool = renderer.geometryPools[poolHandle];
+        std::vector<AllocationMove> vertexMoves;
+        std::vector<AllocationMove> indexMoves;
+        pool.vertexAllocator.compact(vertexMoves);
+        pool.indexAllocator.compact(indexMoves);
+
+        if (!vertexMoves.empty()) {
+            for (uint8_t i = 0; i < pool.numVertexBuffers; ++i) {
+                moveRanges(renderer, pool.vertexBuffers[i], pool.strides[i], vertexMoves);
+            }
+        }
+        if (!indexMoves.empty()) {
+            moveRanges(renderer, pool.indexBuffer, kGeometryPoolIndexUnitSize, indexMoves);
+        }
+
+        for (size_t i = 0; i < renderer.meshes.size(); ++i) {
+            Mesh& mesh = renderer.meshes[i];
+            if (mesh.geometryPool.idx != poolHandle.idx) {
+                continue;
+            }
+            const uint32_t indexSize = getByteSize(mesh.indexBuffer.format);
+            const uint32_t indexOffset = mesh.firstIndex * indexSize / kGeometryPoolIndexUnitSize;
+            mesh.baseVertex = remapOffset(vertexMoves, mesh.baseVertex);
+            mesh.firstIndex = remapOffset(indexMoves, indexOffset) * kGeometryPoolIndexUnitSize / indexSize;
+            // The pool's buffers were replaced too
+            updateDrawRecord(renderer, { uint32_t(i) });
+        }
+    }
+
+    void defragmentGeometryPools(Renderer& renderer, const float maxFragmentation)
+    {
+        for (size_t i = 0; i < renderer.geometryPools.size(); ++i) {
+            const GeometryPoolStats stats = getStats(renderer.geometryPools[i]);
+            if (stats.vertices.fragmentation > maxFragmentation || stats.indices.fragmentation > maxFragmentation) {
+                defragmentGeometryPool(renderer, { uint32_t(i) });
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "pch.h"
+
+#include "Core/TlsfAllocator.h"
+#include "Resources.h"
+#include "GPUBuffer.h"
+
+namespace bdr
+{
+    class Renderer;
+
+    // Arena sizes of new pools, unless a mesh needs more
+    constexpr uint32_t kGeometryPoolVertices = 1u << 20;
+    constexpr uint32_t kGeometryPoolIndexUnits = 4u << 20;
+    // Index arenas are allocated in units of 4 bytes, so 16 and 32 bit indices can share them
+    constexpr uint32_t kGeometryPoolIndexUnitSize = 4u;
+    // Pools with free space more fragmented than this get compacted by defragmentGeometryPools
+    constexpr float kGeometryPoolMaxFragmentation = 0.5f;
+
+    // Vertex and index buffers shared by every mesh with the same vertex buffer strides. Meshes are sub-allocated
+    // from them and drawn with a base vertex and first index, so draws only re-bind buffers when the pool changes.
+    struct GeometryPool
+    {
+        uint8_t numVertexBuffers = 0;
+        uint32_t strides[Mesh::maxAttrCount] = { 0 };
+        GPUBuffer vertexBuffers[Mesh::maxAttrCount];
+        GPUBuffer indexBuffer;
+        // In vertices
+        TlsfAllocator vertexAllocator;
+        // In kGeometryPoolIndexUnitSize units
+        TlsfAllocator indexAllocator;
+    };
+
+    struct GeometryPoolStats
+    {
+        AllocatorStats vertices;
+        AllocatorStats indices;
+    };
+
+    void reset(GeometryPool& pool);
+
+    // Uploads a mesh's vertex buffers, in binding order, and indices into a pool matching its numVertexBuffers and
+    // strides, creating a new pool when none has room. The mesh's indexBuffer.format has to be set already.
+    void allocatePooledGeometry(
+        Renderer& renderer,
+        Mesh& mesh,
+        const uint8_t* const* vertexData,
+        const uint8_t* indexData,
+        const uint32_t numIndices
+    );
+
+    // Hands a pooled mesh's ranges back to its pool
+    void freePooledGeometry(Renderer& renderer, Mesh& mesh);
+
+    GeometryPoolStats getStats(const GeometryPool& pool);
+
+    // Packs a pool's allocations to the start of its buffers on the GPU, and updates the offsets of its meshes
+    void defragmentGeometryPool(Renderer& renderer, const GeometryPoolHandle poolHandle);
+
+    // Defragments the pools where either arena's fragmentation is above maxFragmentation
+    void defragmentGeometryPools(Renderer& renderer, const float maxFragmentation = kGeometryPoolMaxFragmentation);
+}
@@ -2,6 +2,7 @@
 
 #include "d3dcompiler.h"
 #include "InputLayoutManager.h"
+#include "VertexInterleaving.h"
 
 namespace bdr
 {
@@ -28,7 +29,8 @@ namespace bdr
 
     // The generated key is laid out as follows:
     // bits 0 - 7  : the attribute mask
-    // bits 8 - 63 : the format of each attribute, in 8 bit chunks.
+    // bits 8 - 55 : the format of each attribute, in 8 bit chunks.
+    // bits 56 - 63: the vertex layout
     InputLayoutDesc getInputLayoutDesc(const MeshCreationInfo& meshCreationInfo)
     {
         InputLayoutDesc inputLayoutDesc{};
@@ -41,6 +43,7 @@ namespace bdr
             inputLayoutDesc.bufferFormats[i] = meshCreationInfo.bufferFormats[i];
         }
         inputLayoutDesc.numAttributes = i;
+        inputLayoutDesc.vertexLayout = meshCreationInfo.vertexLayout;
         return inputLayoutDesc;
     }
 
@@ -70,7 +73,7 @@ namespace bdr
             // We shift by 8 * bufferNumber to ensure that we do not overwrite the formats we set previously
             formats |= uint64_t(inputLayoutDesc.bufferFormats[i]) << (8u * i);
         }
-        return attrMask | (formats << 8);
+        return attrMask | (formats << 8) | (uint64_t(inputLayoutDesc.vertexLayout) << 56);
     }
 
     ID3D11InputLayout* InputLayoutManager::createInputLayout(const InputLayoutDesc& inputLayoutDesc)
@@ -97,6 +100,8 @@ namespace bdr
                 break;
             case BufferFormat::UNORM8_2:
             case BufferFormat::UNORM16_2:
+            case BufferFormat::SNORM16_2:
+            case BufferFormat::FLOAT16_2:
                 elementsStr += "float2";
                 break;
             case BufferFormat::UINT8_4:
@@ -132,17 +137,24 @@ float4 main(SimpleVertex vi) : SV_Position \n\
         char shaderBuf[1024];
         sprintf_s(shaderBuf, shaderTemplate, elementsStr.c_str());
 
+        // Interleaved meshes have positions in slot 0 and everything else in slot 1
+        const bool isInterleaved = inputLayoutDesc.vertexLayout == VertexLayout::INTERLEAVED;
+        const InterleavedLayout interleavedLayout = isInterleaved
+            ? getInterleavedLayout(inputLayoutDesc.bufferFormats, inputLayoutDesc.attributes, inputLayoutDesc.numAttributes)
+            : InterleavedLayout{};
+
         std::string semanticNames[Mesh::maxAttrCount]{};
         bufferNumber = 0;
         D3D11_INPUT_ELEMENT_DESC descs[Mesh::maxAttrCount]{};
         for (uint32_t i = 0; i < inputLayoutDesc.numAttributes; i++) {
+            const bool isPosition = inputLayoutDesc.attributes[i] == MeshAttribute::POSITION;
             semanticNames[bufferNumber] = getSemanticName(inputLayoutDesc.attributes[i]);
             descs[bufferNumber] = {
                 semanticNames[bufferNumber].c_str(),
                 0,
                 mapFormatToDXGI(inputLayoutDesc.bufferFormats[i]),
-                bufferNumber,
-                D3D11_APPEND_ALIGNED_ELEMENT,
+                isInterleaved ? (isPosition ? 0u : 1u) : bufferNumber,
+                isInterleaved ? (isPosition ? 0u : interleavedLayout.offsets[i]) : D3D11_APPEND_ALIGNED_ELEMENT,
                 D3D11_INPUT_PER_VERTEX_DATA,
                 0,
             };
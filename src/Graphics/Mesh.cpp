@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "Mesh.h"
+#include "MeshSimplification.h"
+#include "VertexInterleaving.h"
 #include "Renderer.h"
 
 namespace bdr
@@ -43,7 +45,7 @@ namespace bdr
     void collectBuffers(const Mesh& mesh, ID3D11Buffer* outputBuffers[])
     {
         size_t counter = 0;
-        for (size_t i = 0; i < mesh.numPresentAttr; i++) {
+        for (size_t i = 0; i < mesh.numVertexBuffers; i++) {
             outputBuffers[counter++] = mesh.vertexBuffers[i].buffer;
         }
     }
@@ -54,6 +56,15 @@ namespace bdr
             HALT("Mesh does not have requested attributes");
         }
         size_t counter = 0;
+        if (mesh.vertexLayout == VertexLayout::INTERLEAVED) {
+            if (attrsToSelect & MeshAttribute::POSITION) {
+                outputBuffers[counter++] = mesh.vertexBuffers[0].buffer;
+            }
+            if (attrsToSelect & ~MeshAttribute::POSITION) {
+                outputBuffers[counter++] = mesh.vertexBuffers[1].buffer;
+            }
+            return;
+        }
         for (size_t i = 0; i < mesh.numPresentAttr; i++) {
             if (mesh.attributes[i] & attrsToSelect) {
                 outputBuffers[counter++] = mesh.vertexBuffers[i].buffer;
@@ -66,6 +77,7 @@ namespace bdr
         if ((mesh.presentAttributesMask & attrsToSelect) != attrsToSelect) {
             HALT("Mesh does not have requested attributes");
         }
+        ASSERT(mesh.vertexLayout == VertexLayout::SEPARATE, "Interleaved vertex buffers have no views");
         size_t counter = 0;
         for (size_t i = 0; i < mesh.maxAttrCount; i++) {
             if (mesh.attributes[i] & attrsToSelect) {
@@ -79,6 +91,7 @@ namespace bdr
         if ((mesh.presentAttributesMask & attrsToSelect) != attrsToSelect) {
             HALT("Mesh does not have requested attributes");
         }
+        ASSERT(mesh.vertexLayout == VertexLayout::SEPARATE, "Interleaved vertex buffers have no views");
         size_t counter = 0;
         for (size_t i = 0; i < mesh.maxAttrCount; i++) {
             if (mesh.attributes[i] & attrsToSelect) {
@@ -122,42 +135,381 @@ namespace bdr
         ++meshCreationInfo.numAttributes;
     }
 
-    MeshHandle createMesh(Renderer& renderer, const MeshCreationInfo& meshCreateInfo)
+    // Coarsest a generated LOD may get, relative to the mesh's bounding sphere radius
+    constexpr float kMaxLODError = 0.1f;
+
+    // Reorders triangles and vertices, generates LODs and meshlets from 32 bit indices, then writes the index data
+    // back out in the mesh's format
+    void processIndices(const MeshCreationInfo& meshCreateInfo, const size_t positionIdx, PreparedMesh& prepared)
     {
-        MeshHandle meshId = renderer.meshes.create();
-        Mesh& mesh = renderer.meshes[meshId];
+        const uint32_t numIndices = meshCreateInfo.numIndices;
+        const uint32_t numVertices = meshCreateInfo.numVertices;
+        const bool isShortInput = meshCreateInfo.indexFormat == BufferFormat::UINT16;
+        ASSERT(isShortInput || meshCreateInfo.indexFormat == BufferFormat::UINT32, "Unsupported index format");
+        std::vector<uint32_t> indices(numIndices);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            indices[i] = isShortInput
+                ? reinterpret_cast<const uint16_t*>(meshCreateInfo.indexData)[i]
+                : reinterpret_cast<const uint32_t*>(meshCreateInfo.indexData)[i];
+        }
 
-        mesh.numIndices = meshCreateInfo.numIndices;
-        mesh.numVertices = meshCreateInfo.numVertices;
+        if (meshCreateInfo.optimizeTriangleOrder) {
+            const glm::vec3* positions = reinterpret_cast<const glm::vec3*>(meshCreateInfo.data[positionIdx]);
+            prepared.originalCacheStats = analyzeVertexCache(indices.data(), numIndices, numVertices);
+            optimizeVertexCache(indices.data(), numIndices, numVertices);
+            optimizeOverdraw(positions, indices.data(), numIndices, numVertices);
+        }
+        if (meshCreateInfo.optimizeVertexOrder) {
+            std::vector<uint32_t> remap;
+            optimizeVertexFetch(indices.data(), numIndices, numVertices, remap);
+            for (size_t i = 0; i < meshCreateInfo.numAttributes; ++i) {
+                if (meshCreateInfo.data[i] == nullptr) {
+                    continue;
+                }
+                prepared.vertexData[i].resize(size_t(numVertices) * meshCreateInfo.strides[i]);
+                remapVertexStream(meshCreateInfo.data[i], meshCreateInfo.strides[i], numVertices, remap, prepared.vertexData[i].data());
+            }
+        }
 
-        BufferCreationInfo indexCreateInfo{};
-        indexCreateInfo.numElements = meshCreateInfo.numIndices;
-        indexCreateInfo.usage = BufferUsage::INDEX;
-        indexCreateInfo.format = meshCreateInfo.indexFormat;
+        const glm::vec3* positions = reinterpret_cast<const glm::vec3*>(getVertexData(meshCreateInfo, prepared, positionIdx));
+        SimplificationInput input{};
+        input.positions = positions;
+        input.numVertices = numVertices;
+        for (size_t i = 0; i < meshCreateInfo.numAttributes; ++i) {
+            const BufferFormat format = meshCreateInfo.bufferFormats[i];
+            const uint8_t* data = getVertexData(meshCreateInfo, prepared, i);
+            if (meshCreateInfo.attributes[i] == MeshAttribute::NORMAL && format == BufferFormat::FLOAT_3) {
+                input.normals = reinterpret_cast<const glm::vec3*>(data);
+            }
+            // Normalized integer texcoords are rare enough to simplify without them
+            else if (meshCreateInfo.attributes[i] == MeshAttribute::TEXCOORD && format == BufferFormat::FLOAT_2) {
+                input.texcoords = reinterpret_cast<const glm::vec2*>(data);
+            }
+        }
 
-        ID3D11Device* device = renderer.getDevice();
-        mesh.indexBuffer = createBuffer(device, meshCreateInfo.indexData, indexCreateInfo);
+        std::vector<uint32_t> lodIndices;
+        const uint32_t maxLODs = std::min(uint32_t(meshCreateInfo.numLODs), uint32_t(Mesh::maxLODs));
+        prepared.numLODs = uint8_t(generateLODChain(input, indices.data(), numIndices, maxLODs, kMaxLODError, lodIndices, prepared.lods));
+        // Collapses scatter the cache order, overdraw matters less at the distances coarser LODs are drawn at
+        if (meshCreateInfo.optimizeTriangleOrder) {
+            for (uint32_t lod = 1; lod < prepared.numLODs; ++lod) {
+                optimizeVertexCache(&lodIndices[prepared.lods[lod].indexOffset], prepared.lods[lod].numIndices, numVertices);
+            }
+        }
+
+        // Only full detail gets split, coarser LODs are drawn when the mesh is too small on screen for it to matter
+        if (meshCreateInfo.buildMeshlets && numIndices / 3 >= kMinMeshletMeshTriangles) {
+            buildMeshlets(positions, lodIndices.data(), prepared.lods[0].numIndices, prepared.meshlets);
+        }
+        if (meshCreateInfo.optimizeTriangleOrder) {
+            prepared.optimizedCacheStats = analyzeVertexCache(lodIndices.data(), prepared.lods[0].numIndices, numVertices);
+        }
+
+        const bool isShortIndices = prepared.indexFormat == BufferFormat::UINT16;
+        prepared.indexData.resize(lodIndices.size() * (isShortIndices ? sizeof(uint16_t) : sizeof(uint32_t)));
+        for (size_t i = 0; i < lodIndices.size(); ++i) {
+            if (isShortIndices) {
+                reinterpret_cast<uint16_t*>(prepared.indexData.data())[i] = uint16_t(lodIndices[i]);
+            }
+            else {
+                reinterpret_cast<uint32_t*>(prepared.indexData.data())[i] = lodIndices[i];
+            }
+        }
+    }
 
+    // Replaces the float streams quantizeVertices covers with their quantized versions
+    void quantizeVertexStreams(const MeshCreationInfo& meshCreateInfo, PreparedMesh& prepared)
+    {
+        const uint32_t numVertices = meshCreateInfo.numVertices;
         for (size_t i = 0; i < meshCreateInfo.numAttributes; ++i) {
-            BufferCreationInfo createInfo{};
-            createInfo.numElements = meshCreateInfo.numVertices;
-            createInfo.usage = meshCreateInfo.bufferUsages[i];
-            createInfo.format = meshCreateInfo.bufferFormats[i];
-            createInfo.type = BufferType::Default;
+            const uint8_t* source = getVertexData(meshCreateInfo, prepared, i);
+            const MeshAttribute attribute = meshCreateInfo.attributes[i];
+            const BufferFormat format = meshCreateInfo.bufferFormats[i];
+            if (source == nullptr) {
+                continue;
+            }
 
-            if (createInfo.usage == BufferUsage::UNUSED) {
+            std::vector<uint8_t> quantized;
+            BufferFormat quantizedFormat = format;
+            if (attribute == MeshAttribute::POSITION && format == BufferFormat::FLOAT_3) {
+                quantizedFormat = BufferFormat::UNORM16_4;
+                quantized.resize(size_t(numVertices) * sizeof(glm::u16vec4));
+                quantizePositions(reinterpret_cast<const glm::vec3*>(source), numVertices, prepared.bounds, reinterpret_cast<glm::u16vec4*>(quantized.data()));
+                prepared.hasQuantizedPositions = true;
+            }
+            else if (attribute == MeshAttribute::NORMAL && format == BufferFormat::FLOAT_3) {
+                quantizedFormat = BufferFormat::SNORM16_2;
+                quantized.resize(size_t(numVertices) * sizeof(glm::i16vec2));
+                quantizeNormals(reinterpret_cast<const glm::vec3*>(source), numVertices, reinterpret_cast<glm::i16vec2*>(quantized.data()));
+            }
+            else if (attribute == MeshAttribute::TEXCOORD && format == BufferFormat::FLOAT_2) {
+                quantizedFormat = BufferFormat::FLOAT16_2;
+                quantized.resize(size_t(numVertices) * sizeof(uint32_t));
+                quantizeTexcoords(reinterpret_cast<const glm::vec2*>(source), numVertices, reinterpret_cast<uint32_t*>(quantized.data()));
+            }
+            else {
                 continue;
             }
+            prepared.vertexData[i] = std::move(quantized);
+            prepared.bufferFormats[i] = quantizedFormat;
+            prepared.strides[i] = getByteSize(quantizedFormat);
+        }
+    }
+
+    void prepareMesh(const MeshCreationInfo& meshCreateInfo, PreparedMesh& prepared)
+    {
+        size_t positionIdx = SIZE_MAX;
+        for (size_t i = 0; i < meshCreateInfo.numAttributes; ++i) {
+            if (meshCreateInfo.attributes[i] == MeshAttribute::POSITION) {
+                ASSERT(meshCreateInfo.bufferFormats[i] == BufferFormat::FLOAT_3, "Expected float3 positions");
+                positionIdx = i;
+                break;
+            }
+        }
+        if (positionIdx != SIZE_MAX) {
+            const glm::vec3* positions = reinterpret_cast<const glm::vec3*>(meshCreateInfo.data[positionIdx]);
+            prepared.bounds = math::isEmpty(meshCreateInfo.bounds)
+                ? math::computeAABB(positions, meshCreateInfo.numVertices)
+                : meshCreateInfo.bounds;
+            prepared.boundingSphere = math::computeBoundingSphere(positions, meshCreateInfo.numVertices, prepared.bounds);
+        }
+
+        prepared.lods[0] = MeshLOD{ 0, meshCreateInfo.numIndices, 0.0f };
+        prepared.numLODs = 1;
+        prepared.indexData.clear();
+        for (std::vector<uint8_t>& vertexData : prepared.vertexData) {
+            vertexData.clear();
+        }
+        prepared.meshlets.clear();
+        prepared.indexFormat = meshCreateInfo.indexFormat;
+        std::copy(meshCreateInfo.bufferFormats, meshCreateInfo.bufferFormats + Mesh::maxAttrCount, prepared.bufferFormats);
+        std::copy(meshCreateInfo.strides, meshCreateInfo.strides + Mesh::maxAttrCount, prepared.strides);
+        prepared.hasQuantizedPositions = false;
+
+        // Every index fits in 16 bits as long as there are few enough vertices
+        const bool narrowIndices = meshCreateInfo.indexFormat == BufferFormat::UINT32 && meshCreateInfo.numVertices <= UINT16_MAX + 1u;
+        if (narrowIndices) {
+            prepared.indexFormat = BufferFormat::UINT16;
+        }
+        const bool needsIndices = meshCreateInfo.numLODs > 1
+            || meshCreateInfo.buildMeshlets
+            || meshCreateInfo.optimizeTriangleOrder
+            || meshCreateInfo.optimizeVertexOrder
+            || narrowIndices;
+        if (needsIndices) {
+            ASSERT(positionIdx != SIZE_MAX, "Can't optimize, simplify or split meshes without positions");
+            processIndices(meshCreateInfo, positionIdx, prepared);
+        }
+        if (meshCreateInfo.quantizeVertices) {
+            quantizeVertexStreams(meshCreateInfo, prepared);
+        }
+    }
+
+    // A mesh's vertex buffers in binding order, before they're uploaded
+    struct VertexStreams
+    {
+        const uint8_t* data[Mesh::maxAttrCount] = { nullptr };
+        uint32_t strides[Mesh::maxAttrCount] = { 0 };
+        BufferFormat formats[Mesh::maxAttrCount] = { BufferFormat::INVALID };
+        uint8_t usages[Mesh::maxAttrCount] = { BufferUsage::UNUSED };
+        uint8_t numStreams = 0;
+        // Backs the second stream of interleaved meshes
+        std::vector<uint8_t> interleaved;
+    };
+
+    // One stream per attribute, or positions followed by every other attribute interleaved
+    void gatherVertexStreams(const MeshCreationInfo& meshCreateInfo, const PreparedMesh& prepared, Mesh& mesh, VertexStreams& streams)
+    {
+        if (meshCreateInfo.vertexLayout == VertexLayout::SEPARATE) {
+            for (size_t i = 0; i < meshCreateInfo.numAttributes; ++i) {
+                streams.usages[i] = meshCreateInfo.bufferUsages[i];
+                if (streams.usages[i] == BufferUsage::UNUSED) {
+                    continue;
+                }
+                streams.data[i] = getVertexData(meshCreateInfo, prepared, i);
+                streams.strides[i] = prepared.strides[i];
+                streams.formats[i] = prepared.bufferFormats[i];
+                mesh.attributes[i] = meshCreateInfo.attributes[i];
+                mesh.presentAttributesMask |= meshCreateInfo.attributes[i];
+            }
+            streams.numStreams = meshCreateInfo.numAttributes;
+            return;
+        }
 
-            mesh.vertexBuffers[i] = createBuffer(device, meshCreateInfo.data[i], createInfo);
+        const InterleavedLayout layout = getInterleavedLayout(prepared.bufferFormats, meshCreateInfo.attributes, meshCreateInfo.numAttributes);
+        const uint8_t* sources[Mesh::maxAttrCount] = { nullptr };
+        uint32_t elementSizes[Mesh::maxAttrCount] = { 0 };
+        uint32_t offsets[Mesh::maxAttrCount] = { 0 };
+        uint32_t numSources = 0;
+        for (size_t i = 0; i < meshCreateInfo.numAttributes; ++i) {
+            ASSERT(meshCreateInfo.bufferUsages[i] == BufferUsage::VERTEX, "Interleaved attributes can only be used as vertices");
             mesh.attributes[i] = meshCreateInfo.attributes[i];
             mesh.presentAttributesMask |= meshCreateInfo.attributes[i];
-            mesh.strides[i] = meshCreateInfo.strides[i];
+            if (meshCreateInfo.attributes[i] == MeshAttribute::POSITION) {
+                streams.data[0] = getVertexData(meshCreateInfo, prepared, i);
+                streams.strides[0] = prepared.strides[i];
+                streams.formats[0] = prepared.bufferFormats[i];
+                streams.usages[0] = BufferUsage::VERTEX;
+                continue;
+            }
+            sources[numSources] = getVertexData(meshCreateInfo, prepared, i);
+            elementSizes[numSources] = prepared.strides[i];
+            offsets[numSources] = layout.offsets[i];
+            ++numSources;
+        }
+        ASSERT(streams.data[0] != nullptr, "Interleaved meshes need positions");
+        streams.numStreams = 1;
+        if (numSources == 0) {
+            return;
+        }
+
+        streams.interleaved.assign(size_t(meshCreateInfo.numVertices) * layout.stride, 0);
+        interleaveVertexStreams(sources, elementSizes, offsets, numSources, meshCreateInfo.numVertices, layout.stride, streams.interleaved.data());
+        streams.data[1] = streams.interleaved.data();
+        streams.strides[1] = layout.stride;
+        // There's no format for a whole vertex, so the buffer's size comes from the stride
+        streams.formats[1] = BufferFormat::STRUCTURED;
+        streams.usages[1] = BufferUsage::VERTEX;
+        streams.numStreams = 2;
+    }
+
+    uint32_t collectDrawBuffers(const Renderer& renderer, const Mesh& mesh, ID3D11Buffer* outputBuffers[], const uint32_t** outputStrides)
+    {
+        uint32_t numVertexBuffers = mesh.numVertexBuffers;
+        if (isValid(mesh.geometryPool)) {
+            const GeometryPool& pool = renderer.geometryPools[mesh.geometryPool];
+            for (uint8_t i = 0; i < pool.numVertexBuffers; ++i) {
+                outputBuffers[i] = pool.vertexBuffers[i].buffer;
+            }
+            *outputStrides = pool.strides;
+            numVertexBuffers = pool.numVertexBuffers;
+        }
+        else {
+            collectBuffers(mesh, outputBuffers);
+            *outputStrides = mesh.strides;
+        }
+        // Streams past the last used one don't need binding
+        while (numVertexBuffers > 0 && outputBuffers[numVertexBuffers - 1] == nullptr) {
+            --numVertexBuffers;
+        }
+        return numVertexBuffers;
+    }
+
+    void updateDrawRecord(Renderer& renderer, const MeshHandle meshHandle)
+    {
+        if (renderer.meshDrawRecords.size() < renderer.meshes.size()) {
+            renderer.meshDrawRecords.resize(renderer.meshes.size());
+        }
+        const Mesh& mesh = renderer.meshes[meshHandle];
+        MeshDrawRecord& record = renderer.meshDrawRecords[meshHandle.idx];
+        record = MeshDrawRecord{};
+
+        ID3D11Buffer* vertexBuffers[Mesh::maxAttrCount] = { nullptr };
+        const uint32_t* strides = nullptr;
+        const uint32_t numVertexBuffers = collectDrawBuffers(renderer, mesh, vertexBuffers, &strides);
+        bool fitsRecord = numVertexBuffers <= kMaxDrawVertexBuffers;
+        for (uint32_t i = 0; i < numVertexBuffers; ++i) {
+            fitsRecord &= strides[i] <= UINT8_MAX;
+        }
+        if (fitsRecord) {
+            for (uint32_t i = 0; i < numVertexBuffers; ++i) {
+                record.vertexBuffers[i] = vertexBuffers[i];
+                record.strides[i] = uint8_t(strides[i]);
+            }
+            record.numVertexBuffers = uint8_t(numVertexBuffers);
+        }
+        else {
+            record.flags |= BINDS_FROM_MESH;
         }
+        record.indexBuffer = isValid(mesh.geometryPool) ? renderer.geometryPools[mesh.geometryPool].indexBuffer.buffer : mesh.indexBuffer.buffer;
+        record.indexFormat = mesh.indexBuffer.format;
+        record.firstIndex = mesh.firstIndex;
+        record.baseVertex = int32_t(mesh.baseVertex);
+        record.numIndices = mesh.lods[0].numIndices;
+        record.flags |= (mesh.numLODs > 1 ? HAS_LODS : 0) | (mesh.numMeshlets > 0 ? HAS_MESHLETS : 0) |
+            (mesh.hasQuantizedPositions ? HAS_QUANTIZED_POSITIONS : 0);
+    }
+
+    MeshHandle createMesh(Renderer& renderer, const MeshCreationInfo& meshCreateInfo, const PreparedMesh& prepared)
+    {
+        MeshHandle meshId = renderer.meshes.create();
+        Mesh& mesh = renderer.meshes[meshId];
+
+        mesh.numIndices = meshCreateInfo.numIndices;
+        mesh.numVertices = meshCreateInfo.numVertices;
+        mesh.bounds = prepared.bounds;
+        mesh.boundingSphere = prepared.boundingSphere;
+        std::copy(prepared.lods, prepared.lods + prepared.numLODs, mesh.lods);
+        mesh.numLODs = prepared.numLODs;
+        if (!prepared.meshlets.empty()) {
+            mesh.firstMeshlet = addMeshlets(renderer.meshlets, prepared.meshlets);
+            mesh.numMeshlets = uint32_t(prepared.meshlets.size());
+        }
+        const MeshLOD& lastLOD = mesh.lods[mesh.numLODs - 1];
+        const uint32_t numIndices = lastLOD.indexOffset + lastLOD.numIndices;
+        const uint8_t* indexData = prepared.indexData.empty() ? meshCreateInfo.indexData : prepared.indexData.data();
+
+        mesh.vertexLayout = meshCreateInfo.vertexLayout;
+        VertexStreams streams;
+        gatherVertexStreams(meshCreateInfo, prepared, mesh, streams);
+        std::copy(streams.strides, streams.strides + Mesh::maxAttrCount, mesh.strides);
+        mesh.numVertexBuffers = streams.numStreams;
         mesh.numPresentAttr = meshCreateInfo.numAttributes;
-        mesh.inputLayoutHandle = renderer.inputLayoutManager.getOrCreateInputLayout(meshCreateInfo);
+        mesh.indexBuffer.format = prepared.indexFormat;
+
+        if (meshCreateInfo.useGeometryPool) {
+            for (size_t i = 0; i < streams.numStreams; ++i) {
+                ASSERT(streams.usages[i] == BufferUsage::VERTEX, "Pooled attributes can only be used as vertices");
+            }
+            allocatePooledGeometry(renderer, mesh, streams.data, indexData, numIndices);
+        }
+        else {
+            ID3D11Device* device = renderer.getDevice();
+            BufferCreationInfo indexCreateInfo{};
+            indexCreateInfo.numElements = numIndices;
+            indexCreateInfo.usage = BufferUsage::INDEX;
+            indexCreateInfo.format = prepared.indexFormat;
+            mesh.indexBuffer = createBuffer(device, indexData, indexCreateInfo);
+
+            for (size_t i = 0; i < streams.numStreams; ++i) {
+                BufferCreationInfo createInfo{};
+                createInfo.numElements = meshCreateInfo.numVertices;
+                createInfo.usage = streams.usages[i];
+                createInfo.format = streams.formats[i];
+                createInfo.elementSize = streams.strides[i];
+                createInfo.type = BufferType::Default;
+
+                if (createInfo.usage == BufferUsage::UNUSED) {
+                    continue;
+                }
+                mesh.vertexBuffers[i] = createBuffer(device, streams.data[i], createInfo);
+            }
+        }
+        mesh.hasQuantizedPositions = prepared.hasQuantizedPositions;
+
+        MeshCreationInfo layoutInfo = meshCreateInfo;
+        std::copy(prepared.bufferFormats, prepared.bufferFormats + Mesh::maxAttrCount, layoutInfo.bufferFormats);
+        mesh.inputLayoutHandle = renderer.inputLayoutManager.getOrCreateInputLayout(layoutInfo);
+        updateDrawRecord(renderer, meshId);
         return meshId;
     }
 
+    MeshHandle createMesh(Renderer& renderer, const MeshCreationInfo& meshCreateInfo)
+    {
+        PreparedMesh prepared;
+        prepareMesh(meshCreateInfo, prepared);
+        return createMesh(renderer, meshCreateInfo, prepared);
+    }
 
-}
\ No newline at end of file
+    uint8_t selectLOD(const Mesh& mesh, const float projectedRadius, const float maxError, const uint8_t currentLOD)
+    {
+        uint8_t lod = std::min(currentLOD, uint8_t(mesh.numLODs - 1));
+        while (lod > 0 && mesh.lods[lod].error * projectedRadius > maxError * (1.0f + kLODHysteresis)) {
+            --lod;
+        }
+        while (lod + 1 < mesh.numLODs && mesh.lods[lod + 1].error * projectedRadius < maxError * (1.0f - kLODHysteresis)) {
+            ++lod;
+        }
+        return lod;
+    }
+}
@@ -2,6 +2,9 @@
 #include "pch.h"
 #include "Resources.h"
 #include "GPUBuffer.h"
+#include "Meshlets.h"
+#include "MeshOptimization.h"
+#include "VertexQuantization.h"
 
 namespace bdr
 {
@@ -16,5 +19,65 @@ namespace bdr
 
     void addAttribute(MeshCreationInfo& meshCreationInfo, const void* data, const BufferFormat format, const MeshAttribute attrFlag);
 
+    // The vertex buffers and strides drawing the mesh binds, its geometry pool's if it has one. Returns how many to bind.
+    uint32_t collectDrawBuffers(const Renderer& renderer, const Mesh& mesh, ID3D11Buffer* outputBuffers[], const uint32_t** outputStrides);
+
+    // Rebuilds the mesh's entry in Renderer::meshDrawRecords, after creating it or moving its buffers
+    void updateDrawRecord(Renderer& renderer, const MeshHandle meshHandle);
+
+    // Whether drawing b after a can skip binding vertex and index buffers
+    inline bool hasSameBuffers(const MeshDrawRecord& a, const MeshDrawRecord& b)
+    {
+        return a.indexBuffer == b.indexBuffer && a.indexFormat == b.indexFormat && a.numVertexBuffers == b.numVertexBuffers &&
+            memcmp(a.vertexBuffers, b.vertexBuffers, sizeof(a.vertexBuffers)) == 0 && memcmp(a.strides, b.strides, sizeof(a.strides)) == 0;
+    }
+
+    // The CPU side work of creating a mesh: bounds, LODs and meshlets. It doesn't touch the renderer, so several
+    // meshes can be prepared in parallel before creating them.
+    struct PreparedMesh
+    {
+        AABB bounds;
+        BoundingSphere boundingSphere;
+        MeshLOD lods[Mesh::maxLODs];
+        uint8_t numLODs = 1;
+        // Every LOD's indices in indexFormat, empty when the creation info's indices can be used as they are
+        std::vector<uint8_t> indexData;
+        // Reordered or quantized copies of the creation info's vertex streams, empty for streams used as they are
+        std::vector<uint8_t> vertexData[Mesh::maxAttrCount];
+        // The creation info's formats, after narrowing indices and quantizing
+        BufferFormat indexFormat = BufferFormat::INVALID;
+        BufferFormat bufferFormats[Mesh::maxAttrCount] = { BufferFormat::INVALID };
+        uint32_t strides[Mesh::maxAttrCount] = { 0 };
+        bool hasQuantizedPositions = false;
+        std::vector<Meshlet> meshlets;
+        // LOD 0's vertex cache efficiency before and after optimizing its triangle order
+        VertexCacheStats originalCacheStats;
+        VertexCacheStats optimizedCacheStats;
+    };
+
+    void prepareMesh(const MeshCreationInfo& meshCreateInfo, PreparedMesh& prepared);
+
+    // The prepared mesh's vertices for one of the creation info's streams
+    inline const uint8_t* getVertexData(const MeshCreationInfo& meshCreateInfo, const PreparedMesh& prepared, const size_t attrIdx)
+    {
+        return prepared.vertexData[attrIdx].empty() ? meshCreateInfo.data[attrIdx] : prepared.vertexData[attrIdx].data();
+    }
+
+    // Maps the mesh's vertex positions to object space, to apply before the model matrix
+    inline glm::mat4 getDequantizationTransform(const Mesh& mesh)
+    {
+        return mesh.hasQuantizedPositions ? getDequantizationTransform(mesh.bounds) : glm::mat4{ 1.0f };
+    }
+
+    MeshHandle createMesh(Renderer& renderer, const MeshCreationInfo& meshCreateInfo, const PreparedMesh& prepared);
+
+    // Prepares the mesh and creates it
     MeshHandle createMesh(Renderer& renderer, const MeshCreationInfo& meshCreateInfo);
+
+    // How far past the error threshold a LOD's error has to get before objects switch to or from it
+    constexpr float kLODHysteresis = 0.25f;
+
+    // Coarsest LOD whose error, scaled by the projected radius of the mesh's bounding sphere, stays under maxError.
+    // Starts from the current LOD so that objects hovering around a threshold don't pop back and forth.
+    uint8_t selectLOD(const Mesh& mesh, const float projectedRadius, const float maxError, const uint8_t currentLOD);
 }
\ No newline at end of file
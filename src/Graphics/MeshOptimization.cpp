@@ -0,0 +1,356 @@
+#include "pch.h"
+#include "MeshOptimization.h"
+
+
+namespace bdr
+{
+    // Forsyth's scoring, with his recommended constants. The LRU cache it models is larger than real FIFO caches,
+    // which keeps the order good across cache sizes.
+    constexpr uint32_t kForsythCacheSize = 32;
+    constexpr float kCacheDecayPower = 1.5f;
+    constexpr float kLastTriangleScore = 0.75f;
+    constexpr float kValenceBoostScale = 2.0f;
+    constexpr float kValenceBoostPower = 0.5f;
+    // Vertices with more triangles left than this score the same
+    constexpr uint32_t kMaxScoredValence = 32;
+
+    // Simulates a FIFO cache over one triangle, returning its misses. Vertices are in the cache while their
+    // timestamp is within cacheSize of the current one.
+    inline uint32_t updateFIFOCache(
+        const uint32_t* triangle,
+        const uint32_t cacheSize,
+        std::vector<uint32_t>& timestamps,
+        uint32_t& timestamp
+    )
+    {
+        uint32_t misses = 0;
+        for (uint32_t i = 0; i < 3; ++i) {
+            const uint32_t vertex = triangle[i];
+            if (timestamp - timestamps[vertex] > cacheSize) {
+                timestamps[vertex] = timestamp++;
+                ++misses;
+            }
+        }
+        return misses;
+    }
+
+    VertexCacheStats analyzeVertexCache(
+        const uint32_t* indices,
+        const uint32_t numIndices,
+        const uint32_t numVertices,
+        const uint32_t cacheSize
+    )
+    {
+        VertexCacheStats stats{};
+        if (numIndices < 3) {
+            return stats;
+        }
+        // Starting past cacheSize leaves every vertex out of the cache
+        std::vector<uint32_t> timestamps(numVertices, 0);
+        uint32_t timestamp = cacheSize + 1;
+        uint32_t misses = 0;
+        for (uint32_t i = 0; i + 3 <= numIndices; i += 3) {
+            misses += updateFIFOCache(&indices[i], cacheSize, timestamps, timestamp);
+        }
+
+        std::vector<bool> isReferenced(numVertices, false);
+        uint32_t numReferenced = 0;
+        for (uint32_t i = 0; i < numIndices; ++i) {
+            if (!isReferenced[indices[i]]) {
+                isReferenced[indices[i]] = true;
+                ++numReferenced;
+            }
+        }
+        stats.acmr = float(misses) / float(numIndices / 3);
+        stats.atvr = float(misses) / float(numReferenced);
+        return stats;
+    }
+
+    struct VertexScoreTables
+    {
+        float cache[kForsythCacheSize];
+        float valence[kMaxScoredValence + 1];
+
+        VertexScoreTables()
+        {
+            for (uint32_t i = 0; i < kForsythCacheSize; ++i) {
+                // The last triangle's vertices get a fixed score, so it isn't favoured for simply being adjacent
+                cache[i] = i < 3
+                    ? kLastTriangleScore
+                    : powf(1.0f - float(i - 3) / float(kForsythCacheSize - 3), kCacheDecayPower);
+            }
+            valence[0] = 0.0f;
+            for (uint32_t i = 1; i <= kMaxScoredValence; ++i) {
+                valence[i] = kValenceBoostScale * powf(float(i), -kValenceBoostPower);
+            }
+        }
+    };
+
+    inline float getVertexScore(const VertexScoreTables& tables, const int32_t cachePosition, const uint32_t numTrianglesLeft)
+    {
+        if (numTrianglesLeft == 0) {
+            return -1.0f;
+        }
+        const float cacheScore = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+        return cacheScore + tables.valence[std::min(numTrianglesLeft, kMaxScoredValence)];
+    }
+
+    void optimizeVertexCache(uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices)
+    {
+        static const VertexScoreTables tables;
+        const uint32_t numTriangles = numIndices / 3;
+        if (numTriangles == 0) {
+            return;
+        }
+
+        // Triangles using each vertex, the first numTrianglesLeft of each range are the ones not emitted yet
+        std::vector<uint32_t> adjacencyOffsets(numVertices + 1, 0);
+        for (uint32_t i = 0; i < numTriangles * 3; ++i) {
+            ++adjacencyOffsets[indices[i] + 1];
+        }
+        for (uint32_t vertex = 0; vertex < numVertices; ++vertex) {
+            adjacencyOffsets[vertex + 1] += adjacencyOffsets[vertex];
+        }
+        std::vector<uint32_t> adjacency(adjacencyOffsets.back());
+        std::vector<uint32_t> numTrianglesLeft(numVertices, 0);
+        for (uint32_t i = 0; i < numTriangles * 3; ++i) {
+            const uint32_t vertex = indices[i];
+            adjacency[adjacencyOffsets[vertex] + numTrianglesLeft[vertex]++] = i / 3;
+        }
+
+        std::vector<int32_t> cachePositions(numVertices, -1);
+        std::vector<float> vertexScores(numVertices);
+        for (uint32_t vertex = 0; vertex < numVertices; ++vertex) {
+            vertexScores[vertex] = getVertexScore(tables, -1, numTrianglesLeft[vertex]);
+        }
+
+        // Start from the triangle with the fewest neighbours, usually on a boundary
+        std::vector<bool> isEmitted(numTriangles, false);
+        uint32_t bestTriangle = 0;
+        float bestScore = -1.0f;
+        for (uint32_t triangle = 0; triangle < numTriangles; ++triangle) {
+            const uint32_t* corners = &indices[triangle * 3];
+            const float score = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+            if (score > bestScore) {
+                bestScore = score;
+                bestTriangle = triangle;
+            }
+        }
+
+        // Three extra slots for the vertices pushed out by the newest triangle
+        uint32_t cache[kForsythCacheSize + 3];
+        uint32_t cacheSize = 0;
+        uint32_t newCache[kForsythCacheSize + 3];
+        std::vector<uint32_t> orderedIndices;
+        orderedIndices.reserve(numTriangles * 3);
+        uint32_t cursor = 0;
+
+        while (orderedIndices.size() < numTriangles * 3) {
+            // Nothing left around the cache, continue with the next triangle in the original order
+            if (bestTriangle == UINT32_MAX) {
+                while (isEmitted[cursor]) {
+                    ++cursor;
+                }
+                bestTriangle = cursor;
+            }
+
+            isEmitted[bestTriangle] = true;
+            const uint32_t corners[3] = { indices[bestTriangle * 3], indices[bestTriangle * 3 + 1], indices[bestTriangle * 3 + 2] };
+            uint32_t newCacheSize = 0;
+            for (uint32_t i = 0; i < 3; ++i) {
+                const uint32_t vertex = corners[i];
+                orderedIndices.push_back(vertex);
+
+                const uint32_t begin = adjacencyOffsets[vertex];
+                const uint32_t end = begin + numTrianglesLeft[vertex];
+                for (uint32_t j = begin; j < end; ++j) {
+                    if (adjacency[j] == bestTriangle) {
+                        std::swap(adjacency[j], adjacency[end - 1]);
+                        --numTrianglesLeft[vertex];
+                        break;
+                    }
+                }
+                // Degenerate triangles repeat vertices, which only go in the cache once
+                if (std::find(newCache, newCache + newCacheSize, vertex) == newCache + newCacheSize) {
+                    newCache[newCacheSize++] = vertex;
+                }
+            }
+            for (uint32_t i = 0; i < cacheSize; ++i) {
+                const uint32_t vertex = cache[i];
+                if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2]) {
+                    newCache[newCacheSize++] = vertex;
+                }
+            }
+
+            // Rescore everything that was or still is in the cache, along with their remaining triangles
+            bestTriangle = UINT32_MAX;
+            bestScore = -1.0f;
+            for (uint32_t i = 0; i < newCacheSize; ++i) {
+                const uint32_t vertex = newCache[i];
+                cachePositions[vertex] = i < kForsythCacheSize ? int32_t(i) : -1;
+                vertexScores[vertex] = getVertexScore(tables, cachePositions[vertex], numTrianglesLeft[vertex]);
+            }
+            for (uint32_t i = 0; i < newCacheSize; ++i) {
+                const uint32_t vertex = newCache[i];
+                const uint32_t begin = adjacencyOffsets[vertex];
+                for (uint32_t j = begin; j < begin + numTrianglesLeft[vertex]; ++j) {
+                    const uint32_t triangle = adjacency[j];
+                    const uint32_t* triangleCorners = &indices[triangle * 3];
+                    const float score = vertexScores[triangleCorners[0]] + vertexScores[triangleCorners[1]] + vertexScores[triangleCorners[2]];
+                    if (score > bestScore) {
+                        bestScore = score;
+                        bestTriangle = triangle;
+                    }
+                }
+            }
+
+            cacheSize = std::min(newCacheSize, kForsythCacheSize);
+            std::copy(newCache, newCache + cacheSize, cache);
+        }
+        std::copy(orderedIndices.begin(), orderedIndices.end(), indices);
+    }
+
+    struct OverdrawCluster
+    {
+        uint32_t firstTriangle = 0;
+        uint32_t numTriangles = 0;
+        // Larger sorts first
+        float sortKey = 0.0f;
+    };
+
+    void optimizeOverdraw(
+        const glm::vec3* positions,
+        uint32_t* indices,
+        const uint32_t numIndices,
+        const uint32_t numVertices,
+        const float threshold
+    )
+    {
+        const uint32_t numTriangles = numIndices / 3;
+        if (numTriangles < 2) {
+            return;
+        }
+        const uint32_t cacheSize = kVertexCacheStatsSize;
+        std::vector<uint32_t> timestamps(numVertices, 0);
+        uint32_t timestamp = cacheSize + 1;
+
+        // Patches start where every vertex of a triangle misses the cache
+        std::vector<uint32_t> patchStarts;
+        for (uint32_t triangle = 0; triangle < numTriangles; ++triangle) {
+            const uint32_t misses = updateFIFOCache(&indices[triangle * 3], cacheSize, timestamps, timestamp);
+            if (triangle == 0 || misses == 3) {
+                patchStarts.push_back(triangle);
+            }
+        }
+        patchStarts.push_back(numTriangles);
+
+        // Patches are split once the running ACMR gets close enough to the patch's, any later split costs little
+        std::vector<OverdrawCluster> clusters;
+        for (size_t patch = 0; patch + 1 < patchStarts.size(); ++patch) {
+            const uint32_t begin = patchStarts[patch];
+            const uint32_t end = patchStarts[patch + 1];
+
+            timestamp += cacheSize + 1;
+            uint32_t patchMisses = 0;
+            for (uint32_t triangle = begin; triangle < end; ++triangle) {
+                patchMisses += updateFIFOCache(&indices[triangle * 3], cacheSize, timestamps, timestamp);
+            }
+            const float clusterThreshold = threshold * float(patchMisses) / float(end - begin);
+
+            timestamp += cacheSize + 1;
+            OverdrawCluster cluster{ begin, 0, 0.0f };
+            uint32_t clusterMisses = 0;
+            for (uint32_t triangle = begin; triangle < end; ++triangle) {
+                clusterMisses += updateFIFOCache(&indices[triangle * 3], cacheSize, timestamps, timestamp);
+                ++cluster.numTriangles;
+                if (float(clusterMisses) <= clusterThreshold * float(cluster.numTriangles) && triangle + 1 < end) {
+                    clusters.push_back(cluster);
+                    cluster = OverdrawCluster{ triangle + 1, 0, 0.0f };
+                    clusterMisses = 0;
+                    timestamp += cacheSize + 1;
+                }
+            }
+            clusters.push_back(cluster);
+        }
+
+        // Clusters whose surface faces away from the mesh's center tend to be in front of the rest
+        glm::vec3 meshCenter{ 0.0f };
+        float meshArea = 0.0f;
+        for (uint32_t i = 0; i < numTriangles * 3; i += 3) {
+            const glm::vec3& a = positions[indices[i]];
+            const float area = glm::length(glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a));
+            meshCenter += (a + positions[indices[i + 1]] + positions[indices[i + 2]]) * (area / 3.0f);
+            meshArea += area;
+        }
+        meshCenter = meshArea > 0.0f ? meshCenter / meshArea : positions[indices[0]];
+
+        for (OverdrawCluster& cluster : clusters) {
+            glm::vec3 center{ 0.0f };
+            glm::vec3 normal{ 0.0f };
+            float area = 0.0f;
+            for (uint32_t i = cluster.firstTriangle * 3; i < (cluster.firstTriangle + cluster.numTriangles) * 3; i += 3) {
+                const glm::vec3& a = positions[indices[i]];
+                // Area weighted, as the cross product's length is twice the area
+                const glm::vec3 areaNormal = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+                const float triangleArea = glm::length(areaNormal);
+                center += (a + positions[indices[i + 1]] + positions[indices[i + 2]]) * (triangleArea / 3.0f);
+                normal += areaNormal;
+                area += triangleArea;
+            }
+            const float normalLength = glm::length(normal);
+            if (area > 0.0f && normalLength > 0.0f) {
+                cluster.sortKey = glm::dot(center / area - meshCenter, normal / normalLength);
+            }
+        }
+        std::stable_sort(clusters.begin(), clusters.end(), [](const OverdrawCluster& lhs, const OverdrawCluster& rhs) {
+            return lhs.sortKey > rhs.sortKey;
+        });
+
+        std::vector<uint32_t> orderedIndices;
+        orderedIndices.reserve(numTriangles * 3);
+        for (const OverdrawCluster& cluster : clusters) {
+            orderedIndices.insert(
+                orderedIndices.end(),
+                indices + cluster.firstTriangle * 3,
+                indices + (cluster.firstTriangle + cluster.numTriangles) * 3
+            );
+        }
+        std::copy(orderedIndices.begin(), orderedIndices.end(), indices);
+    }
+
+    void optimizeVertexFetch(
+        uint32_t* indices,
+        const uint32_t numIndices,
+        const uint32_t numVertices,
+        std::vector<uint32_t>& remap
+    )
+    {
+        remap.assign(numVertices, UINT32_MAX);
+        uint32_t nextVertex = 0;
+        for (uint32_t i = 0; i < numIndices; ++i) {
+            uint32_t& newVertex = remap[indices[i]];
+            if (newVertex == UINT32_MAX) {
+                newVertex = nextVertex++;
+            }
+            indices[i] = newVertex;
+        }
+        for (uint32_t vertex = 0; vertex < numVertices; ++vertex) {
+            if (remap[vertex] == UINT32_MAX) {
+                remap[vertex] = nextVertex++;
+            }
+        }
+    }
+
+    void remapVertexStream(
+        const uint8_t* source,
+        const uint32_t stride,
+        const uint32_t numVertices,
+        const std::vector<uint32_t>& remap,
+        uint8_t* destination
+    )
+    {
+        for (uint32_t vertex = 0; vertex < numVertices; ++vertex) {
+            memcpy(destination + size_t(remap[vertex]) * stride, source + size_t(vertex) * stride, stride);
+        }
+    }
+}
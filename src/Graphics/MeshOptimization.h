@@ -0,0 +1,64 @@
+#pragma once
+#include "pch.h"
+
+#include <vector>
+
+#include "Core/bdrMath.h"
+
+namespace bdr
+{
+    // Post transform cache size the statistics are simulated with, a FIFO like most hardware
+    constexpr uint32_t kVertexCacheStatsSize = 16;
+    // How much worse than the cache optimized order the overdraw order's clusters may get, as a ratio of ACMRs
+    constexpr float kOverdrawThreshold = 1.05f;
+
+    struct VertexCacheStats
+    {
+        // Average cache miss ratio, vertex shader invocations per triangle. 0.5 is the best a large regular grid can do.
+        float acmr = 0.0f;
+        // Average transformed vertex ratio, vertex shader invocations per referenced vertex. 1 is optimal.
+        float atvr = 0.0f;
+    };
+
+    VertexCacheStats analyzeVertexCache(
+        const uint32_t* indices,
+        const uint32_t numIndices,
+        const uint32_t numVertices,
+        const uint32_t cacheSize = kVertexCacheStatsSize
+    );
+
+    // Reorders triangles in place with Tom Forsyth's linear speed vertex cache optimization: triangles are picked
+    // greedily by the scores of their vertices, which favour vertices recently used in an LRU cache and vertices with
+    // few triangles left.
+    void optimizeVertexCache(uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices);
+
+    // Reorders the clusters of an already cache optimized index buffer so triangles facing out of the mesh come
+    // first and occlude the rest (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+    // Clusters start where the cache order jumps to a new patch, and are split further as long as their ACMR stays
+    // within threshold of the whole patch's.
+    void optimizeOverdraw(
+        const glm::vec3* positions,
+        uint32_t* indices,
+        const uint32_t numIndices,
+        const uint32_t numVertices,
+        const float threshold = kOverdrawThreshold
+    );
+
+    // Renumbers vertices in the order the indices first use them, rewriting indices in place. remap maps old vertex
+    // indices to new ones, unreferenced vertices are kept at the end in their original order.
+    void optimizeVertexFetch(
+        uint32_t* indices,
+        const uint32_t numIndices,
+        const uint32_t numVertices,
+        std::vector<uint32_t>& remap
+    );
+
+    // Writes every vertex of a stream to its remapped position in destination
+    void remapVertexStream(
+        const uint8_t* source,
+        const uint32_t stride,
+        const uint32_t numVertices,
+        const std::vector<uint32_t>& remap,
+        uint8_t* destination
+    );
+}
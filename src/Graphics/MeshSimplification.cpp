@@ -0,0 +1,443 @@
+#include "pch.h"
+#include "MeshSimplification.h"
+
+#include <queue>
+#include <unordered_map>
+
+
+namespace bdr
+{
+    // Position, normal and texcoord
+    constexpr uint32_t kQuadricDims = 8;
+    constexpr uint32_t kPackedSize = kQuadricDims * (kQuadricDims + 1) / 2;
+    // Boundary planes count this much more than the triangles along them
+    constexpr float kBoundaryWeight = 10.0f;
+    // Collapses may not turn a triangle's normal further than this, as a cosine
+    constexpr float kMinNormalCosine = 0.1f;
+    // A LOD that isn't at least this much smaller than the previous one ends the chain
+    constexpr float kMinLODReduction = 0.85f;
+
+    struct QuadricVector
+    {
+        double values[kQuadricDims] = { 0.0 };
+
+        inline double& operator[](const size_t index)
+        {
+            return values[index];
+        }
+        inline const double& operator[](const size_t index) const
+        {
+            return values[index];
+        }
+    };
+
+    // Q(x) = x'Ax + 2b'x + c, with the symmetric A stored as its upper triangle, row by row
+    struct Quadric
+    {
+        double a[kPackedSize] = { 0.0 };
+        double b[kQuadricDims] = { 0.0 };
+        double c = 0.0;
+        // Sum of the weights of everything added, errors are averaged over it
+        double weight = 0.0;
+    };
+
+    inline void add(Quadric& quadric, const Quadric& other)
+    {
+        for (uint32_t i = 0; i < kPackedSize; ++i) {
+            quadric.a[i] += other.a[i];
+        }
+        for (uint32_t i = 0; i < kQuadricDims; ++i) {
+            quadric.b[i] += other.b[i];
+        }
+        quadric.c += other.c;
+        quadric.weight += other.weight;
+    }
+
+    // Weighted mean squared distance from x to everything in the quadric
+    double evaluate(const Quadric& quadric, const QuadricVector& x)
+    {
+        if (quadric.weight <= 0.0) {
+            return 0.0;
+        }
+        double result = quadric.c;
+        uint32_t packedIdx = 0;
+        for (uint32_t i = 0; i < kQuadricDims; ++i) {
+            double row = 0.5 * quadric.a[packedIdx++] * x[i];
+            for (uint32_t j = i + 1; j < kQuadricDims; ++j) {
+                row += quadric.a[packedIdx++] * x[j];
+            }
+            result += 2.0 * x[i] * (row + quadric.b[i]);
+        }
+        return result / quadric.weight;
+    }
+
+    inline double dot(const QuadricVector& lhs, const QuadricVector& rhs)
+    {
+        double result = 0.0;
+        for (uint32_t i = 0; i < kQuadricDims; ++i) {
+            result += lhs[i] * rhs[i];
+        }
+        return result;
+    }
+
+    // Squared distance to the triangle's plane in attribute space, weighted by its area
+    void addTriangleQuadric(Quadric& quadric, const QuadricVector& p, const QuadricVector& q, const QuadricVector& r, const double weight)
+    {
+        QuadricVector e1;
+        QuadricVector e2;
+        for (uint32_t i = 0; i < kQuadricDims; ++i) {
+            e1[i] = q[i] - p[i];
+            e2[i] = r[i] - p[i];
+        }
+        const double length1 = sqrt(dot(e1, e1));
+        if (length1 < 1e-12) {
+            return;
+        }
+        for (uint32_t i = 0; i < kQuadricDims; ++i) {
+            e1[i] /= length1;
+        }
+        const double projection = dot(e1, e2);
+        for (uint32_t i = 0; i < kQuadricDims; ++i) {
+            e2[i] -= projection * e1[i];
+        }
+        const double length2 = sqrt(dot(e2, e2));
+        if (length2 < 1e-12) {
+            return;
+        }
+        for (uint32_t i = 0; i < kQuadricDims; ++i) {
+            e2[i] /= length2;
+        }
+
+        // A = I - e1e1' - e2e2', b = (p.e1)e1 + (p.e2)e2 - p, c = p.p - (p.e1)^2 - (p.e2)^2
+        const double pe1 = dot(p, e1);
+        const double pe2 = dot(p, e2);
+        uint32_t packedIdx = 0;
+        for (uint32_t i = 0; i < kQuadricDims; ++i) {
+            for (uint32_t j = i; j < kQuadricDims; ++j) {
+                const double identity = i == j ? 1.0 : 0.0;
+                quadric.a[packedIdx++] += weight * (identity - e1[i] * e1[j] - e2[i] * e2[j]);
+            }
+            quadric.b[i] += weight * (pe1 * e1[i] + pe2 * e2[i] - p[i]);
+        }
+        quadric.c += weight * (dot(p, p) - pe1 * pe1 - pe2 * pe2);
+        quadric.weight += weight;
+    }
+
+    // Squared distance to a plane through the positions
+    void addPlaneQuadric(Quadric& quadric, const glm::vec3& normal, const float distance, const double weight)
+    {
+        uint32_t packedIdx = 0;
+        for (uint32_t i = 0; i < 3; ++i) {
+            for (uint32_t j = i; j < kQuadricDims; ++j) {
+                quadric.a[packedIdx++] += j < 3 ? weight * normal[i] * normal[j] : 0.0;
+            }
+            quadric.b[i] += weight * distance * normal[i];
+        }
+        quadric.c += weight * distance * distance;
+        quadric.weight += weight;
+    }
+
+    struct Collapse
+    {
+        float cost;
+        uint32_t from;
+        uint32_t to;
+        // Versions of both vertices when this was queued, stale entries get skipped
+        uint32_t fromVersion;
+        uint32_t toVersion;
+
+        bool operator>(const Collapse& other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    struct Simplifier
+    {
+        // Positions normalized to the bounding sphere, for the flip test
+        std::vector<glm::vec3> positions;
+        std::vector<QuadricVector> vectors;
+        std::vector<Quadric> quadrics;
+        std::vector<uint32_t> indices;
+        std::vector<bool> isTriangleAlive;
+        std::vector<std::vector<uint32_t>> vertexTriangles;
+        std::vector<uint32_t> versions;
+        std::vector<bool> isAlive;
+        std::vector<bool> isLocked;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+        uint32_t numTriangles = 0;
+        float maxCost = 0.0f;
+    };
+
+    void getNeighbours(const Simplifier& simplifier, const uint32_t vertex, std::vector<uint32_t>& neighbours)
+    {
+        neighbours.clear();
+        for (const uint32_t triangle : simplifier.vertexTriangles[vertex]) {
+            if (!simplifier.isTriangleAlive[triangle]) {
+                continue;
+            }
+            for (uint32_t i = 0; i < 3; ++i) {
+                const uint32_t other = simplifier.indices[triangle * 3 + i];
+                if (other != vertex) {
+                    neighbours.push_back(other);
+                }
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    }
+
+    void queueCollapse(Simplifier& simplifier, const uint32_t from, const uint32_t to)
+    {
+        if (simplifier.isLocked[from]) {
+            return;
+        }
+        const float cost = float(std::max(evaluate(simplifier.quadrics[from], simplifier.vectors[to]), 0.0));
+        simplifier.queue.push({ cost, from, to, simplifier.versions[from], simplifier.versions[to] });
+    }
+
+    bool isCollapseValid(const Simplifier& simplifier, const Collapse& collapse, std::vector<uint32_t>& fromNeighbours, std::vector<uint32_t>& toNeighbours)
+    {
+        // Edges with more than two shared neighbours would leave non manifold geometry behind
+        getNeighbours(simplifier, collapse.from, fromNeighbours);
+        getNeighbours(simplifier, collapse.to, toNeighbours);
+        uint32_t numShared = 0;
+        auto toIt = toNeighbours.begin();
+        for (const uint32_t neighbour : fromNeighbours) {
+            toIt = std::lower_bound(toIt, toNeighbours.end(), neighbour);
+            numShared += (toIt != toNeighbours.end() && *toIt == neighbour) ? 1 : 0;
+        }
+        if (numShared > 2) {
+            return false;
+        }
+
+        const glm::vec3& target = simplifier.positions[collapse.to];
+        for (const uint32_t triangle : simplifier.vertexTriangles[collapse.from]) {
+            if (!simplifier.isTriangleAlive[triangle]) {
+                continue;
+            }
+            const uint32_t* corners = &simplifier.indices[triangle * 3];
+            if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to) {
+                continue;
+            }
+            glm::vec3 before[3];
+            glm::vec3 after[3];
+            for (uint32_t i = 0; i < 3; ++i) {
+                before[i] = simplifier.positions[corners[i]];
+                after[i] = corners[i] == collapse.from ? target : before[i];
+            }
+            const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            const float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+            if (lengths <= 0.0f || glm::dot(normalBefore, normalAfter) < kMinNormalCosine * lengths) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void applyCollapse(Simplifier& simplifier, const Collapse& collapse, std::vector<uint32_t>& neighbours)
+    {
+        for (const uint32_t triangle : simplifier.vertexTriangles[collapse.from]) {
+            if (!simplifier.isTriangleAlive[triangle]) {
+                continue;
+            }
+            uint32_t* corners = &simplifier.indices[triangle * 3];
+            if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to) {
+                simplifier.isTriangleAlive[triangle] = false;
+                --simplifier.numTriangles;
+                continue;
+            }
+            for (uint32_t i = 0; i < 3; ++i) {
+                corners[i] = corners[i] == collapse.from ? collapse.to : corners[i];
+            }
+            simplifier.vertexTriangles[collapse.to].push_back(triangle);
+        }
+        simplifier.vertexTriangles[collapse.from].clear();
+        simplifier.isAlive[collapse.from] = false;
+        add(simplifier.quadrics[collapse.to], simplifier.quadrics[collapse.from]);
+        ++simplifier.versions[collapse.to];
+        simplifier.maxCost = std::max(simplifier.maxCost, collapse.cost);
+
+        getNeighbours(simplifier, collapse.to, neighbours);
+        for (const uint32_t neighbour : neighbours) {
+            queueCollapse(simplifier, collapse.to, neighbour);
+            queueCollapse(simplifier, neighbour, collapse.to);
+        }
+    }
+
+    void initSimplifier(Simplifier& simplifier, const SimplificationInput& input, const uint32_t* indices, const uint32_t numIndices)
+    {
+        const uint32_t numVertices = input.numVertices;
+        const uint32_t numTriangles = numIndices / 3;
+        const AABB bounds = math::computeAABB(input.positions, numVertices);
+        const BoundingSphere sphere = math::computeBoundingSphere(input.positions, numVertices, bounds);
+        const float scale = 1.0f / std::max(sphere.radius, FLT_EPSILON);
+
+        simplifier.positions.resize(numVertices);
+        simplifier.vectors.resize(numVertices);
+        for (uint32_t vertex = 0; vertex < numVertices; ++vertex) {
+            QuadricVector& vector = simplifier.vectors[vertex];
+            simplifier.positions[vertex] = (input.positions[vertex] - sphere.center) * scale;
+            for (uint32_t i = 0; i < 3; ++i) {
+                vector[i] = simplifier.positions[vertex][i];
+            }
+            if (input.normals != nullptr) {
+                for (uint32_t i = 0; i < 3; ++i) {
+                    vector[3 + i] = input.normals[vertex][i] * input.normalWeight;
+                }
+            }
+            if (input.texcoords != nullptr) {
+                for (uint32_t i = 0; i < 2; ++i) {
+                    vector[6 + i] = input.texcoords[vertex][i] * input.texcoordWeight;
+                }
+            }
+        }
+
+        simplifier.indices.assign(indices, indices + numTriangles * 3);
+        simplifier.isTriangleAlive.assign(numTriangles, true);
+        simplifier.numTriangles = numTriangles;
+        simplifier.quadrics.assign(numVertices, Quadric{});
+        simplifier.vertexTriangles.assign(numVertices, {});
+        simplifier.versions.assign(numVertices, 0);
+        simplifier.isAlive.assign(numVertices, true);
+        simplifier.isLocked.assign(numVertices, false);
+
+        std::unordered_map<uint64_t, uint32_t> edgeCounts;
+        for (uint32_t triangle = 0; triangle < numTriangles; ++triangle) {
+            const uint32_t* corners = &simplifier.indices[triangle * 3];
+            const glm::vec3 edge0 = simplifier.positions[corners[1]] - simplifier.positions[corners[0]];
+            const glm::vec3 edge1 = simplifier.positions[corners[2]] - simplifier.positions[corners[0]];
+            const double area = 0.5 * glm::length(glm::cross(edge0, edge1));
+            Quadric quadric;
+            addTriangleQuadric(quadric, simplifier.vectors[corners[0]], simplifier.vectors[corners[1]], simplifier.vectors[corners[2]], area);
+            for (uint32_t i = 0; i < 3; ++i) {
+                add(simplifier.quadrics[corners[i]], quadric);
+                simplifier.vertexTriangles[corners[i]].push_back(triangle);
+                const uint32_t a = corners[i];
+                const uint32_t b = corners[(i + 1) % 3];
+                ++edgeCounts[(uint64_t(std::min(a, b)) << 32) | std::max(a, b)];
+            }
+        }
+
+        // Open edges get a plane perpendicular to their triangle so collapses keep them in place, vertices on
+        // non manifold edges just get locked
+        for (uint32_t triangle = 0; triangle < numTriangles; ++triangle) {
+            const uint32_t* corners = &simplifier.indices[triangle * 3];
+            const glm::vec3 faceNormal = glm::cross(
+                simplifier.positions[corners[1]] - simplifier.positions[corners[0]],
+                simplifier.positions[corners[2]] - simplifier.positions[corners[0]]
+            );
+            for (uint32_t i = 0; i < 3; ++i) {
+                const uint32_t a = corners[i];
+                const uint32_t b = corners[(i + 1) % 3];
+                const uint32_t count = edgeCounts[(uint64_t(std::min(a, b)) << 32) | std::max(a, b)];
+                if (count > 2) {
+                    simplifier.isLocked[a] = true;
+                    simplifier.isLocked[b] = true;
+                }
+                if (count != 1) {
+                    continue;
+                }
+                const glm::vec3 edge = simplifier.positions[b] - simplifier.positions[a];
+                const glm::vec3 planeNormal = glm::cross(edge, faceNormal);
+                const float length = glm::length(planeNormal);
+                if (length <= 0.0f) {
+                    continue;
+                }
+                const glm::vec3 normal = planeNormal / length;
+                const float distance = -glm::dot(normal, simplifier.positions[a]);
+                const double weight = kBoundaryWeight * glm::dot(edge, edge);
+                addPlaneQuadric(simplifier.quadrics[a], normal, distance, weight);
+                addPlaneQuadric(simplifier.quadrics[b], normal, distance, weight);
+            }
+        }
+
+        // Vertices sharing a position sit on a seam between attribute values, moving them would tear it open
+        std::vector<uint32_t> sortedVertices(numVertices);
+        for (uint32_t vertex = 0; vertex < numVertices; ++vertex) {
+            sortedVertices[vertex] = vertex;
+        }
+        const glm::vec3* positions = input.positions;
+        const auto isPositionLess = [positions](const uint32_t lhs, const uint32_t rhs) {
+            const glm::vec3& a = positions[lhs];
+            const glm::vec3& b = positions[rhs];
+            return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+        };
+        std::sort(sortedVertices.begin(), sortedVertices.end(), isPositionLess);
+        for (uint32_t i = 1; i < numVertices; ++i) {
+            if (positions[sortedVertices[i]] == positions[sortedVertices[i - 1]]) {
+                simplifier.isLocked[sortedVertices[i]] = true;
+                simplifier.isLocked[sortedVertices[i - 1]] = true;
+            }
+        }
+
+        for (const auto& edgeCount : edgeCounts) {
+            const uint32_t a = uint32_t(edgeCount.first >> 32);
+            const uint32_t b = uint32_t(edgeCount.first);
+            queueCollapse(simplifier, a, b);
+            queueCollapse(simplifier, b, a);
+        }
+    }
+
+    uint32_t generateLODChain(
+        const SimplificationInput& input,
+        const uint32_t* indices,
+        const uint32_t numIndices,
+        const uint32_t maxLODs,
+        const float maxError,
+        std::vector<uint32_t>& lodIndices,
+        MeshLOD* lods
+    )
+    {
+        ASSERT(maxLODs > 0);
+        lodIndices.assign(indices, indices + numIndices);
+        lods[0] = MeshLOD{ 0, numIndices, 0.0f };
+        if (maxLODs == 1 || numIndices < 6) {
+            return 1;
+        }
+
+        Simplifier simplifier;
+        initSimplifier(simplifier, input, indices, numIndices);
+
+        const float maxCost = maxError * maxError;
+        std::vector<uint32_t> fromNeighbours;
+        std::vector<uint32_t> toNeighbours;
+        uint32_t numLODs = 1;
+        bool isDone = false;
+        while (numLODs < maxLODs && !isDone) {
+            const uint32_t previousTriangles = lods[numLODs - 1].numIndices / 3;
+            const uint32_t targetTriangles = previousTriangles / 2;
+            while (simplifier.numTriangles > targetTriangles) {
+                if (simplifier.queue.empty() || simplifier.queue.top().cost > maxCost) {
+                    isDone = true;
+                    break;
+                }
+                const Collapse collapse = simplifier.queue.top();
+                simplifier.queue.pop();
+                if (!simplifier.isAlive[collapse.from] || !simplifier.isAlive[collapse.to]
+                    || simplifier.versions[collapse.from] != collapse.fromVersion
+                    || simplifier.versions[collapse.to] != collapse.toVersion) {
+                    continue;
+                }
+                if (isCollapseValid(simplifier, collapse, fromNeighbours, toNeighbours)) {
+                    applyCollapse(simplifier, collapse, toNeighbours);
+                }
+            }
+
+            if (float(simplifier.numTriangles) > kMinLODReduction * float(previousTriangles)) {
+                break;
+            }
+            MeshLOD& lod = lods[numLODs++];
+            lod.indexOffset = uint32_t(lodIndices.size());
+            lod.numIndices = simplifier.numTriangles * 3;
+            lod.error = sqrtf(simplifier.maxCost);
+            for (uint32_t triangle = 0; triangle < uint32_t(simplifier.isTriangleAlive.size()); ++triangle) {
+                if (simplifier.isTriangleAlive[triangle]) {
+                    lodIndices.insert(lodIndices.end(), &simplifier.indices[triangle * 3], &simplifier.indices[triangle * 3 + 3]);
+                }
+            }
+        }
+        return numLODs;
+    }
+}
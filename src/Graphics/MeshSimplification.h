@@ -0,0 +1,38 @@
+#pragma once
+#include "pch.h"
+
+#include <vector>
+
+#include "Resources.h"
+
+namespace bdr
+{
+    struct SimplificationInput
+    {
+        const glm::vec3* positions = nullptr;
+        // Optional, attributes only raise the cost of collapses that would distort them
+        const glm::vec3* normals = nullptr;
+        const glm::vec2* texcoords = nullptr;
+        uint32_t numVertices = 0;
+        // How much attribute differences count next to position differences, which are relative to the mesh's size
+        float normalWeight = 0.5f;
+        float texcoordWeight = 1.0f;
+    };
+
+    // Simplifies the mesh with quadric error metric edge collapses, onto existing vertices so every LOD can share
+    // the mesh's vertex buffers. Quadrics cover positions, normals and texcoords (Garland and Heckbert's
+    // generalized quadrics) plus planes holding open boundaries in place. Vertices on attribute seams are locked.
+    // Each LOD aims for half the previous one's triangles. The chain stops early at maxLODs, once collapses get
+    // more expensive than maxError, or once a level can't be made meaningfully smaller.
+    // lodIndices gets every LOD's indices one after the other, starting with the unchanged full detail indices.
+    // Returns the number of LODs written to lods.
+    uint32_t generateLODChain(
+        const SimplificationInput& input,
+        const uint32_t* indices,
+        const uint32_t numIndices,
+        const uint32_t maxLODs,
+        const float maxError,
+        std::vector<uint32_t>& lodIndices,
+        MeshLOD* lods
+    );
+}
@@ -0,0 +1,199 @@
+#include "pch.h"
+#include "Meshlets.h"
+#include "MeshOptimization.h"
+
+
+namespace bdr
+{
+    void finishMeshlet(
+        const glm::vec3* positions,
+        uint32_t* indices,
+        const std::vector<uint32_t>& vertices,
+        Meshlet& meshlet
+    )
+    {
+        // Growing by shared vertices wanders, so reorder for the vertex cache with the meshlet's own vertex indices
+        uint32_t localIndices[kMaxMeshletTriangles * 3];
+        for (uint32_t i = 0; i < meshlet.numIndices; ++i) {
+            localIndices[i] = uint32_t(std::find(vertices.begin(), vertices.end(), indices[meshlet.indexOffset + i]) - vertices.begin());
+        }
+        optimizeVertexCache(localIndices, meshlet.numIndices, uint32_t(vertices.size()));
+        for (uint32_t i = 0; i < meshlet.numIndices; ++i) {
+            indices[meshlet.indexOffset + i] = vertices[localIndices[i]];
+        }
+
+        glm::vec3 points[kMaxMeshletVertices];
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            points[i] = positions[vertices[i]];
+        }
+        meshlet.bounds = math::computeBoundingSphere(points, vertices.size(), math::computeAABB(points, vertices.size()));
+
+        glm::vec3 normals[kMaxMeshletTriangles];
+        uint32_t numNormals = 0;
+        glm::vec3 normalSum{ 0.0f };
+        for (uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.numIndices; i += 3) {
+            const glm::vec3& a = positions[indices[i]];
+            const glm::vec3 normal = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+            const float length = glm::length(normal);
+            // Degenerate triangles don't face anywhere
+            if (length > 0.0f) {
+                normals[numNormals++] = normal / length;
+                normalSum += normal / length;
+            }
+        }
+
+        meshlet.coneAxis = glm::vec3{ 0.0f };
+        meshlet.coneCutoff = 1.0f;
+        const float sumLength = glm::length(normalSum);
+        if (numNormals == 0 || sumLength <= 0.0f) {
+            return;
+        }
+        const glm::vec3 axis = normalSum / sumLength;
+        float minDot = 1.0f;
+        for (uint32_t i = 0; i < numNormals; ++i) {
+            minDot = std::min(minDot, glm::dot(axis, normals[i]));
+        }
+        // Normals more than 90 degrees apart can face every direction
+        if (minDot > 0.0f) {
+            meshlet.coneAxis = axis;
+            meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+        }
+    }
+
+    void buildMeshlets(
+        const glm::vec3* positions,
+        uint32_t* indices,
+        const uint32_t numIndices,
+        std::vector<Meshlet>& meshlets
+    )
+    {
+        const uint32_t numTriangles = numIndices / 3;
+        uint32_t numVertices = 0;
+        for (uint32_t i = 0; i < numTriangles * 3; ++i) {
+            numVertices = std::max(numVertices, indices[i] + 1);
+        }
+
+        // Triangles using each vertex
+        std::vector<uint32_t> adjacencyOffsets(numVertices + 1, 0);
+        for (uint32_t i = 0; i < numTriangles * 3; ++i) {
+            ++adjacencyOffsets[indices[i] + 1];
+        }
+        for (uint32_t vertex = 0; vertex < numVertices; ++vertex) {
+            adjacencyOffsets[vertex + 1] += adjacencyOffsets[vertex];
+        }
+        std::vector<uint32_t> adjacency(adjacencyOffsets.back());
+        std::vector<uint32_t> adjacencyCounts(numVertices, 0);
+        for (uint32_t i = 0; i < numTriangles * 3; ++i) {
+            const uint32_t vertex = indices[i];
+            adjacency[adjacencyOffsets[vertex] + adjacencyCounts[vertex]++] = i / 3;
+        }
+
+        std::vector<bool> isEmitted(numTriangles, false);
+        // Meshlet each vertex was last added to, plus one
+        std::vector<uint32_t> vertexMeshlets(numVertices, 0);
+        // Meshlet each triangle was last made a candidate of, plus one
+        std::vector<uint32_t> candidateMeshlets(numTriangles, 0);
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> meshletVertices;
+        std::vector<uint32_t> orderedIndices;
+        orderedIndices.reserve(numTriangles * 3);
+
+        uint32_t seedCursor = 0;
+        while (orderedIndices.size() < numTriangles * 3) {
+            while (isEmitted[seedCursor]) {
+                ++seedCursor;
+            }
+            const uint32_t meshletId = uint32_t(meshlets.size()) + 1;
+            Meshlet meshlet;
+            meshlet.indexOffset = uint32_t(orderedIndices.size());
+            meshletVertices.clear();
+            candidates.clear();
+            glm::vec3 positionSum{ 0.0f };
+
+            uint32_t triangle = seedCursor;
+            while (triangle != UINT32_MAX) {
+                isEmitted[triangle] = true;
+                for (uint32_t i = 0; i < 3; ++i) {
+                    const uint32_t vertex = indices[triangle * 3 + i];
+                    orderedIndices.push_back(vertex);
+                    if (vertexMeshlets[vertex] == meshletId) {
+                        continue;
+                    }
+                    vertexMeshlets[vertex] = meshletId;
+                    meshletVertices.push_back(vertex);
+                    positionSum += positions[vertex];
+                    for (uint32_t j = adjacencyOffsets[vertex]; j < adjacencyOffsets[vertex + 1]; ++j) {
+                        const uint32_t neighbour = adjacency[j];
+                        if (!isEmitted[neighbour] && candidateMeshlets[neighbour] != meshletId) {
+                            candidateMeshlets[neighbour] = meshletId;
+                            candidates.push_back(neighbour);
+                        }
+                    }
+                }
+                meshlet.numIndices += 3;
+                if (meshlet.numIndices == kMaxMeshletTriangles * 3) {
+                    break;
+                }
+
+                // Next is the candidate adding the fewest new vertices, then the one closest to the meshlet's center
+                const glm::vec3 center = positionSum / float(meshletVertices.size());
+                triangle = UINT32_MAX;
+                uint32_t bestNewVertices = UINT32_MAX;
+                float bestDistance = FLT_MAX;
+                size_t numCandidates = 0;
+                for (const uint32_t candidate : candidates) {
+                    if (isEmitted[candidate]) {
+                        continue;
+                    }
+                    candidates[numCandidates++] = candidate;
+                    const uint32_t* corners = &indices[candidate * 3];
+                    uint32_t newVertices = 0;
+                    for (uint32_t i = 0; i < 3; ++i) {
+                        newVertices += vertexMeshlets[corners[i]] == meshletId ? 0 : 1;
+                    }
+                    if (meshletVertices.size() + newVertices > kMaxMeshletVertices || newVertices > bestNewVertices) {
+                        continue;
+                    }
+                    const glm::vec3 centroid = (positions[corners[0]] + positions[corners[1]] + positions[corners[2]]) / 3.0f;
+                    const glm::vec3 offset = centroid - center;
+                    const float distance = glm::dot(offset, offset);
+                    if (newVertices < bestNewVertices || distance < bestDistance) {
+                        triangle = candidate;
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+                candidates.resize(numCandidates);
+            }
+
+            finishMeshlet(positions, orderedIndices.data(), meshletVertices, meshlet);
+            meshlets.push_back(meshlet);
+        }
+        std::copy(orderedIndices.begin(), orderedIndices.end(), indices);
+    }
+
+    uint32_t addMeshlets(MeshletStore& store, const std::vector<Meshlet>& meshlets)
+    {
+        const uint32_t firstMeshlet = uint32_t(store.radius.size());
+        const size_t paddedSize = firstMeshlet + (meshlets.size() + kMeshletPadding - 1) / kMeshletPadding * kMeshletPadding;
+        for (const Meshlet& meshlet : meshlets) {
+            store.centerX.push_back(meshlet.bounds.center.x);
+            store.centerY.push_back(meshlet.bounds.center.y);
+            store.centerZ.push_back(meshlet.bounds.center.z);
+            store.radius.push_back(meshlet.bounds.radius);
+            store.coneAxisX.push_back(meshlet.coneAxis.x);
+            store.coneAxisY.push_back(meshlet.coneAxis.y);
+            store.coneAxisZ.push_back(meshlet.coneAxis.z);
+            store.coneCutoff.push_back(meshlet.coneCutoff);
+            store.indexOffsets.push_back(meshlet.indexOffset);
+            store.numIndices.push_back(meshlet.numIndices);
+        }
+        for (std::vector<float>* values : { &store.centerX, &store.centerY, &store.centerZ, &store.radius, &store.coneAxisX, &store.coneAxisY, &store.coneAxisZ }) {
+            values->resize(paddedSize, 0.0f);
+        }
+        store.coneCutoff.resize(paddedSize, 1.0f);
+        store.indexOffsets.resize(paddedSize, 0);
+        store.numIndices.resize(paddedSize, 0);
+        return firstMeshlet;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "pch.h"
+
+#include <vector>
+
+#include "Core/bdrMath.h"
+
+namespace bdr
+{
+    constexpr uint32_t kMaxMeshletVertices = 64;
+    constexpr uint32_t kMaxMeshletTriangles = 124;
+    // Meshes with fewer triangles than this are left to per object culling
+    constexpr uint32_t kMinMeshletMeshTriangles = 4 * kMaxMeshletTriangles;
+    // Each mesh's range of the store is padded to a multiple of this, so SIMD culling never reads past it
+    constexpr uint32_t kMeshletPadding = 8;
+
+    // A cluster of triangles that's contiguous in its mesh's index buffer, with everything needed to cull it
+    struct Meshlet
+    {
+        BoundingSphere bounds;
+        // Every triangle's normal is within the cone around coneAxis, coneCutoff is the sine of its half angle.
+        // A cutoff of one never gets culled.
+        glm::vec3 coneAxis{ 0.0f };
+        float coneCutoff = 1.0f;
+        uint32_t indexOffset = 0;
+        uint32_t numIndices = 0;
+    };
+
+    // Splits the triangles into meshlets of at most kMaxMeshletVertices unique vertices and kMaxMeshletTriangles
+    // triangles, grown greedily over shared vertices then by distance. Reorders indices so each meshlet's triangles
+    // are contiguous and ordered for the vertex cache, indexOffsets are relative to indices.
+    void buildMeshlets(
+        const glm::vec3* positions,
+        uint32_t* indices,
+        const uint32_t numIndices,
+        std::vector<Meshlet>& meshlets
+    );
+
+    // Every mesh's meshlets in SoA, what cluster culling reads
+    struct MeshletStore
+    {
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> radius;
+        std::vector<float> coneAxisX;
+        std::vector<float> coneAxisY;
+        std::vector<float> coneAxisZ;
+        std::vector<float> coneCutoff;
+        std::vector<uint32_t> indexOffsets;
+        std::vector<uint32_t> numIndices;
+    };
+
+    // Returns the index of the mesh's first meshlet in the store
+    uint32_t addMeshlets(MeshletStore& store, const std::vector<Meshlet>& meshlets);
+}
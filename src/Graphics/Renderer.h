@@ -8,6 +8,8 @@
 #include "Texture.h"
 #include "ResourceManager.h"
 #include "PipelineState.h"
+#include "Meshlets.h"
+#include "GeometryPool.h"
 
 
 namespace bdr
@@ -86,6 +88,10 @@ namespace bdr
 
         InputLayoutManager inputLayoutManager;
         ResourceManager<Mesh, MeshHandle> meshes;
+        // Indexed like meshes, see updateDrawRecord
+        std::vector<MeshDrawRecord, Memory::AlignedAllocator<MeshDrawRecord, 64>> meshDrawRecords;
+        ResourceManager<GeometryPool, GeometryPoolHandle> geometryPools;
+        MeshletStore meshlets;
         ResourceManager<GPUBuffer, GPUBufferHandle> jointBuffers;
         ResourceManager<Texture, TextureHandle> textures;
         ResourceManager<GPUBuffer, GPUBufferHandle> constantBuffers;
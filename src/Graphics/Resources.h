@@ -5,6 +5,7 @@
 #include <string>
 #include <functional>
 
+#include "Core/bdrMath.h"
 #include "Core/Map.h"
 #include "DXHelpers.h"
 #include "RenderStates.h"
@@ -35,6 +36,9 @@ namespace bdr
         UINT16_4,
         UNORM16_4,
         FLOAT_4,
+        // Octahedral normals
+        SNORM16_2,
+        FLOAT16_2,
 
         STRUCTURED,
     };
@@ -59,6 +63,15 @@ namespace bdr
         Structured,
     };
 
+    enum class VertexLayout : uint8_t
+    {
+        // One vertex buffer per attribute
+        SEPARATE = 0,
+        // Positions alone in the first vertex buffer, for depth only passes, every other attribute interleaved in
+        // the second. Shaders can't read or write these buffers.
+        INTERLEAVED,
+    };
+
     enum MeshAttribute : uint8_t
     {
         INVALID = 0,
@@ -133,20 +146,79 @@ namespace bdr
     };
 
     RESOURCE_HANDLE(MeshHandle);
+    RESOURCE_HANDLE(GeometryPoolHandle);
+    // Range of a mesh's index buffer drawn at some level of detail
+    struct MeshLOD
+    {
+        uint32_t indexOffset = 0;
+        uint32_t numIndices = 0;
+        // Simplification error, relative to the radius of the mesh's bounding sphere
+        float error = 0.0f;
+    };
+
     struct Mesh
     {
         static constexpr size_t maxAttrCount = 6u;
+        static constexpr size_t maxLODs = 6u;
         GPUBuffer indexBuffer;
         GPUBuffer vertexBuffers[maxAttrCount];
         ID3D11InputLayout* inputLayoutHandle = nullptr;
+        // Per vertex buffer
         uint32_t strides[maxAttrCount] = { 0 };
         MeshAttribute attributes[Mesh::maxAttrCount] = { MeshAttribute::INVALID };
+        VertexLayout vertexLayout = VertexLayout::SEPARATE;
+        uint8_t numVertexBuffers = 0;
+        // Pooled meshes have no buffers of their own, only indexBuffer.format is set. Their vertices and indices
+        // start at baseVertex and firstIndex of the pool's buffers.
+        GeometryPoolHandle geometryPool = INVALID_HANDLE;
+        uint32_t baseVertex = 0;
+        uint32_t firstIndex = 0;
         uint32_t numIndices = 0;
         uint32_t numVertices = 0;
         MeshHandle preskinMeshId = INVALID_HANDLE;
         uint8_t presentAttributesMask = 0;
         uint8_t numPresentAttr = 0;
+        // Object space bounds of the POSITION attribute
+        AABB bounds;
+        BoundingSphere boundingSphere;
+        // LOD 0 is the full detail mesh, numIndices long. All LODs share the vertex buffers.
+        MeshLOD lods[maxLODs];
+        uint8_t numLODs = 1;
+        // Range of Renderer::meshlets splitting up LOD 0, empty for meshes too small to be worth it
+        uint32_t firstMeshlet = 0;
+        uint32_t numMeshlets = 0;
+        // Positions are UNORM16 over bounds, see getDequantizationTransform
+        bool hasQuantizedPositions = false;
+    };
+
+    // Most vertex buffers a draw record can bind
+    constexpr uint32_t kMaxDrawVertexBuffers = 4u;
+
+    enum MeshDrawFlags : uint8_t
+    {
+        HAS_LODS = (1 << 0),
+        HAS_MESHLETS = (1 << 1),
+        HAS_QUANTIZED_POSITIONS = (1 << 2),
+        // More streams or wider strides than the record holds, vertex buffers get bound from the Mesh instead
+        BINDS_FROM_MESH = (1 << 3),
+    };
+
+    // What the draw loop needs to bind and draw a mesh, packed into one cache line. Kept in
+    // Renderer::meshDrawRecords, apart from the Mesh, which only gets read for the flagged features.
+    struct alignas(64) MeshDrawRecord
+    {
+        ID3D11Buffer* vertexBuffers[kMaxDrawVertexBuffers] = { nullptr };
+        ID3D11Buffer* indexBuffer = nullptr;
+        uint32_t firstIndex = 0;
+        int32_t baseVertex = 0;
+        // LOD 0's
+        uint32_t numIndices = 0;
+        uint8_t strides[kMaxDrawVertexBuffers] = { 0 };
+        BufferFormat indexFormat = BufferFormat::INVALID;
+        uint8_t numVertexBuffers = 0;
+        uint8_t flags = 0;
     };
+    static_assert(sizeof(MeshDrawRecord) == 64, "Draw records should fill a cache line");
 
     struct MeshCreationInfo
     {
@@ -161,6 +233,23 @@ namespace bdr
         uint32_t numVertices = 0;
         uint8_t numAttributes = 0;
         uint8_t presentAttributesMask = 0;
+        // Leave empty to have createMesh scan the positions for them
+        AABB bounds;
+        // Up to Mesh::maxLODs, anything above one has createMesh generate coarser LODs
+        uint8_t numLODs = 1;
+        // Splits LOD 0 into meshlets for cluster culling, for meshes large enough to be worth it
+        bool buildMeshlets = false;
+        // Reorders triangles for the post transform cache and less overdraw
+        bool optimizeTriangleOrder = false;
+        // Reorders vertices in the order triangles use them. Anything else indexing the vertices has to be remapped.
+        bool optimizeVertexOrder = false;
+        // Quantizes float positions, normals and texcoords, see VertexQuantization.h. Not for vertex buffers that
+        // skinning or morph targets write to.
+        bool quantizeVertices = false;
+        // INTERLEAVED needs every attribute to be BufferUsage::VERTEX only
+        VertexLayout vertexLayout = VertexLayout::SEPARATE;
+        // Sub-allocates the mesh from Renderer::geometryPools, see GeometryPool.h. Same usage restriction as INTERLEAVED.
+        bool useGeometryPool = false;
     };
 
     struct InputLayoutDesc
@@ -168,6 +257,7 @@ namespace bdr
         uint8_t numAttributes = 0;
         MeshAttribute attributes[Mesh::maxAttrCount] = { MeshAttribute::INVALID };
         BufferFormat bufferFormats[Mesh::maxAttrCount] = { BufferFormat::INVALID };
+        VertexLayout vertexLayout = VertexLayout::SEPARATE;
     };
 
     struct TextureCreationInfo
@@ -0,0 +1,78 @@
+#include "pch.h"
+#include "VertexInterleaving.h"
+#include "GPUBuffer.h"
+
+
+namespace bdr
+{
+    InterleavedLayout getInterleavedLayout(
+        const BufferFormat* bufferFormats,
+        const MeshAttribute* attributes,
+        const uint8_t numAttributes
+    )
+    {
+        InterleavedLayout layout{};
+        for (uint8_t i = 0; i < numAttributes; ++i) {
+            if (attributes[i] == MeshAttribute::POSITION) {
+                continue;
+            }
+            layout.offsets[i] = layout.stride;
+            layout.stride += (getByteSize(bufferFormats[i]) + 3u) & ~3u;
+        }
+        return layout;
+    }
+
+    // Fixed size copies compile down to plain loads and stores instead of memcpy calls
+    template<uint32_t elementSize>
+    void copyElements(const uint8_t* source, const uint32_t numVertices, const uint32_t stride, uint8_t* destination)
+    {
+        for (uint32_t i = 0; i < numVertices; ++i) {
+            memcpy(destination + size_t(i) * stride, source + size_t(i) * elementSize, elementSize);
+        }
+    }
+
+    void copyElements(const uint8_t* source, const uint32_t elementSize, const uint32_t numVertices, const uint32_t stride, uint8_t* destination)
+    {
+        switch (elementSize) {
+        case 2u:
+            copyElements<2u>(source, numVertices, stride, destination);
+            break;
+        case 4u:
+            copyElements<4u>(source, numVertices, stride, destination);
+            break;
+        case 8u:
+            copyElements<8u>(source, numVertices, stride, destination);
+            break;
+        case 12u:
+            copyElements<12u>(source, numVertices, stride, destination);
+            break;
+        case 16u:
+            copyElements<16u>(source, numVertices, stride, destination);
+            break;
+        default:
+            for (uint32_t i = 0; i < numVertices; ++i) {
+                memcpy(destination + size_t(i) * stride, source + size_t(i) * elementSize, elementSize);
+            }
+        }
+    }
+
+    void interleaveVertexStreams(
+        const uint8_t* const* sources,
+        const uint32_t* elementSizes,
+        const uint32_t* offsets,
+        const uint32_t numStreams,
+        const uint32_t numVertices,
+        const uint32_t stride,
+        uint8_t* destination
+    )
+    {
+        for (uint32_t blockStart = 0; blockStart < numVertices; blockStart += kInterleaveBlockSize) {
+            const uint32_t blockSize = std::min(kInterleaveBlockSize, numVertices - blockStart);
+            uint8_t* block = destination + size_t(blockStart) * stride;
+            for (uint32_t stream = 0; stream < numStreams; ++stream) {
+                const uint8_t* source = sources[stream] + size_t(blockStart) * elementSizes[stream];
+                copyElements(source, elementSizes[stream], blockSize, stride, block + offsets[stream]);
+            }
+        }
+    }
+}
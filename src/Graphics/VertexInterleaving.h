@@ -0,0 +1,35 @@
+#pragma once
+#include "pch.h"
+
+#include "Resources.h"
+
+namespace bdr
+{
+    // Vertices interleaved per block, so the block being written stays in cache while each stream is copied in
+    constexpr uint32_t kInterleaveBlockSize = 256;
+
+    // Where every attribute other than POSITION lives in an interleaved vertex. Elements and the stride are 4 byte
+    // aligned, padding is left as zeros.
+    struct InterleavedLayout
+    {
+        uint32_t offsets[Mesh::maxAttrCount] = { 0 };
+        uint32_t stride = 0;
+    };
+
+    InterleavedLayout getInterleavedLayout(
+        const BufferFormat* bufferFormats,
+        const MeshAttribute* attributes,
+        const uint8_t numAttributes
+    );
+
+    // Copies element i of each source stream to destination + i * stride + offsets[stream]
+    void interleaveVertexStreams(
+        const uint8_t* const* sources,
+        const uint32_t* elementSizes,
+        const uint32_t* offsets,
+        const uint32_t numStreams,
+        const uint32_t numVertices,
+        const uint32_t stride,
+        uint8_t* destination
+    );
+}
@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "VertexQuantization.h"
+
+#include <glm/gtc/packing.hpp>
+
+
+namespace bdr
+{
+    void quantizePositions(const glm::vec3* positions, const uint32_t numVertices, const AABB& bounds, glm::u16vec4* output)
+    {
+        const glm::vec3 extent = bounds.max - bounds.min;
+        // Flat axes all quantize to zero
+        const glm::vec3 scale{
+            extent.x > 0.0f ? 65535.0f / extent.x : 0.0f,
+            extent.y > 0.0f ? 65535.0f / extent.y : 0.0f,
+            extent.z > 0.0f ? 65535.0f / extent.z : 0.0f,
+        };
+        for (uint32_t i = 0; i < numVertices; ++i) {
+            const glm::vec3 quantized = glm::clamp((positions[i] - bounds.min) * scale + 0.5f, glm::vec3{ 0.0f }, glm::vec3{ 65535.0f });
+            output[i] = glm::u16vec4{ quantized.x, quantized.y, quantized.z, 0 };
+        }
+    }
+
+    glm::mat4 getDequantizationTransform(const AABB& bounds)
+    {
+        glm::mat4 transform{ 1.0f };
+        transform[0][0] = bounds.max.x - bounds.min.x;
+        transform[1][1] = bounds.max.y - bounds.min.y;
+        transform[2][2] = bounds.max.z - bounds.min.z;
+        transform[3] = glm::vec4{ bounds.min, 1.0f };
+        return transform;
+    }
+
+    inline glm::vec2 signNotZero(const glm::vec2& v)
+    {
+        return glm::vec2{ v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f };
+    }
+
+    glm::vec3 decodeOctahedral(const glm::i16vec2 encoded)
+    {
+        // SNORM conversion, -32768 and -32767 both map to -1
+        const glm::vec2 e = glm::max(glm::vec2{ encoded } / 32767.0f, glm::vec2{ -1.0f });
+        glm::vec3 normal{ e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y) };
+        if (normal.z < 0.0f) {
+            const glm::vec2 folded = (1.0f - glm::abs(glm::vec2{ normal.y, normal.x })) * signNotZero(glm::vec2{ normal });
+            normal.x = folded.x;
+            normal.y = folded.y;
+        }
+        return glm::normalize(normal);
+    }
+
+    glm::i16vec2 encodeOctahedral(const glm::vec3& normal)
+    {
+        const float l1Norm = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+        if (l1Norm <= 0.0f) {
+            return glm::i16vec2{ 0, 0 };
+        }
+        glm::vec2 e = glm::vec2{ normal } / l1Norm;
+        if (normal.z < 0.0f) {
+            e = (1.0f - glm::abs(glm::vec2{ e.y, e.x })) * signNotZero(e);
+        }
+
+        const glm::vec2 scaled = e * 32767.0f;
+        const glm::vec2 base = glm::floor(scaled);
+        const glm::vec3 unitNormal = normal / glm::length(normal);
+        glm::i16vec2 best{ 0, 0 };
+        float bestDot = -2.0f;
+        for (uint32_t i = 0; i < 4; ++i) {
+            const glm::vec2 candidate = glm::clamp(base + glm::vec2{ float(i & 1), float(i >> 1) }, glm::vec2{ -32767.0f }, glm::vec2{ 32767.0f });
+            const glm::i16vec2 encoded{ candidate };
+            const float candidateDot = glm::dot(decodeOctahedral(encoded), unitNormal);
+            if (candidateDot > bestDot) {
+                bestDot = candidateDot;
+                best = encoded;
+            }
+        }
+        return best;
+    }
+
+    void quantizeNormals(const glm::vec3* normals, const uint32_t numVertices, glm::i16vec2* output)
+    {
+        for (uint32_t i = 0; i < numVertices; ++i) {
+            output[i] = encodeOctahedral(normals[i]);
+        }
+    }
+
+    void quantizeTexcoords(const glm::vec2* texcoords, const uint32_t numVertices, uint32_t* output)
+    {
+        for (uint32_t i = 0; i < numVertices; ++i) {
+            output[i] = glm::packHalf2x16(texcoords[i]);
+        }
+    }
+}
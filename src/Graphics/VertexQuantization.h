@@ -0,0 +1,25 @@
+#pragma once
+#include "pch.h"
+
+#include "Core/bdrMath.h"
+
+namespace bdr
+{
+    // Positions as UNORM16_4, normalized to the mesh's bounds. w is left at zero, shaders only read xyz.
+    void quantizePositions(const glm::vec3* positions, const uint32_t numVertices, const AABB& bounds, glm::u16vec4* output);
+
+    // Maps quantized positions back into object space, to be applied before the model matrix
+    glm::mat4 getDequantizationTransform(const AABB& bounds);
+
+    // Octahedral encoding into SNORM16_2: the unit sphere is projected onto an octahedron, whose lower half is folded
+    // over the upper one. Picks whichever of the neighbouring encodings decodes closest to the normal.
+    glm::i16vec2 encodeOctahedral(const glm::vec3& normal);
+
+    // Same decode as the shaders' decodeOctahedral
+    glm::vec3 decodeOctahedral(const glm::i16vec2 encoded);
+
+    void quantizeNormals(const glm::vec3* normals, const uint32_t numVertices, glm::i16vec2* output);
+
+    // Texcoords as FLOAT16_2, precise to about a texel of a 2048 texture over [0, 1]
+    void quantizeTexcoords(const glm::vec2* texcoords, const uint32_t numVertices, uint32_t* output);
+}
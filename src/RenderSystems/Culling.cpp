@@ -0,0 +1,226 @@
+#include "pch.h"
+#include "Culling.h"
+
+#include "Core/bdrSimd.h"
+#include "Game/ECSRegistry.h"
+#include "Graphics/Meshlets.h"
+#include "OcclusionCulling.h"
+#include "PotentiallyVisibleSet.h"
+
+
+namespace bdr
+{
+    using simd::FloatV;
+    constexpr uint32_t kLanes = simd::laneWidth;
+    constexpr uint32_t kNumPlanes = 6;
+
+    void cullRenderObjects(
+        const math::Frustum& frustum,
+        const ECSRegistry& registry,
+        const std::vector<RenderObject>& renderObjects,
+        std::vector<uint32_t>& visibleObjects,
+        CullingStats& stats
+    )
+    {
+        static_assert(sizeof(AABB) == 6 * sizeof(float), "World bounds are gathered as 6 packed floats");
+        const uint32_t numObjects = uint32_t(renderObjects.size());
+        if (numObjects == 0) {
+            return;
+        }
+
+        FloatV planes[kNumPlanes][4];
+        FloatV absNormals[kNumPlanes][3];
+        for (uint32_t p = 0; p < kNumPlanes; ++p) {
+            for (uint32_t c = 0; c < 4; ++c) {
+                planes[p][c] = simd::set1(frustum.planes[p][c]);
+            }
+            for (uint32_t c = 0; c < 3; ++c) {
+                absNormals[p][c] = simd::abs(planes[p][c]);
+            }
+        }
+        const FloatV half = simd::set1(0.5f);
+        const float* worldBounds = &registry.worldBounds[0].min.x;
+
+        const size_t firstVisible = visibleObjects.size();
+        visibleObjects.reserve(firstVisible + numObjects);
+        for (uint32_t first = 0; first < numObjects; first += kLanes) {
+            const uint32_t numLanes = std::min(kLanes, numObjects - first);
+            const uint32_t laneMask = (1u << numLanes) - 1u;
+
+            // Lanes past the end and entities without bounds read the first entity's bounds, their results get masked
+            alignas(32) int32_t boundsOffsets[kLanes] = { 0 };
+            uint32_t unboundedMask = 0;
+            for (uint32_t lane = 0; lane < numLanes; ++lane) {
+                const uint32_t entity = renderObjects[first + lane].entityId;
+                if (registry.cmpMasks[entity] & CmpMasks::BOUNDS) {
+                    boundsOffsets[lane] = int32_t(entity * 6);
+                }
+                else {
+                    unboundedMask |= 1u << lane;
+                }
+            }
+
+            FloatV center[3];
+            FloatV extents[3];
+            for (uint32_t c = 0; c < 3; ++c) {
+                const FloatV minimum = simd::gather(worldBounds + c, boundsOffsets);
+                const FloatV maximum = simd::gather(worldBounds + 3 + c, boundsOffsets);
+                center[c] = simd::mul(simd::add(maximum, minimum), half);
+                extents[c] = simd::mul(simd::sub(maximum, minimum), half);
+            }
+
+            // Spheres first, the box's bounding sphere only needs one radius for every plane
+            FloatV radius = simd::mul(extents[0], extents[0]);
+            radius = simd::madd(extents[1], extents[1], radius);
+            radius = simd::sqrt(simd::madd(extents[2], extents[2], radius));
+            const FloatV negRadius = simd::negate(radius);
+
+            FloatV distances[kNumPlanes];
+            FloatV isOutside = simd::zero();
+            for (uint32_t p = 0; p < kNumPlanes; ++p) {
+                FloatV distance = simd::madd(planes[p][0], center[0], planes[p][3]);
+                distance = simd::madd(planes[p][1], center[1], distance);
+                distances[p] = simd::madd(planes[p][2], center[2], distance);
+                isOutside = simd::bitOr(isOutside, simd::cmpLt(distances[p], negRadius));
+            }
+
+            // Then the boxes, if any are left that could still be culled
+            if ((~simd::moveMask(isOutside) & ~unboundedMask & laneMask) != 0) {
+                for (uint32_t p = 0; p < kNumPlanes; ++p) {
+                    FloatV projectedRadius = simd::mul(absNormals[p][0], extents[0]);
+                    projectedRadius = simd::madd(absNormals[p][1], extents[1], projectedRadius);
+                    projectedRadius = simd::madd(absNormals[p][2], extents[2], projectedRadius);
+                    isOutside = simd::bitOr(isOutside, simd::cmpLt(distances[p], simd::negate(projectedRadius)));
+                }
+            }
+
+            const uint32_t visibleMask = (~simd::moveMask(isOutside) | unboundedMask) & laneMask;
+            for (uint32_t lane = 0; lane < numLanes; ++lane) {
+                if (visibleMask & (1u << lane)) {
+                    visibleObjects.push_back(first + lane);
+                }
+            }
+        }
+
+        const uint32_t numVisible = uint32_t(visibleObjects.size() - firstVisible);
+        stats.numVisible += numVisible;
+        stats.numCulled += numObjects - numVisible;
+    }
+
+    void cullOccludedObjects(
+        const OcclusionBuffer& buffer,
+        const ECSRegistry& registry,
+        const std::vector<RenderObject>& renderObjects,
+        std::vector<uint32_t>& visibleObjects,
+        CullingStats& stats
+    )
+    {
+        size_t numVisible = 0;
+        for (const uint32_t renderObjectIdx : visibleObjects) {
+            const uint32_t entity = renderObjects[renderObjectIdx].entityId;
+            if ((registry.cmpMasks[entity] & CmpMasks::BOUNDS) && isOccluded(buffer, registry.worldBounds[entity])) {
+                continue;
+            }
+            visibleObjects[numVisible++] = renderObjectIdx;
+        }
+        const uint32_t numOccluded = uint32_t(visibleObjects.size() - numVisible);
+        visibleObjects.resize(numVisible);
+        stats.numVisible -= numOccluded;
+        stats.numOccluded += numOccluded;
+    }
+
+    void cullPVSObjects(
+        const std::vector<uint64_t>& visibleEntities,
+        const std::vector<RenderObject>& renderObjects,
+        std::vector<uint32_t>& visibleObjects,
+        CullingStats& stats
+    )
+    {
+        size_t numVisible = 0;
+        for (const uint32_t renderObjectIdx : visibleObjects) {
+            if (isEntityVisible(visibleEntities, renderObjects[renderObjectIdx].entityId)) {
+                visibleObjects[numVisible++] = renderObjectIdx;
+            }
+        }
+        const uint32_t numHidden = uint32_t(visibleObjects.size() - numVisible);
+        visibleObjects.resize(numVisible);
+        stats.numVisible -= numHidden;
+        stats.numOccluded += numHidden;
+    }
+
+    uint32_t cullMeshlets(
+        const MeshletStore& store,
+        const uint32_t firstMeshlet,
+        const uint32_t numMeshlets,
+        const math::Frustum& frustum,
+        const glm::vec3& cameraPosition,
+        const bool cullBackfaces,
+        std::vector<IndexRange>& ranges
+    )
+    {
+        static_assert(kMeshletPadding % kLanes == 0, "Meshlet ranges must be padded to whole SIMD batches");
+        FloatV planes[kNumPlanes][4];
+        for (uint32_t p = 0; p < kNumPlanes; ++p) {
+            for (uint32_t c = 0; c < 4; ++c) {
+                planes[p][c] = simd::set1(frustum.planes[p][c]);
+            }
+        }
+        const FloatV cameraX = simd::set1(cameraPosition.x);
+        const FloatV cameraY = simd::set1(cameraPosition.y);
+        const FloatV cameraZ = simd::set1(cameraPosition.z);
+
+        uint32_t numVisible = 0;
+        for (uint32_t first = 0; first < numMeshlets; first += kLanes) {
+            const uint32_t idx = firstMeshlet + first;
+            const uint32_t numLanes = std::min(kLanes, numMeshlets - first);
+            const uint32_t laneMask = (1u << numLanes) - 1u;
+
+            const FloatV centerX = simd::load(&store.centerX[idx]);
+            const FloatV centerY = simd::load(&store.centerY[idx]);
+            const FloatV centerZ = simd::load(&store.centerZ[idx]);
+            const FloatV radius = simd::load(&store.radius[idx]);
+            const FloatV negRadius = simd::negate(radius);
+
+            FloatV isCulled = simd::zero();
+            for (uint32_t p = 0; p < kNumPlanes; ++p) {
+                FloatV distance = simd::madd(planes[p][0], centerX, planes[p][3]);
+                distance = simd::madd(planes[p][1], centerY, distance);
+                distance = simd::madd(planes[p][2], centerZ, distance);
+                isCulled = simd::bitOr(isCulled, simd::cmpLt(distance, negRadius));
+            }
+
+            // Backfacing if the whole sphere sees the cone from behind: dot(v, axis) >= cutoff * |v| + radius,
+            // with v going from the camera to the center
+            if (cullBackfaces) {
+                const FloatV viewX = simd::sub(centerX, cameraX);
+                const FloatV viewY = simd::sub(centerY, cameraY);
+                const FloatV viewZ = simd::sub(centerZ, cameraZ);
+                FloatV viewLength = simd::mul(viewX, viewX);
+                viewLength = simd::madd(viewY, viewY, viewLength);
+                viewLength = simd::sqrt(simd::madd(viewZ, viewZ, viewLength));
+                FloatV coneDot = simd::mul(viewX, simd::load(&store.coneAxisX[idx]));
+                coneDot = simd::madd(viewY, simd::load(&store.coneAxisY[idx]), coneDot);
+                coneDot = simd::madd(viewZ, simd::load(&store.coneAxisZ[idx]), coneDot);
+                const FloatV coneLimit = simd::madd(simd::load(&store.coneCutoff[idx]), viewLength, radius);
+                isCulled = simd::bitOr(isCulled, simd::cmpGe(coneDot, coneLimit));
+            }
+
+            const uint32_t visibleMask = ~simd::moveMask(isCulled) & laneMask;
+            for (uint32_t lane = 0; lane < numLanes; ++lane) {
+                if ((visibleMask & (1u << lane)) == 0) {
+                    continue;
+                }
+                ++numVisible;
+                const uint32_t offset = store.indexOffsets[idx + lane];
+                const uint32_t count = store.numIndices[idx + lane];
+                if (!ranges.empty() && ranges.back().offset + ranges.back().count == offset) {
+                    ranges.back().count += count;
+                }
+                else {
+                    ranges.push_back({ offset, count });
+                }
+            }
+        }
+        return numMeshlets - numVisible;
+    }
+}
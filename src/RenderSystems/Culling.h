@@ -0,0 +1,80 @@
+#pragma once
+#include "pch.h"
+
+#include <vector>
+
+#include "Core/bdrMath.h"
+#include "./Resources.h"
+
+namespace bdr
+{
+    class ECSRegistry;
+    struct OcclusionBuffer;
+    struct MeshletStore;
+
+    struct CullingStats
+    {
+        uint32_t numVisible = 0;
+        // Outside the frustum
+        uint32_t numCulled = 0;
+        // Inside the frustum but hidden behind occluders, or not in the view's potentially visible set
+        uint32_t numOccluded = 0;
+        // Triangles drawn for the visible objects at their selected LODs, and what they'd be at full detail
+        uint32_t numTriangles = 0;
+        uint32_t numFullDetailTriangles = 0;
+        // Meshlets of the visible objects, and how many of those were culled on their own
+        uint32_t numMeshlets = 0;
+        uint32_t numMeshletsCulled = 0;
+    };
+
+    // A range of an index buffer to draw
+    struct IndexRange
+    {
+        uint32_t offset = 0;
+        uint32_t count = 0;
+    };
+
+    // Tests the world bounds of each render object against the frustum, laneWidth objects at a time: first the
+    // bounding sphere of the box, then the box itself for the objects the sphere couldn't reject.
+    // Indices of the visible render objects are appended to visibleObjects. Entities without a BOUNDS component
+    // are always visible.
+    void cullRenderObjects(
+        const math::Frustum& frustum,
+        const ECSRegistry& registry,
+        const std::vector<RenderObject>& renderObjects,
+        std::vector<uint32_t>& visibleObjects,
+        CullingStats& stats
+    );
+
+    // Removes the objects hidden behind the buffer's occluders from visibleObjects, which should hold the results of
+    // cullRenderObjects for the same render objects. See isOccluded.
+    void cullOccludedObjects(
+        const OcclusionBuffer& buffer,
+        const ECSRegistry& registry,
+        const std::vector<RenderObject>& renderObjects,
+        std::vector<uint32_t>& visibleObjects,
+        CullingStats& stats
+    );
+
+    // Same as cullOccludedObjects, for a visible set decoded with getVisibleEntities
+    void cullPVSObjects(
+        const std::vector<uint64_t>& visibleEntities,
+        const std::vector<RenderObject>& renderObjects,
+        std::vector<uint32_t>& visibleObjects,
+        CullingStats& stats
+    );
+
+    // Culls a mesh's meshlets against the frustum and, with cullBackfaces, their normal cones, laneWidth meshlets
+    // at a time. The frustum and camera position must be in the mesh's object space, e.g. the frustum of
+    // viewProjection * model. Only cull backfaces when the rasterizer would discard counter clockwise back faces.
+    // Index ranges of the surviving meshlets are appended to ranges, merging neighbours. Returns how many were culled.
+    uint32_t cullMeshlets(
+        const MeshletStore& store,
+        const uint32_t firstMeshlet,
+        const uint32_t numMeshlets,
+        const math::Frustum& frustum,
+        const glm::vec3& cameraPosition,
+        const bool cullBackfaces,
+        std::vector<IndexRange>& ranges
+    );
+}
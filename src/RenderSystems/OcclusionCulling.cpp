@@ -0,0 +1,405 @@
+#include "pch.h"
+#include "OcclusionCulling.h"
+
+#include "Core/bdrSimd.h"
+#include "Core/JobSystem.h"
+
+
+namespace bdr
+{
+    using simd::FloatV;
+    constexpr uint32_t kLanes = simd::laneWidth;
+    // Vertices closer than this (in clip space w) get clipped, occludees closer than this are never occluded
+    constexpr float kNearClipW = 1e-3f;
+    // Triangles reaching this many half screens past the edges get clipped, to keep the edge functions precise
+    constexpr float kGuardBand = 4.0f;
+    constexpr uint32_t kNumClipPlanes = 5;
+
+    // A clipped, projected occluder triangle, set up for rasterization
+    struct ScreenTriangle
+    {
+        // Edge functions edgeA * x + edgeB * y + edgeC, positive inside the triangle
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        // 1 / w as a plane over the screen
+        float depthA;
+        float depthB;
+        float depthC;
+        // Pixel bounds, inclusive
+        int32_t minX;
+        int32_t maxX;
+        int32_t minY;
+        int32_t maxY;
+    };
+
+    void initOcclusionBuffer(OcclusionBuffer& buffer, const uint32_t width, const uint32_t height)
+    {
+        ASSERT(width % kOcclusionBlockWidth == 0 && height % kOcclusionBlockHeight == 0, "Occlusion buffer must be a whole number of blocks");
+        buffer.width = width;
+        buffer.height = height;
+        buffer.depth.assign(size_t(width) * height, 0.0f);
+
+        buffer.levels.clear();
+        uint32_t levelWidth = width;
+        uint32_t levelHeight = height;
+        uint32_t offset = 0;
+        do {
+            levelWidth = (levelWidth + 1) / 2;
+            levelHeight = (levelHeight + 1) / 2;
+            buffer.levels.push_back({ levelWidth, levelHeight, offset });
+            offset += levelWidth * levelHeight;
+        } while (levelWidth > 1 || levelHeight > 1);
+        buffer.hiZ.assign(offset, 0.0f);
+    }
+
+    float getDepth(const OcclusionBuffer& buffer, const uint32_t x, const uint32_t y)
+    {
+        const uint32_t blocksPerRow = buffer.width / kOcclusionBlockWidth;
+        const uint32_t blockIdx = (y / kOcclusionBlockHeight) * blocksPerRow + x / kOcclusionBlockWidth;
+        return buffer.depth[blockIdx * kOcclusionBlockSize + (y % kOcclusionBlockHeight) * kOcclusionBlockWidth + x % kOcclusionBlockWidth];
+    }
+
+    void setupTriangle(const OcclusionBuffer& buffer, const glm::vec4 clip[3], std::vector<ScreenTriangle>& triangles)
+    {
+        glm::vec3 screen[3];
+        for (uint32_t i = 0; i < 3; ++i) {
+            const float invW = 1.0f / clip[i].w;
+            screen[i].x = (clip[i].x * invW * 0.5f + 0.5f) * float(buffer.width);
+            screen[i].y = (0.5f - clip[i].y * invW * 0.5f) * float(buffer.height);
+            screen[i].z = invW;
+        }
+
+        const float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y)
+            - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+        if (fabsf(area) < 1e-6f) {
+            return;
+        }
+
+        ScreenTriangle triangle;
+        const float minX = std::min(std::min(screen[0].x, screen[1].x), screen[2].x);
+        const float maxX = std::max(std::max(screen[0].x, screen[1].x), screen[2].x);
+        const float minY = std::min(std::min(screen[0].y, screen[1].y), screen[2].y);
+        const float maxY = std::max(std::max(screen[0].y, screen[1].y), screen[2].y);
+        triangle.minX = std::max(int32_t(floorf(minX)), 0);
+        triangle.maxX = std::min(int32_t(ceilf(maxX)), int32_t(buffer.width) - 1);
+        triangle.minY = std::max(int32_t(floorf(minY)), 0);
+        triangle.maxY = std::min(int32_t(ceilf(maxY)), int32_t(buffer.height) - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            return;
+        }
+
+        // Edge i is opposite vertex i, and evaluates to the area at that vertex. Occluders are rasterized
+        // two sided, so flip the edges of clockwise triangles to keep the inside positive.
+        const float sign = area > 0.0f ? 1.0f : -1.0f;
+        const float invArea = 1.0f / area;
+        triangle.depthA = 0.0f;
+        triangle.depthB = 0.0f;
+        triangle.depthC = 0.0f;
+        for (uint32_t i = 0; i < 3; ++i) {
+            const glm::vec3& v0 = screen[(i + 1) % 3];
+            const glm::vec3& v1 = screen[(i + 2) % 3];
+            const float a = v0.y - v1.y;
+            const float b = v1.x - v0.x;
+            const float c = v0.x * v1.y - v1.x * v0.y;
+            triangle.edgeA[i] = sign * a;
+            triangle.edgeB[i] = sign * b;
+            triangle.edgeC[i] = sign * c;
+            triangle.depthA += a * screen[i].z * invArea;
+            triangle.depthB += b * screen[i].z * invArea;
+            triangle.depthC += c * screen[i].z * invArea;
+        }
+        triangles.push_back(triangle);
+    }
+
+    // Signed distance to the near plane (plane 0) and the guard band planes, positive inside
+    inline float getClipDistance(const glm::vec4& clip, const uint32_t plane)
+    {
+        switch (plane) {
+        case 0: return clip.w - kNearClipW;
+        case 1: return kGuardBand * clip.w - clip.x;
+        case 2: return kGuardBand * clip.w + clip.x;
+        case 3: return kGuardBand * clip.w - clip.y;
+        default: return kGuardBand * clip.w + clip.y;
+        }
+    }
+
+    // Clips against the near plane and the guard band, then fans the polygon back into triangles
+    void clipTriangle(const OcclusionBuffer& buffer, const glm::vec4 clip[3], std::vector<ScreenTriangle>& triangles)
+    {
+        constexpr uint32_t kMaxVertices = 3 + kNumClipPlanes;
+        glm::vec4 polygons[2][kMaxVertices];
+        uint32_t numVertices = 3;
+        std::copy(clip, clip + 3, polygons[0]);
+        for (uint32_t plane = 0; plane < kNumClipPlanes && numVertices >= 3; ++plane) {
+            const glm::vec4* input = polygons[plane % 2];
+            glm::vec4* output = polygons[(plane + 1) % 2];
+            uint32_t numOutput = 0;
+            for (uint32_t i = 0; i < numVertices; ++i) {
+                const glm::vec4& current = input[i];
+                const glm::vec4& next = input[(i + 1) % numVertices];
+                const float currentDistance = getClipDistance(current, plane);
+                const float nextDistance = getClipDistance(next, plane);
+                if (currentDistance >= 0.0f) {
+                    output[numOutput++] = current;
+                }
+                if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+                    output[numOutput++] = glm::mix(current, next, currentDistance / (currentDistance - nextDistance));
+                }
+            }
+            numVertices = numOutput;
+        }
+
+        const glm::vec4* polygon = polygons[kNumClipPlanes % 2];
+        for (uint32_t i = 2; i < numVertices; ++i) {
+            const glm::vec4 triangle[3] = { polygon[0], polygon[i - 1], polygon[i] };
+            setupTriangle(buffer, triangle, triangles);
+        }
+    }
+
+    void transformOccluder(const OcclusionBuffer& buffer, const Occluder& occluder, std::vector<ScreenTriangle>& triangles)
+    {
+        const glm::mat4 transform = simd::mul(buffer.viewProjection, occluder.transform);
+        for (uint32_t i = 0; i + 2 < occluder.numIndices; i += 3) {
+            glm::vec4 clip[3];
+            uint32_t outsideMask = 0x3F;
+            for (uint32_t v = 0; v < 3; ++v) {
+                clip[v] = transform * glm::vec4{ occluder.positions[occluder.indices[i + v]], 1.0f };
+                // Triangles entirely past one side of the frustum get rejected before clipping
+                uint32_t vertexOutside = 0;
+                vertexOutside |= clip[v].x < -clip[v].w ? 1 : 0;
+                vertexOutside |= clip[v].x > clip[v].w ? 2 : 0;
+                vertexOutside |= clip[v].y < -clip[v].w ? 4 : 0;
+                vertexOutside |= clip[v].y > clip[v].w ? 8 : 0;
+                vertexOutside |= clip[v].w < kNearClipW ? 16 : 0;
+                outsideMask &= vertexOutside;
+            }
+            if (outsideMask != 0) {
+                continue;
+            }
+            bool needsClipping = false;
+            for (uint32_t v = 0; v < 3; ++v) {
+                for (uint32_t plane = 0; plane < kNumClipPlanes; ++plane) {
+                    needsClipping |= getClipDistance(clip[v], plane) < 0.0f;
+                }
+            }
+            if (needsClipping) {
+                clipTriangle(buffer, clip, triangles);
+            }
+            else {
+                setupTriangle(buffer, clip, triangles);
+            }
+        }
+    }
+
+    // Rasterizes the part of the triangle inside block row blockRow, keeping the closest depth
+    void rasterizeTriangle(OcclusionBuffer& buffer, const ScreenTriangle& triangle, const uint32_t blockRow)
+    {
+        const int32_t firstRow = int32_t(blockRow * kOcclusionBlockHeight);
+        const int32_t minY = std::max(triangle.minY, firstRow);
+        const int32_t maxY = std::min(triangle.maxY, firstRow + int32_t(kOcclusionBlockHeight) - 1);
+        if (minY > maxY) {
+            return;
+        }
+
+        alignas(32) float laneOffsets[kLanes];
+        for (uint32_t lane = 0; lane < kLanes; ++lane) {
+            laneOffsets[lane] = float(lane) + 0.5f;
+        }
+        const FloatV laneX = simd::load(laneOffsets);
+        FloatV edgeA[3];
+        for (uint32_t i = 0; i < 3; ++i) {
+            edgeA[i] = simd::set1(triangle.edgeA[i]);
+        }
+        const FloatV depthA = simd::set1(triangle.depthA);
+        const FloatV zero = simd::zero();
+
+        const uint32_t blocksPerRow = buffer.width / kOcclusionBlockWidth;
+        const uint32_t firstBlock = uint32_t(triangle.minX) / kOcclusionBlockWidth;
+        const uint32_t lastBlock = uint32_t(triangle.maxX) / kOcclusionBlockWidth;
+        for (uint32_t blockX = firstBlock; blockX <= lastBlock; ++blockX) {
+            float* block = &buffer.depth[size_t(blockRow * blocksPerRow + blockX) * kOcclusionBlockSize];
+            for (int32_t y = minY; y <= maxY; ++y) {
+                const float pixelY = float(y) + 0.5f;
+                float* row = block + (y - firstRow) * kOcclusionBlockWidth;
+                FloatV rowEdges[3];
+                for (uint32_t i = 0; i < 3; ++i) {
+                    rowEdges[i] = simd::set1(triangle.edgeB[i] * pixelY + triangle.edgeC[i]);
+                }
+                const FloatV rowDepth = simd::set1(triangle.depthB * pixelY + triangle.depthC);
+
+                for (uint32_t x = 0; x < kOcclusionBlockWidth; x += kLanes) {
+                    const FloatV pixelX = simd::add(laneX, simd::set1(float(blockX * kOcclusionBlockWidth + x)));
+                    FloatV isInside = simd::cmpGe(simd::madd(edgeA[0], pixelX, rowEdges[0]), zero);
+                    isInside = simd::bitAnd(isInside, simd::cmpGe(simd::madd(edgeA[1], pixelX, rowEdges[1]), zero));
+                    isInside = simd::bitAnd(isInside, simd::cmpGe(simd::madd(edgeA[2], pixelX, rowEdges[2]), zero));
+                    if (simd::moveMask(isInside) == 0) {
+                        continue;
+                    }
+                    const FloatV depth = simd::madd(depthA, pixelX, rowDepth);
+                    const FloatV previous = simd::load(row + x);
+                    simd::store(row + x, simd::select(previous, simd::max(previous, depth), isInside));
+                }
+            }
+        }
+    }
+
+    void buildHiZ(OcclusionBuffer& buffer)
+    {
+        // The first level reads the blocked full resolution buffer, the rest read the level below
+        const OcclusionBuffer::Level& first = buffer.levels[0];
+        for (uint32_t y = 0; y < first.height; ++y) {
+            for (uint32_t x = 0; x < first.width; ++x) {
+                const uint32_t x0 = 2 * x;
+                const uint32_t y0 = 2 * y;
+                const uint32_t x1 = std::min(x0 + 1, buffer.width - 1);
+                const uint32_t y1 = std::min(y0 + 1, buffer.height - 1);
+                buffer.hiZ[first.offset + y * first.width + x] = std::min(
+                    std::min(getDepth(buffer, x0, y0), getDepth(buffer, x1, y0)),
+                    std::min(getDepth(buffer, x0, y1), getDepth(buffer, x1, y1))
+                );
+            }
+        }
+        for (size_t levelIdx = 1; levelIdx < buffer.levels.size(); ++levelIdx) {
+            const OcclusionBuffer::Level& source = buffer.levels[levelIdx - 1];
+            const OcclusionBuffer::Level& level = buffer.levels[levelIdx];
+            const float* sourceDepth = &buffer.hiZ[source.offset];
+            for (uint32_t y = 0; y < level.height; ++y) {
+                for (uint32_t x = 0; x < level.width; ++x) {
+                    const uint32_t x0 = 2 * x;
+                    const uint32_t y0 = 2 * y;
+                    const uint32_t x1 = std::min(x0 + 1, source.width - 1);
+                    const uint32_t y1 = std::min(y0 + 1, source.height - 1);
+                    buffer.hiZ[level.offset + y * level.width + x] = std::min(
+                        std::min(sourceDepth[y0 * source.width + x0], sourceDepth[y0 * source.width + x1]),
+                        std::min(sourceDepth[y1 * source.width + x0], sourceDepth[y1 * source.width + x1])
+                    );
+                }
+            }
+        }
+    }
+
+    // Rasterizes every triangle overlapping block rows [begin, end)
+    void rasterizeBlockRows(
+        OcclusionBuffer& buffer,
+        const std::vector<std::vector<ScreenTriangle>>& occluderTriangles,
+        const uint32_t begin,
+        const uint32_t end
+    )
+    {
+        for (const std::vector<ScreenTriangle>& triangles : occluderTriangles) {
+            for (const ScreenTriangle& triangle : triangles) {
+                const uint32_t firstBlockRow = uint32_t(triangle.minY) / kOcclusionBlockHeight;
+                const uint32_t lastBlockRow = uint32_t(triangle.maxY) / kOcclusionBlockHeight;
+                const uint32_t bandBegin = std::max(firstBlockRow, begin);
+                const uint32_t bandEnd = std::min(lastBlockRow + 1, end);
+                for (uint32_t blockRow = bandBegin; blockRow < bandEnd; ++blockRow) {
+                    rasterizeTriangle(buffer, triangle, blockRow);
+                }
+            }
+        }
+    }
+
+    void renderOccluders(
+        JobSystem& jobSystem,
+        OcclusionBuffer& buffer,
+        const glm::mat4& viewProjection,
+        const Occluder* occluders,
+        const uint32_t numOccluders
+    )
+    {
+        ASSERT(buffer.width > 0 && buffer.height > 0, "Occlusion buffer hasn't been initialized");
+        buffer.viewProjection = viewProjection;
+        std::fill(buffer.depth.begin(), buffer.depth.end(), 0.0f);
+
+        std::vector<std::vector<ScreenTriangle>> occluderTriangles(numOccluders);
+        jobSystem.parallelFor(numOccluders, 1, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                transformOccluder(buffer, occluders[i], occluderTriangles[i]);
+            }
+        });
+
+        // Every band of block rows belongs to a single job, so no two jobs ever write the same pixels
+        const uint32_t numBlockRows = buffer.height / kOcclusionBlockHeight;
+        jobSystem.parallelFor(numBlockRows, 1, [&](const size_t begin, const size_t end) {
+            rasterizeBlockRows(buffer, occluderTriangles, uint32_t(begin), uint32_t(end));
+        });
+
+        buildHiZ(buffer);
+    }
+
+    void renderOccluders(
+        OcclusionBuffer& buffer,
+        const glm::mat4& viewProjection,
+        const Occluder* occluders,
+        const uint32_t numOccluders
+    )
+    {
+        ASSERT(buffer.width > 0 && buffer.height > 0, "Occlusion buffer hasn't been initialized");
+        buffer.viewProjection = viewProjection;
+        std::fill(buffer.depth.begin(), buffer.depth.end(), 0.0f);
+
+        std::vector<std::vector<ScreenTriangle>> occluderTriangles(numOccluders);
+        for (uint32_t i = 0; i < numOccluders; ++i) {
+            transformOccluder(buffer, occluders[i], occluderTriangles[i]);
+        }
+        rasterizeBlockRows(buffer, occluderTriangles, 0, buffer.height / kOcclusionBlockHeight);
+
+        buildHiZ(buffer);
+    }
+
+    bool isOccluded(const OcclusionBuffer& buffer, const AABB& bounds)
+    {
+        float minX = FLT_MAX;
+        float maxX = -FLT_MAX;
+        float minY = FLT_MAX;
+        float maxY = -FLT_MAX;
+        float nearestDepth = 0.0f;
+        for (uint32_t corner = 0; corner < 8; ++corner) {
+            const glm::vec3 position{
+                (corner & 1) ? bounds.max.x : bounds.min.x,
+                (corner & 2) ? bounds.max.y : bounds.min.y,
+                (corner & 4) ? bounds.max.z : bounds.min.z,
+            };
+            const glm::vec4 clip = buffer.viewProjection * glm::vec4{ position, 1.0f };
+            if (clip.w < kNearClipW) {
+                return false;
+            }
+            const float invW = 1.0f / clip.w;
+            const float x = (clip.x * invW * 0.5f + 0.5f) * float(buffer.width);
+            const float y = (0.5f - clip.y * invW * 0.5f) * float(buffer.height);
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearestDepth = std::max(nearestDepth, invW);
+        }
+
+        // Anything off screen is left to frustum culling
+        if (maxX < 0.0f || maxY < 0.0f || minX >= float(buffer.width) || minY >= float(buffer.height)) {
+            return false;
+        }
+        const uint32_t x0 = uint32_t(std::max(minX, 0.0f));
+        const uint32_t y0 = uint32_t(std::max(minY, 0.0f));
+        const uint32_t x1 = std::min(uint32_t(maxX), buffer.width - 1);
+        const uint32_t y1 = std::min(uint32_t(maxY), buffer.height - 1);
+
+        // Pick the level where the rectangle covers at most a few texels a side. Level l's texels are 2^(l+1) pixels.
+        const uint32_t size = std::max(x1 - x0, y1 - y0) + 1;
+        uint32_t levelIdx = 0;
+        while (levelIdx + 1 < buffer.levels.size() && (size >> (levelIdx + 1)) > 2) {
+            ++levelIdx;
+        }
+        const OcclusionBuffer::Level& level = buffer.levels[levelIdx];
+        const uint32_t shift = levelIdx + 1;
+        const float* levelDepth = &buffer.hiZ[level.offset];
+        for (uint32_t y = y0 >> shift; y <= (y1 >> shift); ++y) {
+            for (uint32_t x = x0 >> shift; x <= (x1 >> shift); ++x) {
+                if (levelDepth[y * level.width + x] <= nearestDepth) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
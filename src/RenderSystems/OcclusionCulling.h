@@ -0,0 +1,78 @@
+#pragma once
+#include "pch.h"
+
+#include <vector>
+
+#include "Core/bdrMath.h"
+
+namespace bdr
+{
+    class JobSystem;
+
+    // Pixels are rasterized in blocks of this size, the buffer's dimensions must be multiples of it
+    constexpr uint32_t kOcclusionBlockWidth = 8;
+    constexpr uint32_t kOcclusionBlockHeight = 4;
+    constexpr uint32_t kOcclusionBlockSize = kOcclusionBlockWidth * kOcclusionBlockHeight;
+
+    // Low resolution depth buffer of the occluders, plus its Hi-Z pyramid.
+    // Depth is stored as 1 / w (larger is closer, 0 is empty), which interpolates linearly in screen space and
+    // works the same for regular and reversed Z projections.
+    struct OcclusionBuffer
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        // Full resolution depth, in 8x4 blocks of pixels stored row by row
+        std::vector<float> depth;
+
+        // Each level of the pyramid stores the farthest depth of the 2x2 texels below it. Level 0 is half the
+        // buffer's resolution, levels are stored row major one after the other.
+        struct Level
+        {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t offset = 0;
+        };
+        std::vector<Level> levels;
+        std::vector<float> hiZ;
+
+        // The transform occluders were rasterized with, occludees are projected with the same one
+        glm::mat4 viewProjection{ 1.0f };
+    };
+
+    // CPU side copy of an occluder's geometry. Occluders should be simple, closed and conservative: they must
+    // never cover anything the real mesh doesn't.
+    struct Occluder
+    {
+        const glm::vec3* positions = nullptr;
+        const uint32_t* indices = nullptr;
+        uint32_t numIndices = 0;
+        glm::mat4 transform{ 1.0f };
+    };
+
+    void initOcclusionBuffer(OcclusionBuffer& buffer, const uint32_t width, const uint32_t height);
+
+    // Clears the buffer and rasterizes the occluders with viewProjection * occluder.transform, splitting the
+    // buffer into bands of block rows across the job system. Then builds the Hi-Z pyramid.
+    void renderOccluders(
+        JobSystem& jobSystem,
+        OcclusionBuffer& buffer,
+        const glm::mat4& viewProjection,
+        const Occluder* occluders,
+        const uint32_t numOccluders
+    );
+
+    // Single threaded version, for callers that are already running inside a job
+    void renderOccluders(
+        OcclusionBuffer& buffer,
+        const glm::mat4& viewProjection,
+        const Occluder* occluders,
+        const uint32_t numOccluders
+    );
+
+    // Conservative test of world space bounds: the box's nearest depth against the farthest occluder depth over
+    // its screen rectangle. Boxes crossing the near plane are never occluded.
+    bool isOccluded(const OcclusionBuffer& buffer, const AABB& bounds);
+
+    // Depth of a single pixel, for debugging
+    float getDepth(const OcclusionBuffer& buffer, const uint32_t x, const uint32_t y);
+}
@@ -0,0 +1,306 @@
+#include "pch.h"
+#include "PotentiallyVisibleSet.h"
+
+#include <fstream>
+#include <map>
+
+#include "Core/JobSystem.h"
+#include "Game/ECSRegistry.h"
+#include "OcclusionCulling.h"
+
+
+namespace bdr
+{
+    constexpr uint32_t kPVSFileMagic = 0x53565042; // "BPVS"
+    constexpr uint32_t kPVSFileVersion = 1;
+
+    // Spreads the low 10 bits of value out to every third bit
+    inline uint32_t expandBits(uint32_t value)
+    {
+        value &= 0x3FF;
+        value = (value | (value << 16)) & 0x030000FF;
+        value = (value | (value << 8)) & 0x0300F00F;
+        value = (value | (value << 4)) & 0x030C30C3;
+        value = (value | (value << 2)) & 0x09249249;
+        return value;
+    }
+
+    // Baked entities sorted along a Morton curve of their bounds' centers
+    void collectEntities(const ECSRegistry& registry, std::vector<uint32_t>& entities, std::vector<AABB>& bounds)
+    {
+        AABB centerBounds{};
+        for (uint32_t entity = 0; entity < registry.numEntities; ++entity) {
+            const uint32_t cmpMask = registry.cmpMasks[entity];
+            if ((cmpMask & CmpMasks::BOUNDS) && (cmpMask & CmpMasks::STATIC)) {
+                entities.push_back(entity);
+                math::expand(centerBounds, math::getCenter(registry.worldBounds[entity]));
+            }
+        }
+
+        const glm::vec3 scale = 1023.0f / glm::max(centerBounds.max - centerBounds.min, glm::vec3{ FLT_EPSILON });
+        std::vector<std::pair<uint32_t, uint32_t>> keys;
+        keys.reserve(entities.size());
+        for (const uint32_t entity : entities) {
+            const glm::uvec3 cell{ (math::getCenter(registry.worldBounds[entity]) - centerBounds.min) * scale };
+            keys.emplace_back(expandBits(cell.x) | (expandBits(cell.y) << 1) | (expandBits(cell.z) << 2), entity);
+        }
+        std::sort(keys.begin(), keys.end());
+
+        bounds.reserve(entities.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            entities[i] = keys[i].second;
+            bounds.push_back(registry.worldBounds[entities[i]]);
+        }
+    }
+
+    void writeVarint(uint32_t value, std::vector<uint8_t>& output)
+    {
+        while (value >= 0x80) {
+            output.push_back(uint8_t(value) | 0x80);
+            value >>= 7;
+        }
+        output.push_back(uint8_t(value));
+    }
+
+    inline uint32_t readVarint(const uint8_t*& input)
+    {
+        uint32_t value = 0;
+        for (uint32_t shift = 0;; shift += 7) {
+            const uint8_t byte = *input++;
+            value |= uint32_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    void encodeRuns(const std::vector<uint64_t>& bits, const uint32_t numBits, std::vector<uint8_t>& output)
+    {
+        bool isVisibleRun = false;
+        uint32_t runStart = 0;
+        while (runStart < numBits) {
+            uint32_t runEnd = runStart;
+            while (runEnd < numBits && ((bits[runEnd / 64] >> (runEnd % 64)) & 1) == uint64_t(isVisibleRun)) {
+                ++runEnd;
+            }
+            writeVarint(runEnd - runStart, output);
+            runStart = runEnd;
+            isVisibleRun = !isVisibleRun;
+        }
+    }
+
+    inline glm::vec3 getCellMin(const PotentiallyVisibleSet& pvs, const uint32_t cell)
+    {
+        const glm::uvec3 coords{ cell % pvs.numCells.x, (cell / pvs.numCells.x) % pvs.numCells.y, cell / (pvs.numCells.x * pvs.numCells.y) };
+        return pvs.bounds.min + glm::vec3{ coords } * pvs.cellSize;
+    }
+
+    // Looks down each axis from a sample point, marking the objects any face sees
+    void sampleVisibility(
+        OcclusionBuffer& buffer,
+        const glm::vec3& position,
+        const glm::mat4& projection,
+        const Occluder* occluders,
+        const uint32_t numOccluders,
+        const std::vector<AABB>& objectBounds,
+        std::vector<uint64_t>& visibleObjects
+    )
+    {
+        constexpr glm::vec3 directions[6] = {
+            { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f },
+            { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+            { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f },
+        };
+        for (uint32_t face = 0; face < 6; ++face) {
+            const glm::vec3 up = directions[face].y != 0.0f ? glm::vec3{ 0.0f, 0.0f, 1.0f } : math::up;
+            const glm::mat4 viewProjection = projection * glm::lookAt(position, position + directions[face], up);
+            renderOccluders(buffer, viewProjection, occluders, numOccluders);
+
+            const math::Frustum frustum = math::extractFrustum(viewProjection);
+            for (uint32_t i = 0; i < uint32_t(objectBounds.size()); ++i) {
+                if (visibleObjects[i / 64] & (1ull << (i % 64))) {
+                    continue;
+                }
+                if (math::isAABBInFrustum(frustum, objectBounds[i]) && !isOccluded(buffer, objectBounds[i])) {
+                    visibleObjects[i / 64] |= 1ull << (i % 64);
+                }
+            }
+        }
+    }
+
+    void bakePVS(
+        JobSystem& jobSystem,
+        const PVSBakeSettings& settings,
+        const ECSRegistry& registry,
+        const Occluder* occluders,
+        const uint32_t numOccluders,
+        PotentiallyVisibleSet& pvs
+    )
+    {
+        ASSERT(!settings.navigableVolumes.empty(), "Nothing to bake without navigable space");
+        ASSERT(settings.cellSize > 0.0f && settings.samplesPerAxis > 0);
+
+        pvs = PotentiallyVisibleSet{};
+        pvs.cellSize = settings.cellSize;
+        for (const AABB& volume : settings.navigableVolumes) {
+            math::expand(pvs.bounds, volume);
+        }
+        pvs.numCells = glm::max(glm::uvec3{ glm::ceil((pvs.bounds.max - pvs.bounds.min) / pvs.cellSize) }, glm::uvec3{ 1 });
+
+        std::vector<AABB> objectBounds;
+        collectEntities(registry, pvs.entities, objectBounds);
+        const uint32_t numObjects = uint32_t(pvs.entities.size());
+
+        std::vector<uint32_t> navigableCells;
+        const uint32_t numCells = pvs.numCells.x * pvs.numCells.y * pvs.numCells.z;
+        for (uint32_t cell = 0; cell < numCells; ++cell) {
+            const glm::vec3 cellMin = getCellMin(pvs, cell);
+            const AABB cellBounds{ cellMin, cellMin + glm::vec3{ pvs.cellSize } };
+            for (const AABB& volume : settings.navigableVolumes) {
+                if (math::overlaps(cellBounds, volume)) {
+                    navigableCells.push_back(cell);
+                    break;
+                }
+            }
+        }
+
+        // The far plane only has to reach past everything
+        AABB sceneBounds = pvs.bounds;
+        for (const AABB& bounds : objectBounds) {
+            math::expand(sceneBounds, bounds);
+        }
+        const float farPlane = 2.0f * glm::length(sceneBounds.max - sceneBounds.min) + settings.nearPlane;
+        const float resolution = float(settings.faceResolution);
+        const glm::mat4 projection = math::perspective(math::HALF_PI, resolution, resolution, settings.nearPlane, farPlane);
+
+        std::vector<std::vector<uint8_t>> cellRuns(navigableCells.size());
+        jobSystem.parallelFor(navigableCells.size(), 1, [&](const size_t begin, const size_t end) {
+            OcclusionBuffer buffer;
+            initOcclusionBuffer(buffer, settings.faceResolution, settings.faceResolution);
+            std::vector<uint64_t> visibleObjects;
+            const float sampleSpacing = pvs.cellSize / float(settings.samplesPerAxis);
+            for (size_t i = begin; i < end; ++i) {
+                const uint32_t cell = navigableCells[i];
+                const glm::vec3 cellMin = getCellMin(pvs, cell);
+
+                visibleObjects.assign((numObjects + 63) / 64, 0);
+                for (uint32_t z = 0; z < settings.samplesPerAxis; ++z) {
+                    for (uint32_t y = 0; y < settings.samplesPerAxis; ++y) {
+                        for (uint32_t x = 0; x < settings.samplesPerAxis; ++x) {
+                            const glm::vec3 position = cellMin + (glm::vec3{ x, y, z } + 0.5f) * sampleSpacing;
+                            sampleVisibility(buffer, position, projection, occluders, numOccluders, objectBounds, visibleObjects);
+                        }
+                    }
+                }
+                encodeRuns(visibleObjects, numObjects, cellRuns[i]);
+            }
+        });
+
+        pvs.cellOffsets.assign(numCells, kInvalidPVSCell);
+        std::map<std::vector<uint8_t>, uint32_t> uniqueRuns;
+        for (size_t i = 0; i < navigableCells.size(); ++i) {
+            const auto inserted = uniqueRuns.emplace(std::move(cellRuns[i]), uint32_t(pvs.runs.size()));
+            if (inserted.second) {
+                pvs.runs.insert(pvs.runs.end(), inserted.first->first.begin(), inserted.first->first.end());
+            }
+            pvs.cellOffsets[navigableCells[i]] = inserted.first->second;
+        }
+    }
+
+    uint32_t getPVSCell(const PotentiallyVisibleSet& pvs, const glm::vec3& position)
+    {
+        const glm::vec3 coords = glm::floor((position - pvs.bounds.min) / pvs.cellSize);
+        if (glm::any(glm::lessThan(coords, glm::vec3{ 0.0f })) || glm::any(glm::greaterThanEqual(coords, glm::vec3{ pvs.numCells }))) {
+            return kInvalidPVSCell;
+        }
+        const glm::uvec3 cellCoords{ coords };
+        const uint32_t cell = cellCoords.x + pvs.numCells.x * (cellCoords.y + pvs.numCells.y * cellCoords.z);
+        return pvs.cellOffsets[cell] == kInvalidPVSCell ? kInvalidPVSCell : cell;
+    }
+
+    void getVisibleEntities(const PotentiallyVisibleSet& pvs, const uint32_t cell, std::vector<uint64_t>& visibleEntities)
+    {
+        // No words means everything is visible
+        visibleEntities.clear();
+        if (cell == kInvalidPVSCell || pvs.entities.empty()) {
+            return;
+        }
+
+        const uint32_t maxEntity = *std::max_element(pvs.entities.begin(), pvs.entities.end());
+        visibleEntities.assign(maxEntity / 64 + 1, ~0ull);
+        for (const uint32_t entity : pvs.entities) {
+            visibleEntities[entity / 64] &= ~(1ull << (entity % 64));
+        }
+
+        const uint8_t* runs = &pvs.runs[pvs.cellOffsets[cell]];
+        const uint32_t numObjects = uint32_t(pvs.entities.size());
+        bool isVisibleRun = false;
+        for (uint32_t runStart = 0; runStart < numObjects; isVisibleRun = !isVisibleRun) {
+            const uint32_t runEnd = runStart + readVarint(runs);
+            if (isVisibleRun) {
+                for (uint32_t i = runStart; i < runEnd; ++i) {
+                    visibleEntities[pvs.entities[i] / 64] |= 1ull << (pvs.entities[i] % 64);
+                }
+            }
+            runStart = runEnd;
+        }
+    }
+
+    template<typename T>
+    void writeArray(std::ofstream& file, const std::vector<T>& data)
+    {
+        const uint32_t size = uint32_t(data.size());
+        file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(size * sizeof(T)));
+    }
+
+    template<typename T>
+    bool readArray(std::ifstream& file, std::vector<T>& data)
+    {
+        uint32_t size = 0;
+        if (!file.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+            return false;
+        }
+        data.resize(size);
+        return bool(file.read(reinterpret_cast<char*>(data.data()), std::streamsize(size * sizeof(T))));
+    }
+
+    bool savePVS(const PotentiallyVisibleSet& pvs, const char* filePath)
+    {
+        std::ofstream file{ filePath, std::ios::out | std::ios::binary };
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&kPVSFileMagic), sizeof(kPVSFileMagic));
+        file.write(reinterpret_cast<const char*>(&kPVSFileVersion), sizeof(kPVSFileVersion));
+        file.write(reinterpret_cast<const char*>(&pvs.bounds), sizeof(pvs.bounds));
+        file.write(reinterpret_cast<const char*>(&pvs.cellSize), sizeof(pvs.cellSize));
+        file.write(reinterpret_cast<const char*>(&pvs.numCells), sizeof(pvs.numCells));
+        writeArray(file, pvs.entities);
+        writeArray(file, pvs.cellOffsets);
+        writeArray(file, pvs.runs);
+        return bool(file);
+    }
+
+    bool loadPVS(PotentiallyVisibleSet& pvs, const char* filePath)
+    {
+        std::ifstream file{ filePath, std::ios::in | std::ios::binary };
+        if (!file.is_open()) {
+            return false;
+        }
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+        file.read(reinterpret_cast<char*>(&version), sizeof(version));
+        if (!file || magic != kPVSFileMagic || version != kPVSFileVersion) {
+            return false;
+        }
+        file.read(reinterpret_cast<char*>(&pvs.bounds), sizeof(pvs.bounds));
+        file.read(reinterpret_cast<char*>(&pvs.cellSize), sizeof(pvs.cellSize));
+        file.read(reinterpret_cast<char*>(&pvs.numCells), sizeof(pvs.numCells));
+        if (!file || !readArray(file, pvs.entities) || !readArray(file, pvs.cellOffsets) || !readArray(file, pvs.runs)) {
+            return false;
+        }
+        return pvs.cellOffsets.size() == size_t(pvs.numCells.x) * pvs.numCells.y * pvs.numCells.z;
+    }
+}
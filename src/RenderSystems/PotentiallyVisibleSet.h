@@ -0,0 +1,76 @@
+#pragma once
+#include "pch.h"
+
+#include <vector>
+
+#include "Core/bdrMath.h"
+
+namespace bdr
+{
+    class ECSRegistry;
+    class JobSystem;
+    struct Occluder;
+
+    constexpr uint32_t kInvalidPVSCell = UINT32_MAX;
+
+    // Entities visible from each cell of a grid over a static scene, baked offline.
+    // Each cell's visible set is a bitset over the baked entities, stored as alternating runs of hidden and visible
+    // entities (starting with hidden), each run length a LEB128 varint. Entities are ordered along a Morton curve
+    // of their bounds' centers so that nearby entities, which tend to be visible together, make long runs.
+    // The bake references entity ids directly, so it's only valid for the registry it was baked from.
+    struct PotentiallyVisibleSet
+    {
+        AABB bounds;
+        float cellSize = 1.0f;
+        glm::uvec3 numCells{ 0 };
+        // Baked entities, in bitset order
+        std::vector<uint32_t> entities;
+        // Offset of each cell's runs, kInvalidPVSCell for cells outside the navigable space. Cells with the same
+        // visible set share their runs.
+        std::vector<uint32_t> cellOffsets;
+        std::vector<uint8_t> runs;
+    };
+
+    struct PVSBakeSettings
+    {
+        // Space the camera can be in, every cell overlapping one of these gets baked
+        std::vector<AABB> navigableVolumes;
+        float cellSize = 2.0f;
+        // Cells are sampled from samplesPerAxis^3 points spread evenly over them
+        uint32_t samplesPerAxis = 2;
+        // Resolution of each cube face rendered from a sample point
+        uint32_t faceResolution = 128;
+        float nearPlane = 0.05f;
+    };
+
+    // Bakes the visibility of every STATIC entity with bounds, in parallel over the cells. Each sample point
+    // renders the occluders into the six faces of a cube map, an entity is visible from a cell if any sample
+    // point sees its world bounds. Visibility between sample points is not guaranteed, so cells should be small
+    // next to the occluders.
+    void bakePVS(
+        JobSystem& jobSystem,
+        const PVSBakeSettings& settings,
+        const ECSRegistry& registry,
+        const Occluder* occluders,
+        const uint32_t numOccluders,
+        PotentiallyVisibleSet& pvs
+    );
+
+    // Index of the cell containing position, or kInvalidPVSCell if it's outside the baked navigable space
+    uint32_t getPVSCell(const PotentiallyVisibleSet& pvs, const glm::vec3& position);
+
+    // Decodes the cell's visible set into visibleEntities, one bit per entity id. Entities that weren't baked are
+    // always marked visible, so the result can filter any entity.
+    void getVisibleEntities(const PotentiallyVisibleSet& pvs, const uint32_t cell, std::vector<uint64_t>& visibleEntities);
+
+    inline bool isEntityVisible(const std::vector<uint64_t>& visibleEntities, const uint32_t entity)
+    {
+        const size_t word = entity / 64;
+        return word >= visibleEntities.size() || (visibleEntities[word] & (1ull << (entity % 64))) != 0;
+    }
+
+    // Binary files, returns false if the file couldn't be opened or isn't a PVS of the current version
+    bool savePVS(const PotentiallyVisibleSet& pvs, const char* filePath);
+
+    bool loadPVS(PotentiallyVisibleSet& pvs, const char* filePath);
+}
@@ -5,6 +5,7 @@
 #include "Game/Camera.h"
 #include "Game/Scene.h"
 #include "Graphics/Renderer.h"
+#include "PotentiallyVisibleSet.h"
 
 
 namespace bdr
@@ -129,6 +130,7 @@ namespace bdr
         RenderPass& pass = renderSystem.getPass(passId);
         pass.name = L"Mesh Pass";
         pass.views.push_back(view);
+        pass.cullingStats.emplace_back();
         //GPUBuffer vertexCB{};
         static ConstantBuffer<DrawConstants> vertexCB{};
 
@@ -152,14 +154,38 @@ namespace bdr
             context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
             setConstants(renderer, view);
-            const auto& renderObjectsAoA = pass.renderObjectsManager.renderObjectsAoA;
+            const Camera* camera = view.getCamera();
+            const math::Frustum frustum = math::extractFrustum(camera->projection * camera->view);
+            const size_t viewIdx = std::find(pass.views.begin(), pass.views.end(), &view) - pass.views.begin();
+            CullingStats& cullingStats = pass.cullingStats[viewIdx];
+            cullingStats = CullingStats{};
+            const glm::vec3 cameraPosition = math::getTranslation(camera->invView);
+            // Projected radii are fractions of the screen's height
+            const float projectionScale = 0.5f * camera->projection[1][1];
+            if (view.pvs != nullptr) {
+                const uint32_t cell = getPVSCell(*view.pvs, cameraPosition);
+                getVisibleEntities(*view.pvs, cell, pass.pvsVisibleEntities);
+            }
+
+            auto& renderObjectsAoA = pass.renderObjectsManager.renderObjectsAoA;
             for (size_t renderAoAIdx = 0; renderAoAIdx < renderObjectsAoA.size(); renderAoAIdx++) {
                 const PipelineHandle pipelineId = pass.renderObjectsManager.pipelineHandles[renderAoAIdx];
                 const PipelineState& pipelineState = renderer->pipelines[pipelineId];
                 const ResourceBindingLayout& layout = pipelineState.resourceLayout;
                 const ResourceBindingHeap& heap = renderer->bindingHeap;
 
-                const std::vector<RenderObject>& renderObjectList = renderObjectsAoA[renderAoAIdx];
+                std::vector<RenderObject>& renderObjectList = renderObjectsAoA[renderAoAIdx];
+                pass.visibleObjects.clear();
+                cullRenderObjects(frustum, registry, renderObjectList, pass.visibleObjects, cullingStats);
+                if (view.pvs != nullptr) {
+                    cullPVSObjects(pass.pvsVisibleEntities, renderObjectList, pass.visibleObjects, cullingStats);
+                }
+                if (view.occlusionBuffer != nullptr) {
+                    cullOccludedObjects(*view.occlusionBuffer, registry, renderObjectList, pass.visibleObjects, cullingStats);
+                }
+                if (pass.visibleObjects.empty()) {
+                    continue;
+                }
 
                 // Set shaders
                 context->VSSetShader(pipelineState.vertexShader, nullptr, 0);
@@ -171,23 +197,95 @@ namespace bdr
 
                 context->IASetInputLayout(pipelineState.inputLayout);
 
-                for (size_t i = 0; i < renderObjectList.size(); ++i) {
+                // Meshlet cones are built from counter clockwise front faces, and are only worth testing if the
+                // rasterizer would discard their back faces anyway
+                D3D11_RASTERIZER_DESC rasterizerDesc{};
+                pipelineState.rasterizerState->GetDesc(&rasterizerDesc);
+                const bool cullsBackfaces = rasterizerDesc.CullMode == D3D11_CULL_BACK && rasterizerDesc.FrontCounterClockwise;
 
-                    const RenderObject& renderObject = renderObjectList[i];
+                // Meshes sharing buffers, like those in the same geometry pool, skip re-binding them
+                const MeshDrawRecord* boundRecord = nullptr;
+
+                for (const uint32_t renderObjectIdx : pass.visibleObjects) {
+                    RenderObject& renderObject = renderObjectList[renderObjectIdx];
                     const uint32_t entityId = renderObject.entityId;
 
                     const DrawConstants& drawConstants = registry.drawConstants[entityId];
-                    const Mesh& mesh = renderer->meshes[renderObject.meshId];
-
-                    ASSERT(mesh.inputLayoutHandle == pipelineState.inputLayout);
-                    ID3D11Buffer* vbuffers[Mesh::maxAttrCount] = { nullptr };
-                    collectBuffers(mesh, vbuffers);
+                    // The Mesh itself only gets read for LODs, meshlets and dequantization
+                    const MeshDrawRecord& record = renderer->meshDrawRecords[renderObject.meshId.idx];
+                    cullingStats.numFullDetailTriangles += record.numIndices / 3;
+
+                    pass.drawRanges.clear();
+                    const bool selectsLOD = (record.flags & HAS_LODS) && view.lodErrorThreshold > 0.0f;
+                    if (selectsLOD || (record.flags & HAS_MESHLETS)) {
+                        const Mesh& mesh = renderer->meshes[renderObject.meshId];
+
+                        uint8_t lod = 0;
+                        if (selectsLOD) {
+                            const glm::vec3 center = drawConstants.model * glm::vec4{ mesh.boundingSphere.center, 1.0f };
+                            const glm::vec3 axes[3] = { drawConstants.model[0], drawConstants.model[1], drawConstants.model[2] };
+                            const float maxScaleSq = std::max(std::max(
+                                glm::dot(axes[0], axes[0]), glm::dot(axes[1], axes[1])), glm::dot(axes[2], axes[2])
+                            );
+                            const float radius = mesh.boundingSphere.radius * sqrtf(maxScaleSq);
+                            const float distance = glm::length(center - cameraPosition);
+                            const float projectedRadius = distance > radius ? radius * projectionScale / distance : FLT_MAX;
+                            lod = selectLOD(mesh, projectedRadius, view.lodErrorThreshold, renderObject.lod);
+                        }
+                        renderObject.lod = lod;
+                        const MeshLOD& meshLOD = mesh.lods[lod];
+
+                        if (lod == 0 && mesh.numMeshlets > 0) {
+                            const math::Frustum objectFrustum = math::extractFrustum(camera->projection * camera->view * drawConstants.model);
+                            const glm::vec3 objectCameraPosition = glm::affineInverse(drawConstants.model) * glm::vec4{ cameraPosition, 1.0f };
+                            // Mirroring transforms flip the winding the cones were built with
+                            const bool cullBackfaces = cullsBackfaces && glm::determinant(glm::mat3{ drawConstants.model }) > 0.0f;
+                            cullingStats.numMeshlets += mesh.numMeshlets;
+                            cullingStats.numMeshletsCulled += cullMeshlets(
+                                renderer->meshlets, mesh.firstMeshlet, mesh.numMeshlets, objectFrustum, objectCameraPosition, cullBackfaces, pass.drawRanges
+                            );
+                            if (pass.drawRanges.empty()) {
+                                continue;
+                            }
+                        }
+                        else {
+                            pass.drawRanges.push_back({ meshLOD.indexOffset, meshLOD.numIndices });
+                        }
+                    }
+                    else {
+                        renderObject.lod = 0;
+                        pass.drawRanges.push_back({ 0, record.numIndices });
+                    }
+                    for (const IndexRange& range : pass.drawRanges) {
+                        cullingStats.numTriangles += range.count / 3;
+                    }
 
-                    context->IASetVertexBuffers(0, mesh.numPresentAttr, vbuffers, mesh.strides, offsets);
-                    context->IASetIndexBuffer(mesh.indexBuffer.buffer, mapFormatToDXGI(mesh.indexBuffer.format), 0);
+                    ASSERT(renderer->meshes[renderObject.meshId].inputLayoutHandle == pipelineState.inputLayout);
+                    if (record.flags & BINDS_FROM_MESH) {
+                        ID3D11Buffer* vbuffers[Mesh::maxAttrCount] = { nullptr };
+                        const uint32_t* strides = nullptr;
+                        const uint32_t numVertexBuffers = collectDrawBuffers(*renderer, renderer->meshes[renderObject.meshId], vbuffers, &strides);
+                        context->IASetVertexBuffers(0, numVertexBuffers, vbuffers, strides, offsets);
+                        context->IASetIndexBuffer(record.indexBuffer, mapFormatToDXGI(record.indexFormat), 0);
+                        boundRecord = nullptr;
+                    }
+                    else if (boundRecord == nullptr || !hasSameBuffers(*boundRecord, record)) {
+                        const UINT strides[kMaxDrawVertexBuffers] = { record.strides[0], record.strides[1], record.strides[2], record.strides[3] };
+                        context->IASetVertexBuffers(0, record.numVertexBuffers, record.vertexBuffers, strides, offsets);
+                        context->IASetIndexBuffer(record.indexBuffer, mapFormatToDXGI(record.indexFormat), 0);
+                        boundRecord = &record;
+                    }
 
-                    // Set constant buffers
-                    vertexCB.copyToGPU(context, drawConstants);
+                    // Set constant buffers. Quantized positions are dequantized by the model matrix, everything above
+                    // works in the mesh's original object space.
+                    if (record.flags & HAS_QUANTIZED_POSITIONS) {
+                        DrawConstants quantizedConstants = drawConstants;
+                        quantizedConstants.model = drawConstants.model * getDequantizationTransform(renderer->meshes[renderObject.meshId]);
+                        vertexCB.copyToGPU(context, quantizedConstants);
+                    }
+                    else {
+                        vertexCB.copyToGPU(context, drawConstants);
+                    }
 
                     // Set resources (textures, samplers)
                     if (hasResources(pipelineState)) {
@@ -201,7 +299,10 @@ namespace bdr
                     }
 
                     context->VSSetConstantBuffers(1, 1, &vertexCB.buffer);
-                    context->DrawIndexed(mesh.numIndices, 0, 0);
+                    // No multi-draw in D3D11, so each range is its own draw
+                    for (const IndexRange& range : pass.drawRanges) {
+                        context->DrawIndexed(range.count, record.firstIndex + range.offset, record.baseVertex);
+                    }
                 }
             }
         };
@@ -215,6 +316,13 @@ namespace bdr
         return passId;
     }
 
+    const CullingStats& getCullingStats(const RenderPass& pass, const View* view)
+    {
+        const auto viewIt = std::find(pass.views.begin(), pass.views.end(), view);
+        ASSERT(viewIt != pass.views.end(), "View isn't rendered by this pass");
+        return pass.cullingStats[viewIt - pass.views.begin()];
+    }
+
     RenderSystem::~RenderSystem()
     {
         for (RenderPass& renderPass : renderPasses) {
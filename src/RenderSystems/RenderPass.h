@@ -8,6 +8,7 @@
 #include "Core/Array.h"
 #include "Graphics/Resources.h"
 #include "./Resources.h"
+#include "Culling.h"
 #include "View.h"
 
 
@@ -82,6 +83,14 @@ namespace bdr
         std::wstring name = L"";
         std::vector<View*> views;
         RenderObjectManager renderObjectsManager;
+        // Scratch list of the render objects that survived culling, reused for every pipeline and view
+        std::vector<uint32_t> visibleObjects;
+        // Scratch visible set of the current view's PVS cell, see getVisibleEntities
+        std::vector<uint64_t> pvsVisibleEntities;
+        // Scratch index ranges of the current object's meshlets that survived culling
+        std::vector<IndexRange> drawRanges;
+        // Results of the last frame's culling, one per entry of views
+        std::vector<CullingStats> cullingStats;
     };
 
     // Note: not a real frame/render graph just yet
@@ -143,8 +152,12 @@ namespace bdr
     );
 
     //RenderPassHandle addSkinningPass(RenderSystem& renderSystem, View* view);
+    // Draws the render objects whose world bounds are inside the view's frustum, skipping those outside the view's
+    // potentially visible set or hidden by its occlusion buffer, when it has them
     RenderPassHandle addMeshPass(RenderSystem& renderSystem, View* view);
 
+    const CullingStats& getCullingStats(const RenderPass& pass, const View* view);
+
     inline bool hasResources(const PipelineState& pipeline)
     {
         const ResourceBindingLayout& layout = pipeline.resourceLayout;
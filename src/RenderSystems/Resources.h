@@ -43,5 +43,7 @@ namespace bdr
         MeshHandle meshId = INVALID_HANDLE;
         PipelineHandle pipelineId = INVALID_HANDLE;
         ResourceBinder resourceBinder = {};
+        // LOD of the mesh drawn last frame, see selectLOD. Shared by every view drawing the object.
+        uint8_t lod = 0;
     };
 }
@@ -8,6 +8,8 @@ namespace bdr
     class Renderer;
     class Scene;
     struct Camera;
+    struct OcclusionBuffer;
+    struct PotentiallyVisibleSet;
 
     enum class ViewType : uint32_t
     {
@@ -32,6 +34,13 @@ namespace bdr
         Scene* scene = nullptr;
         ViewType type = ViewType::Unknown;
         ConstantBuffer<ViewConstants> viewCB;
+        // Optional, occluders rendered from this view's camera. Passes that cull skip what they hide.
+        const OcclusionBuffer* occlusionBuffer = nullptr;
+        // Optional, baked visibility of the scene's static entities, looked up from the camera's position
+        const PotentiallyVisibleSet* pvs = nullptr;
+        // Largest simplification error allowed when picking mesh LODs, as a fraction of the screen's height.
+        // Zero always draws full detail.
+        float lodErrorThreshold = 1.0f / 1080.0f;
 
         inline Camera const* getCamera() const
         {
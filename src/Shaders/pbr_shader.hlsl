@@ -59,8 +59,13 @@ SamplerState emissiveSampler : register(s3);
 //=================================================================================================
 struct VSInput
 {
+    // Quantized positions come in as unorm, with the dequantization folded into the model matrix
     float3 Position : SV_Position;
+#ifdef OCTAHEDRAL_NORMALS
+    float2 Normal : NORMAL;
+#else
     float3 Normal : NORMAL;
+#endif
     float2 UV : TEXCOORD;
 };
 struct VSOutput
@@ -111,6 +116,17 @@ float3 perturb_normal(float3 N, float3 V, float2 texcoord)
     return normalize(mul(map, TBN));
 }
 
+// Inverse of encodeOctahedral in VertexQuantization.cpp
+float3 decodeOctahedral(float2 e)
+{
+    float3 n = float3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        float2 signs = float2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+
 float clampDot(float3 A, float3 B)
 {
     return clamp(dot(A, B), 0.0, 1.0f);
@@ -172,7 +188,12 @@ VSOutput VSMain(in VSInput input)
     output.PositionCS = mul(float4(output.PositionWS, 1.0f), VP);
     output.vUV = input.UV;
     
-    output.NormalWS = normalize(mul(float4(input.Normal, 1.0f), invModel).xyz);
+#ifdef OCTAHEDRAL_NORMALS
+    float3 normal = decodeOctahedral(input.Normal);
+#else
+    float3 normal = input.Normal;
+#endif
+    output.NormalWS = normalize(mul(float4(normal, 1.0f), invModel).xyz);
 
     return output;
 }
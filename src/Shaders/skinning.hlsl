@@ -1,7 +1,16 @@
+#ifdef DUAL_QUATERNION_SKINNING
+struct Joint
+{
+    // xyz vector part, w scalar part
+    float4 real;
+    float4 dual;
+};
+#else
 struct Joint
 {
     matrix transform;
 };
+#endif
 
 StructuredBuffer<Joint> boneBuffer : register(t0);
 
@@ -28,6 +37,27 @@ void main(uint3 DTid : SV_DispatchThreadID)
         
         uint4 joints = in_INDICES.Load(DTid.x);
         float4 weights = (in_WEIGHTS.Load(DTid.x));
+#ifdef DUAL_QUATERNION_SKINNING
+        // Flip joints onto the first joint's hemisphere so the blend takes the short path
+        Joint first = boneBuffer[joints.x];
+        float4 real = weights.x * first.real;
+        float4 dual = weights.x * first.dual;
+        [unroll]
+        for (uint i = 1; i < 4; ++i)
+        {
+            Joint joint = boneBuffer[joints[i]];
+            float weight = dot(joint.real, first.real) < 0.0 ? -weights[i] : weights[i];
+            real += weight * joint.real;
+            dual += weight * joint.dual;
+        }
+        float invLength = 1.0 / length(real);
+        real *= invLength;
+        dual *= invLength;
+
+        position += 2.0 * cross(real.xyz, cross(real.xyz, position) + real.w * position);
+        position += 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+        float3 newNormal = normalize(normal + 2.0 * cross(real.xyz, cross(real.xyz, normal) + real.w * normal));
+#else
         matrix skinMatrix = mul(weights.x, boneBuffer[joints.x].transform)
 			+ mul(weights.y, boneBuffer[joints.y].transform)
 			+ mul(weights.z, boneBuffer[joints.z].transform)
@@ -37,6 +67,7 @@ void main(uint3 DTid : SV_DispatchThreadID)
         float4 newPos = mul(float4(position, 1.0), skinMatrix);
         position = newPos.xyz / newPos.w;
         float3 newNormal = normalize(mul(normal, normalMatrix));
+#endif
 
         out_Pos.Store3(posOffset, asuint(position));
         out_Norm.Store3(posOffset, asuint(newNormal));
@@ -2,6 +2,7 @@
 #include "pch.h"
 
 #include "./Core/Window.h"
+#include "./Core/JobSystem.h"
 #include "StepTimer.h"
 #include "Game/Scene.h"
 #include "Game/Camera.h"
@@ -58,6 +59,7 @@ namespace bdr
         std::unique_ptr<DirectX::Mouse> mouse;
 
         Scene scene;
+        JobSystem jobSystem;
         Renderer renderer;
         RenderSystem renderSystem;
         Window window = Window{};
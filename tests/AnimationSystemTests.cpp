@@ -0,0 +1,159 @@
+#include "pch.h"
+#include "catch2/catch.hpp"
+
+#include <random>
+#include <vector>
+
+#include "Game/AnimationSystem.h"
+
+using namespace bdr;
+
+namespace
+{
+    // The sampler updateAnimation used before keyframe cursors. It derives the keyframe from the time assuming
+    // uniformly spaced keys, so it's only kept as a baseline for the benchmark below. The index is clamped, the
+    // original read past the last keyframe.
+    template<typename ChannelT>
+    float getUniformKeyframe(const ChannelT& channel, const float animationTime, uint32_t& previousIdx)
+    {
+        const float deltaT = (channel.maxInput - channel.input[0]) / float(channel.input.size() - 1);
+        previousIdx = std::min(uint32_t(floorf(animationTime / deltaT)), uint32_t(channel.input.size() - 2));
+        const float previousTime = channel.input[previousIdx];
+        const float nextTime = channel.input[previousIdx + 1];
+        return (animationTime - previousTime) / (nextTime - previousTime);
+    }
+
+    void updateAnimationUniformKeys(ECSRegistry& registry, Animation& animation, const float currentTime)
+    {
+        const float timeSinceStart = currentTime - animation.startTime;
+        for (auto& channel : animation.rotationChannels) {
+            const float animationTime = fmod(timeSinceStart, channel.maxInput);
+            uint32_t previousIdx;
+            const float t = getUniformKeyframe(channel, animationTime, previousIdx);
+            registry.transforms[channel.targetEntity].rotation = glm::slerp(channel.output[previousIdx], channel.output[previousIdx + 1], t);
+        }
+        for (auto& channel : animation.translationChannels) {
+            const float animationTime = fmod(timeSinceStart, channel.maxInput);
+            uint32_t previousIdx;
+            const float t = getUniformKeyframe(channel, animationTime, previousIdx);
+            registry.transforms[channel.targetEntity].translation = glm::mix(channel.output[previousIdx], channel.output[previousIdx + 1], t);
+        }
+    }
+
+    Animation::TranslationChannel createTranslationChannel(const uint32_t entity, std::vector<float> input, std::vector<glm::vec3> output)
+    {
+        Animation::TranslationChannel channel;
+        channel.targetEntity = entity;
+        channel.maxInput = input.back();
+        channel.input = std::move(input);
+        channel.output = std::move(output);
+        return channel;
+    }
+}
+
+TEST_CASE("Keyframe cursors find the preceding keyframe", "[animation]")
+{
+    const std::vector<float> input = { 0.0f, 0.1f, 1.0f, 1.05f, 2.0f, 2.5f, 2.6f, 4.0f };
+    const uint32_t numKeys = uint32_t(input.size());
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> distribution(-0.5f, 4.5f);
+    uint32_t cursor = 0;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        // Mostly small steps forward, with the occasional seek
+        const float time = i % 10 == 0 ? distribution(rng) : (float(i % 100) / 100.0f) * 4.5f - 0.25f;
+        cursor = advanceKeyframeCursor(input.data(), numKeys, cursor, time);
+
+        const uint32_t expected = std::max(uint32_t(std::upper_bound(input.begin(), input.end(), time) - input.begin()), 1u) - 1u;
+        REQUIRE(cursor == expected);
+    }
+
+    CHECK(advanceKeyframeCursor(input.data(), numKeys, 5, -1.0f) == 0);
+    CHECK(advanceKeyframeCursor(input.data(), numKeys, 0, 10.0f) == numKeys - 1);
+    CHECK(advanceKeyframeCursor(input.data(), numKeys, 0, 1.0f) == 2);
+}
+
+TEST_CASE("Animations sample non-uniform keyframes", "[animation]")
+{
+    ECSRegistry registry;
+    const uint32_t entity = createEntity(registry);
+    Animation animation;
+    animation.playingState = Animation::State::Playing;
+    addTranslationChannel(animation, createTranslationChannel(
+        entity,
+        { 0.0f, 0.1f, 1.0f, 1.05f },
+        { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 2.0f, 0.0f, 0.0f }, { 3.0f, 0.0f, 0.0f } }
+    ));
+
+    const std::pair<float, float> samples[] = {
+        { 0.05f, 0.5f },
+        { 0.55f, 1.5f },
+        { 1.02f, 2.4f },
+        // Seeking backwards
+        { 0.2f, 1.0f + 0.1f / 0.9f },
+        { 1.049f, 2.98f },
+        // Looping
+        { 1.1f, 0.5f },
+    };
+    for (const auto& sample : samples) {
+        updateAnimation(registry, animation, sample.first);
+        CHECK(registry.transforms[entity].translation.x == Approx(sample.second).epsilon(1e-3));
+    }
+
+    animation.translationChannels[0].interpolationType = Animation::InterpolationType::Step;
+    updateAnimation(registry, animation, 0.99f);
+    CHECK(registry.transforms[entity].translation.x == 1.0f);
+}
+
+TEST_CASE("Animation sampling benchmarks", "[.][benchmark][animation]")
+{
+    // Uniformly spaced keys, which the previous sampler requires
+    constexpr uint32_t kNumChannels = 4096;
+    constexpr uint32_t kNumKeys = 64;
+    constexpr float kKeyInterval = 1.0f / 30.0f;
+    ECSRegistry registry;
+    Animation animation;
+    animation.playingState = Animation::State::Playing;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    for (uint32_t i = 0; i < kNumChannels; ++i) {
+        const uint32_t entity = createEntity(registry);
+        Animation::RotationChannel rotationChannel;
+        Animation::TranslationChannel translationChannel;
+        rotationChannel.targetEntity = translationChannel.targetEntity = entity;
+        for (uint32_t key = 0; key < kNumKeys; ++key) {
+            rotationChannel.input.push_back(float(key) * kKeyInterval);
+            translationChannel.input.push_back(float(key) * kKeyInterval);
+            rotationChannel.output.push_back(glm::normalize(glm::quat{ distribution(rng), distribution(rng), distribution(rng), distribution(rng) }));
+            translationChannel.output.push_back({ distribution(rng), distribution(rng), distribution(rng) });
+        }
+        rotationChannel.maxInput = translationChannel.maxInput = float(kNumKeys - 1) * kKeyInterval;
+        addRotationChannel(animation, std::move(rotationChannel));
+        addTranslationChannel(animation, std::move(translationChannel));
+    }
+
+    // Both samplers agree on uniform keys
+    updateAnimationUniformKeys(registry, animation, 0.5f);
+    const std::vector<Transform> expected(registry.transforms.data, registry.transforms.data + kNumChannels);
+    updateAnimation(registry, animation, 0.5f);
+    for (uint32_t i = 0; i < kNumChannels; ++i) {
+        REQUIRE(glm::all(glm::epsilonEqual(registry.transforms[i].translation, expected[i].translation, 1e-5f)));
+    }
+
+    // One frame at 60 fps per run, so the cursors see monotonic playback
+    constexpr float kFrameTime = 1.0f / 60.0f;
+    float uniformKeysTime = 0.0f;
+    BENCHMARK("8192 channels, uniform keyframe indexing")
+    {
+        uniformKeysTime += kFrameTime;
+        updateAnimationUniformKeys(registry, animation, uniformKeysTime);
+        return registry.transforms[0].translation.x;
+    };
+    float cursorTime = 0.0f;
+    BENCHMARK("8192 channels, keyframe cursors")
+    {
+        cursorTime += kFrameTime;
+        updateAnimation(registry, animation, cursorTime);
+        return registry.transforms[0].translation.x;
+    };
+}
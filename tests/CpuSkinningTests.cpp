@@ -0,0 +1,167 @@
+#include "pch.h"
+#include "catch2/catch.hpp"
+
+#include <random>
+#include <vector>
+
+#include "Core/JobSystem.h"
+#include "Game/CpuSkinning.h"
+
+using namespace bdr;
+
+namespace
+{
+    // Random vertices influenced by four random joints each. The vertex count matches the three skinned meshes of
+    // the test scene and isn't a multiple of any SIMD width.
+    struct SkinnedMesh
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::u16vec4> joints;
+        std::vector<glm::vec4> weights;
+        std::vector<glm::mat4> jointMatrices;
+        std::vector<DualQuaternion> jointDualQuaternions;
+
+        SkinningInput getInput(const SkinningMode mode) const
+        {
+            SkinningInput input;
+            input.numVertices = uint32_t(positions.size());
+            input.positions = positions.data();
+            input.normals = normals.data();
+            input.joints = joints.data();
+            input.weights = weights.data();
+            input.jointMatrices = jointMatrices.data();
+            input.jointDualQuaternions = jointDualQuaternions.data();
+            input.mode = mode;
+            return input;
+        }
+    };
+
+    SkinnedMesh createSkinnedMesh(const uint32_t numVertices, const uint32_t numJoints)
+    {
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        auto randomVec3 = [&]() { return glm::vec3{ distribution(rng), distribution(rng), distribution(rng) }; };
+
+        SkinnedMesh mesh;
+        for (uint32_t i = 0; i < numVertices; ++i) {
+            mesh.positions.push_back(randomVec3());
+            mesh.normals.push_back(glm::normalize(randomVec3()));
+            mesh.joints.push_back(glm::u16vec4{ glm::uvec4{ rng(), rng(), rng(), rng() } % numJoints });
+            const glm::vec4 weights = glm::abs(glm::vec4{ randomVec3(), distribution(rng) });
+            mesh.weights.push_back(weights / (weights.x + weights.y + weights.z + weights.w));
+        }
+        // Rigid joints, with the translation in the last row like the skinning shaders expect
+        for (uint32_t i = 0; i < numJoints; ++i) {
+            glm::mat4 jointMatrix = glm::mat4_cast(glm::normalize(glm::quat{ distribution(rng), distribution(rng), distribution(rng), distribution(rng) }));
+            const glm::vec3 translation = randomVec3();
+            jointMatrix[0][3] = translation.x;
+            jointMatrix[1][3] = translation.y;
+            jointMatrix[2][3] = translation.z;
+            mesh.jointMatrices.push_back(jointMatrix);
+            mesh.jointDualQuaternions.push_back(math::toDualQuaternion(jointMatrix));
+        }
+        return mesh;
+    }
+
+    float getMaxDistance(const std::vector<glm::vec3>& a, const std::vector<glm::vec3>& b)
+    {
+        float maxDistance = 0.0f;
+        for (size_t i = 0; i < a.size(); ++i) {
+            maxDistance = std::max(maxDistance, glm::length(a[i] - b[i]));
+        }
+        return maxDistance;
+    }
+
+    constexpr uint32_t kNumVertices = 98097;
+    constexpr uint32_t kNumJoints = 36;
+}
+
+TEST_CASE("SIMD skinning matches the scalar version", "[skinning]")
+{
+    const SkinnedMesh mesh = createSkinnedMesh(kNumVertices, kNumJoints);
+    const SkinningInput input = mesh.getInput(SkinningMode::Linear);
+    std::vector<glm::vec3> expectedPositions(kNumVertices);
+    std::vector<glm::vec3> expectedNormals(kNumVertices);
+    skinVerticesScalar(input, 0, kNumVertices, expectedPositions.data(), expectedNormals.data());
+
+    std::vector<glm::vec3> positions(kNumVertices);
+    std::vector<glm::vec3> normals(kNumVertices);
+    SECTION("Whole mesh")
+    {
+        skinVertices(input, 0, kNumVertices, positions.data(), normals.data());
+    }
+    SECTION("Ranges that don't start or end on a lane boundary")
+    {
+        const std::vector<uint32_t> splits = { 0, 1, 6, 1003, 50001, kNumVertices };
+        for (size_t i = 0; i + 1 < splits.size(); ++i) {
+            skinVertices(input, splits[i], splits[i + 1], positions.data(), normals.data());
+        }
+    }
+    SECTION("Job system")
+    {
+        JobSystem jobSystem;
+        skinVertices(jobSystem, input, positions.data(), normals.data());
+    }
+    CHECK(getMaxDistance(positions, expectedPositions) < 1e-5f);
+    CHECK(getMaxDistance(normals, expectedNormals) < 1e-5f);
+}
+
+TEST_CASE("Dual quaternion skinning", "[skinning]")
+{
+    SkinnedMesh mesh = createSkinnedMesh(1000, kNumJoints);
+    std::vector<glm::vec3> positions(mesh.positions.size());
+    std::vector<glm::vec3> normals(mesh.positions.size());
+    std::vector<glm::vec3> expectedPositions(mesh.positions.size());
+    std::vector<glm::vec3> expectedNormals(mesh.positions.size());
+
+    // The job system overload follows the input's mode
+    const SkinningInput input = mesh.getInput(SkinningMode::DualQuaternion);
+    skinVerticesDualQuaternion(input, 0, input.numVertices, expectedPositions.data(), expectedNormals.data());
+    JobSystem jobSystem;
+    skinVertices(jobSystem, input, positions.data(), normals.data(), 64);
+    CHECK(getMaxDistance(positions, expectedPositions) < 1e-5f);
+    CHECK(getMaxDistance(normals, expectedNormals) < 1e-5f);
+
+    // With a single influence per vertex there's nothing to blend, so both modes apply the same rigid transform
+    for (glm::vec4& weights : mesh.weights) {
+        weights = { 1.0f, 0.0f, 0.0f, 0.0f };
+    }
+    skinVerticesScalar(mesh.getInput(SkinningMode::Linear), 0, input.numVertices, expectedPositions.data(), expectedNormals.data());
+    skinVerticesDualQuaternion(mesh.getInput(SkinningMode::DualQuaternion), 0, input.numVertices, positions.data(), normals.data());
+    CHECK(getMaxDistance(positions, expectedPositions) < 1e-5f);
+    CHECK(getMaxDistance(normals, expectedNormals) < 1e-5f);
+}
+
+TEST_CASE("CPU skinning benchmarks", "[.][benchmark][skinning]")
+{
+    // Vertices per ms is 98097 over the mean
+    const SkinnedMesh mesh = createSkinnedMesh(kNumVertices, kNumJoints);
+    const SkinningInput input = mesh.getInput(SkinningMode::Linear);
+    std::vector<glm::vec3> positions(kNumVertices);
+    std::vector<glm::vec3> normals(kNumVertices);
+    JobSystem jobSystem;
+
+    BENCHMARK("98097 vertices, scalar")
+    {
+        skinVerticesScalar(input, 0, kNumVertices, positions.data(), normals.data());
+        return positions[0].x;
+    };
+    BENCHMARK("98097 vertices, SIMD")
+    {
+        skinVertices(input, 0, kNumVertices, positions.data(), normals.data());
+        return positions[0].x;
+    };
+    BENCHMARK("98097 vertices, SIMD and job system")
+    {
+        skinVertices(jobSystem, input, positions.data(), normals.data());
+        return positions[0].x;
+    };
+
+    const SkinningInput dualQuaternionInput = mesh.getInput(SkinningMode::DualQuaternion);
+    BENCHMARK("98097 vertices, dual quaternions")
+    {
+        skinVerticesDualQuaternion(dualQuaternionInput, 0, kNumVertices, positions.data(), normals.data());
+        return positions[0].x;
+    };
+}
@@ -0,0 +1,368 @@
+#include "pch.h"
+#include "catch2/catch.hpp"
+
+#include <random>
+#include <vector>
+
+#include "Game/GltfAccessors.h"
+
+using namespace bdr::gltf;
+
+namespace
+{
+    const ComponentType kComponentTypes[] = {
+        COMPONENT_BYTE,
+        COMPONENT_UNSIGNED_BYTE,
+        COMPONENT_SHORT,
+        COMPONENT_UNSIGNED_SHORT,
+        COMPONENT_UNSIGNED_INT,
+        COMPONENT_FLOAT,
+    };
+    const AccessorType kAccessorTypes[] = {
+        AccessorType::SCALAR,
+        AccessorType::VEC2,
+        AccessorType::VEC3,
+        AccessorType::VEC4,
+        AccessorType::MAT2,
+        AccessorType::MAT3,
+        AccessorType::MAT4,
+    };
+
+    bool isUnsignedInteger(const ComponentType componentType)
+    {
+        return componentType == COMPONENT_UNSIGNED_BYTE
+            || componentType == COMPONENT_UNSIGNED_SHORT
+            || componentType == COMPONENT_UNSIGNED_INT;
+    }
+
+    // Reads one component the slow way
+    double readReference(const uint8_t* data, const ComponentType componentType)
+    {
+        switch (componentType) {
+        case COMPONENT_BYTE:
+            return int8_t(data[0]);
+        case COMPONENT_UNSIGNED_BYTE:
+            return data[0];
+        case COMPONENT_SHORT: {
+            int16_t value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        case COMPONENT_UNSIGNED_SHORT: {
+            uint16_t value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        case COMPONENT_UNSIGNED_INT: {
+            uint32_t value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        default: {
+            float value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        }
+    }
+
+    // glTF's normalization: c / max, clamped to -1 for the most negative signed value
+    float toFloatReference(const double value, const ComponentType componentType, const bool normalized)
+    {
+        if (!normalized) {
+            return float(value);
+        }
+        float maximum = 65535.0f;
+        switch (componentType) {
+        case COMPONENT_BYTE:
+            maximum = 127.0f;
+            break;
+        case COMPONENT_UNSIGNED_BYTE:
+            maximum = 255.0f;
+            break;
+        case COMPONENT_SHORT:
+            maximum = 32767.0f;
+            break;
+        default:
+            break;
+        }
+        return std::max(float(value) / maximum, -1.0f);
+    }
+
+    // Narrowing integer conversions need values that fit the output type
+    void fillRandom(std::mt19937& rng, const ComponentType componentType, const ComponentType outputType, std::vector<uint8_t>& bytes)
+    {
+        for (uint8_t& byte : bytes) {
+            byte = uint8_t(rng());
+        }
+        // Random bits would be mostly NaNs and denormals
+        if (componentType == COMPONENT_FLOAT) {
+            for (size_t i = 0; i + sizeof(float) <= bytes.size(); i += sizeof(float)) {
+                const float value = float(int32_t(rng() % 20001) - 10000) / 7.0f;
+                memcpy(&bytes[i], &value, sizeof(value));
+            }
+        }
+        else if (componentType == COMPONENT_UNSIGNED_INT && outputType == COMPONENT_UNSIGNED_SHORT) {
+            for (size_t i = 0; i + sizeof(uint32_t) <= bytes.size(); i += sizeof(uint32_t)) {
+                const uint32_t value = rng() % 65536;
+                memcpy(&bytes[i], &value, sizeof(value));
+            }
+        }
+    }
+
+    enum class SparseMode
+    {
+        Dense,
+        Sparse,
+        // No buffer view, so only the sparse elements are non zero
+        SparseOverZeros,
+    };
+
+    // Decodes a random accessor and compares every component against readReference, returns the number of
+    // mismatches. Conversions decodeAccessor doesn't support have to throw.
+    uint32_t checkDecode(
+        std::mt19937& rng,
+        const ComponentType componentType,
+        const AccessorType type,
+        const bool normalized,
+        const uint32_t extraStride,
+        const SparseMode sparseMode,
+        const ComponentType outputType
+    )
+    {
+        const uint32_t numComponents = getNumComponents(type);
+        const uint32_t numColumns = type == AccessorType::MAT2 ? 2 : type == AccessorType::MAT3 ? 3 : type == AccessorType::MAT4 ? 4 : 1;
+        const uint32_t numRows = numComponents / numColumns;
+        const uint32_t componentSize = getComponentSize(componentType);
+        const uint32_t columnStride = numColumns > 1 ? (numRows * componentSize + 3) & ~3u : numRows * componentSize;
+        const uint32_t elementSize = getElementSize(componentType, type);
+        REQUIRE(elementSize == numColumns * columnStride);
+
+        const uint32_t count = 1 + rng() % 77;
+        const uint32_t byteStride = extraStride == UINT32_MAX ? 0 : elementSize + extraStride;
+        const uint32_t elementStride = byteStride != 0 ? byteStride : elementSize;
+        std::vector<uint8_t> data(size_t(elementStride) * count);
+        fillRandom(rng, componentType, outputType, data);
+
+        AccessorView view{};
+        view.data = sparseMode == SparseMode::SparseOverZeros ? nullptr : data.data();
+        view.count = count;
+        view.byteStride = byteStride;
+        view.componentType = componentType;
+        view.type = type;
+        view.normalized = normalized;
+
+        std::vector<uint32_t> sparseIndices;
+        std::vector<uint8_t> sparseValues;
+        std::vector<uint8_t> indices8;
+        std::vector<uint16_t> indices16;
+        if (sparseMode != SparseMode::Dense) {
+            for (uint32_t i = 0; i < count; ++i) {
+                if (rng() % 3 == 0) {
+                    sparseIndices.push_back(i);
+                }
+            }
+            sparseValues.resize(sparseIndices.size() * elementSize);
+            fillRandom(rng, componentType, outputType, sparseValues);
+        }
+        if (!sparseIndices.empty()) {
+            view.sparse.count = uint32_t(sparseIndices.size());
+            view.sparse.values = sparseValues.data();
+            const uint32_t indexType = rng() % 3;
+            if (indexType == 0 && count < 256) {
+                indices8.assign(sparseIndices.begin(), sparseIndices.end());
+                view.sparse.indices = indices8.data();
+                view.sparse.indexComponentType = COMPONENT_UNSIGNED_BYTE;
+            }
+            else if (indexType == 1) {
+                indices16.assign(sparseIndices.begin(), sparseIndices.end());
+                view.sparse.indices = reinterpret_cast<const uint8_t*>(indices16.data());
+                view.sparse.indexComponentType = COMPONENT_UNSIGNED_SHORT;
+            }
+            else {
+                view.sparse.indices = reinterpret_cast<const uint8_t*>(sparseIndices.data());
+                view.sparse.indexComponentType = COMPONENT_UNSIGNED_INT;
+            }
+        }
+
+        const bool isValidNormalization = !normalized || (componentType != COMPONENT_UNSIGNED_INT && componentType != COMPONENT_FLOAT);
+        const bool isSupported = isValidNormalization && (outputType == componentType
+            || outputType == COMPONENT_FLOAT
+            || (isUnsignedInteger(componentType) && !normalized));
+
+        // One guard byte past the end catches overruns
+        constexpr uint8_t kGuard = 0xCD;
+        std::vector<uint8_t> output(getDecodedSize(view, outputType) + 1, kGuard);
+        if (!isSupported) {
+            CHECK_THROWS_AS(decodeAccessor(view, outputType, output.data()), std::runtime_error);
+            return 0;
+        }
+        decodeAccessor(view, outputType, output.data());
+        CHECK(output.back() == kGuard);
+
+        const uint32_t outputSize = getComponentSize(outputType);
+        uint32_t numMismatches = 0;
+        for (uint32_t element = 0; element < count; ++element) {
+            const uint8_t* elementData = nullptr;
+            const auto sparseIt = std::find(sparseIndices.begin(), sparseIndices.end(), element);
+            if (sparseIt != sparseIndices.end()) {
+                elementData = sparseValues.data() + (sparseIt - sparseIndices.begin()) * elementSize;
+            }
+            else if (view.data != nullptr) {
+                elementData = data.data() + size_t(element) * elementStride;
+            }
+
+            for (uint32_t c = 0; c < numComponents; ++c) {
+                const uint8_t* componentData = elementData != nullptr
+                    ? elementData + (c / numRows) * columnStride + (c % numRows) * componentSize
+                    : nullptr;
+                const uint8_t* decoded = output.data() + (size_t(element) * numComponents + c) * outputSize;
+                bool isMatch;
+                if (outputType == componentType) {
+                    isMatch = componentData != nullptr
+                        ? memcmp(decoded, componentData, componentSize) == 0
+                        : std::all_of(decoded, decoded + componentSize, [](const uint8_t byte) { return byte == 0; });
+                }
+                else if (outputType == COMPONENT_FLOAT) {
+                    const float expected = componentData != nullptr
+                        ? toFloatReference(readReference(componentData, componentType), componentType, normalized)
+                        : 0.0f;
+                    // Bit exact, SIMD and scalar kernels have to agree
+                    isMatch = memcmp(decoded, &expected, sizeof(expected)) == 0;
+                }
+                else {
+                    const uint32_t expected = componentData != nullptr ? uint32_t(readReference(componentData, componentType)) : 0;
+                    uint32_t value = 0;
+                    memcpy(&value, decoded, outputSize);
+                    isMatch = value == expected;
+                }
+                numMismatches += isMatch ? 0 : 1;
+            }
+        }
+        return numMismatches;
+    }
+}
+
+TEST_CASE("Accessors decode to every supported output type", "[gltf]")
+{
+    std::mt19937 rng(1);
+    const SparseMode sparseModes[] = { SparseMode::Dense, SparseMode::Sparse, SparseMode::SparseOverZeros };
+    // UINT32_MAX leaves the stride at 0, for tightly packed elements
+    const uint32_t extraStrides[] = { UINT32_MAX, 0, 4, 12 };
+
+    for (const ComponentType componentType : kComponentTypes) {
+        for (const AccessorType type : kAccessorTypes) {
+            for (const bool normalized : { false, true }) {
+                for (const uint32_t extraStride : extraStrides) {
+                    for (const SparseMode sparseMode : sparseModes) {
+                        for (const ComponentType outputType : { COMPONENT_FLOAT, COMPONENT_UNSIGNED_SHORT, COMPONENT_UNSIGNED_INT, componentType }) {
+                            INFO("component type " << componentType << ", type " << int(type) << ", normalized " << normalized
+                                << ", extra stride " << int32_t(extraStride) << ", sparse mode " << int(sparseMode)
+                                << ", output type " << outputType);
+                            CHECK(checkDecode(rng, componentType, type, normalized, extraStride, sparseMode, outputType) == 0);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Every normalized 8 and 16 bit value decodes like glTF specifies", "[gltf]")
+{
+    const ComponentType componentTypes[] = { COMPONENT_BYTE, COMPONENT_UNSIGNED_BYTE, COMPONENT_SHORT, COMPONENT_UNSIGNED_SHORT };
+    for (const ComponentType componentType : componentTypes) {
+        const uint32_t componentSize = getComponentSize(componentType);
+        const uint32_t count = 1u << (8 * componentSize);
+        std::vector<uint8_t> data(size_t(count) * componentSize);
+        for (uint32_t i = 0; i < count; ++i) {
+            memcpy(&data[size_t(i) * componentSize], &i, componentSize);
+        }
+
+        AccessorView view{};
+        view.data = data.data();
+        view.count = count;
+        view.componentType = componentType;
+        view.normalized = true;
+        std::vector<float> output(count);
+        decodeAccessor(view, COMPONENT_FLOAT, output.data());
+
+        uint32_t numMismatches = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            const float expected = toFloatReference(readReference(&data[size_t(i) * componentSize], componentType), componentType, true);
+            numMismatches += output[i] == expected ? 0 : 1;
+        }
+        INFO("component type " << componentType);
+        CHECK(numMismatches == 0);
+        if (componentType == COMPONENT_BYTE || componentType == COMPONENT_SHORT) {
+            CHECK(*std::min_element(output.begin(), output.end()) == -1.0f);
+        }
+        CHECK(*std::max_element(output.begin(), output.end()) == 1.0f);
+    }
+}
+
+TEST_CASE("Accessor decoding throughput", "[.][benchmark][gltf]")
+{
+    constexpr uint32_t kCount = 1u << 20;
+    std::vector<uint8_t> data(size_t(kCount) * 32);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = uint8_t((i * 2654435761u) >> 13);
+    }
+    std::vector<float> output(size_t(kCount) * 4);
+    std::vector<uint16_t> indices(kCount);
+
+    struct Case
+    {
+        const char* name;
+        ComponentType componentType;
+        AccessorType type;
+        bool normalized;
+        uint32_t byteStride;
+        ComponentType outputType;
+    };
+    const Case cases[] = {
+        { "u8 vec4 normalized, packed, to float", COMPONENT_UNSIGNED_BYTE, AccessorType::VEC4, true, 0, COMPONENT_FLOAT },
+        { "i16 vec3 normalized, packed, to float", COMPONENT_SHORT, AccessorType::VEC3, true, 0, COMPONENT_FLOAT },
+        { "u16 vec2 normalized, stride 16, to float", COMPONENT_UNSIGNED_SHORT, AccessorType::VEC2, true, 16, COMPONENT_FLOAT },
+        { "i8 vec4 normalized, stride 12, to float", COMPONENT_BYTE, AccessorType::VEC4, true, 12, COMPONENT_FLOAT },
+        { "float vec3, stride 32, to float", COMPONENT_FLOAT, AccessorType::VEC3, false, 32, COMPONENT_FLOAT },
+        { "u8 scalar to u16 indices", COMPONENT_UNSIGNED_BYTE, AccessorType::SCALAR, false, 0, COMPONENT_UNSIGNED_SHORT },
+    };
+
+    for (const Case& c : cases) {
+        AccessorView view{};
+        view.data = data.data();
+        view.count = kCount;
+        view.byteStride = c.byteStride;
+        view.componentType = c.componentType;
+        view.type = c.type;
+        view.normalized = c.normalized;
+        void* destination = c.outputType == COMPONENT_FLOAT ? static_cast<void*>(output.data()) : static_cast<void*>(indices.data());
+
+        BENCHMARK(std::string(c.name) + ", decodeAccessor") {
+            decodeAccessor(view, c.outputType, destination);
+            return output[0] + indices[0];
+        };
+
+        // Baseline: a straightforward loader's loop, switching on the component type for every component
+        const uint32_t numComponents = getNumComponents(c.type);
+        const uint32_t componentSize = getComponentSize(c.componentType);
+        const uint32_t elementStride = c.byteStride != 0 ? c.byteStride : getElementSize(c.componentType, c.type);
+        BENCHMARK(std::string(c.name) + ", scalar loop") {
+            for (uint32_t element = 0; element < kCount; ++element) {
+                for (uint32_t component = 0; component < numComponents; ++component) {
+                    const uint8_t* componentData = &data[size_t(element) * elementStride + component * componentSize];
+                    const float value = toFloatReference(readReference(componentData, c.componentType), c.componentType, c.normalized);
+                    const size_t outputIdx = size_t(element) * numComponents + component;
+                    if (c.outputType == COMPONENT_FLOAT) {
+                        output[outputIdx] = value;
+                    }
+                    else {
+                        indices[outputIdx] = uint16_t(value);
+                    }
+                }
+            }
+            return output[0] + indices[0];
+        };
+    }
+}
@@ -0,0 +1,239 @@
+#include "pch.h"
+#include "catch2/catch.hpp"
+
+#include <random>
+#include <vector>
+
+#include "Core/JobSystem.h"
+#include "RenderSystems/OcclusionCulling.h"
+
+using namespace bdr;
+
+namespace
+{
+    constexpr uint32_t kWidth = 320;
+    constexpr uint32_t kHeight = 192;
+
+    const std::vector<glm::vec3> kCubePositions = {
+        { -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f },
+        { -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f },
+    };
+    const std::vector<uint32_t> kCubeIndices = {
+        0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 0, 4, 5, 0, 5, 1,
+        3, 2, 6, 3, 6, 7, 0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2,
+    };
+
+    Occluder createBoxOccluder(const glm::vec3& center, const glm::vec3& halfSize)
+    {
+        Occluder occluder;
+        occluder.positions = kCubePositions.data();
+        occluder.indices = kCubeIndices.data();
+        occluder.numIndices = uint32_t(kCubeIndices.size());
+        occluder.transform = glm::translate(glm::mat4(1.0f), center) * glm::scale(glm::mat4(1.0f), halfSize);
+        return occluder;
+    }
+
+    // A wall at z = 0 with a doorway in the middle, seen from 30 units in front of it
+    std::vector<Occluder> createWall()
+    {
+        return {
+            createBoxOccluder({ -12.0f, 5.0f, 0.0f }, { 10.0f, 6.0f, 0.5f }),
+            createBoxOccluder({ 12.0f, 5.0f, 0.0f }, { 10.0f, 6.0f, 0.5f }),
+            createBoxOccluder({ 0.0f, 9.0f, 0.0f }, { 2.0f, 2.0f, 0.5f }),
+        };
+    }
+
+    glm::mat4 getViewProjection()
+    {
+        const glm::mat4 projection = math::perspective(glm::quarter_pi<float>(), float(kWidth), float(kHeight), 1.0f, 1000.0f);
+        const glm::mat4 view = glm::lookAt(glm::vec3{ 0.0f, 2.0f, -30.0f }, glm::vec3{ 0.0f, 2.0f, 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+        return projection * view;
+    }
+
+    // Scalar reference: the nearest 1 / w of every triangle covering the pixel's center. Triangles crossing the
+    // near plane would need clipping, so it's only valid for occluders entirely in front of it.
+    float getReferenceDepth(const OcclusionBuffer& buffer, const std::vector<Occluder>& occluders, const uint32_t x, const uint32_t y)
+    {
+        const glm::vec2 pixel{ float(x) + 0.5f, float(y) + 0.5f };
+        float depth = 0.0f;
+        for (const Occluder& occluder : occluders) {
+            const glm::mat4 transform = buffer.viewProjection * occluder.transform;
+            for (uint32_t i = 0; i < occluder.numIndices; i += 3) {
+                glm::vec3 vertices[3];
+                for (uint32_t v = 0; v < 3; ++v) {
+                    const glm::vec4 clip = transform * glm::vec4{ occluder.positions[occluder.indices[i + v]], 1.0f };
+                    vertices[v] = {
+                        (clip.x / clip.w * 0.5f + 0.5f) * float(buffer.width),
+                        (0.5f - clip.y / clip.w * 0.5f) * float(buffer.height),
+                        1.0f / clip.w,
+                    };
+                }
+
+                const float area = (vertices[1].x - vertices[0].x) * (vertices[2].y - vertices[0].y) -
+                    (vertices[2].x - vertices[0].x) * (vertices[1].y - vertices[0].y);
+                if (std::abs(area) < 1e-6f) {
+                    continue;
+                }
+                float edges[3];
+                for (uint32_t k = 0; k < 3; ++k) {
+                    const glm::vec3& a = vertices[(k + 1) % 3];
+                    const glm::vec3& b = vertices[(k + 2) % 3];
+                    edges[k] = ((a.y - b.y) * pixel.x + (b.x - a.x) * pixel.y + (a.x * b.y - b.x * a.y)) / area;
+                }
+                if (edges[0] >= 0.0f && edges[1] >= 0.0f && edges[2] >= 0.0f) {
+                    depth = std::max(depth, edges[0] * vertices[0].z + edges[1] * vertices[1].z + edges[2] * vertices[2].z);
+                }
+            }
+        }
+        return depth;
+    }
+
+    // Checks the box against every full resolution pixel of its screen rectangle, rather than the Hi-Z pyramid
+    bool isOccludedFullResolution(const OcclusionBuffer& buffer, const AABB& bounds)
+    {
+        glm::vec2 min{ FLT_MAX };
+        glm::vec2 max{ -FLT_MAX };
+        float nearestDepth = 0.0f;
+        for (uint32_t corner = 0; corner < 8; ++corner) {
+            const glm::vec3 position{
+                (corner & 1) ? bounds.max.x : bounds.min.x,
+                (corner & 2) ? bounds.max.y : bounds.min.y,
+                (corner & 4) ? bounds.max.z : bounds.min.z,
+            };
+            const glm::vec4 clip = buffer.viewProjection * glm::vec4{ position, 1.0f };
+            const glm::vec2 screen{
+                (clip.x / clip.w * 0.5f + 0.5f) * float(buffer.width),
+                (0.5f - clip.y / clip.w * 0.5f) * float(buffer.height),
+            };
+            min = glm::min(min, screen);
+            max = glm::max(max, screen);
+            nearestDepth = std::max(nearestDepth, 1.0f / clip.w);
+        }
+
+        const int32_t x0 = std::max(int32_t(min.x), 0);
+        const int32_t y0 = std::max(int32_t(min.y), 0);
+        const int32_t x1 = std::min(int32_t(max.x), int32_t(buffer.width) - 1);
+        const int32_t y1 = std::min(int32_t(max.y), int32_t(buffer.height) - 1);
+        for (int32_t y = y0; y <= y1; ++y) {
+            for (int32_t x = x0; x <= x1; ++x) {
+                if (getDepth(buffer, uint32_t(x), uint32_t(y)) <= nearestDepth) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+TEST_CASE("Occluder depth matches a scalar rasterizer", "[occlusion]")
+{
+    OcclusionBuffer buffer;
+    initOcclusionBuffer(buffer, kWidth, kHeight);
+    std::vector<Occluder> occluders = createWall();
+    // Something rotated, so the edges aren't all axis aligned
+    Occluder rotated = createBoxOccluder({ 6.0f, 1.0f, -10.0f }, { 1.0f, 1.5f, 1.0f });
+    rotated.transform = rotated.transform * glm::rotate(glm::mat4(1.0f), 0.7f, glm::normalize(glm::vec3{ 1.0f, 2.0f, 0.5f }));
+    occluders.push_back(rotated);
+    renderOccluders(buffer, getViewProjection(), occluders.data(), uint32_t(occluders.size()));
+
+    // Edges can land on a pixel center, where the two rasterizers may disagree about which triangle owns it
+    uint32_t numMismatches = 0;
+    uint32_t numCovered = 0;
+    for (uint32_t y = 0; y < kHeight; ++y) {
+        for (uint32_t x = 0; x < kWidth; ++x) {
+            const float expected = getReferenceDepth(buffer, occluders, x, y);
+            const float depth = getDepth(buffer, x, y);
+            numCovered += expected > 0.0f ? 1 : 0;
+            numMismatches += std::abs(depth - expected) > 1e-4f * expected ? 1 : 0;
+        }
+    }
+    CHECK(numCovered > kWidth * kHeight / 4);
+    CHECK(numMismatches == 0);
+
+    // The threaded version produces the same buffer
+    JobSystem jobSystem;
+    OcclusionBuffer threadedBuffer;
+    initOcclusionBuffer(threadedBuffer, kWidth, kHeight);
+    renderOccluders(jobSystem, threadedBuffer, getViewProjection(), occluders.data(), uint32_t(occluders.size()));
+    CHECK(threadedBuffer.depth == buffer.depth);
+    CHECK(threadedBuffer.hiZ == buffer.hiZ);
+}
+
+TEST_CASE("Occlusion tests are conservative", "[occlusion]")
+{
+    OcclusionBuffer buffer;
+    initOcclusionBuffer(buffer, kWidth, kHeight);
+    std::vector<Occluder> occluders = createWall();
+    // A pillar right next to the camera, crossing the near plane, which has to be clipped
+    occluders.push_back(createBoxOccluder({ 1.0f, 0.0f, -28.75f }, { 0.5f, 10.0f, 1.75f }));
+    renderOccluders(buffer, getViewProjection(), occluders.data(), uint32_t(occluders.size()));
+
+    // Boxes scattered around and behind the wall
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    uint32_t numOccluded = 0;
+    uint32_t numNotConservative = 0;
+    constexpr uint32_t kNumBoxes = 20000;
+    for (uint32_t i = 0; i < kNumBoxes; ++i) {
+        const glm::vec3 center{
+            distribution(rng) * 40.0f,
+            1.0f + distribution(rng) * 3.0f,
+            5.0f + (distribution(rng) + 1.0f) * 30.0f,
+        };
+        const AABB bounds{ center - glm::vec3{ 0.5f }, center + glm::vec3{ 0.5f } };
+        if (isOccluded(buffer, bounds)) {
+            ++numOccluded;
+            numNotConservative += isOccludedFullResolution(buffer, bounds) ? 0 : 1;
+        }
+    }
+    CHECK(numNotConservative == 0);
+    // Most of them are behind the wall
+    CHECK(numOccluded > kNumBoxes / 2);
+
+    const AABB inFront{ { -0.5f, 1.0f, -5.0f }, { 0.5f, 2.0f, -4.0f } };
+    const AABB throughDoorway{ { -0.5f, 1.0f, 10.0f }, { 0.5f, 2.0f, 11.0f } };
+    const AABB behindWall{ { -8.5f, 1.0f, 10.0f }, { -7.5f, 2.0f, 11.0f } };
+    const AABB behindPillar{ { 3.8f, 1.8f, -20.2f }, { 4.2f, 2.2f, -19.8f } };
+    const AABB crossingNearPlane{ { -1.0f, 1.0f, -31.0f }, { 1.0f, 3.0f, 40.0f } };
+    CHECK_FALSE(isOccluded(buffer, inFront));
+    CHECK_FALSE(isOccluded(buffer, throughDoorway));
+    CHECK(isOccluded(buffer, behindWall));
+    CHECK(isOccluded(buffer, behindPillar));
+    CHECK_FALSE(isOccluded(buffer, crossingNearPlane));
+}
+
+TEST_CASE("Occlusion culling benchmarks", "[.][benchmark][occlusion]")
+{
+    JobSystem jobSystem;
+    OcclusionBuffer buffer;
+    initOcclusionBuffer(buffer, kWidth, kHeight);
+    const std::vector<Occluder> occluders = createWall();
+    const glm::mat4 viewProjection = getViewProjection();
+
+    BENCHMARK("Render occluders")
+    {
+        renderOccluders(buffer, viewProjection, occluders.data(), uint32_t(occluders.size()));
+        return buffer.hiZ[0];
+    };
+    BENCHMARK("Render occluders, job system")
+    {
+        renderOccluders(jobSystem, buffer, viewProjection, occluders.data(), uint32_t(occluders.size()));
+        return buffer.hiZ[0];
+    };
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<AABB> boxes(10000);
+    for (AABB& bounds : boxes) {
+        const glm::vec3 center{ distribution(rng) * 40.0f, 1.0f + distribution(rng) * 3.0f, 5.0f + (distribution(rng) + 1.0f) * 30.0f };
+        bounds = { center - glm::vec3{ 0.5f }, center + glm::vec3{ 0.5f } };
+    }
+    BENCHMARK("10000 occlusion tests")
+    {
+        uint32_t numOccluded = 0;
+        for (const AABB& bounds : boxes) {
+            numOccluded += isOccluded(buffer, bounds) ? 1 : 0;
+        }
+        return numOccluded;
+    };
+}
@@ -0,0 +1,322 @@
+#include "pch.h"
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Game/AnimationSystem.h"
+#include "Game/ECSRegistry.h"
+#include "Game/SpatialIndex.h"
+
+using namespace bdr;
+
+namespace
+{
+    // 100x100 unit cubes on the ground, with two thirds of them static
+    constexpr uint32_t kGridSize = 100;
+
+    void createCubeGrid(ECSRegistry& registry)
+    {
+        const AABB cube{ glm::vec3{ -0.5f }, glm::vec3{ 0.5f } };
+        for (uint32_t i = 0; i < kGridSize; ++i) {
+            for (uint32_t j = 0; j < kGridSize; ++j) {
+                const uint32_t entity = createEntity(registry);
+                Transform transform{};
+                transform.translation = { 1.5f * (float(i) - 50.0f), 0.0f, 1.5f * (float(j) - 50.0f) };
+                transform.scale = glm::vec3{ 1.0f };
+                transform.mask |= TransformType::Translation;
+                assignTransform(registry, entity, transform);
+                assignBounds(registry, entity, cube);
+                if ((i * j) % 3 != 0) {
+                    registry.cmpMasks[entity] |= CmpMasks::STATIC;
+                }
+            }
+        }
+        updateMatrices(registry);
+    }
+
+    // Returns the height of the subtree
+    int32_t checkSubtree(const DynamicAABBTree& tree, const uint32_t nodeIdx, const uint32_t parent, uint32_t& numLeaves)
+    {
+        const DynamicAABBTree::Node& node = tree.nodes[nodeIdx];
+        REQUIRE(node.parent == parent);
+        if (node.children[0] == kInvalidNode) {
+            ++numLeaves;
+            REQUIRE(tree.entityLeaves[node.entity] == nodeIdx);
+            REQUIRE(math::contains(node.bounds, tree.entityBounds[node.entity]));
+            return 0;
+        }
+
+        const int32_t leftHeight = checkSubtree(tree, node.children[0], nodeIdx, numLeaves);
+        const int32_t rightHeight = checkSubtree(tree, node.children[1], nodeIdx, numLeaves);
+        REQUIRE(node.height == 1 + std::max(leftHeight, rightHeight));
+        REQUIRE(math::contains(node.bounds, tree.nodes[node.children[0]].bounds));
+        REQUIRE(math::contains(node.bounds, tree.nodes[node.children[1]].bounds));
+        return node.height;
+    }
+
+    void checkTree(const DynamicAABBTree& tree)
+    {
+        uint32_t numLeaves = 0;
+        if (tree.root != kInvalidNode) {
+            checkSubtree(tree, tree.root, kInvalidNode, numLeaves);
+        }
+        REQUIRE(numLeaves == tree.numLeaves);
+        // Rotations don't keep the tree strictly balanced, but they keep it from degenerating
+        if (numLeaves > 1) {
+            REQUIRE(float(tree.nodes[tree.root].height) <= 2.0f * std::log2(float(numLeaves)));
+        }
+    }
+
+    math::Frustum getRandomFrustum(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        const glm::vec3 eye{ distribution(rng) * 80.0f, 20.0f + distribution(rng) * 10.0f, distribution(rng) * 80.0f };
+        const glm::vec3 target{ distribution(rng) * 50.0f, 0.0f, distribution(rng) * 50.0f };
+        const glm::mat4 projection = math::perspective(glm::quarter_pi<float>(), 1.25f, 1.0f, 1.0f, 1000.0f);
+        return math::extractFrustum(projection * glm::lookAt(eye, target, glm::vec3{ 0.0f, 1.0f, 0.0f }));
+    }
+
+    std::vector<Ray> getRandomRays(std::mt19937& rng, const uint32_t numRays)
+    {
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        std::vector<Ray> rays(numRays);
+        for (Ray& ray : rays) {
+            ray.origin = { distribution(rng) * 80.0f, 30.0f, distribution(rng) * 80.0f };
+            ray.direction = glm::normalize(glm::vec3{ distribution(rng), -1.0f, distribution(rng) });
+        }
+        return rays;
+    }
+
+    // Brute force versions of the queries, over every entity with bounds
+    void queryFrustumBruteForce(const ECSRegistry& registry, const math::Frustum& frustum, std::vector<uint32_t>& results)
+    {
+        for (uint32_t entity = 0; entity < registry.numEntities; ++entity) {
+            if (math::isAABBInFrustum(frustum, registry.worldBounds[entity])) {
+                results.push_back(entity);
+            }
+        }
+    }
+
+    void queryOverlapBruteForce(const ECSRegistry& registry, const AABB& bounds, std::vector<uint32_t>& results)
+    {
+        for (uint32_t entity = 0; entity < registry.numEntities; ++entity) {
+            if (math::overlaps(registry.worldBounds[entity], bounds)) {
+                results.push_back(entity);
+            }
+        }
+    }
+
+    RayHit raycastBruteForce(const ECSRegistry& registry, const Ray& ray)
+    {
+        RayHit hit;
+        const glm::vec3 invDirection = 1.0f / ray.direction;
+        for (uint32_t entity = 0; entity < registry.numEntities; ++entity) {
+            const AABB& bounds = registry.worldBounds[entity];
+            const glm::vec3 t0 = (bounds.min - ray.origin) * invDirection;
+            const glm::vec3 t1 = (bounds.max - ray.origin) * invDirection;
+            const glm::vec3 tMin = glm::min(t0, t1);
+            const glm::vec3 tMax = glm::max(t0, t1);
+            const float entry = std::max(std::max(std::max(tMin.x, tMin.y), tMin.z), 0.0f);
+            const float exit = std::min(std::min(std::min(tMax.x, tMax.y), tMax.z), ray.maxDistance);
+            if (entry <= exit && entry < hit.distance) {
+                hit.distance = entry;
+                hit.entity = entity;
+            }
+        }
+        return hit;
+    }
+
+    // Lets any time sliced rebuilds run to completion
+    void finishRebuilds(const ECSRegistry& registry, SpatialIndex& index)
+    {
+        for (uint32_t i = 0; i < 1000 && (index.staticBuild.isBuilding || index.reinsertCursor != UINT32_MAX); ++i) {
+            updateSpatialIndex(registry, index);
+        }
+        REQUIRE_FALSE(index.staticBuild.isBuilding);
+        REQUIRE(index.reinsertCursor == UINT32_MAX);
+    }
+}
+
+TEST_CASE("Spatial index queries match brute force as entities move", "[spatial]")
+{
+    ECSRegistry registry;
+    createCubeGrid(registry);
+    SpatialIndex index;
+    updateSpatialIndex(registry, index);
+    finishRebuilds(registry, index);
+    CHECK(index.dynamicTree.numLeaves + index.staticBVH.entities.size() == kGridSize * kGridSize);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<uint32_t> results;
+    std::vector<uint32_t> expected;
+    for (uint32_t frame = 0; frame < 200; ++frame) {
+        for (uint32_t entity = 0; entity < registry.numEntities; ++entity) {
+            if ((registry.cmpMasks[entity] & CmpMasks::STATIC) == 0) {
+                registry.transforms[entity].translation += glm::vec3{ distribution(rng), distribution(rng) * 0.2f, distribution(rng) } * 0.3f;
+            }
+        }
+        // Entities switching between the static and dynamic structures, and a static entity teleporting
+        if (frame == 50) {
+            for (uint32_t entity = 0; entity < 300; ++entity) {
+                registry.cmpMasks[entity] ^= CmpMasks::STATIC;
+            }
+        }
+        if (frame == 80) {
+            registry.transforms[1].translation.y += 5.0f;
+            registry.cmpMasks[1] |= CmpMasks::STATIC;
+        }
+        updateMatrices(registry);
+        updateSpatialIndex(registry, index);
+
+        if (frame % 20 != 0) {
+            continue;
+        }
+        checkTree(index.dynamicTree);
+        // Queries use the previous static BVH until the rebuild is done
+        if (index.staticBuild.isBuilding) {
+            continue;
+        }
+
+        const math::Frustum frustum = getRandomFrustum(rng);
+        results.clear();
+        expected.clear();
+        queryFrustum(index, frustum, results);
+        queryFrustumBruteForce(registry, frustum, expected);
+        std::sort(results.begin(), results.end());
+        CHECK(results == expected);
+
+        AABB bounds;
+        bounds.min = { distribution(rng) * 60.0f, -2.0f, distribution(rng) * 60.0f };
+        bounds.max = bounds.min + glm::vec3{ 10.0f, 4.0f, 10.0f };
+        results.clear();
+        expected.clear();
+        queryOverlap(index, bounds, results);
+        queryOverlapBruteForce(registry, bounds, expected);
+        std::sort(results.begin(), results.end());
+        CHECK(results == expected);
+    }
+
+    // Forcing an incremental rebuild of the dynamic tree
+    index.dynamicBaseCost = 1.0f;
+    const float cost = getCost(index.dynamicTree);
+    updateSpatialIndex(registry, index);
+    REQUIRE(index.reinsertCursor != UINT32_MAX);
+    finishRebuilds(registry, index);
+    checkTree(index.dynamicTree);
+    CHECK(getCost(index.dynamicTree) <= cost);
+
+    const std::vector<Ray> rays = getRandomRays(rng, 1000);
+    std::vector<RayHit> hits(rays.size());
+    raycast(index, rays.data(), uint32_t(rays.size()), hits.data());
+    uint32_t numHits = 0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+        const RayHit expectedHit = raycastBruteForce(registry, rays[i]);
+        REQUIRE(hits[i].distance == Approx(expectedHit.distance).margin(1e-4));
+        numHits += hits[i].entity != UINT32_MAX ? 1 : 0;
+    }
+    CHECK(numHits > 0);
+}
+
+TEST_CASE("Static BVH builds the same tree time sliced", "[spatial]")
+{
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+    std::vector<uint32_t> entities;
+    std::vector<AABB> bounds;
+    for (uint32_t i = 0; i < 5000; ++i) {
+        const glm::vec3 center{ distribution(rng), distribution(rng), distribution(rng) };
+        entities.push_back(i);
+        bounds.push_back({ center - glm::vec3{ 1.0f }, center + glm::vec3{ 1.0f } });
+    }
+
+    StaticBVH bvh;
+    buildStaticBVH(bvh, std::vector<uint32_t>(entities), std::vector<AABB>(bounds));
+
+    StaticBVHBuild build;
+    beginStaticBVHBuild(build, std::move(entities), std::move(bounds));
+    uint32_t numSteps = 1;
+    while (!stepStaticBVHBuild(build, 16)) {
+        ++numSteps;
+    }
+    CHECK(numSteps > 1);
+    REQUIRE(build.bvh.nodes.size() == bvh.nodes.size());
+    CHECK(build.bvh.entities == bvh.entities);
+    for (size_t i = 0; i < bvh.nodes.size(); ++i) {
+        REQUIRE(build.bvh.nodes[i].first == bvh.nodes[i].first);
+        REQUIRE(build.bvh.nodes[i].count == bvh.nodes[i].count);
+    }
+}
+
+TEST_CASE("Spatial index benchmarks", "[.][benchmark][spatial]")
+{
+    // Queries per second is the query count over the reported mean
+    ECSRegistry registry;
+    createCubeGrid(registry);
+    SpatialIndex index;
+    updateSpatialIndex(registry, index);
+    finishRebuilds(registry, index);
+
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    const std::vector<Ray> rays = getRandomRays(rng, 1000);
+    std::vector<RayHit> hits(rays.size());
+    std::vector<math::Frustum> frustums;
+    for (uint32_t i = 0; i < 20; ++i) {
+        frustums.push_back(getRandomFrustum(rng));
+    }
+    std::vector<AABB> overlapBounds(1000);
+    for (AABB& bounds : overlapBounds) {
+        bounds.min = { distribution(rng) * 70.0f, -2.0f, distribution(rng) * 70.0f };
+        bounds.max = bounds.min + glm::vec3{ 4.0f };
+    }
+    std::vector<uint32_t> results;
+    results.reserve(registry.numEntities);
+
+    BENCHMARK("1000 rays, spatial index")
+    {
+        raycast(index, rays.data(), uint32_t(rays.size()), hits.data());
+        return hits[0].distance;
+    };
+    BENCHMARK("1000 rays, brute force")
+    {
+        for (size_t i = 0; i < rays.size(); ++i) {
+            hits[i] = raycastBruteForce(registry, rays[i]);
+        }
+        return hits[0].distance;
+    };
+    BENCHMARK("20 frustums, spatial index")
+    {
+        results.clear();
+        for (const math::Frustum& frustum : frustums) {
+            queryFrustum(index, frustum, results);
+        }
+        return results.size();
+    };
+    BENCHMARK("20 frustums, brute force")
+    {
+        results.clear();
+        for (const math::Frustum& frustum : frustums) {
+            queryFrustumBruteForce(registry, frustum, results);
+        }
+        return results.size();
+    };
+    BENCHMARK("1000 overlaps, spatial index")
+    {
+        results.clear();
+        for (const AABB& bounds : overlapBounds) {
+            queryOverlap(index, bounds, results);
+        }
+        return results.size();
+    };
+    BENCHMARK("1000 overlaps, brute force")
+    {
+        results.clear();
+        for (const AABB& bounds : overlapBounds) {
+            queryOverlapBruteForce(registry, bounds, results);
+        }
+        return results.size();
+    };
+}
@@ -0,0 +1,224 @@
+#include "pch.h"
+#include "catch2/catch.hpp"
+
+#include <map>
+#include <random>
+#include <vector>
+
+#include "Core/TlsfAllocator.h"
+
+using namespace bdr;
+
+namespace
+{
+    // Live allocations by offset, to their size
+    typedef std::map<uint32_t, uint32_t> ReferenceAllocations;
+
+    // Free neighbours are merged, so the allocator's free blocks are exactly the gaps between allocations
+    AllocatorStats getReferenceStats(const ReferenceAllocations& allocations, const uint32_t size)
+    {
+        AllocatorStats stats{};
+        stats.size = size;
+        stats.numAllocations = uint32_t(allocations.size());
+        uint32_t end = 0;
+        auto addGap = [&](const uint32_t gap) {
+            if (gap > 0) {
+                stats.largestFreeBlock = std::max(stats.largestFreeBlock, gap);
+                ++stats.numFreeBlocks;
+            }
+        };
+        for (const auto& allocation : allocations) {
+            addGap(allocation.first - end);
+            end = allocation.first + allocation.second;
+            stats.usedSize += allocation.second;
+        }
+        addGap(size - end);
+        stats.freeSize = size - stats.usedSize;
+        if (stats.freeSize > 0) {
+            stats.fragmentation = 1.0f - float(stats.largestFreeBlock) / float(stats.freeSize);
+        }
+        return stats;
+    }
+
+    void checkAllocations(const TlsfAllocator& allocator, const ReferenceAllocations& allocations)
+    {
+        uint32_t end = 0;
+        bool overlaps = false;
+        for (const auto& allocation : allocations) {
+            overlaps |= allocation.first < end;
+            end = allocation.first + allocation.second;
+        }
+        REQUIRE_FALSE(overlaps);
+        REQUIRE(end <= allocator.getSize());
+
+        const AllocatorStats stats = allocator.getStats();
+        const AllocatorStats expected = getReferenceStats(allocations, allocator.getSize());
+        REQUIRE(stats.usedSize == expected.usedSize);
+        REQUIRE(stats.freeSize == expected.freeSize);
+        REQUIRE(stats.numAllocations == expected.numAllocations);
+        REQUIRE(stats.numFreeBlocks == expected.numFreeBlocks);
+        REQUIRE(stats.largestFreeBlock == expected.largestFreeBlock);
+        REQUIRE(stats.fragmentation == Approx(expected.fragmentation));
+    }
+
+    // Mostly small sizes, with the occasional large one
+    uint32_t getRandomSize(std::mt19937& rng)
+    {
+        return 1 + (rng() % 4 == 0 ? rng() % 20000 : rng() % 300);
+    }
+
+    // Stands in for a GPU buffer: every unit holds the offset its allocation was made at, so moved allocations can
+    // be told apart from stale copies
+    struct StubDevice
+    {
+        std::vector<uint32_t> memory;
+
+        void write(const uint32_t offset, const uint32_t size)
+        {
+            std::fill(memory.begin() + offset, memory.begin() + offset + size, offset);
+        }
+
+        // Moves come in increasing offset order and only move allocations down, so copying them in order never
+        // overwrites a range that still has to be read
+        void apply(const std::vector<AllocationMove>& moves)
+        {
+            for (const AllocationMove& move : moves) {
+                std::copy(memory.begin() + move.from, memory.begin() + move.from + move.size, memory.begin() + move.to);
+            }
+        }
+    };
+}
+
+TEST_CASE("TLSF allocations match a reference map", "[tlsf]")
+{
+    constexpr uint32_t kSize = 1u << 20;
+    TlsfAllocator allocator;
+    allocator.init(kSize);
+    ReferenceAllocations allocations;
+    std::mt19937 rng(5);
+
+    // Mostly allocates, until the range is full. Then frees at random until half of it is free again.
+    uint32_t numFailures = 0;
+    bool isDraining = false;
+    for (uint32_t op = 0; op < 200000; ++op) {
+        if (!isDraining && (allocations.empty() || rng() % 3 != 0)) {
+            const uint32_t size = getRandomSize(rng);
+            const uint32_t offset = allocator.allocate(size);
+            if (offset == kInvalidAllocation) {
+                // Rounding the size up to its free list can skip blocks barely large enough, never ones twice as large
+                REQUIRE(allocator.getStats().largestFreeBlock < 2 * size);
+                ++numFailures;
+                isDraining = true;
+            }
+            else {
+                REQUIRE(allocations.count(offset) == 0);
+                allocations[offset] = size;
+            }
+        }
+        else {
+            auto it = allocations.begin();
+            std::advance(it, rng() % allocations.size());
+            allocator.free(it->first);
+            allocations.erase(it);
+            isDraining &= allocator.getStats().usedSize > kSize / 2;
+        }
+
+        if (op % 1000 == 0) {
+            checkAllocations(allocator, allocations);
+        }
+    }
+    checkAllocations(allocator, allocations);
+    // The range fills up over and over
+    CHECK(numFailures > 10);
+
+    for (const auto& allocation : allocations) {
+        allocator.free(allocation.first);
+    }
+    allocations.clear();
+    checkAllocations(allocator, allocations);
+    CHECK(allocator.getStats().numFreeBlocks == 1);
+    CHECK(allocator.getStats().largestFreeBlock == kSize);
+}
+
+TEST_CASE("TLSF compaction packs allocations in order", "[tlsf]")
+{
+    constexpr uint32_t kSize = 1u << 18;
+    TlsfAllocator allocator;
+    allocator.init(kSize);
+    ReferenceAllocations allocations;
+    StubDevice device;
+    device.memory.assign(kSize, UINT32_MAX);
+    std::mt19937 rng(7);
+
+    // Fragment the range: fill it, then free a random half
+    for (;;) {
+        const uint32_t size = getRandomSize(rng);
+        const uint32_t offset = allocator.allocate(size);
+        if (offset == kInvalidAllocation) {
+            break;
+        }
+        allocations[offset] = size;
+    }
+    for (auto it = allocations.begin(); it != allocations.end();) {
+        if (rng() % 2 == 0) {
+            allocator.free(it->first);
+            it = allocations.erase(it);
+        }
+        else {
+            device.write(it->first, it->second);
+            ++it;
+        }
+    }
+    checkAllocations(allocator, allocations);
+    REQUIRE(allocator.getStats().fragmentation > 0.5f);
+
+    std::vector<AllocationMove> moves;
+    allocator.compact(moves);
+    device.apply(moves);
+
+    // Every allocation ends up right after the previous one, and only the ones that changed offset are moves
+    ReferenceAllocations compacted;
+    uint32_t cursor = 0;
+    size_t moveIdx = 0;
+    for (const auto& allocation : allocations) {
+        if (allocation.first != cursor) {
+            REQUIRE(moveIdx < moves.size());
+            CHECK(moves[moveIdx].from == allocation.first);
+            CHECK(moves[moveIdx].to == cursor);
+            CHECK(moves[moveIdx].size == allocation.second);
+            ++moveIdx;
+        }
+        // The allocation's contents followed it
+        const auto contents = device.memory.begin() + cursor;
+        REQUIRE(std::all_of(contents, contents + allocation.second, [&](const uint32_t unit) { return unit == allocation.first; }));
+        compacted[cursor] = allocation.second;
+        cursor += allocation.second;
+    }
+    CHECK(moveIdx == moves.size());
+    checkAllocations(allocator, compacted);
+
+    const AllocatorStats stats = allocator.getStats();
+    CHECK(stats.numFreeBlocks == 1);
+    CHECK(stats.largestFreeBlock == kSize - cursor);
+    CHECK(stats.fragmentation == 0.0f);
+
+    // The compacted allocator keeps working
+    for (const auto& allocation : compacted) {
+        allocator.free(allocation.first);
+    }
+    CHECK(allocator.getStats().largestFreeBlock == kSize);
+}
+
+TEST_CASE("TLSF fills its range exactly", "[tlsf]")
+{
+    TlsfAllocator allocator;
+    allocator.init(1000);
+    const uint32_t offset = allocator.allocate(1000);
+    CHECK(offset == 0);
+    CHECK(allocator.allocate(1) == kInvalidAllocation);
+    allocator.free(offset);
+    CHECK(allocator.allocate(1000) == 0);
+
+    allocator.init(0);
+    CHECK(allocator.allocate(5) == kInvalidAllocation);
+}
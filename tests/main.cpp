@@ -0,0 +1,4 @@
+// Catch2 supplies main(). Benchmarks are tagged [.][benchmark], so they only run when asked for:
+//   tests "[benchmark]"
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"